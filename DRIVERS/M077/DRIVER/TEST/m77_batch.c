@@ -0,0 +1,176 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m77_batch.c
+ *
+ *      \author  ts
+ *
+ *  	 \brief  Verification helper for the batched I/O of the control
+ *				 device /dev/m77ctl: echoes the data received on a set of
+ *				 channels back on the same channel, with one M77_BATCH_IO
+ *				 per round for all of them, and counts the calls made.
+ *
+ *				 Build on Commandline using:
+ *				 gcc -Wall -O2 -o m77_batch m77_batch.c
+ *
+ *     Switches: -
+ *
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2003-2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include "../serial_m77.h"
+
+#define MAX_LINES	64
+#define BUF_SIZE	256
+
+static volatile int G_stop;
+
+/***********************************************************************/
+/*
+ * Display Program usage
+ */
+static void usage(void)
+{
+	printf(" m77_batch [-t ms] line [line ...]\n");
+	printf(" echoes the received data of /dev/ttyD<line> back, until ^C\n");
+	printf(" -t   wait timeout per round in ms, default 1000\n");
+	printf(" -h   help, dumps this usage text\n");
+	exit(1);
+}
+
+static void sig_handler(int sig)
+{
+	(void)sig;
+	G_stop = 1;
+}
+
+
+/***********************************************************************/
+/*
+ * the only main function
+ *
+ */
+int main(int argc, char *argv[])
+{
+	static unsigned char buf[MAX_LINES][BUF_SIZE];
+	struct m77_batch_entry ent[2 * MAX_LINES];
+	struct m77_batch_lines bl;
+	struct m77_batch b;
+	unsigned int line[MAX_LINES], num = 0, nent, nwr, i;
+	unsigned long calls = 0, rx = 0, tx = 0;
+	unsigned int tmo = 1000;
+	char name[32];
+	int option, ctl, fd;
+
+	while ((option = getopt(argc, argv, "ht:")) >= 0) {
+		switch (option) {
+		case 't':
+			tmo = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+
+	memset(&bl, 0, sizeof(bl));
+	for (; optind < argc && num < MAX_LINES; optind++) {
+		line[num] = atoi(argv[optind]);
+		if (line[num] >= MAX_LINES)
+			usage();
+
+		/* the channels stay open until the program ends */
+		sprintf(name, "/dev/ttyD%u", line[num]);
+		if ((fd = open(name, O_RDWR | O_NOCTTY)) < 0) {
+			printf("*** can't open %s\n", name);
+			exit(1);
+		}
+		bl.lines[line[num] / 32] |= 1U << (line[num] % 32);
+		num++;
+	}
+	if (!num)
+		usage();
+
+	if ((ctl = open("/dev/" M77_CTL_NAME, O_RDWR)) < 0) {
+		printf("*** can't open /dev/%s\n", M77_CTL_NAME);
+		exit(1);
+	}
+	if (ioctl(ctl, M77_BATCH_ATTACH, &bl)) {
+		printf("*** M77_BATCH_ATTACH failed\n");
+		exit(1);
+	}
+	for (i = 0; i < num; i++)
+		if (!(bl.lines[line[i] / 32] & (1U << (line[i] % 32))))
+			printf("*** ttyD%u not attached (mode in use?)\n", line[i]);
+
+	signal(SIGINT, sig_handler);
+
+	/* round 1 reads only, then the data read is written back */
+	nent = 0;
+	while (!G_stop) {
+		nwr = nent;
+		for (i = 0; i < num; i++) {
+			ent[nent].line 	= line[i];
+			ent[nent].dir 	= M77_BATCH_READ;
+			ent[nent].len 	= BUF_SIZE;
+			ent[nent].buf 	= (unsigned long)buf[i];
+			nent++;
+		}
+
+		memset(&b, 0, sizeof(b));
+		b.num 		= nent;
+		b.flags 	= nwr ? 0 : M77_BATCH_WAIT;	/* don't delay writes */
+		b.timeoutMs = tmo;
+		b.entries 	= (unsigned long)ent;
+		if (ioctl(ctl, M77_BATCH_IO, &b))
+			break;
+		calls++;
+
+		/* the writes are in front of the reads */
+		for (i = 0; i < nwr; i++)
+			if (ent[i].result > 0)
+				tx += ent[i].result;
+
+		/* turn the reads into writes for the next round */
+		nent = 0;
+		for (i = b.num - num; i < b.num; i++) {
+			if (ent[i].result <= 0)
+				continue;
+			rx += ent[i].result;
+			ent[nent] = ent[i];
+			ent[nent].dir = M77_BATCH_WRITE;
+			ent[nent].len = ent[i].result;
+			nent++;
+		}
+	}
+
+	printf("%lu M77_BATCH_IO calls, %lu chars read, %lu written\n",
+		   calls, rx, tx);
+
+	memset(&bl, 0, sizeof(bl));
+	ioctl(ctl, M77_BATCH_ATTACH, &bl);
+	close(ctl);
+	return 0;
+}
@@ -0,0 +1,172 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m77_bpf.c
+ *
+ *      \author  ts
+ *
+ *  	 \brief  Attaches a BPF receive filter to a channel and shows its
+ *				 hit counters. Either a classic filter built from the
+ *				 options (address match on the 1st char, truncation) or
+ *				 an eBPF socket filter pinned in the BPF filesystem, e.g.
+ *				 with bpftool prog load filter.o /sys/fs/bpf/m77.
+ *				 The frames are cut by the idle gap or Modbus RTU mode.
+ *				 The filter is detached on the last close of the tty, so
+ *				 run it while the application has the tty open. Attaching
+ *				 needs CAP_NET_ADMIN.
+ *
+ *				 Build on Commandline using:
+ *				 gcc -Wall -O2 -o m77_bpf m77_bpf.c
+ *
+ *     Switches: -
+ *
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2003-2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/filter.h>
+#include <linux/bpf.h>
+#include "../serial_m77.h"
+
+/***********************************************************************/
+/*
+ * Display Program usage
+ */
+static void usage(void)
+{
+	printf(" m77_bpf [-a addr] [-t len] line\n");
+	printf(" m77_bpf -p pinned line\n");
+	printf(" m77_bpf -r | -s line\n");
+	printf(" filters the frames received on /dev/ttyD<line>\n");
+	printf(" -a   pass frames with 1st char addr only\n");
+	printf(" -t   truncate frames to len chars\n");
+	printf(" -p   attach the eBPF socket filter pinned at path\n");
+	printf(" -r   detach the filter\n");
+	printf(" -s   show the hit counters\n");
+	printf(" -h   help, dumps this usage text\n");
+	exit(1);
+}
+
+/*
+ * fd of a pinned eBPF program
+ */
+static int bpf_obj_get(const char *path)
+{
+	union bpf_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.pathname = (unsigned long)path;
+	return syscall(__NR_bpf, BPF_OBJ_GET, &attr, sizeof(attr));
+}
+
+
+/***********************************************************************/
+/*
+ * the only main function
+ *
+ */
+int main(int argc, char *argv[])
+{
+	struct sock_filter insns[4];
+	struct m77_bpf b;
+	unsigned int n = 0, keep = 0xffffffff;
+	int option, fd, addr = -1, show = 0;
+	char *pinned = NULL, name[32];
+
+	memset(&b, 0, sizeof(b));
+	b.type = M77_BPF_CLASSIC;
+	while ((option = getopt(argc, argv, "ha:t:p:rs")) >= 0) {
+		switch (option) {
+		case 'a':
+			addr = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			keep = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			pinned = optarg;
+			b.type = M77_BPF_EBPF;
+			break;
+		case 'r':
+			b.type = M77_BPF_NONE;
+			break;
+		case 's':
+			show = 1;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind >= argc)
+		usage();
+
+	sprintf(name, "/dev/ttyD%s", argv[optind]);
+	if ((fd = open(name, O_RDWR | O_NOCTTY)) < 0) {
+		printf("*** can't open %s\n", name);
+		exit(1);
+	}
+
+	if (show) {
+		if (ioctl(fd, M77_BPF_GET, &b)) {
+			perror("*** M77_BPF_GET");
+			exit(1);
+		}
+		printf("%s filter, %u frames: %u passed, %u truncated, "
+			   "%u dropped\n", b.type == M77_BPF_EBPF ? "eBPF" : 
+			   b.type == M77_BPF_CLASSIC ? "classic" : "no", 
+			   b.runs, b.passed, b.truncated, b.dropped);
+		close(fd);
+		return 0;
+	}
+
+	if (b.type == M77_BPF_EBPF) {
+		if ((b.fd = bpf_obj_get(pinned)) < 0) {
+			printf("*** can't get the program pinned at %s\n", pinned);
+			exit(1);
+		}
+	} else if (b.type == M77_BPF_CLASSIC) {
+		/* A = 1st char, other address: ret 0 */
+		if (addr >= 0) {
+			insns[n++] = (struct sock_filter)
+				BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 0);
+			insns[n++] = (struct sock_filter)
+				BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, addr, 0, 1);
+		}
+		insns[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, keep);
+		if (addr >= 0)
+			insns[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, 0);
+		b.len 	= n;
+		b.insns = (unsigned long)insns;
+	}
+
+	if (ioctl(fd, M77_BPF_SET, &b)) {
+		perror("*** M77_BPF_SET");
+		exit(1);
+	}
+	if (b.type == M77_BPF_EBPF)
+		close(b.fd);	/* the driver holds its own reference */
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,190 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m77_crccheck.c
+ *
+ *      \author  ts
+ *
+ *  	 \brief  Known answer check of the CRC types the driver checks on
+ *				 received frames. The driver runs crc16(), crc_itu_t() and
+ *				 crc32_le() of the kernel over a frame and its CRC and
+ *				 compares the register against M77_CRC*_RES; this checks
+ *				 those residues and init values with bitwise reference
+ *				 CRCs, also with the frame split into chunks.
+ *
+ *				 Build on Commandline using:
+ *				 gcc -Wall -o m77_crccheck m77_crccheck.c
+ *
+ *     Switches: -
+ *
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2003-2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * As in serial_m77.c: the register is preset with init, the kernel
+ * functions used there apply no final XOR.
+ */
+#define M77_CRC16_MODBUS_POLY	0xa001		/* 0x8005 reflected			*/
+#define M77_CRC16_CCITT_POLY	0x1021
+#define M77_CRC32_POLY			0xedb88320	/* 0x04c11db7 reflected		*/
+
+/* register over frame + its CRC (as sent) of a good frame, serial_m77.c */
+#define M77_CRC16_MODBUS_RES	0x0000
+#define M77_CRC16_CCITT_RES		0x0000
+#define M77_CRC32_RES			0xdebb20e3
+
+
+/***********************************************************************/
+/*
+ * bitwise reference implementations, same register semantics as
+ * crc16(), crc_itu_t() and crc32_le() of the kernel
+ */
+static unsigned int crc16_modbus_bit(unsigned int crc,
+									 const unsigned char *buf,
+									 unsigned int len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *buf++;
+		for (i = 0; i < 8; i++)
+			crc = (crc & 1) ? (crc >> 1) ^ M77_CRC16_MODBUS_POLY : crc >> 1;
+	}
+	return crc;
+}
+
+static unsigned int crc16_ccitt_bit(unsigned int crc,
+									const unsigned char *buf,
+									unsigned int len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *buf++ << 8;
+		for (i = 0; i < 8; i++)
+			crc = (crc & 0x8000) ? (crc << 1) ^ M77_CRC16_CCITT_POLY : crc << 1;
+		crc &= 0xffff;
+	}
+	return crc;
+}
+
+static unsigned int crc32_bit(unsigned int crc,
+							  const unsigned char *buf,
+							  unsigned int len)
+{
+	int i;
+
+	while (len--) {
+		crc ^= *buf++;
+		for (i = 0; i < 8; i++)
+			crc = (crc & 1) ? (crc >> 1) ^ M77_CRC32_POLY : crc >> 1;
+	}
+	return crc;
+}
+
+typedef unsigned int (*CRC_FUNC)(unsigned int, const unsigned char *,
+								 unsigned int);
+
+static const struct {
+	const char *name;
+	CRC_FUNC	func;
+	unsigned int init;		/* as men_uart_crc_preset() */
+	unsigned int xorOut;
+	unsigned int check;		/* CRC of "123456789" */
+	unsigned int res;		/* register after frame + CRC */
+	int			msbFirst;	/* CRC sent high byte first */
+	unsigned int bytes;
+} G_crc[] = {
+	{ "CRC-16/MODBUS", crc16_modbus_bit, 0xffff, 0, 0x4b37,
+	  M77_CRC16_MODBUS_RES, 0, 2 },
+	{ "CRC-16/CCITT ", crc16_ccitt_bit, 0xffff, 0, 0x29b1,
+	  M77_CRC16_CCITT_RES, 1, 2 },
+	{ "CRC-32       ", crc32_bit, 0xffffffff, 0xffffffff, 0xcbf43926,
+	  M77_CRC32_RES, 0, 4 },
+};
+
+#define NUM_CRCS (sizeof(G_crc) / sizeof(G_crc[0]))
+
+
+/***********************************************************************/
+/*
+ * check a CRC type against check value and residue; frame + CRC is also
+ * split at each position, as the driver gets it in chunks
+ */
+static int check_crc(unsigned int k)
+{
+	unsigned char frame[16];
+	unsigned int crc, i, len = 9;
+
+	memcpy(frame, "123456789", len);
+	crc = G_crc[k].func(G_crc[k].init, frame, len) ^ G_crc[k].xorOut;
+	if (crc != G_crc[k].check) {
+		printf("*** %s: check value 0x%x, expected 0x%x\n",
+			   G_crc[k].name, crc, G_crc[k].check);
+		return 1;
+	}
+
+	/* append the CRC as sent on the line */
+	for (i = 0; i < G_crc[k].bytes; i++)
+		frame[len + i] = G_crc[k].msbFirst ?
+			crc >> (8 * (G_crc[k].bytes - 1 - i)) : crc >> (8 * i);
+	len += G_crc[k].bytes;
+
+	for (i = 0; i <= len; i++) {
+		crc = G_crc[k].func(G_crc[k].init, frame, i);
+		crc = G_crc[k].func(crc, frame + i, len - i);
+		if (crc != G_crc[k].res) {
+			printf("*** %s: residue 0x%x split at %u, expected 0x%x\n",
+				   G_crc[k].name, crc, i, G_crc[k].res);
+			return 1;
+		}
+	}
+
+	/* a corrupted frame must not leave the residue */
+	frame[3] ^= 0x01;
+	crc = G_crc[k].func(G_crc[k].init, frame, len);
+	if (crc == G_crc[k].res) {
+		printf("*** %s: bad frame leaves the residue\n", G_crc[k].name);
+		return 1;
+	}
+
+	printf(" %s check 0x%08x residue 0x%08x ok\n", G_crc[k].name,
+		   G_crc[k].check, G_crc[k].res);
+	return 0;
+}
+
+
+/***********************************************************************/
+/*
+ * the only main function
+ *
+ */
+int main(void)
+{
+	unsigned int k;
+	int errors = 0;
+
+	for (k = 0; k < NUM_CRCS; k++)
+		errors += check_crc(k);
+
+	return errors ? 1 : 0;
+}
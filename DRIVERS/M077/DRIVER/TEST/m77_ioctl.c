@@ -38,7 +38,9 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <string.h>
 #include <sys/ioctl.h>
+#include <linux/serial.h>
 #include "../serial_m77.h"
 
 
@@ -55,6 +57,8 @@ void usage(void)
 	printf("Example for M45N specific ioctls (Tristate control):\n");
 	printf(" m77_ioctl /dev/ttyDn -t 1    set Chan. n to Tristate\n");
 	printf(" m77_ioctl /dev/ttyDn -t 0    set Chan. n to normal Operation\n");
+	printf(" m77_ioctl /dev/ttyDn -T 20   auto Tristate, 20us guard time\n");
+	printf(" m77_ioctl /dev/ttyDn -T off  manual Tristate control\n");
 	printf("\n");
 
 	printf("Example for M77 specific ioctls (physical Mode Control):\n");
@@ -64,6 +68,112 @@ void usage(void)
 	printf(" m77_ioctl /dev/ttyDn -p 4    RS485 Fullduplex\n");
 	printf(" m77_ioctl /dev/ttyDn -p 7    RS232\n");
 
+	printf("Example for in-band flow control (XON/XOFF sequences):\n");
+	printf(" m77_ioctl /dev/ttyDn -x 0        XON1/XOFF1 only (default)\n");
+	printf(" m77_ioctl /dev/ttyDn -x 0x11,0x13  set XON2/XOFF2 sequence\n");
+	printf(" m77_ioctl /dev/ttyDn -i          show recognized XOFF count\n");
+	printf("\n");
+
+	printf("Example for 9-bit multidrop address filtering:\n");
+	printf(" m77_ioctl /dev/ttyDn -a 0x12       station address 0x12\n");
+	printf(" m77_ioctl /dev/ttyDn -a 0x12,0xff  addresses 0x12 and 0xff\n");
+	printf(" m77_ioctl /dev/ttyDn -a off        back to 8 bit operation\n");
+	printf("\n");
+
+	printf("Example for delimiter wakeup (read returns on frame end):\n");
+	printf(" m77_ioctl /dev/ttyDn -e 0x0a        wake up on LF\n");
+	printf(" m77_ioctl /dev/ttyDn -e 0x03,2000   wake up on ETX or 2ms idle\n");
+	printf(" m77_ioctl /dev/ttyDn -e off         back to normal operation\n");
+	printf("\n");
+
+	printf("Example for gapless frame transmission:\n");
+	printf(" m77_ioctl /dev/ttyDn -f 0     frame TX mode, default TX trigger\n");
+	printf(" m77_ioctl /dev/ttyDn -f 112   frame TX mode, TX trigger 112\n");
+	printf(" m77_ioctl /dev/ttyDn -f off   normal TX mode\n");
+	printf(" m77_ioctl /dev/ttyDn -F       show frame/underrun counters\n");
+	printf("\n");
+
+	printf("Example for Modbus RTU frame mode:\n");
+	printf(" m77_ioctl /dev/ttyDn -M 1   RTU mode, bad frames marked\n");
+	printf(" m77_ioctl /dev/ttyDn -M 2   RTU mode, bad frames discarded\n");
+	printf(" m77_ioctl /dev/ttyDn -M 0   RTU mode off\n");
+	printf(" m77_ioctl /dev/ttyDn -I     show RTU counters and frame infos\n");
+	printf("\n");
+
+	printf("Example for idle gap telegram mode:\n");
+	printf(" m77_ioctl /dev/ttyDn -g 22b     telegrams end after 22 bit times\n");
+	printf(" m77_ioctl /dev/ttyDn -g 500us   telegrams end after 500us idle\n");
+	printf(" m77_ioctl /dev/ttyDn -g off     idle gap mode off\n");
+	printf(" m77_ioctl /dev/ttyDn -G         show counters and frame infos\n");
+	printf(" m77_ioctl /dev/ttyDn -K 3       check CRC-32 of each telegram\n");
+	printf(" m77_ioctl /dev/ttyDn -K 1,drop  CRC-16/MODBUS, drop bad frames\n");
+	printf(" m77_ioctl /dev/ttyDn -K 0       no CRC check\n");
+	printf(" m77_ioctl /dev/ttyDn -L         show CRC counters\n");
+	printf("\n");
+
+	printf("Example for time triggered transmission:\n");
+	printf(" m77_ioctl /dev/ttyDn -S 0,10000,0,0103000a  slot 0: every 10ms\n");
+	printf(" m77_ioctl /dev/ttyDn -S 1,5000,2500,0203    slot 1: 5ms, phase 2.5ms\n");
+	printf(" m77_ioctl /dev/ttyDn -S 0,off               remove slot 0\n");
+	printf(" m77_ioctl /dev/ttyDn -Q 0                   show/clear slot 0 timing\n");
+	printf("\n");
+
+	printf("Example for the priority TX queue:\n");
+	printf(" m77_ioctl /dev/ttyDn -P 0110ff   send 3 bytes ahead of written data\n");
+	printf(" m77_ioctl /dev/ttyDn -R          show/clear queueing latencies\n");
+	printf("\n");
+
+	printf("Example for LIN master (19200 baud set with stty before):\n");
+	printf(" m77_ioctl /dev/ttyDn -l 0x10,0,4,10000 -l 0x20,1,2,10000,0102\n");
+	printf("              table: read 4 bytes from ID 0x10, send 0102 to\n");
+	printf("              ID 0x20, 10ms slots (-l adds one entry)\n");
+	printf(" m77_ioctl /dev/ttyDn -n 1   run the table cyclic\n");
+	printf(" m77_ioctl /dev/ttyDn -n 2   run the table once\n");
+	printf(" m77_ioctl /dev/ttyDn -n 0   LIN master off\n");
+	printf(" m77_ioctl /dev/ttyDn -N     show LIN counters and results\n");
+	printf("\n");
+
+	printf("Example for the port-to-port bridge (both ports kept open by -k):\n");
+	printf(" m77_ioctl -d /dev/ttyD1 -k &\n");
+	printf(" m77_ioctl -d /dev/ttyD0 -B 1,bidir,flow -k  ttyD0 <-> ttyD1\n");
+	printf(" m77_ioctl -d /dev/ttyD0 -B 1                ttyD0 RX -> ttyD1 TX\n");
+	printf(" m77_ioctl /dev/ttyDn -B off  remove the bridge\n");
+	printf(" m77_ioctl /dev/ttyDn -b     show bridge counters\n");
+	printf("\n");
+
+	printf("Example for port groups:\n");
+	printf(" m77_ioctl /dev/ttyDn -j 0:0,1,2,8  group 0: ttyD0-2 and ttyD8\n");
+	printf(" m77_ioctl /dev/ttyDn -J 0:0103ff   send 3 bytes on group 0\n");
+	printf("\n");
+
+	printf("Example for RX time stamps:\n");
+	printf(" m77_ioctl /dev/ttyDn -z 1   stamp the chars of each RX interrupt\n");
+	printf(" m77_ioctl /dev/ttyDn -z 0   no RX time stamps\n");
+	printf(" m77_ioctl /dev/ttyDn -Z     show the queued stamps\n");
+	printf("\n");
+
+	printf("Example for modem status events (tty kept open by -k):\n");
+	printf(" m77_ioctl /dev/ttyDn -y 1 -k        queue time stamped MSR changes\n");
+	printf(" m77_ioctl /dev/ttyDn -y 0,pps -k    DCD as PPS source, assert on\n");
+	printf("                                     DCD active (,clear: inactive)\n");
+	printf(" m77_ioctl /dev/ttyDn -y 0           events and PPS off\n");
+	printf(" m77_ioctl /dev/ttyDn -Y             show the queued events\n");
+	printf("\n");
+
+	printf("Example for echo cancellation in HD modes:\n");
+	printf(" m77_ioctl /dev/ttyDn -c 1   drop echoes of sent chars\n");
+	printf(" m77_ioctl /dev/ttyDn -c 2   same, pass collisions as errors\n");
+	printf(" m77_ioctl /dev/ttyDn -c 0   echo cancellation off\n");
+	printf(" m77_ioctl /dev/ttyDn -C     show echo/collision counters\n");
+	printf("\n");
+
+	printf("Example for standard RS485 settings (TIOCSRS485):\n");
+	printf(" m77_ioctl /dev/ttyDn -r 0,0      RS485, UART switches driver\n");
+	printf(" m77_ioctl /dev/ttyDn -r 1,2,1    RTS delays 1/2ms, RX during TX\n");
+	printf(" m77_ioctl /dev/ttyDn -r off      back to previous PHY mode\n");
+	printf(" m77_ioctl /dev/ttyDn -q          show and clear turnaround times\n");
+	printf("\n");
+
 	printf("Example for M77 specific ioctls (Echo suppression in HD):\n");
 	printf(" m77_ioctl /dev/ttyDn -s 0  suppress echo (DCR[RX_EN] = 0)\n");
 	printf(" m77_ioctl /dev/ttyDn -s 1  Enable echo (DCR[RX_EN]   = 1)\n");
@@ -93,6 +203,37 @@ int main(int argc, char *argv[])
 	int retval 	= 0;
 	int nverbose = 0;
 	int nkeypress = 0;
+	unsigned int xon2, xoff2;
+	struct m77_inband inband;
+	struct m77_multidrop mdrop;
+	struct m77_delim delim;
+	struct serial_rs485 rs485;
+	struct m77_echo echoc;
+	struct m45_tri_auto triauto;
+	struct m77_frametx frametx;
+	struct m77_rtu rtu;
+	struct m77_frame_info finfo;
+	struct m77_idle idle;
+	struct m77_crc crc;
+	struct m77_sched_slot sched;
+	struct m77_sched_stat sstat;
+	char *hex;
+	struct m77_lin lin;
+	struct m77_lin_table lintab;
+	struct m77_lin_entry *le;
+	struct m77_lin_result linres;
+	unsigned int id, dir, len, slot;
+	struct m77_prio_frame prio;
+	struct m77_prio_stats pstat;
+	struct m77_bridge bridge;
+	struct m77_group group;
+	struct m77_group_write gwrite;
+	struct m77_rs485_stats tastat;
+	struct m77_rxts_set rxtsset;
+	struct m77_rxts_read rxts;
+	struct m77_msr_set msrset;
+	struct m77_msr_read msrev;
+	unsigned int rxtx;
 
 	/* map given phy mode (equal to definition in serial_m77.h) to a string*/
 	char *phyModes[8]={" ", "RS422HD", "RS422FD", "RS485HD", "RS485FD",
@@ -105,7 +246,9 @@ int main(int argc, char *argv[])
 	if (argc < 2)
 		usage();
 
-	while ((option = getopt(argc, argv, "vhkd:t:p:s:")) >=0 ) {
+	memset(&lintab, 0, sizeof(lintab));
+
+	while ((option = getopt(argc, argv, "vhkiqbCFIGLNRd:t:p:s:x:a:e:r:c:T:f:M:g:K:S:Q:l:n:P:B:j:J:z:Zy:Y")) >=0 ) {
 		switch (option) {
 
 		case 'k':
@@ -151,6 +294,18 @@ int main(int argc, char *argv[])
 			retval = ioctl( fileno(fd), M45_TIO_TRI_MODE, val );
 			break;
 
+		case 'T':
+			memset(&triauto, 0, sizeof(triauto));
+			if (strcmp(optarg, "off")) {
+				triauto.enable  = 1;
+				triauto.guardUs = atoi(optarg);
+			}
+			if (nverbose)
+				printf("Set M45N auto Tristate %d, guard %uus\n",
+					   triauto.enable, triauto.guardUs);
+			retval = ioctl( fileno(fd), M45_TIO_TRI_AUTO_SET, &triauto );
+			break;
+
 		case 's':
 			val = atoi(optarg);
 			if (nverbose)
@@ -158,6 +313,395 @@ int main(int argc, char *argv[])
 			retval = ioctl( fileno(fd), M77_ECHO_SUPPRESS, val );
 			break;
 
+		case 'x':
+			memset(&inband, 0, sizeof(inband));
+			if (sscanf(optarg, "%i,%i", &xon2, &xoff2) == 2) {
+				inband.mode  = M77_INBAND_SEQ;
+				inband.xon2  = xon2;
+				inband.xoff2 = xoff2;
+			}
+			if (nverbose)
+				printf("Set in-band flow mode %d\n", inband.mode);
+			retval = ioctl( fileno(fd), M77_INBAND_SET, &inband );
+			break;
+
+		case 'i':
+			retval = ioctl( fileno(fd), M77_INBAND_GET, &inband );
+			if (!retval)
+				printf("in-band mode %d XON2 0x%02x XOFF2 0x%02x, "
+					   "%u XOFF received\n", inband.mode, inband.xon2,
+					   inband.xoff2, inband.xoffCount);
+			break;
+
+		case 'a':
+			memset(&mdrop, 0, sizeof(mdrop));
+			if (strcmp(optarg, "off")) {
+				mdrop.enable = 1;
+				mdrop.flags  = M77_MD_HWGATE;
+				mdrop.nrAddr = sscanf(optarg, "%i,%i", &xon2, &xoff2);
+				mdrop.addr[0] = xon2;
+				mdrop.addr[1] = xoff2;
+			}
+			if (nverbose)
+				printf("Set multidrop mode %d, %d address(es)\n",
+					   mdrop.enable, mdrop.nrAddr);
+			retval = ioctl( fileno(fd), M77_MULTIDROP_SET, &mdrop );
+			break;
+
+		case 'e':
+			memset(&delim, 0, sizeof(delim));
+			if (strcmp(optarg, "off")) {
+				delim.enable = 1;
+				xoff2 = 0;
+				sscanf(optarg, "%i,%u", &xon2, &xoff2);
+				delim.delim  = xon2;
+				delim.idleUs = xoff2;
+			}
+			if (nverbose)
+				printf("Set delimiter mode %d, delimiter 0x%02x\n",
+					   delim.enable, delim.delim);
+			retval = ioctl( fileno(fd), M77_DELIM_SET, &delim );
+			break;
+
+		case 'r':
+			memset(&rs485, 0, sizeof(rs485));
+			if (strcmp(optarg, "off")) {
+				rxtx = 0;
+				sscanf(optarg, "%u,%u,%u", &rs485.delay_rts_before_send,
+					   &rs485.delay_rts_after_send, &rxtx);
+				rs485.flags = SER_RS485_ENABLED | SER_RS485_RTS_ON_SEND;
+				if (rxtx)
+					rs485.flags |= SER_RS485_RX_DURING_TX;
+			}
+			retval = ioctl( fileno(fd), TIOCSRS485, &rs485 );
+			if (!retval && nverbose)
+				printf("RS485 flags 0x%x, delays %u/%ums\n", rs485.flags,
+					   rs485.delay_rts_before_send, 
+					   rs485.delay_rts_after_send);
+			break;
+
+		case 'f':
+			memset(&frametx, 0, sizeof(frametx));
+			if (strcmp(optarg, "off")) {
+				frametx.enable = 1;
+				frametx.ttl    = atoi(optarg);
+			}
+			if (nverbose)
+				printf("Set frame TX mode %d\n", frametx.enable);
+			retval = ioctl( fileno(fd), M77_FRAMETX_SET, &frametx );
+			break;
+
+		case 'F':
+			retval = ioctl( fileno(fd), M77_FRAMETX_GET, &frametx );
+			if (!retval)
+				printf("frame TX %d (TX trigger %u): %u frames, %u underruns\n",
+					   frametx.enable, frametx.ttl, frametx.frames,
+					   frametx.underruns);
+			break;
+
+		case 'M':
+			memset(&rtu, 0, sizeof(rtu));
+			val = atoi(optarg);
+			rtu.enable = !!val;
+			if (val == 2)
+				rtu.flags = M77_RTU_CRCDROP;
+			if (nverbose)
+				printf("Set RTU mode %d\n", rtu.enable);
+			retval = ioctl( fileno(fd), M77_RTU_SET, &rtu );
+			break;
+
+		case 'I':
+			retval = ioctl( fileno(fd), M77_RTU_GET, &rtu );
+			if (retval)
+				break;
+			printf("RTU mode %d (t1.5 %uus t3.5 %uus): %u frames, %u CRC "
+				   "errors, %u t1.5 errors, %u infos lost\n", rtu.enable,
+				   rtu.t15Us, rtu.t35Us, rtu.frames, rtu.crcErrors, 
+				   rtu.t15Errors, rtu.infoLost);
+			while (!ioctl( fileno(fd), M77_FRAME_INFO, &finfo ))
+				printf(" frame: %u bytes, flags 0x%x, LSR 0x%02x at %u.%09u\n",
+					   finfo.len, finfo.flags, finfo.lsr, finfo.tsSec,
+					   finfo.tsNsec);
+			break;
+
+		case 'g':
+			memset(&idle, 0, sizeof(idle));
+			if (strcmp(optarg, "off")) {
+				idle.enable = 1;
+				idle.gap 	= atoi(optarg);
+				idle.unit 	= strstr(optarg, "us") ? M77_IDLE_US : M77_IDLE_BITS;
+			}
+			if (nverbose)
+				printf("Set idle gap mode %d, gap %u%s\n", idle.enable, 
+					   idle.gap, idle.unit == M77_IDLE_US ? "us" : " bits");
+			retval = ioctl( fileno(fd), M77_IDLE_SET, &idle );
+			break;
+
+		case 'K':
+			memset(&crc, 0, sizeof(crc));
+			crc.type = atoi(optarg);
+			if (strstr(optarg, "drop"))
+				crc.flags = M77_CRC_DROP;
+			if (nverbose)
+				printf("Set CRC type %d flags 0x%x\n", crc.type, crc.flags);
+			retval = ioctl( fileno(fd), M77_CRC_SET, &crc );
+			break;
+
+		case 'L':
+			retval = ioctl( fileno(fd), M77_CRC_GET, &crc );
+			if (!retval)
+				printf("CRC type %d flags 0x%x: %u good, %u bad, %u dropped\n",
+					   crc.type, crc.flags, crc.good, crc.bad, crc.dropped);
+			break;
+
+		case 'S':
+			memset(&sched, 0, sizeof(sched));
+			sched.slot = atoi(optarg);
+			if (!strstr(optarg, "off")) {
+				if (sscanf(optarg, "%*u,%u,%u,", &sched.periodUs,
+						   &sched.phaseUs) != 2 ||
+					!(hex = strrchr(optarg, ','))) {
+					printf("*** use -S slot,period,phase,hexdata\n");
+					exit(1);
+				}
+				sched.enable = 1;
+				for (hex++; sched.len < M77_SCHED_FRAME_MAX &&
+						 sscanf(hex, "%2x", &val) == 1; hex += 2)
+					sched.data[sched.len++] = val;
+			}
+			if (nverbose)
+				printf("Set TX slot %d: %d bytes every %uus\n", sched.slot,
+					   sched.len, sched.periodUs);
+			retval = ioctl( fileno(fd), M77_SCHED_SET, &sched );
+			break;
+
+		case 'Q':
+			memset(&sstat, 0, sizeof(sstat));
+			sstat.slot 	= atoi(optarg);
+			sstat.clear = 1;
+			retval = ioctl( fileno(fd), M77_SCHED_STAT, &sstat );
+			if (!retval)
+				printf("TX slot %d en %d: %u sent, %u missed, last at "
+					   "%u.%09u, late %u/%u/%uns (last/min/max)\n", 
+					   sstat.slot, sstat.enable, sstat.count, sstat.missed,
+					   sstat.lastSec, sstat.lastNsec, sstat.lateNs,
+					   sstat.minLateNs, sstat.maxLateNs);
+			break;
+
+		case 'l':
+			if (lintab.num >= M77_LIN_ENTRIES ||
+				sscanf(optarg, "%i,%u,%u,%u", &id, &dir, &len, &slot) != 4) {
+				printf("*** use -l id,dir,len,slotUs[,hexdata]\n");
+				exit(1);
+			}
+			le = &lintab.entry[lintab.num++];
+			le->id 		= id;
+			le->dir 	= dir;
+			le->len 	= len;
+			le->slotUs 	= slot;
+			hex = strchr(optarg, ',');
+			for (val = 0; val < 3 && hex; val++)
+				hex = strchr(hex + 1, ',');
+			for (len = 0; hex && len < 8 && 
+					 sscanf(hex + 1 + 2 * len, "%2x", &val) == 1; len++)
+				le->data[len] = val;
+			if (nverbose)
+				printf("LIN table entry %d: ID 0x%02x dir %d len %d\n",
+					   lintab.num - 1, le->id, le->dir, le->len);
+			retval = ioctl( fileno(fd), M77_LIN_TABLE, &lintab );
+			break;
+
+		case 'n':
+			memset(&lin, 0, sizeof(lin));
+			val = atoi(optarg);
+			lin.enable = !!val;
+			if (val == 2)
+				lin.flags = M77_LIN_ONCE;
+			if (nverbose)
+				printf("Set LIN master %d\n", lin.enable);
+			retval = ioctl( fileno(fd), M77_LIN_SET, &lin );
+			break;
+
+		case 'N':
+			retval = ioctl( fileno(fd), M77_LIN_GET, &lin );
+			if (retval)
+				break;
+			printf("LIN master %d running %d: %u frames, %u no response, "
+				   "%u checksum errors, %u bit errors, %u results lost\n",
+				   lin.enable, lin.running, lin.frames, lin.noResponse,
+				   lin.checksumErrors, lin.bitErrors, lin.resultsLost);
+			while (!ioctl( fileno(fd), M77_LIN_RESULT, &linres )) {
+				printf(" %u.%09u ID 0x%02x status %d:", linres.tsSec,
+					   linres.tsNsec, linres.id, linres.status);
+				for (len = 0; len < linres.len; len++)
+					printf(" %02x", linres.data[len]);
+				printf("\n");
+			}
+			break;
+
+		case 'P':
+			memset(&prio, 0, sizeof(prio));
+			for (hex = optarg; prio.len < M77_PRIO_MAX &&
+					 sscanf(hex, "%2x", &val) == 1; hex += 2)
+				prio.data[prio.len++] = val;
+			if (nverbose)
+				printf("Send %d bytes priority frame\n", prio.len);
+			retval = ioctl( fileno(fd), M77_PRIO_SEND, &prio );
+			break;
+
+		case 'R':
+			memset(&pstat, 0, sizeof(pstat));
+			pstat.clear = 1;
+			retval = ioctl( fileno(fd), M77_PRIO_STATS, &pstat );
+			if (!retval)
+				printf("priority TX: %u sent, %u queued, %u refused, latency "
+					   "%u/%u/%u/%uns (last/min/max/avg)\n", pstat.count,
+					   pstat.queued, pstat.full, pstat.lastNs, pstat.minNs,
+					   pstat.maxNs, pstat.avgNs);
+			break;
+
+		case 'B':
+			memset(&bridge, 0, sizeof(bridge));
+			if (strcmp(optarg, "off")) {
+				bridge.enable = 1;
+				bridge.line = atoi(optarg);
+				if (strstr(optarg, "bidir"))
+					bridge.flags |= M77_BRIDGE_BIDIR;
+				if (strstr(optarg, "flow"))
+					bridge.flags |= M77_BRIDGE_FLOW;
+			}
+			if (nverbose)
+				printf("Set bridge %d to line %d flags 0x%x\n", bridge.enable,
+					   bridge.line, bridge.flags);
+			retval = ioctl( fileno(fd), M77_BRIDGE_SET, &bridge );
+			break;
+
+		case 'b':
+			retval = ioctl( fileno(fd), M77_BRIDGE_GET, &bridge );
+			if (!retval)
+				printf("bridge %d to line %u flags 0x%x: %u forwarded, %u "
+					   "dropped, %u holds\n", bridge.enable, bridge.line,
+					   bridge.flags, bridge.forwarded, bridge.dropped,
+					   bridge.holds);
+			break;
+
+		case 'z':
+			rxtsset.enable = atoi(optarg);
+			if (nverbose)
+				printf("Set RX time stamps %d\n", rxtsset.enable);
+			retval = ioctl( fileno(fd), M77_RXTS_SET, &rxtsset );
+			break;
+
+		case 'Z':
+			rxts.num = M77_RXTS_NUM;
+			retval = ioctl( fileno(fd), M77_RXTS_READ, &rxts );
+			if (retval)
+				break;
+			printf("RX time stamps %d: %u chars, %u stamps lost\n",
+				   rxts.enable, rxts.pos, rxts.lost);
+			for (val = 0; val < (int)rxts.num; val++)
+				printf(" chars %u-%u: LSR 0x%02x at %u.%09u\n",
+					   rxts.ts[val].pos, 
+					   rxts.ts[val].pos + rxts.ts[val].len - 1,
+					   rxts.ts[val].lsr, rxts.ts[val].tsSec, 
+					   rxts.ts[val].tsNsec);
+			break;
+
+		case 'y':
+			memset(&msrset, 0, sizeof(msrset));
+			msrset.enable = atoi(optarg);
+			if (strstr(optarg, "pps"))
+				msrset.flags |= M77_MSR_PPS;
+			if (strstr(optarg, "clear"))
+				msrset.flags |= M77_MSR_PPS_CLEAR;
+			if (nverbose)
+				printf("Set MSR events %d flags 0x%x\n", msrset.enable,
+					   msrset.flags);
+			retval = ioctl( fileno(fd), M77_MSR_SET, &msrset );
+			break;
+
+		case 'Y':
+			msrev.num = M77_MSR_NUM;
+			retval = ioctl( fileno(fd), M77_MSR_READ, &msrev );
+			if (retval)
+				break;
+			printf("MSR events %d flags 0x%x: %u events lost\n",
+				   msrev.enable, msrev.flags, msrev.lost);
+			for (val = 0; val < (int)msrev.num; val++)
+				printf(" MSR 0x%02x at %u.%09u\n", msrev.ev[val].msr,
+					   msrev.ev[val].tsSec, msrev.ev[val].tsNsec);
+			break;
+
+		case 'j':
+			memset(&group, 0, sizeof(group));
+			group.group = atoi(optarg);
+			for (hex = strchr(optarg, ':'); hex; hex = strchr(hex + 1, ',')) {
+				val = atoi(hex + 1);
+				if (val >= 0 && val < 64)
+					group.lines[val / 32] |= 1U << (val % 32);
+			}
+			if (nverbose)
+				printf("Set group %d to lines 0x%08x%08x\n", group.group,
+					   group.lines[1], group.lines[0]);
+			retval = ioctl( fileno(fd), M77_GROUP_SET, &group );
+			break;
+
+		case 'J':
+			memset(&gwrite, 0, sizeof(gwrite));
+			gwrite.group = atoi(optarg);
+			if ((hex = strchr(optarg, ':')))
+				for (hex++; gwrite.len < M77_GROUP_MAX &&
+						 sscanf(hex, "%2x", &val) == 1; hex += 2)
+					gwrite.data[gwrite.len++] = val;
+			retval = ioctl( fileno(fd), M77_GROUP_WRITE, &gwrite );
+			if (!retval)
+				printf("%u bytes queued on lines 0x%08x%08x\n", gwrite.len,
+					   gwrite.queued[1], gwrite.queued[0]);
+			break;
+
+		case 'G':
+			retval = ioctl( fileno(fd), M77_IDLE_GET, &idle );
+			if (retval)
+				break;
+			printf("idle gap mode %d (gap %uus): %u telegrams, %u infos lost\n",
+				   idle.enable, idle.gapUs, idle.telegrams, idle.infoLost);
+			while (!ioctl( fileno(fd), M77_FRAME_INFO, &finfo ))
+				printf(" telegram: %u bytes, LSR 0x%02x at %u.%09u\n",
+					   finfo.len, finfo.lsr, finfo.tsSec, finfo.tsNsec);
+			break;
+
+		case 'c':
+			memset(&echoc, 0, sizeof(echoc));
+			val = atoi(optarg);
+			echoc.enable = !!val;
+			if (val == 2)
+				echoc.flags = M77_ECHO_MARKERR;
+			if (nverbose)
+				printf("Set echo cancellation %d\n", echoc.enable);
+			retval = ioctl( fileno(fd), M77_ECHO_CANCEL_SET, &echoc );
+			break;
+
+		case 'C':
+			retval = ioctl( fileno(fd), M77_ECHO_CANCEL_GET, &echoc );
+			if (!retval)
+				printf("echo cancellation %d: %u echoes dropped, %u "
+					   "collisions%s, %u lost\n", echoc.enable, 
+					   echoc.echoCount, echoc.collisions, 
+					   echoc.collision ? " (new)" : "", echoc.lostCount);
+			break;
+
+		case 'q':
+			memset(&tastat, 0, sizeof(tastat));
+			tastat.clear = 1;
+			retval = ioctl( fileno(fd), M77_RS485_STATS, &tastat );
+			if (!retval)
+				printf("turnaround (%s): %u measured, last %uns "
+					   "min %uns max %uns, resolution %uns\n",
+					   tastat.swCtrl ? "timer" : "UART", tastat.count,
+					   tastat.lastNs, tastat.minNs, tastat.maxNs, 
+					   tastat.resNs);
+			break;
+
 		case 'm':
 			for (val = 0; val < 5; val ++) {
 				if (nverbose)
@@ -0,0 +1,117 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m77_net.c
+ *
+ *      \author  ts
+ *
+ *  	 \brief  Creates or removes the network interface of a channel
+ *				 through /dev/m77ctl. The interface is brought up with
+ *				 ip link set m77n<line> up then.
+ *
+ *				 Build on Commandline using:
+ *				 gcc -Wall -O2 -o m77_net m77_net.c
+ *
+ *     Switches: -
+ *
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2003-2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include "../serial_m77.h"
+
+/***********************************************************************/
+/*
+ * Display Program usage
+ */
+static void usage(void)
+{
+	printf(" m77_net [-b baud] [-g gap] [-u] [-d delim] line\n");
+	printf(" m77_net -r line\n");
+	printf(" creates the network interface of /dev/ttyD<line>\n");
+	printf(" -b   baud rate, default 9600\n");
+	printf(" -g   idle gap ending a packet in bit times, default 40\n");
+	printf(" -u   gap in microseconds\n");
+	printf(" -d   char ending a packet too, e.g. 0x0a\n");
+	printf(" -r   remove the interface\n");
+	printf(" -h   help, dumps this usage text\n");
+	exit(1);
+}
+
+
+/***********************************************************************/
+/*
+ * the only main function
+ *
+ */
+int main(int argc, char *argv[])
+{
+	struct m77_net nt;
+	int option, ctl;
+
+	memset(&nt, 0, sizeof(nt));
+	nt.enable 	= 1;
+	nt.unit 	= M77_IDLE_BITS;
+	nt.gap 		= 40;
+	while ((option = getopt(argc, argv, "hb:g:ud:r")) >= 0) {
+		switch (option) {
+		case 'b':
+			nt.baud = strtoul(optarg, NULL, 0);
+			break;
+		case 'g':
+			nt.gap = strtoul(optarg, NULL, 0);
+			break;
+		case 'u':
+			nt.unit = M77_IDLE_US;
+			break;
+		case 'd':
+			nt.delim = strtoul(optarg, NULL, 0);
+			nt.flags |= M77_NET_DELIM;
+			break;
+		case 'r':
+			nt.enable = 0;
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind >= argc)
+		usage();
+	nt.line = atoi(argv[optind]);
+
+	if ((ctl = open("/dev/" M77_CTL_NAME, O_RDWR)) < 0) {
+		printf("*** can't open /dev/%s\n", M77_CTL_NAME);
+		exit(1);
+	}
+	if (ioctl(ctl, M77_NET_SET, &nt)) {
+		perror("*** M77_NET_SET");
+		exit(1);
+	}
+
+	if (nt.enable)
+		printf("ttyD%u is %s, bring it up with: ip link set %s up\n",
+			   nt.line, nt.name, nt.name);
+	close(ctl);
+	return 0;
+}
@@ -0,0 +1,198 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m77_raw.c
+ *
+ *      \author  ts
+ *
+ *  	 \brief  Verification helper for the raw RX ring: switches a channel
+ *				 to raw mode, maps its ring and consumes it with poll() as
+ *				 the only syscall. Dumps the chunks or counts the data.
+ *
+ *				 Build on Commandline using:
+ *				 gcc -Wall -O2 -o m77_raw m77_raw.c
+ *
+ *     Switches: -
+ *
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2003-2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include "../serial_m77.h"
+
+static volatile int G_stop;
+
+/***********************************************************************/
+/*
+ * Display Program usage
+ */
+static void usage(void)
+{
+	printf(" m77_raw [-c] [-q] [-s size] line\n");
+	printf(" reads /dev/ttyD<line> in raw mode until ^C\n");
+	printf(" -c   chunks with timestamp and LSR errors\n");
+	printf(" -q   quiet, count the data only\n");
+	printf(" -s   ring size, power of 2, default %d\n", M77_RAW_SIZE_DEFAULT);
+	printf(" -h   help, dumps this usage text\n");
+	exit(1);
+}
+
+static void sig_handler(int sig)
+{
+	(void)sig;
+	G_stop = 1;
+}
+
+/*
+ * copy out of the ring, the records may wrap
+ */
+static void ring_copy(void *dst, const unsigned char *data, unsigned int size,
+					  unsigned int pos, unsigned int len)
+{
+	unsigned int off = pos & (size - 1);
+	unsigned int c = (len < size - off) ? len : size - off;
+
+	memcpy(dst, data + off, c);
+	memcpy((unsigned char *)dst + c, data, len - c);
+}
+
+
+/***********************************************************************/
+/*
+ * the only main function
+ *
+ */
+int main(int argc, char *argv[])
+{
+	volatile struct m77_raw_ring *ring;
+	struct m77_raw_chunk ch;
+	struct m77_raw raw;
+	struct pollfd pfd;
+	unsigned char *data, buf[256];
+	unsigned int head, tail, i, chunks = 0, quiet = 0;
+	unsigned long long total = 0;
+	char name[32];
+	int option, ctl, fd;
+	size_t mapLen;
+
+	memset(&raw, 0, sizeof(raw));
+	while ((option = getopt(argc, argv, "hcqs:")) >= 0) {
+		switch (option) {
+		case 'c':
+			raw.flags |= M77_RAW_CHUNKS;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		case 's':
+			raw.size = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind >= argc)
+		usage();
+	raw.line 	= atoi(argv[optind]);
+	raw.enable 	= 1;
+
+	/* the tty sets up the channel (baud rate etc.) and stays open */
+	sprintf(name, "/dev/ttyD%u", raw.line);
+	if ((fd = open(name, O_RDWR | O_NOCTTY)) < 0) {
+		printf("*** can't open %s\n", name);
+		exit(1);
+	}
+
+	if ((ctl = open("/dev/" M77_CTL_NAME, O_RDWR)) < 0) {
+		printf("*** can't open /dev/%s\n", M77_CTL_NAME);
+		exit(1);
+	}
+	if (ioctl(ctl, M77_RAW_SET, &raw) || ioctl(ctl, M77_RAW_GET, &raw)) {
+		printf("*** can't switch %s to raw mode\n", name);
+		exit(1);
+	}
+
+	mapLen = M77_RAW_DATA_OFF + raw.size;
+	ring = mmap(NULL, mapLen, PROT_READ | PROT_WRITE, MAP_SHARED, ctl, 0);
+	if (ring == MAP_FAILED) {
+		printf("*** mmap failed\n");
+		exit(1);
+	}
+	data = (unsigned char *)ring + M77_RAW_DATA_OFF;
+
+	signal(SIGINT, sig_handler);
+	pfd.fd 		= ctl;
+	pfd.events 	= POLLIN;
+
+	tail = ring->tail;
+	while (!G_stop) {
+		head = ring->head;
+		if (head == tail) {
+			if (poll(&pfd, 1, 1000) > 0 && (pfd.revents & POLLHUP)) {
+				printf("%s left raw mode\n", name);
+				break;
+			}
+			continue;
+		}
+		__sync_synchronize();	/* data after head */
+
+		while (tail != head) {
+			if (raw.flags & M77_RAW_CHUNKS) {
+				ring_copy(&ch, data, raw.size, tail, sizeof(ch));
+				tail += sizeof(ch);
+				ring_copy(buf, data, raw.size, tail, ch.len);
+				tail += (ch.len + 3) & ~3;
+				chunks++;
+			} else {
+				ch.len = (head - tail < sizeof(buf)) ?
+					head - tail : sizeof(buf);
+				ring_copy(buf, data, raw.size, tail, ch.len);
+				tail += ch.len;
+			}
+			total += ch.len;
+
+			if (quiet)
+				continue;
+			if (raw.flags & M77_RAW_CHUNKS)
+				printf("%u.%09u LSR 0x%02x %3u:", ch.tsSec, ch.tsNsec,
+					   ch.lsr, ch.len);
+			for (i = 0; i < ch.len; i++)
+				printf(" %02x", buf[i]);
+			printf("\n");
+		}
+
+		__sync_synchronize();	/* done with the data before freeing it */
+		ring->tail = tail;
+	}
+
+	printf("%llu chars, %u chunks, %u lost\n", total, chunks, ring->lost);
+	munmap((void *)ring, mapLen);
+	close(ctl);
+	close(fd);
+	return 0;
+}
@@ -0,0 +1,241 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m77_tap.c
+ *
+ *      \author  ts
+ *
+ *  	 \brief  Decoder of the traffic tap: taps RX and TX of a set of
+ *				 channels through /dev/m77ctl, maps the tap ring and prints
+ *				 the records in time order. The records can be saved to a
+ *				 file as they are and decoded later.
+ *
+ *				 Build on Commandline using:
+ *				 gcc -Wall -O2 -o m77_tap m77_tap.c
+ *
+ *     Switches: -
+ *
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2003-2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include "../serial_m77.h"
+
+#define MAX_LINES	64
+
+static volatile int G_stop;
+
+/***********************************************************************/
+/*
+ * Display Program usage
+ */
+static void usage(void)
+{
+	printf(" m77_tap [-q] [-s size] [-o file] line [line ...]\n");
+	printf(" m77_tap -i file\n");
+	printf(" prints RX and TX of /dev/ttyD<line> until ^C\n");
+	printf(" -q   quiet, count the data only\n");
+	printf(" -s   ring size, power of 2, default %d\n", M77_RAW_SIZE_DEFAULT);
+	printf(" -o   save the records to file\n");
+	printf(" -i   decode the records saved in file\n");
+	printf(" -h   help, dumps this usage text\n");
+	exit(1);
+}
+
+static void sig_handler(int sig)
+{
+	(void)sig;
+	G_stop = 1;
+}
+
+/*
+ * copy out of the ring, the records may wrap
+ */
+static void ring_copy(void *dst, const unsigned char *data, unsigned int size,
+					  unsigned int pos, unsigned int len)
+{
+	unsigned int off = pos & (size - 1);
+	unsigned int c = (len < size - off) ? len : size - off;
+
+	memcpy(dst, data + off, c);
+	memcpy((unsigned char *)dst + c, data, len - c);
+}
+
+/*
+ * print one record
+ */
+static void print_rec(const struct m77_tap_rec *rec, const unsigned char *buf)
+{
+	unsigned int i;
+
+	printf("%u.%09u ttyD%-2u %s", rec->tsSec, rec->tsNsec, rec->line,
+		   rec->dir == M77_TAP_TX ? "TX" : "RX");
+	if (rec->lsr)
+		printf(" LSR 0x%02x", rec->lsr);
+	printf(" %3u:", rec->len);
+	for (i = 0; i < rec->len; i++)
+		printf(" %02x", buf[i]);
+	printf("\n");
+}
+
+/*
+ * decode a file written with -o
+ */
+static int decode_file(const char *name)
+{
+	struct m77_tap_rec rec;
+	unsigned char buf[0x10000];
+	FILE *fp;
+
+	if (!(fp = fopen(name, "rb"))) {
+		printf("*** can't open %s\n", name);
+		return 1;
+	}
+	while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+		if (fread(buf, (rec.len + 3) & ~3, 1, fp) != 1 && rec.len) {
+			printf("*** %s truncated\n", name);
+			break;
+		}
+		print_rec(&rec, buf);
+	}
+	fclose(fp);
+	return 0;
+}
+
+
+/***********************************************************************/
+/*
+ * the only main function
+ *
+ */
+int main(int argc, char *argv[])
+{
+	volatile struct m77_raw_ring *ring;
+	struct m77_tap_rec rec;
+	struct m77_tap tp;
+	struct pollfd pfd;
+	unsigned char *data, buf[0x10000];
+	unsigned int head, tail, line, quiet = 0;
+	unsigned long long total[2] = { 0, 0 };
+	char *outName = NULL;
+	FILE *out = NULL;
+	int option, ctl;
+	size_t mapLen;
+
+	memset(&tp, 0, sizeof(tp));
+	while ((option = getopt(argc, argv, "hqs:o:i:")) >= 0) {
+		switch (option) {
+		case 'q':
+			quiet = 1;
+			break;
+		case 's':
+			tp.size = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			outName = optarg;
+			break;
+		case 'i':
+			return decode_file(optarg);
+		default:
+			usage();
+		}
+	}
+
+	/* the channels are set up by their ttys, the tap doesn't open them */
+	for (; optind < argc; optind++) {
+		line = atoi(argv[optind]);
+		if (line >= MAX_LINES)
+			usage();
+		tp.lines[line / 32] |= 1U << (line % 32);
+	}
+	if (!tp.lines[0] && !tp.lines[1])
+		usage();
+
+	if (outName && !(out = fopen(outName, "wb"))) {
+		printf("*** can't create %s\n", outName);
+		exit(1);
+	}
+
+	if ((ctl = open("/dev/" M77_CTL_NAME, O_RDWR)) < 0) {
+		printf("*** can't open /dev/%s\n", M77_CTL_NAME);
+		exit(1);
+	}
+	if (ioctl(ctl, M77_TAP_SET, &tp) || ioctl(ctl, M77_TAP_GET, &tp)) {
+		printf("*** M77_TAP_SET failed (tap in use?)\n");
+		exit(1);
+	}
+
+	mapLen = M77_RAW_DATA_OFF + tp.size;
+	ring = mmap(NULL, mapLen, PROT_READ | PROT_WRITE, MAP_SHARED, ctl, 0);
+	if (ring == MAP_FAILED) {
+		printf("*** mmap failed\n");
+		exit(1);
+	}
+	data = (unsigned char *)ring + M77_RAW_DATA_OFF;
+
+	signal(SIGINT, sig_handler);
+	pfd.fd 		= ctl;
+	pfd.events 	= POLLIN;
+
+	tail = ring->tail;
+	while (!G_stop) {
+		head = ring->head;
+		if (head == tail) {
+			poll(&pfd, 1, 1000);
+			continue;
+		}
+		__sync_synchronize();	/* data after head */
+
+		while (tail != head) {
+			ring_copy(&rec, data, tp.size, tail, sizeof(rec));
+			tail += sizeof(rec);
+			ring_copy(buf, data, tp.size, tail, (rec.len + 3) & ~3);
+			tail += (rec.len + 3) & ~3;
+			total[rec.dir == M77_TAP_TX] += rec.len;
+
+			if (out) {
+				fwrite(&rec, sizeof(rec), 1, out);
+				fwrite(buf, (rec.len + 3) & ~3, 1, out);
+			}
+			if (!quiet)
+				print_rec(&rec, buf);
+		}
+
+		__sync_synchronize();	/* done with the data before freeing it */
+		ring->tail = tail;
+	}
+
+	printf("%llu chars RX, %llu chars TX, %u lost\n", total[0], total[1],
+		   ring->lost);
+	if (out) {
+		fclose(out);
+		printf("records saved to %s\n", outName);
+	}
+	munmap((void *)ring, mapLen);
+	close(ctl);
+	return 0;
+}
@@ -0,0 +1,244 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m77_uio_lib.c
+ *
+ *      \author  ts
+ *
+ *  	 \brief  16C950 RX/TX polling loops on a M-Module handed to 
+ *				 userspace through UIO, see m77_uio_lib.h.
+ *
+ *     Switches: -
+ *
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2003-2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <linux/serial_reg.h>
+#include "m77_uio_lib.h"
+
+#define MM_UARTCLK		18432000	/* as in the driver */
+
+/*
+ * read one line of a sysfs file
+ */
+static int sysfs_read(const char *path, char *buf, size_t size)
+{
+	FILE *fp = fopen(path, "r");
+	int ok;
+
+	if (!fp)
+		return -1;
+	ok = fgets(buf, size, fp) != NULL;
+	fclose(fp);
+	if (!ok)
+		return -1;
+	buf[strcspn(buf, "\n")] = '\0';
+	return 0;
+}
+
+/*
+ * index of register reg of channel ch in the 16 bit register window
+ */
+static unsigned int reg_idx(M77_UIO *dev, unsigned int ch, unsigned int reg)
+{
+	unsigned int off = 0x10 * ch;
+
+	/* M45N address gap between channel 0-3 and 4-7 */
+	if (dev->m45 && ch > 3)
+		off += 0x40;
+	return (off + (reg << 1)) / 2;
+}
+
+
+/***********************************************************************/
+/*
+ * find /dev/uioN of the M-Module name and map its register window
+ */
+int m77u_open(M77_UIO *dev, const char *name)
+{
+	char path[64], buf[64];
+	unsigned long offs;
+	long page = sysconf(_SC_PAGESIZE);
+	int n;
+
+	memset(dev, 0, sizeof(*dev));
+	for (n = 0; n < 64; n++) {
+		sprintf(path, "/sys/class/uio/uio%d/name", n);
+		if (!sysfs_read(path, buf, sizeof(buf)) && !strcmp(buf, name))
+			break;
+	}
+	if (n == 64)
+		return -1;
+
+	sprintf(path, "/sys/class/uio/uio%d/maps/map0/offset", n);
+	if (sysfs_read(path, buf, sizeof(buf)))
+		return -1;
+	offs = strtoul(buf, NULL, 0);
+
+	sprintf(path, "/dev/uio%d", n);
+	if ((dev->fd = open(path, O_RDWR)) < 0)
+		return -1;
+
+	/* map 0 is at offset 0 of /dev/uioN */
+	dev->mapLen = (offs + 256 + page - 1) & ~(page - 1);
+	dev->map = mmap(NULL, dev->mapLen, PROT_READ | PROT_WRITE, MAP_SHARED,
+					dev->fd, 0);
+	if (dev->map == MAP_FAILED) {
+		close(dev->fd);
+		return -1;
+	}
+	dev->regs 	= (volatile unsigned short *)((char *)dev->map + offs);
+	dev->m45 	= !strncmp(name, "m45", 3);
+	dev->nrChan = dev->m45 ? 8 : 4;
+	return 0;
+}
+
+void m77u_close(M77_UIO *dev)
+{
+	munmap(dev->map, dev->mapLen);
+	close(dev->fd);
+}
+
+/*
+ * serial_in()/serial_out() of the driver
+ */
+unsigned int m77u_in(M77_UIO *dev, unsigned int ch, unsigned int reg)
+{
+	return dev->regs[reg_idx(dev, ch, reg)] & 0x00ff;
+}
+
+void m77u_out(M77_UIO *dev, unsigned int ch, unsigned int reg, 
+			  unsigned int val)
+{
+	dev->regs[reg_idx(dev, ch, reg)] = val;
+}
+
+/*
+ * write an indexed control register (ACR, CPR, TCR...)
+ */
+void m77u_icr_out(M77_UIO *dev, unsigned int ch, unsigned int reg,
+				  unsigned int val)
+{
+	m77u_out(dev, ch, UART_SCR, reg);
+	m77u_out(dev, ch, UART_ICR, val);
+}
+
+
+/***********************************************************************/
+/*
+ * reset a channel and set it to 8N1 with 128 byte FIFOs, no interrupts.
+ * baud is made with the divisor only (16x sampling), up to 1152000.
+ */
+int m77u_init(M77_UIO *dev, unsigned int ch, unsigned int baud)
+{
+	unsigned int quot;
+
+	if (ch >= dev->nrChan || !baud || baud > MM_UARTCLK / 16)
+		return -1;
+	quot = (MM_UARTCLK / 16 + baud / 2) / baud;
+
+	m77u_out(dev, ch, UART_IER, 0);
+	m77u_icr_out(dev, ch, UART_CSR, 0);		/* software reset */
+
+	/* 950 mode: enhanced mode enables the 128 byte FIFOs */
+	m77u_out(dev, ch, UART_LCR, 0xbf);
+	m77u_out(dev, ch, UART_EFR, UART_EFR_ECB);
+	m77u_out(dev, ch, UART_LCR, UART_LCR_DLAB);
+	m77u_out(dev, ch, UART_DLL, quot & 0xff);
+	m77u_out(dev, ch, UART_DLM, quot >> 8);
+	m77u_out(dev, ch, UART_LCR, UART_LCR_WLEN8);
+	m77u_out(dev, ch, UART_FCR, UART_FCR_ENABLE_FIFO | 
+			 UART_FCR_CLEAR_RCVR | UART_FCR_CLEAR_XMIT);
+	m77u_out(dev, ch, UART_MCR, UART_MCR_DTR | UART_MCR_RTS);
+
+	/* read what the reset left */
+	while (m77u_in(dev, ch, UART_LSR) & UART_LSR_DR)
+		m77u_in(dev, ch, UART_RX);
+	return 0;
+}
+
+
+/***********************************************************************/
+/*
+ * TX polling loop: load the FIFO whenever it is empty, returns when all
+ * chars are in the FIFO
+ */
+unsigned int m77u_write(M77_UIO *dev, unsigned int ch, 
+						const unsigned char *buf, unsigned int len)
+{
+	unsigned int n = 0, i;
+
+	while (n < len) {
+		while (!(m77u_in(dev, ch, UART_LSR) & UART_LSR_THRE))
+			;
+		for (i = 0; i < M77U_FIFO_SIZE && n < len; i++)
+			m77u_out(dev, ch, UART_TX, buf[n++]);
+	}
+	return n;
+}
+
+/*
+ * RX polling loop: drain the FIFO while LSR[DR] is set, doesn't wait.
+ * Returns the chars read, lsr gets the error bits of all of them.
+ */
+unsigned int m77u_read(M77_UIO *dev, unsigned int ch, unsigned char *buf,
+					   unsigned int len, unsigned int *lsr)
+{
+	unsigned int n = 0, l;
+
+	if (lsr)
+		*lsr = 0;
+	while (n < len && ((l = m77u_in(dev, ch, UART_LSR)) & UART_LSR_DR)) {
+		buf[n++] = m77u_in(dev, ch, UART_RX);
+		if (lsr)
+			*lsr |= l & (UART_LSR_BI | UART_LSR_FE | 
+						 UART_LSR_PE | UART_LSR_OE);
+	}
+	return n;
+}
+
+
+/***********************************************************************/
+/*
+ * wait for the M-Module interrupt, the UART interrupts are enabled with
+ * IER by the caller. Unmasks the interrupt (the driver masks it when it
+ * fires), returns 1 if it came, 0 on timeout, -1 on error.
+ */
+int m77u_wait_irq(M77_UIO *dev, int timeoutMs)
+{
+	struct pollfd pfd;
+	unsigned int cnt = 1;
+	int rv;
+
+	if (write(dev->fd, &cnt, sizeof(cnt)) != sizeof(cnt))
+		return -1;
+
+	pfd.fd 		= dev->fd;
+	pfd.events 	= POLLIN;
+	if ((rv = poll(&pfd, 1, timeoutMs)) <= 0)
+		return rv;
+	return read(dev->fd, &cnt, sizeof(cnt)) == sizeof(cnt) ? 1 : -1;
+}
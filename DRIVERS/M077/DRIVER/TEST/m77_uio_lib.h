@@ -0,0 +1,70 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m77_uio_lib.h
+ *
+ *      \author  ts
+ *
+ *  	 \brief  Userspace access to the 16C950 UARTs of a M-Module handed
+ *				 to userspace with the driver's uio parameter. The driver
+ *				 did the MDIS bring-up and CPLD init, the library maps the
+ *				 register window of /dev/uioN and drives the UARTs with
+ *				 polling loops, or waits for the module interrupt.
+ *
+ *     Switches: -
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2007-2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _M77_UIO_LIB_H
+#define _M77_UIO_LIB_H
+
+#include <stddef.h>
+
+#define M77U_FIFO_SIZE		128		/* 16C950 FIFOs in 950 mode			 */
+
+/** a M-Module opened with m77u_open() */
+typedef struct {
+	int					fd;			/* /dev/uioN						*/
+	void				*map;		/* mapped page						*/
+	size_t				mapLen;
+	volatile unsigned short *regs;	/* register window, 16 bit regs		*/
+	unsigned int		m45;		/* M45N: gap between channel 3 and 4 */
+	unsigned int		nrChan;		/* 4, M45N 8						*/
+} M77_UIO;
+
+/*
+ * m77u_open() takes the MDIS device name given to the driver, e.g. 
+ * "m77_1". The register functions use the conventions of the driver's
+ * serial_in()/serial_out(): register n of a channel is the low byte of
+ * the 16 bit word at channel base + (n << 1).
+ */
+int m77u_open(M77_UIO *dev, const char *name);
+void m77u_close(M77_UIO *dev);
+unsigned int m77u_in(M77_UIO *dev, unsigned int ch, unsigned int reg);
+void m77u_out(M77_UIO *dev, unsigned int ch, unsigned int reg, 
+			  unsigned int val);
+void m77u_icr_out(M77_UIO *dev, unsigned int ch, unsigned int reg,
+				  unsigned int val);
+int m77u_init(M77_UIO *dev, unsigned int ch, unsigned int baud);
+unsigned int m77u_write(M77_UIO *dev, unsigned int ch, 
+						const unsigned char *buf, unsigned int len);
+unsigned int m77u_read(M77_UIO *dev, unsigned int ch, unsigned char *buf,
+					   unsigned int len, unsigned int *lsr);
+int m77u_wait_irq(M77_UIO *dev, int timeoutMs);
+
+#endif /* _M77_UIO_LIB_H */
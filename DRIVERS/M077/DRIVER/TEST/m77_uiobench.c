@@ -0,0 +1,262 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m77_uiobench.c
+ *
+ *      \author  ts
+ *
+ *  	 \brief  Round trip latency of the UIO path against the tty path:
+ *				 sends a block on one channel and times until it is read
+ *				 back on another one (null modem cable) or the same one
+ *				 (loopback plug). The UIO path polls the 16C950 with
+ *				 m77_uio_lib, or waits for the M-Module interrupt (-i).
+ *
+ *				 Build on Commandline using:
+ *				 gcc -Wall -O2 -o m77_uiobench m77_uiobench.c m77_uio_lib.c
+ *
+ *     Switches: -
+ *
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2003-2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <termios.h>
+#include <linux/serial_reg.h>
+#include "m77_uio_lib.h"
+
+#define DEF_LOOPS	1000
+#define DEF_LEN		1
+#define DEF_BAUD	115200
+#define TIMEOUT_MS	1000
+
+/***********************************************************************/
+/*
+ * Display Program usage
+ */
+static void usage(void)
+{
+	printf(" m77_uiobench [-n loops] [-l len] [-b baud] [-i] -u name "
+		   "txch rxch\n");
+	printf(" m77_uiobench [-n loops] [-l len] [-b baud] -t txline rxline\n");
+	printf(" times len chars from one channel to the other and back into\n");
+	printf(" the application, same channel with a loopback plug\n");
+	printf(" -u   UIO path, M-Module name as given to the driver (m77_1),\n");
+	printf("      channels on the M-Module\n");
+	printf(" -t   tty path, /dev/ttyD<txline> and /dev/ttyD<rxline>\n");
+	printf(" -i   UIO: wait for the interrupt instead of polling\n");
+	printf(" -n   round trips, default %d\n", DEF_LOOPS);
+	printf(" -l   chars per round trip, max. %d, default %d\n", 
+		   M77U_FIFO_SIZE, DEF_LEN);
+	printf(" -b   baud rate, default %d\n", DEF_BAUD);
+	printf(" -h   help, dumps this usage text\n");
+	exit(1);
+}
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double d = *(const double *)a - *(const double *)b;
+
+	return (d > 0) - (d < 0);
+}
+
+static speed_t tty_speed(unsigned int baud)
+{
+	switch (baud) {
+	case 9600:		return B9600;
+	case 19200:		return B19200;
+	case 38400:		return B38400;
+	case 57600:		return B57600;
+	case 115200:	return B115200;
+	case 230400:	return B230400;
+	case 460800:	return B460800;
+	case 921600:	return B921600;
+	}
+	return B0;
+}
+
+/*
+ * open a tty raw, 8N1
+ */
+static int tty_open(unsigned int line, unsigned int baud)
+{
+	struct termios t;
+	char name[32];
+	int fd;
+
+	sprintf(name, "/dev/ttyD%u", line);
+	if ((fd = open(name, O_RDWR | O_NOCTTY)) < 0) {
+		printf("*** can't open %s\n", name);
+		exit(1);
+	}
+	tcgetattr(fd, &t);
+	cfmakeraw(&t);
+	t.c_cflag |= CLOCAL | CREAD;
+	t.c_cc[VMIN] 	= 0;
+	t.c_cc[VTIME] 	= 0;
+	cfsetspeed(&t, tty_speed(baud));
+	tcsetattr(fd, TCSANOW, &t);
+	tcflush(fd, TCIOFLUSH);
+	return fd;
+}
+
+
+/***********************************************************************/
+/*
+ * the only main function
+ *
+ */
+int main(int argc, char *argv[])
+{
+	unsigned char tx[M77U_FIFO_SIZE], rx[M77U_FIFO_SIZE];
+	unsigned int loops = DEF_LOOPS, len = DEF_LEN, baud = DEF_BAUD;
+	unsigned int txch, rxch, i, n, lsr, errors = 0, useIrq = 0;
+	int option, txFd = -1, rxFd = -1, rv;
+	char *uioName = NULL;
+	double *lat, t0, sum = 0;
+	struct pollfd pfd;
+	M77_UIO dev;
+
+	while ((option = getopt(argc, argv, "hu:tin:l:b:")) >= 0) {
+		switch (option) {
+		case 'u':
+			uioName = optarg;
+			break;
+		case 't':
+			uioName = NULL;
+			break;
+		case 'i':
+			useIrq = 1;
+			break;
+		case 'n':
+			loops = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			len = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			baud = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage();
+		}
+	}
+	if (optind + 2 > argc || !loops || !len || len > M77U_FIFO_SIZE)
+		usage();
+	txch = atoi(argv[optind]);
+	rxch = atoi(argv[optind + 1]);
+
+	if (uioName) {
+		if (m77u_open(&dev, uioName)) {
+			printf("*** no UIO device %s (driver loaded with uio=1?)\n",
+				   uioName);
+			exit(1);
+		}
+		if (m77u_init(&dev, txch, baud) || 
+			(rxch != txch && m77u_init(&dev, rxch, baud))) {
+			printf("*** can't set up the channels\n");
+			exit(1);
+		}
+		if (useIrq)
+			m77u_out(&dev, rxch, UART_IER, UART_IER_RDI);
+	} else {
+		if (!tty_speed(baud)) {
+			printf("*** baud rate %u not available on the tty\n", baud);
+			exit(1);
+		}
+		txFd = rxFd = tty_open(txch, baud);
+		if (rxch != txch)
+			rxFd = tty_open(rxch, baud);
+		pfd.fd 		= rxFd;
+		pfd.events 	= POLLIN;
+	}
+
+	lat = malloc(loops * sizeof(*lat));
+	for (i = 0; i < len; i++)
+		tx[i] = i;
+
+	for (i = 0; i < loops; i++) {
+		n = 0;
+		t0 = now_us();
+		if (uioName) {
+			m77u_write(&dev, txch, tx, len);
+			while (n < len && now_us() - t0 < TIMEOUT_MS * 1000.0) {
+				if (useIrq && m77u_wait_irq(&dev, TIMEOUT_MS) <= 0)
+					break;
+				n += m77u_read(&dev, rxch, rx + n, len - n, &lsr);
+				if (lsr)
+					errors++;
+			}
+		} else {
+			if (write(txFd, tx, len) != len)
+				break;
+			while (n < len) {
+				if (poll(&pfd, 1, TIMEOUT_MS) <= 0)
+					break;
+				if ((rv = read(rxFd, rx + n, len - n)) <= 0)
+					break;
+				n += rv;
+			}
+		}
+		lat[i] = now_us() - t0;
+
+		if (n < len) {
+			printf("*** round trip %u: %u of %u chars came back\n", i, n, 
+				   len);
+			exit(1);
+		}
+		if (memcmp(tx, rx, len))
+			errors++;
+		sum += lat[i];
+	}
+
+	qsort(lat, loops, sizeof(*lat), cmp_double);
+	printf("%s path%s, %u round trips of %u chars at %u baud\n",
+		   uioName ? "UIO" : "tty", useIrq && uioName ? " (interrupt)" : "",
+		   loops, len, baud);
+	printf("line time %.1f us\n", len * 10 * 1e6 / baud);
+	printf("min %.1f us, avg %.1f us, 99%% %.1f us, max %.1f us\n",
+		   lat[0], sum / loops, lat[loops * 99 / 100], lat[loops - 1]);
+	if (errors)
+		printf("*** %u round trips with wrong data or LSR errors\n", errors);
+
+	if (uioName) {
+		m77u_out(&dev, rxch, UART_IER, 0);
+		m77u_close(&dev);
+	} else {
+		close(txFd);
+		if (rxFd != txFd)
+			close(rxFd);
+	}
+	free(lat);
+	return errors ? 1 : 0;
+}
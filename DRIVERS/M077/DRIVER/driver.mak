@@ -35,7 +35,8 @@ MAK_INCL=$(MEN_INC_DIR)/mdis_com.h   \
          $(MEN_INC_DIR)/maccess.h    \
          $(MEN_INC_DIR)/mdis_api.h   \
 		 $(MEN_MOD_DIR)/serialP_m77.h \
-		 $(MEN_MOD_DIR)/serial_m77.h
+		 $(MEN_MOD_DIR)/serial_m77.h \
+		 $(MEN_MOD_DIR)/m77_kclient.h
 
 MAK_OPTIM=$(OPT_1)
 
@@ -0,0 +1,77 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  m77_kclient.h
+ *
+ *      \author  ts
+ *
+ *       \brief  In-kernel client interface of the M45N/M69N/M77 driver,
+ *				 modeled after serdev: a kernel module (GNSS, HCI, own
+ *				 protocol modules) uses a channel without tty and line
+ *				 discipline and gets the received chars straight from the
+ *				 interrupt handler. Without device tree the channel of a
+ *				 client is given by the driver's module parameter kclient,
+ *				 e.g. kclient=gnss:3:9600 for /dev/ttyD3 at 9600 baud.
+ *
+ *     Switches: __KERNEL__
+ */
+/*
+ *---------------------------------------------------------------------------
+ * Copyright 2007-2019, MEN Mikro Elektronik GmbH
+ ****************************************************************************/
+/*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef _M77_KCLIENT_H
+#define _M77_KCLIENT_H
+
+#define M77_KCLIENT_MAX		8		/* kclient module parameter entries	 */
+
+/** an in-kernel client of one channel */
+struct m77_kclient {
+	const char	*name;		/* matched with the kclient parameter	*/
+
+	/*
+	 * Called in interrupt context with the chars of one RX interrupt,
+	 * returns the number of chars taken. Must not sleep, may call
+	 * m77_kclient_write().
+	 */
+	int		(*receive_buf)(struct m77_kclient *kc,
+						   const unsigned char *buf, size_t count);
+
+	/*
+	 * Called in interrupt context when the TX buffer drained, optional.
+	 * The port lock is not held, it may call m77_kclient_write().
+	 */
+	void	(*write_wakeup)(struct m77_kclient *kc);
+
+	void	*priv;			/* client data							*/
+	int		line;			/* set by m77_kclient_open()			*/
+};
+
+/*
+ * m77_kclient_open() starts the channel with 8N1, no flow control and
+ * the baud rate of the parameter, the tty can't be opened meanwhile.
+ * m77_kclient_write() queues as many chars as fit into the TX buffer
+ * (4kB) and returns that number, it can be called from any context.
+ * Open, close and the setters may sleep. Kernels from 2.6.32 on.
+ */
+int m77_kclient_open(struct m77_kclient *kc);
+void m77_kclient_close(struct m77_kclient *kc);
+int m77_kclient_write(struct m77_kclient *kc, const unsigned char *buf,
+					  size_t count);
+unsigned int m77_kclient_set_baudrate(struct m77_kclient *kc,
+									  unsigned int baud);
+void m77_kclient_set_flow_control(struct m77_kclient *kc, int enable);
+
+#endif /* _M77_KCLIENT_H */
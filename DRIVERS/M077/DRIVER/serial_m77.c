@@ -46,9 +46,28 @@
 #endif
 #include <linux/tty.h>
 #include <linux/tty_flip.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/miscdevice.h>
+#include <linux/fs.h>
+#include <linux/poll.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
+#include <linux/mutex.h>
+#include <linux/jump_label.h>
+#include <linux/crc16.h>
+#include <linux/crc-itu-t.h>
+#include <linux/crc32.h>
 #include "serial_m77.h"
+#include "m77_kclient.h"
 #include <linux/slab.h>
 #include <asm/io.h>
+#if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,18)
+# include <asm/uaccess.h>
+#else
+# include <linux/uaccess.h>
+#endif
 
 /* MDIS stuff */
 #include <MEN/men_typs.h>
@@ -75,9 +94,110 @@ static const char IdentString[]=MENT_XSTR(MAK_REVISION);
 /* This is the total nr. of UARTS, can be e.g. 8xM45N or 8xM77/M69N  */
 #define MAX_SNGL_UARTS				64			
 
+/* serial core calls .throttle/.unthrottle for hardware assisted flow ctrl */
+#if defined(UPSTAT_AUTOXOFF) || defined(UPF_SOFT_FLOW)
+# define M77_HAS_THROTTLE
+#endif
+
+/* serial core handles TIOCSRS485/TIOCGRS485 via uart_port.rs485_config */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,0,0)
+# define M77_HAS_RS485_CONFIG
+#endif
+
+/* DCD as kernel PPS source, pps_device interface of 2.6.38 */
+#if (defined(CONFIG_PPS) || defined(CONFIG_PPS_MODULE)) && \
+	LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,38)
+# define M77_HAS_PPS
+# include <linux/pps_kernel.h>
+#endif
+
+/* in-kernel clients need port.state and ktermios baud rate encoding */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,32)
+# define M77_HAS_KCLIENT
+#endif
+
+/* channels as network interfaces, built on the in-kernel clients */
+#if defined(M77_HAS_KCLIENT) && defined(CONFIG_NET)
+# define M77_HAS_NETDEV
+# include <linux/netdevice.h>
+# include <linux/if_arp.h>
+# include <linux/if_ether.h>
+#endif
+
+/* BPF receive filter, bpf_prog_get_type() and classic BPF from user */
+#if defined(CONFIG_NET) && LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0)
+# define M77_HAS_BPF
+# include <linux/skbuff.h>
+# include <linux/filter.h>
+# include <linux/bpf.h>
+#endif
+
+/* M-Modules handed to userspace, struct uio_mem.offs of 3.10 */
+#if (defined(CONFIG_UIO) || defined(CONFIG_UIO_MODULE)) && \
+	LINUX_VERSION_CODE >= KERNEL_VERSION(3,10,0)
+# define M77_HAS_UIO
+# include <linux/uio_driver.h>
+#endif
+
+/* switch case fall through marker before 5.4 */
+#ifndef fallthrough
+# define fallthrough		do {} while (0)
+#endif
+
+/* rings shared with userspace (raw mode) on kernels before 3.19 */
+#ifndef READ_ONCE
+# define READ_ONCE(x)		ACCESS_ONCE(x)
+# define WRITE_ONCE(x, v)	(ACCESS_ONCE(x) = (v))
+#endif
+
+/* states of software timed RS485 driver enable (RTS delays set) */
+#define M77_RS485_IDLE		0	/* driver disabled, receiving 		 */
+#define M77_RS485_BEFORE	1	/* driver enabled, delay before send */
+#define M77_RS485_TX		2	/* sending							 */
+#define M77_RS485_TEMT		3	/* polling for end of last stop bit	 */
+#define M77_RS485_AFTER		4	/* delay after send					 */
+
+/* echo cancellation shadow of sent chars, must be a power of 2 */
+#define M77_ECHO_SIZE		512
+#define M77_ECHO_MARGIN		6		/* chars: RX FIFO timeout + 2		 */
+#define M77_ECHO_SLACK_NS	500000	/* ns: IRQ latency allowance 		 */
+
+/* frame receive engine modes */
+#define M77_FRM_OFF			0
+#define M77_FRM_RTU			1		/* Modbus RTU: t3.5 gap, CRC-16 	 */
+#define M77_FRM_IDLE		2		/* telegrams cut at a set idle gap	 */
+#define M77_IDLE_MAX_NS		1000000000	/* longest idle gap, t35Ns fits u32 */
+
+/* LIN master frame states */
+#define M77_LIN_IDLE		0		/* schedule table stopped			 */
+#define M77_LIN_BRK			1		/* break on the line				 */
+#define M77_LIN_DELIM		2		/* break delimiter					 */
+#define M77_LIN_RESP		3		/* header sent, response window		 */
+#define M77_LIN_WAIT		4		/* frame done, wait for slot end	 */
+
+#define M77_RXTO_CHARS		4		/* RX timeout IRQ after 4 idle chars */
+#define M77_LSR_ERRORS		(UART_LSR_BI | UART_LSR_PE | UART_LSR_FE | \
+							 UART_LSR_OE)
+#define M77_BRIDGE_POLL_CHARS 32	/* peer TX between flow control polls */
+#define M77_RTU_MINLEN		4		/* address, function, CRC			 */
+
+/* CRC register over frame + its CRC (as sent) of a good frame */
+#define M77_CRC16_MODBUS_RES	0x0000
+#define M77_CRC16_CCITT_RES		0x0000
+#define M77_CRC32_RES			0xdebb20e3
+
+#define M77_RS485_DELAY_MAX	100			/* ms, as serial core clamps */
+#define M77_RS485_POLL_MIN	2000		/* ns, finest TEMT polling 	 */
+
 #define UART_NAME_PREFIX	"ttyD"		/* ttyD0 to ttyDnn 			 */
 #define ARRLEN 	16
 
+/* 16C950 trigger levels (950 mode, ACR[5]) for the 128 byte FIFOs */
+#define M77_RTL_DEFAULT		64			/* RX FIFO interrupt trigger level */
+#define M77_TTL_DEFAULT		16			/* TX FIFO interrupt trigger level */
+#define M77_FCL_DEFAULT		32			/* send XON/assert RTS below this  */
+#define M77_FCH_DEFAULT		96			/* send XOFF/drop RTS above this   */
+
 #define UART_CAP_FIFO		(1 << 8)	/* UART has FIFO 					*/
 #define UART_CAP_EFR		(1 << 9)	/* UART has EFR 					*/
 #define UART_CAP_SLEEP		(1 << 10)	/* UART has IER sleep 				*/
@@ -152,6 +272,33 @@ struct plat_men_uart_port {
 };
 
 
+/*******************************************************************/
+/** A frame sent by the TX scheduler, see M77_SCHED_SET
+ */
+struct m77_sched {
+	unsigned char		enable;		/* slot scheduled					*/
+	unsigned int		len;		/* frame length						*/
+	u64					periodNs;	/* cycle, 0 = one-shot				*/
+	u64					phaseNs;	/* offset to multiples of periodNs	*/
+	ktime_t				due;		/* next scheduled time				*/
+	ktime_t				txDue;		/* scheduled time of queued frame	*/
+	struct m77_sched_stat st;		/* timing statistics				*/
+	unsigned char		data[M77_SCHED_FRAME_MAX];
+};
+
+
+/*******************************************************************/
+/** A frame in the priority TX queue, see M77_PRIO_SEND
+ */
+struct m77_prio {
+	unsigned int		len;		/* frame length						*/
+	ktime_t				queued;		/* time of M77_PRIO_SEND			*/
+	unsigned char		data[M77_PRIO_MAX];
+};
+
+struct m77_ctl_file;
+
+
 /*******************************************************************/
 /** The central Oxford 16C950 UART port struct 
  */
@@ -162,6 +309,8 @@ struct ox16c954_port {
 	unsigned short		capabilities;	/* port capabilities 			*/
 	unsigned short		bugs;			/* port bugs 					*/
 	unsigned int		tx_loadsz;		/* transmit fifo load size 		*/
+	unsigned int		rtl;			/* 950 RX trigger level			*/
+	unsigned int		ttl;			/* 950 TX trigger level			*/
 	unsigned char		acr;			/* Advanced Control Register	*/ 
 	unsigned char		ier;
 	unsigned char		lcr;
@@ -169,6 +318,7 @@ struct ox16c954_port {
 	unsigned char		mcr_mask;		/* mask of user bits 			*/
 	unsigned char		mcr_force;		/* mask of forced bits 			*/
 	unsigned char		lsr_break_flag;
+	unsigned char		throttled;		/* IER RX bits masked by throttle	*/
 
 	/* Additional 16C954 & M-Module maintenance stuff */
 	unsigned char		efr;
@@ -179,6 +329,218 @@ struct ox16c954_port {
 	unsigned int		acrShadow;	/* keep M77 ACR (DTR#) setting		*/
 	unsigned int		m77Mode;	/* M77: PHY Mode setting			*/
 
+	/* in-band (XON/XOFF) flow control done by the UART */
+	unsigned int		iflag;		/* termios c_iflag of last set_termios */
+	unsigned char		xon1;		/* termios c_cc[VSTART]				*/
+	unsigned char		xoff1;		/* termios c_cc[VSTOP]				*/
+	unsigned char		xon2;		/* 2nd XON char (M77_INBAND_SEQ)	*/
+	unsigned char		xoff2;		/* 2nd XOFF char (M77_INBAND_SEQ)	*/
+	unsigned char		inbandMode;	/* M77_INBAND_SINGLE/_SEQ			*/
+	unsigned int		xoffCount;	/* XOFFs recognized by the UART		*/
+
+	/* 9-bit multidrop address filter */
+	unsigned char		mdEnable;	/* 9-bit mode active				*/
+	unsigned char		mdAddr[2];	/* own station addresses			*/
+	unsigned char		mdAddressed;/* last address char was ours		*/
+	unsigned char		mdLcr;		/* LCR as set by termios			*/
+	unsigned int		mdFlags;	/* M77_MD_*							*/
+	unsigned int		mdForeign;	/* frames for other stations		*/
+
+	/* delimiter wakeup: push received data on frame end or line idle */
+	unsigned char		delimEnable;/* delimiter mode active			*/
+	unsigned char		delim;		/* frame delimiter character		*/
+	unsigned char		rxPushNow;	/* special char IRQ saw delimiter	*/
+	unsigned int		delimIdleUs;/* push anyway after this idle time	*/
+	unsigned int		delimFrames;/* pushes on delimiter				*/
+	unsigned int		delimIdles;	/* pushes on idle timeout			*/
+	struct hrtimer		rxTimer;	/* line idle timer					*/
+
+	/* RS485 direction control (TIOCSRS485) */
+	struct serial_rs485	rs485;		/* current RS485 settings			*/
+	unsigned char		rs485Soft;	/* driver enable timed by software	*/
+	unsigned char		triAuto;	/* M45N: automatic tristate			*/
+	unsigned char		triOpen;	/* M45N: open, TCR bit pair taken	*/
+	unsigned char		rs485State;	/* M77_RS485_*						*/
+	unsigned char		rs485Set;	/* RS485 enabled with TIOCSRS485	*/
+	unsigned char		rs485PrevDcr;/* DCR before RS485 was enabled	*/
+	unsigned char		rs485PrevAcr;/* ACR DTR# bits before			*/
+	unsigned int		rs485PrevMode;/* m77Mode before					*/
+	unsigned int		drvBeforeNs;/* driver enable before first char	*/
+	unsigned int		drvAfterNs;	/* driver enable after last stop bit */
+	unsigned int		charNs;		/* time of one character on the line */
+	unsigned int		txLoaded;	/* chars put into FIFO last TX IRQ	*/
+	unsigned int		pollNs;		/* current TEMT polling interval	*/
+	ktime_t				rs485Temt;	/* LSR[TEMT] found set after TX		*/
+	struct hrtimer		rs485Timer;	/* RTS delays and TEMT polling		*/
+	struct m77_rs485_stats taStats;	/* measured turnaround times		*/
+
+	/* echo cancellation: sent chars expected back from the bus */
+	unsigned char		echoEnable;	/* drop echoes of own chars			*/
+	unsigned char		echoColl;	/* collision since last GET			*/
+	unsigned char		echoPrevRxEn;/* M77 DCR RX_EN before enabling	*/
+	unsigned int		echoFlags;	/* M77_ECHO_*						*/
+	unsigned int		echoHead;	/* next free shadow entry			*/
+	unsigned int		echoTail;	/* next expected echo				*/
+	ktime_t				echoDeadline;/* shadow is stale after this		*/
+	unsigned int		echoDropped;/* echoes dropped					*/
+	unsigned int		echoCollisions;/* garbled echoes				*/
+	unsigned int		echoLost;	/* echoes that never came			*/
+	unsigned char		echoBuf[M77_ECHO_SIZE];
+
+	/* frame TX: frames staged in the FIFO with the transmitter disabled */
+	unsigned char		frameTx;	/* frame TX mode active				*/
+	unsigned char		frameActive;/* part of a frame is in the FIFO	*/
+	unsigned int		frameCount;	/* frames staged					*/
+	unsigned int		frameUnderruns;/* FIFO empty within a frame		*/
+
+	/* frame receive engine: frames cut at line idle (Modbus RTU t3.5) */
+	unsigned char		frmMode;	/* M77_FRM_OFF/_RTU/_IDLE			*/
+	unsigned char		idleUnit;	/* M77_IDLE_BITS/_US				*/
+	unsigned char		frmTxPrev;	/* frameTx before frame mode		*/
+	unsigned char		rxTimeout;	/* current IRQ is a RX timeout		*/
+	unsigned int		baud;		/* current baudrate					*/
+	unsigned int		rtuFlags;	/* M77_RTU_*						*/
+	unsigned int		t15Us;		/* configured t1.5, 0 = default		*/
+	unsigned int		t35Us;		/* configured t3.5, 0 = default		*/
+	unsigned int		t15Ns;		/* t1.5 in use						*/
+	unsigned int		t35Ns;		/* t3.5 in use						*/
+	unsigned int		idleGap;	/* idle gap in idleUnit				*/
+	unsigned int		frmLen;		/* chars in frmBuf					*/
+	unsigned int		frmStat;	/* M77_FRM_* of current frame		*/
+	unsigned int		frmLsr;		/* LSR errors of current frame		*/
+	unsigned int		frmCrc;		/* CRC register of current frame	*/
+	unsigned char		crcType;	/* M77_CRC_* in idle gap mode		*/
+	unsigned int		crcFlags;	/* M77_CRC_DROP						*/
+	ktime_t				frmLast;	/* end of last char received		*/
+	ktime_t				frmStart;	/* start of 1st char of the frame	*/
+	struct hrtimer		frmTimer;	/* fires at frmLast + t3.5			*/
+	unsigned int		frmCount;	/* frames delivered					*/
+	unsigned int		frmCrcErr;	/* frames with bad CRC				*/
+	unsigned int		frmCrcOk;	/* frames with good CRC				*/
+	unsigned int		frmDropped;	/* bad frames discarded				*/
+	unsigned int		frmT15Err;	/* frames with t1.5 violation		*/
+	unsigned int		frmInfoLost;/* frame infos overwritten			*/
+	unsigned int		infoHead;	/* next free frame info				*/
+	unsigned int		infoTail;	/* oldest frame info				*/
+	struct m77_frame_info frmInfo[M77_FRAME_INFO_NUM];
+	unsigned char		frmChunk[256];	/* chars of one RX interrupt	*/
+	unsigned char		frmBuf[M77_FRAME_MAX];
+
+	/* TX scheduler: frames sent from schedTimer ahead of xmit */
+	struct hrtimer		schedTimer;	/* fires at the next due slot		*/
+	unsigned int		schedPend;	/* due slots, bit per slot			*/
+	struct m77_sched	*schedCur;	/* frame being loaded into the FIFO	*/
+	unsigned int		schedOff;	/* chars of schedCur loaded			*/
+	struct m77_sched	sched[M77_SCHED_SLOTS];
+
+	/* priority TX queue, sent ahead of xmit */
+	unsigned int		prioHead;	/* next free entry					*/
+	unsigned int		prioTail;	/* oldest entry						*/
+	unsigned int		prioOff;	/* chars of the oldest entry loaded	*/
+	u64					prioSumNs;	/* sum of the latencies				*/
+	struct m77_prio_stats prioStats;
+	struct m77_prio		prio[M77_PRIO_NUM];
+
+	/* LIN master: schedule table run by linTimer */
+	unsigned char		linMode;	/* LIN master active				*/
+	unsigned char		linState;	/* M77_LIN_IDLE/_BRK/...			*/
+	unsigned char		linBreak;	/* break length in bit times		*/
+	unsigned char		linDelim;	/* delimiter length in bit times	*/
+	unsigned int		linFlags;	/* M77_LIN_ONCE						*/
+	unsigned int		linNum;		/* entries in linTab				*/
+	unsigned int		linIdx;		/* current entry					*/
+	unsigned int		linTxLen;	/* chars in linTxBuf				*/
+	unsigned int		linRx;		/* chars in linRxBuf				*/
+	unsigned int		linExpect;	/* chars read back/received per frame */
+	unsigned int		linLsr;		/* LSR errors of the frame			*/
+	ktime_t				linStart;	/* start of break					*/
+	ktime_t				linTmo;		/* end of the response window		*/
+	ktime_t				linNext;	/* start of the next slot			*/
+	struct hrtimer		linTimer;	/* break, delimiter, timeout, slot	*/
+	unsigned int		linFrames;	/* frames completed					*/
+	unsigned int		linNoResp;	/* frames without response			*/
+	unsigned int		linCsErr;	/* responses with bad checksum		*/
+	unsigned int		linBitErr;	/* frames read back wrong			*/
+	unsigned int		linResLost;	/* results overwritten				*/
+	unsigned int		linResHead;	/* next free result					*/
+	unsigned int		linResTail;	/* oldest result					*/
+	unsigned char		linTxBuf[12];	/* sync, PID, data, checksum	*/
+	unsigned char		linRxBuf[12];
+	struct m77_lin_entry linTab[M77_LIN_ENTRIES];
+	struct m77_lin_result linRes[M77_LIN_RESULTS];
+
+	/* bridge: RX chars go straight into the xmit buffer of brgPeer */
+	struct ox16c954_port *brgPeer;	/* NULL: no bridge					*/
+	unsigned int		brgFlags;	/* M77_BRIDGE_BIDIR/_FLOW			*/
+	unsigned int		brgRoom;	/* peer xmit space, last seen		*/
+	unsigned char		brgHeld;	/* RX held by flow control			*/
+	struct hrtimer		brgTimer;	/* polls the peer while held		*/
+	unsigned int		brgFwd;		/* chars forwarded					*/
+	unsigned int		brgDropped;	/* chars lost						*/
+	unsigned int		brgHolds;	/* times RX was held				*/
+
+	/* batch I/O: RX goes to batchBuf, read through the control device */
+	unsigned char		*batchBuf;	/* M77_BATCH_RING chars, NULL: tty	*/
+	unsigned int		batchHead;	/* next free char					*/
+	unsigned int		batchTail;	/* oldest char						*/
+	struct m77_ctl_file	*batchFile;	/* /dev/m77ctl file attached it		*/
+
+	/* raw mode: RX goes into the mapped ring of a /dev/m77ctl file */
+	struct m77_raw_ring	*rawRing;	/* NULL: tty						*/
+	unsigned char		*rawData;	/* data area of rawRing				*/
+	unsigned int		rawMask;	/* data area size - 1				*/
+	unsigned int		rawHead;	/* own copy of rawRing->head		*/
+	unsigned int		rawFlags;	/* M77_RAW_CHUNKS					*/
+	wait_queue_head_t	rawWait;	/* poll() of the bound file			*/
+
+	/* traffic tap: RX chars of one interrupt, recorded after the ISR */
+	unsigned char		tapOn;		/* channel selected by M77_TAP_SET	*/
+	unsigned char		tapLsr;		/* LSR errors of the tapped chars	*/
+	unsigned int		tapCnt;		/* chars in tapBuf					*/
+	unsigned char		tapBuf[256];
+
+	/* RX time stamps of the tty path, fetched with M77_RXTS_READ */
+	unsigned char		rxtsOn;		/* M77_RXTS_SET						*/
+	unsigned int		rxtsPos;	/* chars passed to the tty			*/
+	unsigned int		rxtsLost;	/* stamps overwritten				*/
+	unsigned int		rxtsHead;	/* next free stamp					*/
+	unsigned int		rxtsTail;	/* oldest stamp						*/
+	struct m77_rxts		rxts[M77_RXTS_NUM];
+
+	/* modem status events and PPS source, M77_MSR_SET */
+	unsigned char		msrOn;		/* queue MSR events					*/
+	unsigned char		msrSaved;	/* deltas read by get_mctrl			*/
+	unsigned int		msrFlags;	/* M77_MSR_PPS...					*/
+	unsigned int		msrLost;	/* events overwritten				*/
+	unsigned int		msrHead;	/* next free event					*/
+	unsigned int		msrTail;	/* oldest event						*/
+	struct m77_msr_event msrEv[M77_MSR_NUM];
+#ifdef M77_HAS_PPS
+	struct pps_device	*pps;		/* DCD PPS source, NULL: none		*/
+#endif
+
+	/* in-kernel client, owns the channel instead of the tty */
+	struct m77_kclient	*kcli;		/* NULL: tty						*/
+	struct circ_buf		kcXmit;		/* TX chars of kcli					*/
+	unsigned int		kcBaud;		/* baud rate of kcli				*/
+	unsigned char		kcFlow;		/* RTS/CTS flow control of kcli		*/
+	unsigned char		kcInCb;		/* ISR in a kcli callback			*/
+	unsigned char		kcWake;		/* write_wakeup due after the ISR	*/
+	wait_queue_head_t	kcWait;		/* m77_kclient_close() for kcInCb	*/
+
+	/* network interface, an in-kernel client using the frame engine */
+	struct net_device	*net;		/* NULL: interface down or none		*/
+	int					netDelim;	/* packet end char, -1: gap only	*/
+	unsigned int		netTaLate;	/* turnarounds above the idle gap	*/
+
+#ifdef M77_HAS_BPF
+	/* BPF filter of the frames passed to the tty */
+	struct bpf_prog		*bpfProg;	/* NULL: none						*/
+	struct sk_buff		*bpfSkb;	/* frame handed to bpfProg			*/
+	unsigned int		bpfType;	/* M77_BPF_CLASSIC or M77_BPF_EBPF	*/
+	struct m77_bpf		bpfStats;	/* hit counters of bpfProg			*/
+#endif
+
 	/*
 	 * We provide a per-port pm hook.
 	 */
@@ -204,6 +566,12 @@ typedef struct uartmod {
 	char 		deviceName[ARRLEN];	/* dev. name e.g. "m45_1" 		*/
 	void 		*mdisDev;		/* from mdis_open_external_device 	*/
 	void		*memBase;		/* ioremapped address of Module 	*/
+	unsigned int	uio;		/* 1: channels handed to userspace	*/
+#ifdef M77_HAS_UIO
+	unsigned int	uioOn;		/* uioInfo registered				*/
+	phys_addr_t		uioPhys;	/* bus address of memBase, uioaddr=	*/
+	struct uio_info uioInfo;	/* /dev/uioN of the M-Module		*/
+#endif
   struct uart_port uart;
   struct ox16c954_port *port8250[MAX_SNGL_UARTS];
 
@@ -238,6 +606,21 @@ MODULE_PARM_DESC( mode, "on M77: phy mode of channel 0-3, e.g. '1,1,7,7'" );
 module_param_array(echo, int, &arr_argc, 	0 );
 MODULE_PARM_DESC( echo, "on M77: disable / enable Rx feedback in HD modes");
 
+/* M-Modules whose channels are driven from userspace through UIO */
+static int   uio[MAX_MODS_SUPPORTED];
+module_param_array(uio, int, NULL, 0 );
+MODULE_PARM_DESC( uio, "1: M-Module handed to userspace via UIO, e.g. '0,1'");
+static unsigned long uioaddr[MAX_MODS_SUPPORTED];
+module_param_array(uioaddr, ulong, NULL, 0 );
+MODULE_PARM_DESC( uioaddr, "with uio=1: physical address of the Module's "
+				  "register window, e.g. '0,0xe8001000'");
+
+/* channels of in-kernel clients, see m77_kclient.h */
+static char* kclient[M77_KCLIENT_MAX];
+module_param_array(kclient, charp, NULL, 0444 );
+MODULE_PARM_DESC( kclient, "in-kernel client channels, name:line[:baud], "
+				  "e.g. 'gnss:3:9600'");
+
 /*-----------------------------+
 |   GLOBALS                    |
 +-----------------------------*/
@@ -245,6 +628,58 @@ MODULE_PARM_DESC( echo, "on M77: disable / enable Rx feedback in HD modes");
 /* linked List Anchor */
 static struct list_head		G_uartModListHead;
 
+/* 
+ * M45N TCRs are shared by 4 channels, serializes their read-modify-write
+ * and triOpen/triAuto of channels sharing a bit. Nests in port.lock.
+ */
+static DEFINE_SPINLOCK(m45_tcr_lock);
+
+/* serializes setting up and tearing down bridges between two ports */
+static DEFINE_SPINLOCK(m77_bridge_lock);
+
+/* port groups for M77_GROUP_WRITE, bit n of [n / 32] for /dev/ttyDn */
+static unsigned int m77Groups[M77_GROUPS][2];
+static DEFINE_SPINLOCK(m77_group_lock);
+
+/* serializes M77_MSR_SET, PPS sources are registered outside the lock */
+static DEFINE_MUTEX(m77_msr_mutex);
+
+/* M77_BATCH_WAIT sleeps here, woken on RX of any attached port */
+static DECLARE_WAIT_QUEUE_HEAD(m77_batch_wait);
+static int m77CtlRegistered;
+
+/* per open file of /dev/m77ctl */
+struct m77_ctl_file {
+	struct mutex			lock;	/* M77_RAW_SET against mmap/poll	*/
+	struct ox16c954_port	*raw;	/* channel bound by M77_RAW_SET	*/
+	struct m77_raw_ring		*ring;	/* header + data, vmalloc_user	*/
+	unsigned int			size;	/* data area of ring, the header
+									   is writable from userspace	*/
+	int						tap;	/* ring is the traffic tap		*/
+};
+
+/* traffic tap ring of all channels, owned by one /dev/m77ctl file */
+static struct m77_raw_ring *m77TapRing;	/* NULL: no tap				*/
+static unsigned char *m77TapData;		/* data area of m77TapRing	*/
+static unsigned int m77TapMask;			/* data area size - 1		*/
+static unsigned int m77TapHead;			/* own copy of ring head	*/
+static DEFINE_SPINLOCK(m77_tap_lock);
+static DECLARE_WAIT_QUEUE_HEAD(m77_tap_wait);
+
+/* without a tap the ISR paths see a patched out branch only */
+#ifdef DEFINE_STATIC_KEY_FALSE
+static DEFINE_STATIC_KEY_FALSE(m77_tap_key);
+# define M77_TAP_ACTIVE(up) \
+	(static_branch_unlikely(&m77_tap_key) && (up)->tapOn)
+# define M77_TAP_KEY(on) \
+	((on) ? static_branch_enable(&m77_tap_key) : \
+	 static_branch_disable(&m77_tap_key))
+#else
+static int m77TapKey;
+# define M77_TAP_ACTIVE(up)	(unlikely(m77TapKey) && (up)->tapOn)
+# define M77_TAP_KEY(on)	(m77TapKey = (on))
+#endif
+
 #if LINUX_VERSION_CODE > KERNEL_VERSION(2,6,35)
 static DEFINE_SEMAPHORE(serial_sem);
 #else 
@@ -268,9 +703,14 @@ static void men_uart_start_tx(struct uart_port *port);
 #endif
 
 static void men_uart_stop_rx(struct uart_port *port);
+#ifdef M77_HAS_THROTTLE
+static void men_uart_throttle(struct uart_port *port);
+static void men_uart_unthrottle(struct uart_port *port);
+#endif
 static void men_uart_enable_ms(struct uart_port *port);
 static void men_uart_break_ctl(struct uart_port *port, int break_state);
 static int men_uart_startup(struct uart_port *port);
+static int __men_uart_startup(struct uart_port *port);
 static void men_uart_shutdown(struct uart_port *port);
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,19)
@@ -293,6 +733,29 @@ static int men_uart_verify_port(struct uart_port *port,
 								struct serial_struct *ser);
 static int men_uart_ioctl(struct uart_port *up, unsigned int cmd, 
 						  unsigned long arg);
+static void __start_tx(struct ox16c954_port *up);
+static inline void __stop_tx(struct ox16c954_port *p);
+static int men_uart_frame_end(struct ox16c954_port *up);
+static int men_uart_lin_frame(struct ox16c954_port *up, ktime_t *expires);
+static void men_uart_oob_kick(struct ox16c954_port *up);
+static struct circ_buf *men_uart_port_xmit(struct ox16c954_port *up);
+static unsigned int men_uart_xmit_put(struct circ_buf *xmit,
+									  const unsigned char *buf,
+									  unsigned int cnt);
+static void men_uart_batch_detach(struct ox16c954_port *up, 
+								  struct m77_ctl_file *cf);
+#ifdef M77_HAS_NETDEV
+static void men_uart_net_rx(struct ox16c954_port *up, unsigned int len);
+static void men_uart_net_tx_done(struct ox16c954_port *up);
+static int men_uart_net_set(unsigned long arg);
+#endif
+
+/* RX taken away from the tty by the bridge, batch I/O or raw mode */
+static inline int men_uart_rx_bypass(struct ox16c954_port *up)
+{
+	return up->brgPeer || up->batchBuf || up->rawRing;
+}
+static void men_uart_bridge_unlink(struct ox16c954_port *up);
 
 static int register_uarts(UARTMOD_INFO*);
 
@@ -545,20 +1008,55 @@ static void serial_efr_write(struct ox16c954_port *up, int offset, int value)
 /** Control Software XON/XOFF handshaking in EFR
  *
  * \param up		\IN Oxford 16C954 Port Struct
- * \param en		\IN 0: disable XON/XOFF Flowcontrol else enable it
+ * \param iflag		\IN termios c_iflag: IXON lets the UART obey received
+ *						 XON/XOFF, IXOFF lets it send them, IXANY restarts
+ *						 the transmitter on any received character
+ *
+ * \brief The XON1/2 and XOFF1/2 characters are loaded from up->xon1/xoff1
+ *        and, in M77_INBAND_SEQ mode, up->xon2/xoff2. Everything is done by
+ *        the UART itself, the tty layer never sees the flow characters.
+ *        Must be called with the port lock held.
  *
  * \return 			-
  */
-static void set_inband_flowctrl(struct ox16c954_port *up, unsigned char en)
+static void set_inband_flowctrl(struct ox16c954_port *up, unsigned int iflag)
 {
 
-	unsigned char efr = serial_efr_read(up, M77_EFR_OFFSET) & 0xF0;
-	
-	if (en) 
-		efr |=0xa;  /* bits xxxx 1010 enable it*/
-	
+	unsigned char efr = serial_efr_read(up, M77_EFR_OFFSET) & 
+		~M77_EFR_FLOW_MASK;
+	unsigned char seq = (up->inbandMode == M77_INBAND_SEQ);
+
+	if (iflag & (IXON|IXOFF)) {
+		serial_efr_write(up, M77_XON1_OFFSET,  up->xon1 );
+		serial_efr_write(up, M77_XON2_OFFSET,  seq ? up->xon2  : up->xon1 );
+		serial_efr_write(up, M77_XOFF1_OFFSET, up->xoff1 );
+		serial_efr_write(up, M77_XOFF2_OFFSET, seq ? up->xoff2 : up->xoff1 );
+	}
+
+	if (iflag & IXON)
+		efr |= seq ? M77_EFR_RXFLOW_SEQ : M77_EFR_RXFLOW_XON1;
+	if (iflag & IXOFF)
+		efr |= seq ? M77_EFR_TXFLOW_SEQ : M77_EFR_TXFLOW_XON1;
+
+	/* count each XOFF the UART recognizes (IIR = XOFF/special char) */
+	if (iflag & IXON)
+		up->ier |= M77_IER_SPECIAL;
+	else
+		up->ier &= ~M77_IER_SPECIAL;
+
+	/* XON-any is an MCR bit in enhanced mode */
+	if ((iflag & IXON) && (iflag & IXANY))
+		up->mcr |= M77_MCR_XONANY;
+	else
+		up->mcr &= ~M77_MCR_XONANY;
+
 	M77DBG3("set_inband_flowctrl: Setting EFR = 0x%02x\n", efr);
 	serial_efr_write(up, M77_EFR_OFFSET, efr);
+	serial_out(up, UART_IER, up->ier);
+
+	/* now, not on the next set_mctrl(); LCR is restored, offset 4 is MCR */
+	serial_out(up, UART_MCR, (serial_in(up, UART_MCR) & ~M77_MCR_XONANY) |
+			   (up->mcr & M77_MCR_XONANY));
 }
 
 
@@ -618,6 +1116,125 @@ static inline void men_uart_clear_fifos(struct ox16c954_port *up)
 	}
 }
 
+/*******************************************************************/
+/** Program 950 mode trigger levels and flow control thresholds
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param rtl		\IN receive FIFO interrupt trigger level (1..127)
+ *
+ * \brief With ACR[5] set the UART uses TTL/RTL/FCL/FCH instead of the FCR
+ *        trigger tables. FCL/FCH are the levels at which the UART sends
+ *        XON/XOFF (or drives RTS) by itself, FCH leaves room for the peer
+ *        to react. The TX load per THRE interrupt is reduced accordingly.
+ *        TTL is up->ttl, raised in frame TX mode.
+ *
+ * \return 			-
+ */
+static void men_uart_set_trigger_levels(struct ox16c954_port *up,
+										unsigned int rtl)
+{
+	up->rtl = rtl;
+	serial_icr_write(up, UART_RTL, rtl);
+	serial_icr_write(up, UART_TTL, up->ttl);
+	serial_icr_write(up, UART_FCL, M77_FCL_DEFAULT);
+	serial_icr_write(up, UART_FCH, M77_FCH_DEFAULT);
+
+	up->acr |= UART_ACR_TLENB;
+	up->acrShadow = up->acr;
+	serial_icr_write(up, UART_ACR, up->acr);
+
+	up->tx_loadsz = up->port.fifosize - up->ttl;
+}
+
+/*******************************************************************/
+/** Program special character detection (9-bit multidrop or delimiter)
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \brief Multidrop: the station addresses are loaded as special characters
+ *        XOFF2 and XOFF1 with their 9th bit set (NMR). A received address
+ *        char matching one of them raises the special character interrupt.
+ *        With M77_MD_HWGATE the receiver stays disabled until then, so
+ *        frames for other stations don't even enter the FIFO.
+ *        Delimiter: XOFF2 is the frame delimiter, its arrival raises the
+ *        special character interrupt without waiting for the RX trigger.
+ *        Must be called with the port lock held.
+ *
+ * \return 			-
+ */
+static void men_uart_spchr_program(struct ox16c954_port *up)
+{
+	unsigned char efr = serial_efr_read(up, M77_EFR_OFFSET);
+	unsigned char nmr = 0;
+
+	up->mdAddressed = 0;
+	if (up->mdEnable) {
+		serial_efr_write(up, M77_XOFF2_OFFSET, up->mdAddr[0]);
+		serial_efr_write(up, M77_XOFF1_OFFSET, up->mdAddr[1]);
+		nmr = M77_NMR_9BIT_EN | M77_NMR_9BIT_XOFF1 | M77_NMR_9BIT_XOFF2;
+		efr |= UART_EFR_SCD;
+		up->ier |= M77_IER_SPECIAL;
+		if (up->mdFlags & M77_MD_HWGATE)
+			up->acr |= UART_ACR_RXDIS;
+		else
+			up->acr &= ~UART_ACR_RXDIS;
+	} else if (up->delimEnable) {
+		serial_efr_write(up, M77_XOFF2_OFFSET, up->delim);
+		efr |= UART_EFR_SCD;
+		up->ier |= M77_IER_SPECIAL;
+		up->acr &= ~UART_ACR_RXDIS;
+	} else {
+		efr &= ~UART_EFR_SCD;
+		if (!(up->iflag & IXON))
+			up->ier &= ~M77_IER_SPECIAL;
+		up->acr &= ~UART_ACR_RXDIS;
+	}
+
+	M77DBG2("%s: NMR=0x%02x EFR=0x%02x ACR=0x%02x\n", __FUNCTION__,
+			nmr, efr, up->acr);
+	serial_icr_write(up, UART_NMR, nmr);
+	serial_efr_write(up, M77_EFR_OFFSET, efr);
+	up->acrShadow = up->acr;
+	serial_icr_write(up, UART_ACR, up->acr);
+	serial_out(up, UART_IER, up->ier);
+}
+
+/*******************************************************************/
+/** Address filter for 9-bit multidrop mode, within ISR
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param ch		\IN received character
+ * \param lsr		\IN LSR belonging to ch, LSR[2] is the 9th bit
+ *
+ * \brief Address chars are never passed up. An address for another station
+ *        drops everything until our address is seen again.
+ *
+ * \return 			1 if ch is data for this station, 0 to drop it
+ */
+static inline int men_uart_md_filter(struct ox16c954_port *up,
+									 unsigned char ch, unsigned char lsr)
+{
+	if (!(lsr & M77_LSR_9BIT))
+		return up->mdAddressed;
+
+	if ((ch == up->mdAddr[0]) || (ch == up->mdAddr[1])) {
+		up->mdAddressed = 1;
+		return 0;
+	}
+
+	/* every foreign address starts a frame for another station */
+	up->mdForeign++;
+	if (up->mdAddressed) {
+		up->mdAddressed = 0;
+		if (up->mdFlags & M77_MD_HWGATE) {
+			up->acr |= UART_ACR_RXDIS;
+			up->acrShadow = up->acr;
+			serial_icr_write(up, UART_ACR, up->acr);
+		}
+	}
+	return 0;
+}
+
 /*******************************************************************/
 /** IER sleep support, Unused in this driver
  *
@@ -664,6 +1281,10 @@ static struct uart_ops men_uart_pops = {
 	.stop_tx		= men_uart_stop_tx,
 	.start_tx		= men_uart_start_tx,
 	.stop_rx		= men_uart_stop_rx,
+#ifdef M77_HAS_THROTTLE
+	.throttle		= men_uart_throttle,
+	.unthrottle		= men_uart_unthrottle,
+#endif
 	.enable_ms		= men_uart_enable_ms,
 	.break_ctl		= men_uart_break_ctl,
 	.startup		= men_uart_startup,
@@ -681,6 +1302,140 @@ static struct uart_ops men_uart_pops = {
 static struct ox16c954_port men_uart_ports[MAX_SNGL_UARTS];
 
 
+/*******************************************************************/
+/** push received chars from the flip buffer to the line discipline
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \brief Must be called without the port lock held.
+ *
+ * \return 			-
+ */
+static void men_uart_rx_push(struct ox16c954_port *up)
+{
+#if LINUX_VERSION_CODE <= KERNEL_VERSION(2,6,27)
+	struct tty_struct *tty = up->port.info->tty;
+#elif LINUX_VERSION_CODE <= KERNEL_VERSION(2,6,31)
+	struct tty_struct *tty = up->port.info->port.tty;
+#elif LINUX_VERSION_CODE < KERNEL_VERSION(3,9,0)
+	struct tty_struct *tty = up->port.state->port.tty;
+#endif
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(3,9,0)
+	if (tty)
+		tty_flip_buffer_push(tty);
+#else 
+	tty_flip_buffer_push(&up->port.state->port);
+#endif
+}
+
+
+/*******************************************************************/
+/** line idle timer of delimiter mode, pushes data held back so far
+ *
+ * \param timer		\IN rxTimer of the Oxford 16C954 Port Struct
+ *
+ * \return 			HRTIMER_NORESTART
+ */
+static enum hrtimer_restart men_uart_rx_timer(struct hrtimer *timer)
+{
+	struct ox16c954_port *up = 
+		container_of(timer, struct ox16c954_port, rxTimer);
+	unsigned long flags;
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	up->delimIdles++;
+	spin_unlock_irqrestore(&up->port.lock, flags);
+
+	men_uart_rx_push(up);
+	return HRTIMER_NORESTART;
+}
+
+
+/*******************************************************************/
+/** Switch the M45N line driver of a channel to tristate or back
+ *
+ * \param ox		\IN Oxford 16C954 Port Struct
+ * \param on		\IN 1: tristate, 0: normal operation
+ *
+ * \brief Callable from interrupt context.
+ *
+ * \return 			-
+ */
+static void men_uart_m45_tristate(struct ox16c954_port *ox, int on)
+{
+	unsigned long flags;
+	unsigned char ch;
+
+	spin_lock_irqsave(&m45_tcr_lock, flags);
+	ch = serial_in(ox, ox->tcrReg);		
+	M77DBG3(" 1. read TCR: 0x%02x ", ch );
+	if (on)
+		ch |= ox->tcrBit;
+	else
+		ch &= ~ox->tcrBit;
+
+	M77DBG3("2. set TCR(0x%02x) = %02x\n", ox->tcrReg << 1, ch );
+	serial_out(ox, ox->tcrReg, ch );
+	spin_unlock_irqrestore(&m45_tcr_lock, flags);
+}
+
+
+/*******************************************************************/
+/** RS485 flags of a M77 PHY mode not set with TIOCSRS485
+ *
+ * \param ox		\IN Oxford 16C954 Port Struct
+ * \param dcr		\IN DCR of the channel
+ *
+ * \brief RS485 HD set with the mode parameter or M77_PHYS_INT_SET is 
+ *        reported by TIOCGRS485 too, but doesn't block M77_PHYS_INT_SET.
+ *
+ * \return 			serial_rs485 flags
+ */
+static unsigned int men_uart_rs485_phy_flags(struct ox16c954_port *ox,
+											 unsigned char dcr)
+{
+	unsigned int flags = 0;
+
+	if (ox->m77Mode == M77_RS485_HD) {
+		flags = SER_RS485_ENABLED | SER_RS485_RTS_ON_SEND;
+		if (dcr & M77_RX_EN)
+			flags |= SER_RS485_RX_DURING_TX;
+	}
+	return flags;
+}
+
+
+/*******************************************************************/
+/** Switch the M77 receive line during transmit (echo) on or off
+ *
+ * \param ox		\IN Oxford 16C954 Port Struct
+ * \param on		\IN 1: DCR[RX_EN] set, 0: cleared
+ *
+ * \brief Must be called with the port lock held.
+ *
+ * \return 			-
+ */
+static void men_uart_m77_rxen(struct ox16c954_port *ox, int on)
+{
+	unsigned char ch = serial_in(ox, ox->dcrReg) & ~M77_RX_EN;
+
+	if (on)
+		ch |= M77_RX_EN;	/* enable Receive Line, allowing Echo */
+
+	M77DBG2("set DCR %02x at Reg %02x\n", ch, ox->dcrReg << 1 );
+	serial_out(ox, ox->dcrReg, ch);
+
+	/* keep TIOCGRS485 in sync */
+	ox->rs485.flags &= ~SER_RS485_RX_DURING_TX;
+	if (on && (ox->rs485.flags & SER_RS485_ENABLED))
+		ox->rs485.flags |= SER_RS485_RX_DURING_TX;
+#ifdef M77_HAS_RS485_CONFIG
+	ox->port.rs485.flags = ox->rs485.flags;
+#endif
+}
+
+
 /*******************************************************************/
 /** Ioctl function to treat special codes not handled in serial_core.c
  *
@@ -697,6 +1452,7 @@ static int men_uart_m77phy( struct uart_port *up,
 /*     int retVal = 0; */
 	unsigned char ch = 0;
 	struct ox16c954_port *ox = &men_uart_ports[up->line];
+	unsigned long flags;
 
 	M77DBG2("%s: line %d ox->type = %d\n", __FUNCTION__, up->line, ox->type );
 
@@ -709,14 +1465,14 @@ static int men_uart_m77phy( struct uart_port *up,
 		if (ox->type != MOD_M77)
 			return -ENOTTY;
 
-		ch = serial_in(ox, ox->dcrReg ) & 0xfe;
-		M77DBG2(" 1. read DCR: 0x%02x ", ch );
-		if (arg) {
-			ch |= M77_RX_EN;	/* enable Receive Line, allowing Echo */
+		/* echo cancellation needs the echo */
+		spin_lock_irqsave(&ox->port.lock, flags);
+		if (ox->echoEnable && !arg) {
+			spin_unlock_irqrestore(&ox->port.lock, flags);
+			return -EBUSY;
 		}
-
-		M77DBG2("2. set DCR %02x at Reg %02x\n", ch, ox->dcrReg << 1 );
-		serial_out(ox, ox->dcrReg, ch );
+		men_uart_m77_rxen(ox, !!arg);
+		spin_unlock_irqrestore(&ox->port.lock, flags);
 		break;
 
 
@@ -727,6 +1483,10 @@ static int men_uart_m77phy( struct uart_port *up,
 		M77DBG2("ioctl M77_PHYS_INT_SET\n" );
 		if (ox->type != MOD_M77)
 			return -ENOTTY;
+
+		/* disable with TIOCSRS485 first */
+		if (ox->rs485Set)
+			return -EBUSY;
 		
 		/* Read DCR, ACR and clear out Mode bits DCR[0:2] first */
 		ch = serial_in(ox, ox->dcrReg);
@@ -784,6 +1544,12 @@ static int men_uart_m77phy( struct uart_port *up,
 		}
 
 		ox->m77Mode = arg;
+
+		/* keep TIOCGRS485 in sync */
+		ox->rs485.flags = men_uart_rs485_phy_flags(ox, ch);
+#ifdef M77_HAS_RS485_CONFIG
+		ox->port.rs485.flags = ox->rs485.flags;
+#endif
 		M77DBG(" ACR = %02x\n", ox->acr);
 		break;
 
@@ -795,15 +1561,11 @@ static int men_uart_m77phy( struct uart_port *up,
 		if (ox->type != MOD_M45)
 			return -ENOTTY;
 
-		ch = serial_in(ox, ox->tcrReg);		
-		M77DBG2(" 1. read TCR: 0x%02x ", ch );
-		if (arg)
-			ch |=ox->tcrBit;
-		else
-			ch &=~ox->tcrBit;
+		/* switched by the driver itself */
+		if (ox->triAuto)
+			return -EBUSY;
 
-		M77DBG2("2. set TCR(0x%02x) = %02x\n", ox->tcrReg << 1, ch );
-		serial_out(ox, ox->tcrReg, ch );			
+		men_uart_m45_tristate(ox, !!arg);
 		break;
 	}
 
@@ -814,1684 +1576,7737 @@ static int men_uart_m77phy( struct uart_port *up,
 
 
 /*******************************************************************/
-/** Main HW dependent Ioctl function
+/** Ioctl function for the in-band flow control settings
  *
- * \param up		\IN Oxford 16C954 Port Struct
- * \param cmd		\IN ioctl type, see serial_m77.h
- * \param arg		\IN ioctl argument, see serial_m77.h
+ * \param up		\IN highlevel (serial core) Port Struct
+ * \param cmd		\IN M77_INBAND_SET or M77_INBAND_GET
+ * \param arg		\IN user pointer to struct m77_inband
  *
  * \return 			0 or negative error number
  */
-static int men_uart_ioctl(struct uart_port *up, unsigned int cmd, 
-						  unsigned long arg)
+static int men_uart_inband( struct uart_port *up, 
+							unsigned int cmd,
+							unsigned long arg)
 {
-	int retval = 0;
-
-	/* M77DBG("%s: cmd = 0x%x arg = 0x%x ", __FUNCTION__, cmd, arg ); */
+	struct ox16c954_port *ox = &men_uart_ports[up->line];
+	struct m77_inband inb;
+	unsigned long flags;
 
 	switch (cmd) {
+	case M77_INBAND_SET:
+		if (copy_from_user(&inb, (void __user *)arg, sizeof(inb)))
+			return -EFAULT;
+		if ((inb.mode != M77_INBAND_SINGLE) && (inb.mode != M77_INBAND_SEQ))
+			return -EINVAL;
 
-	case M77_PHYS_INT_SET:
-	case M77_ECHO_SUPPRESS:
-	case M45_TIO_TRI_MODE:
-		retval = men_uart_m77phy( up, cmd, arg);
+		M77DBG2("M77_INBAND_SET: mode %d XON2 0x%02x XOFF2 0x%02x\n",
+				inb.mode, inb.xon2, inb.xoff2);
+		spin_lock_irqsave(&ox->port.lock, flags);
+		ox->inbandMode 	= inb.mode;
+		ox->xon2 		= inb.xon2;
+		ox->xoff2 		= inb.xoff2;
+		set_inband_flowctrl(ox, ox->iflag);
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		break;
+
+	case M77_INBAND_GET:
+		memset(&inb, 0, sizeof(inb));
+		spin_lock_irqsave(&ox->port.lock, flags);
+		inb.mode 		= ox->inbandMode;
+		inb.xon2 		= ox->xon2;
+		inb.xoff2 		= ox->xoff2;
+		inb.xoffCount 	= ox->xoffCount;
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		if (copy_to_user((void __user *)arg, &inb, sizeof(inb)))
+			return -EFAULT;
 		break;
-            
-	default:
-		retval = -ENOIOCTLCMD;
 	}
-	return retval;
 
+	return 0;
 }
 
 
 /*******************************************************************/
-/** Toplevel 16550 + compatibles autoconfig function
+/** Ioctl function for the 9-bit multidrop address filter
  *
- * \param up		\IN Oxford 16C954 Port Struct
+ * \param up		\IN highlevel (serial core) Port Struct
+ * \param cmd		\IN M77_MULTIDROP_SET or M77_MULTIDROP_GET
+ * \param arg		\IN user pointer to struct m77_multidrop
  *
- * \return 			-
+ * \return 			0 or negative error number
  */
-static void autoconfig_16550a(struct ox16c954_port *up)
+static int men_uart_multidrop( struct uart_port *up, 
+							   unsigned int cmd,
+							   unsigned long arg)
 {
-	unsigned int id1, id2, id3, rev;
-	up->port.type = PORT_16C950;
- 	up->capabilities |= UART_CAP_FIFO; 
+	struct ox16c954_port *ox = &men_uart_ports[up->line];
+	struct m77_multidrop md;
+	unsigned long flags;
 
-	serial_out(up, UART_LCR, 0xBF);
-	if (serial_in(up, UART_EFR) == 0 ) {
-		printk("EFRv2 ");
+	switch (cmd) {
+	case M77_MULTIDROP_SET:
+		if (copy_from_user(&md, (void __user *)arg, sizeof(md)))
+			return -EFAULT;
+		if (md.enable && (md.nrAddr < 1 || md.nrAddr > 2))
+			return -EINVAL;
 
-		/* Everything with an EFR has SLEEP */
-		up->capabilities |= UART_CAP_FIFO|UART_CAP_EFR | UART_CAP_SLEEP;
+		/* the special character registers are used for XON/XOFF then */
+		if (md.enable && ((ox->iflag & (IXON|IXOFF)) || ox->delimEnable))
+			return -EBUSY;
+
+		/* frame mode reads the FIFO without the address filter */
+		if (md.enable && ox->frmMode)
+			return -EBUSY;
+
+		M77DBG2("M77_MULTIDROP_SET: en %d addr 0x%02x/0x%02x\n",
+				md.enable, md.addr[0], md.addr[1]);
+		spin_lock_irqsave(&ox->port.lock, flags);
+		if (md.enable && !ox->mdEnable) {
+			/* 8 data bits, the parity bit carries the 9th bit */
+			ox->mdLcr = ox->lcr;
+			ox->lcr = (ox->lcr & ~(UART_LCR_PARITY | UART_LCR_EPAR | 
+								   UART_LCR_SPAR | UART_LCR_WLEN8)) | 
+				UART_LCR_WLEN8;
+		} else if (!md.enable && ox->mdEnable) {
+			ox->lcr = ox->mdLcr | (ox->lcr & UART_LCR_SBC);
+		}
+		serial_out(ox, UART_LCR, ox->lcr);
+
+		ox->mdEnable 	= md.enable;
+		ox->mdFlags 	= md.flags & M77_MD_HWGATE;
+		ox->mdAddr[0] 	= md.addr[0];
+		ox->mdAddr[1] 	= (md.nrAddr == 2) ? md.addr[1] : md.addr[0];
+		men_uart_spchr_program(ox);
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		break;
 
-		/* Check for Oxford Semiconductor 16C95x (true for M45N/69N/77) */
-		up->acr = 0;	
-		up->acrShadow = up->acr;
-		
-		/* Set Enhanced Mode */
-		serial_efr_write(up, UART_EFR, UART_EFR_ECB);
-		id1 = serial_icr_read(up, UART_ID1);
-		id2 = serial_icr_read(up, UART_ID2);
-		id3 = serial_icr_read(up, UART_ID3);
-		rev = serial_icr_read(up, UART_REV);
-		M77DBG("16c950 ID: %02x:%02x:%02x:%02x ", id1, id2, id3, rev);
-		if (id1==0x16 && id2 == 0xC9 && (id3==0x50 || id3==0x52 || id3==0x54)) 
-			up->port.type = PORT_16C950;
-		
-		return;
+	case M77_MULTIDROP_GET:
+		memset(&md, 0, sizeof(md));
+		spin_lock_irqsave(&ox->port.lock, flags);
+		md.enable 		= ox->mdEnable;
+		md.nrAddr 		= (ox->mdAddr[0] == ox->mdAddr[1]) ? 1 : 2;
+		md.addr[0] 		= ox->mdAddr[0];
+		md.addr[1] 		= ox->mdAddr[1];
+		md.flags 		= ox->mdFlags;
+		md.foreignCount = ox->mdForeign;
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		if (copy_to_user((void __user *)arg, &md, sizeof(md)))
+			return -EFAULT;
+		break;
 	}
+
+	return 0;
 }
 
 
 /*******************************************************************/
-/** Toplevel Autoconfig function
+/** Ioctl function for the echo cancellation
  *
- * \param up			\IN Oxford 16C954 Port Struct
- * \param probeflags	\IN one of UPF_*, see serial_core.h
+ * \param up		\IN highlevel (serial core) Port Struct
+ * \param cmd		\IN M77_ECHO_CANCEL_SET or M77_ECHO_CANCEL_GET
+ * \param arg		\IN user pointer to struct m77_echo
  *
- * \brief This is called to determine what type of UART chip this serial 
- *        port is, using: 8250, 16450, 16550, 16550A.
+ * \brief On M77 the receive line is switched on while echo cancellation 
+ *        is active and restored afterwards.
  *
- * \return 			-
+ * \return 			0 or negative error number
  */
-static void autoconfig(struct ox16c954_port *up, unsigned int probeflags)
+static int men_uart_echo( struct uart_port *up, 
+						  unsigned int cmd,
+						  unsigned long arg)
 {
-	unsigned char status1, scratch, scratch2, scratch3;
-	unsigned char save_lcr, save_mcr;
+	struct ox16c954_port *ox = &men_uart_ports[up->line];
+	struct m77_echo ec;
 	unsigned long flags;
 
-	if (!up->port.iobase && !up->port.mapbase && !up->port.membase)
-		return;
-
-	M77DBG( UART_NAME_PREFIX"%d: autoconf: ", up->port.line);
-
-	/*
-	 * We really do need global IRQs disabled here - we're going to
-	 * be frobbing the chips IRQ enable register to see if it exists.
-	 */
-	spin_lock_irqsave(&up->port.lock, flags);
-
-	up->capabilities = 0;
-	up->bugs = 0;
-
-	scratch = serial_in(up, UART_IER);
-	serial_out(up, UART_IER, 0);
-
-	scratch2 = serial_in(up, UART_IER);
-	serial_out(up, UART_IER, 0x0F);
-
-	scratch3 = serial_in(up, UART_IER);
-	serial_out(up, UART_IER, scratch);
-
-	if (scratch2 != 0 || scratch3 != 0x0F) {
-		/* We failed; there's nothing here */
-		M77DBG("IER test failed (%02x, %02x) ",scratch2, scratch3);
-		goto out;
-	}
-
-	save_mcr = serial_in(up, UART_MCR);
-	save_lcr = serial_in(up, UART_LCR);
-
-	/* 
-	 * Check to see if a UART is really there.
-	 */
-	serial_out(up, UART_MCR, UART_MCR_LOOP | 0x0A);
-	status1 = serial_in(up, UART_MSR) & 0xF0;
-	serial_out(up, UART_MCR, save_mcr);
-	if (status1 != 0x90) {
-		M77DBG("LOOP test failed (%02x) ", status1);
-		goto out;
-	}
-
-
-	/*
-	 * We're pretty sure there's a port here.  Lets find out what
-	 * type of port it is.  The IIR top two bits allows us to find
-	 * out if it's 8250 or 16450, 16550, 16550A or later.  This
-	 * determines what we test for next.
-	 *
-	 * We also initialise the EFR (if any) to zero for later.  The
-	 * EFR occupies the same register location as the FCR and IIR.
-	 */
-
-	/* Set Enhanced Mode */
-	serial_efr_write(up, UART_EFR, UART_EFR_ECB);
-
-	serial_out(up, UART_FCR, UART_FCR_ENABLE_FIFO);
-	scratch = serial_in(up, UART_IIR) >> 6;
-
-	M77DBG3("iir=%d ", scratch);
-
-	switch (scratch) {
-	case 3:
-		autoconfig_16550a(up);
-		break;
-	default:
-		printk("*** unknown iir value:=%d (should be 3)", scratch);
+	switch (cmd) {
+	case M77_ECHO_CANCEL_SET:
+		if (copy_from_user(&ec, (void __user *)arg, sizeof(ec)))
+			return -EFAULT;
+
+		M77DBG2("M77_ECHO_CANCEL_SET: en %d flags 0x%x\n", 
+				ec.enable, ec.flags);
+
+		/* DCR is shared with the ISR, tristate and RS485 */
+		spin_lock_irqsave(&ox->port.lock, flags);
+		if (ox->type == MOD_M77 && ec.enable != ox->echoEnable) {
+			if (ec.enable) {
+				ox->echoPrevRxEn = 
+					!!(serial_in(ox, ox->dcrReg) & M77_RX_EN);
+				men_uart_m77_rxen(ox, 1);
+			} else
+				men_uart_m77_rxen(ox, ox->echoPrevRxEn);
+		}
+		ox->echoEnable 	= ec.enable;
+		ox->echoFlags 	= ec.flags;
+		ox->echoHead 	= ox->echoTail = 0;
+		spin_unlock_irqrestore(&ox->port.lock, flags);
 		break;
-	}
-
-	serial_out(up, UART_LCR, save_lcr);
-
-	if (up->capabilities != uart_config[up->port.type].flags) {
 
-		printk(KERN_WARNING UART_NAME_PREFIX
-			   "%d: detected caps %08x should be %08x\n",
-			   up->port.line, up->capabilities,
-			   uart_config[up->port.type].flags);
+	case M77_ECHO_CANCEL_GET:
+		memset(&ec, 0, sizeof(ec));
+		spin_lock_irqsave(&ox->port.lock, flags);
+		ec.enable 		= ox->echoEnable;
+		ec.flags 		= ox->echoFlags;
+		ec.collision 	= ox->echoColl;
+		ec.echoCount 	= ox->echoDropped;
+		ec.collisions 	= ox->echoCollisions;
+		ec.lostCount 	= ox->echoLost;
+		ox->echoColl 	= 0;
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		if (copy_to_user((void __user *)arg, &ec, sizeof(ec)))
+			return -EFAULT;
+		break;
 	}
 
-	up->port.fifosize = uart_config[up->port.type].fifo_size;
-	up->capabilities = uart_config[up->port.type].flags;
-	up->tx_loadsz = uart_config[up->port.type].tx_loadsz;
-
-	if (up->port.type == PORT_UNKNOWN)
-		goto out;
-
-	/*
-	 * Reset the UART.
-	 */
-
-	serial_out(up, UART_MCR, save_mcr);
-	men_uart_clear_fifos(up);
-	(void)serial_in(up, UART_RX);
-	if (up->capabilities & UART_CAP_UUE)
-		serial_out(up, UART_IER, UART_IER_UUE);
-	else
-		serial_out(up, UART_IER, 0);
-
- out:	
-	spin_unlock_irqrestore(&up->port.lock, flags);
-//	restore_flags(flags);
-
+	return 0;
 }
 
 
 /*******************************************************************/
-/** lowlevel TX Stop function, by clearing Threshold IRQ
+/** switch frame TX mode
  *
- * \param p			\IN Oxford 16C954 Port Struct
+ * \param ox		\IN Oxford 16C954 Port Struct
+ * \param enable	\IN 1: stage frames, 0: normal TX
+ * \param ttl		\IN TX trigger level in frame TX mode
+ *
+ * \brief Must be called with the port lock held.
  *
  * \return 			-
  */
-static inline void __stop_tx(struct ox16c954_port *p)
+static void men_uart_frametx_enable(struct ox16c954_port *ox, int enable,
+									unsigned int ttl)
 {
-	if (p->ier & UART_IER_THRI) {
-		p->ier &= ~UART_IER_THRI;
-		serial_out(p, UART_IER, p->ier);
-	}
+	ox->frameTx 	= enable;
+	ox->frameActive = 0;
+	ox->ttl 		= enable ? ttl : M77_TTL_DEFAULT;
+	men_uart_set_trigger_levels(ox, ox->rtl);
 }
 
+
 /*******************************************************************/
-/** highlevel TX stop function called by serial_core
+/** compute the frame gap times in use
  *
- * \param port		\IN highlevel uart_port Struct (as in serial_core)
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \brief Modbus: 1.5 and 3.5 char times, fixed 750us and 1750us above
+ *        19200 baud. Values set with M77_RTU_SET take precedence.
+ *        Idle gap mode: the gap set with M77_IDLE_SET, no t1.5 check.
  *
  * \return 			-
  */
-#if LINUX_VERSION_CODE < Z025_SERIAL_DIFF
-static void men_uart_stop_tx(struct uart_port *port, unsigned int tty_stop)
-#else
-static void men_uart_stop_tx(struct uart_port *port)
-#endif
+static void men_uart_frame_times(struct ox16c954_port *up)
 {
-	struct ox16c954_port *up = (struct ox16c954_port *)port;
-
-	__stop_tx(up);
+	u64 ns;
 
-	/*
-	 * We really want to stop the transmitter from sending.
-	 */
-	if (up->port.type == PORT_16C950) {
-		up->acr |= UART_ACR_TXDIS;
-		serial_icr_write(up, UART_ACR, up->acr);
-		up->acrShadow = up->acr;
+	if (up->frmMode == M77_FRM_IDLE) {
+		if (up->idleUnit == M77_IDLE_US)
+			ns = (u64)up->idleGap * NSEC_PER_USEC;
+		else
+			ns = (u64)up->idleGap * (up->baud ? NSEC_PER_SEC / up->baud : 0);
+		up->t35Ns = (ns > M77_IDLE_MAX_NS) ? M77_IDLE_MAX_NS : ns;
+		up->t15Ns = up->t35Ns;
+		return;
 	}
+
+	/* in u64, clamped as the idle gap: t15Ns/t35Ns are 32 bit */
+	ns = (u64)up->t15Us * NSEC_PER_USEC;
+	if (up->t15Us)
+		up->t15Ns = (ns > M77_IDLE_MAX_NS) ? M77_IDLE_MAX_NS : ns;
+	else
+		up->t15Ns = (up->baud > 19200) ? 750000 : up->charNs * 3 / 2;
+
+	ns = (u64)up->t35Us * NSEC_PER_USEC;
+	if (up->t35Us)
+		up->t35Ns = (ns > M77_IDLE_MAX_NS) ? M77_IDLE_MAX_NS : ns;
+	else
+		up->t35Ns = (up->baud > 19200) ? 1750000 : up->charNs * 7 / 2;
 }
 
 
 /*******************************************************************/
-/** central transmit function, called in ISR 
+/** switch the frame receive engine between its modes
  *
- * \param up		\IN Oxford 16C954 Port Struct
+ * \param ox		\IN Oxford 16C954 Port Struct
+ * \param mode		\IN M77_FRM_OFF, M77_FRM_RTU or M77_FRM_IDLE
  *
- * \return 			-
+ * \brief Frame TX mode is switched on with the frame receive engine so
+ *        telegrams are sent without gaps too. A frame received so far is
+ *        passed up. Must be called with the port lock held, frmTimer is
+ *        canceled by the caller when switching off.
+ *
+ * \return 			1 if the flip buffer must be pushed, else 0
  */
-static inline void transmit_chars(struct ox16c954_port *up)
+static int men_uart_frame_mode(struct ox16c954_port *ox, unsigned char mode)
 {
-
-#if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,32)
-	struct circ_buf *xmit = &up->port.info->xmit;
-#else
-	struct circ_buf *xmit = &up->port.state->xmit;
-#endif
-
-	int count;
-
-	if (up->port.x_char) {
-		serial_out(up, UART_TX, up->port.x_char);
-		up->port.icount.tx++;
-		up->port.x_char = 0;
-		return;
-	}
-
-	if (uart_tx_stopped(&up->port)) {
-#if LINUX_VERSION_CODE < Z025_SERIAL_DIFF
-		men_uart_stop_tx(&up->port, 0);
-#else
-		men_uart_stop_tx(&up->port);
-#endif
-		return;
-	}
-
-	if (uart_circ_empty(xmit)) {
-		__stop_tx(up);
-		return;
+	int push = 0;
+
+	if (mode && !ox->frmMode) {
+		/* send frames without gaps too */
+		ox->frmTxPrev = ox->frameTx;
+		if (!ox->frameTx)
+			men_uart_frametx_enable(ox, 1, M77_FRAMETX_TTL_DEFAULT);
+		ox->infoHead = ox->infoTail = 0;
+	} else if (mode != ox->frmMode) {
+		/* pass up what was received so far */
+		push = men_uart_frame_end(ox);
+		if (!mode && !ox->frmTxPrev)
+			men_uart_frametx_enable(ox, 0, 0);
 	}
 
-	count = up->tx_loadsz;
-	do {
-		serial_out(up, UART_TX, xmit->buf[xmit->tail]);
-		xmit->tail = (xmit->tail + 1) & (UART_XMIT_SIZE - 1);
-		up->port.icount.tx++;
-		if (uart_circ_empty(xmit))
-			break;
-	} while (--count > 0);
-
-	if (uart_circ_chars_pending(xmit) < WAKEUP_CHARS)
-		uart_write_wakeup(&up->port);
-
-	DEBUG_INTR("THRE ");
-
-	if (uart_circ_empty(xmit))
-		__stop_tx(up);
+	ox->frmMode = mode;
+	men_uart_frame_times(ox);
+	return push;
 }
 
 
 /*******************************************************************/
-/** transmit start function
+/** Ioctl function for the RX time stamps
  *
- * \param port		\IN highlevel (serial core) Port Struct
+ * \param up		\IN highlevel (serial core) Port Struct
+ * \param cmd		\IN M77_RXTS_SET or M77_RXTS_READ
+ * \param arg		\IN user pointer to struct m77_rxts_set or m77_rxts_read
  *
- * \return 			-
+ * \brief The stamps refer to the chars passed to the tty by position,
+ *        counted from M77_RXTS_SET. A tty flush (TCIFLUSH) breaks the
+ *        link to the chars read, set again to restart at 0.
+ *
+ * \return 			0 or negative error number
  */
-#if LINUX_VERSION_CODE < Z025_SERIAL_DIFF
-static void men_uart_start_tx(struct uart_port *port, unsigned int tty_start)
-#else
-static void men_uart_start_tx(struct uart_port *port)
-#endif
+static int men_uart_rxts( struct uart_port *up, 
+						  unsigned int cmd,
+						  unsigned long arg)
 {
-	struct ox16c954_port *up = (struct ox16c954_port *)port;
+	struct ox16c954_port *ox = &men_uart_ports[up->line];
+	struct m77_rxts_read *rd;
+	struct m77_rxts_set st;
+	unsigned long flags;
+	unsigned int i;
+	int retval = 0;
 
-	if (!(up->ier & UART_IER_THRI)) {
-		up->ier |= UART_IER_THRI;
-		serial_out(up, UART_IER, up->ier);
+	switch (cmd) {
+	case M77_RXTS_SET:
+		if (copy_from_user(&st, (void __user *)arg, sizeof(st)))
+			return -EFAULT;
+
+		M77DBG2("M77_RXTS_SET: en %d\n", st.enable);
+		spin_lock_irqsave(&ox->port.lock, flags);
+		ox->rxtsOn 		= !!st.enable;
+		ox->rxtsPos 	= 0;
+		ox->rxtsLost 	= 0;
+		ox->rxtsHead 	= ox->rxtsTail = 0;
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		break;
 
-		if (up->bugs & UART_BUG_TXEN) {
-			unsigned char lsr, iir;
-			lsr = serial_in(up, UART_LSR);
-			iir = serial_in(up, UART_IIR);
-			if (lsr & UART_LSR_TEMT && iir & UART_IIR_NO_INT)
-				transmit_chars(up);
+	case M77_RXTS_READ:
+		rd = kmalloc(sizeof(*rd), GFP_KERNEL);
+		if (!rd)
+			return -ENOMEM;
+		if (copy_from_user(&rd->num, (void __user *)arg, sizeof(rd->num))) {
+			retval = -EFAULT;
+			goto read_out;
 		}
-	}
 
-	/* Re-enable the transmitter if we disabled it. */
-	if ( up->acr & UART_ACR_TXDIS) {
-		up->acr &= ~UART_ACR_TXDIS;
-		serial_icr_write(up, UART_ACR, up->acr);
-		up->acrShadow = up->acr;
+		spin_lock_irqsave(&ox->port.lock, flags);
+		for (i = 0; i < rd->num && i < M77_RXTS_NUM && 
+				 ox->rxtsTail != ox->rxtsHead; i++) {
+			rd->ts[i] = ox->rxts[ox->rxtsTail];
+			ox->rxtsTail = (ox->rxtsTail + 1) % M77_RXTS_NUM;
+		}
+		rd->num 	= i;
+		rd->enable 	= ox->rxtsOn;
+		rd->pos 	= ox->rxtsPos;
+		rd->lost 	= ox->rxtsLost;
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+
+		if (copy_to_user((void __user *)arg, rd, 
+						 offsetof(struct m77_rxts_read, ts) + 
+						 i * sizeof(rd->ts[0])))
+			retval = -EFAULT;
+	read_out:
+		kfree(rd);
+		break;
 	}
+
+	return retval;
 }
 
 
 /*******************************************************************/
-/** receive stop function
+/** register DCD of a port as PPS source
  *
- * \param port		\IN highlevel (serial core) Port Struct
+ * \param ox		\IN Oxford 16C954 Port Struct
  *
- * \return 			-
+ * \return 			0 or negative error number
  */
-static void men_uart_stop_rx(struct uart_port *port)
+static int men_uart_pps_register(struct ox16c954_port *ox)
 {
-	struct ox16c954_port *up = (struct ox16c954_port *)port;
+#ifdef M77_HAS_PPS
+	struct pps_source_info info;
+	struct pps_device *pps;
+	unsigned long flags;
 
-	up->ier &= ~UART_IER_RLSI;
-	up->port.read_status_mask &= ~UART_LSR_DR;
-	serial_out(up, UART_IER, up->ier);
+	if (ox->pps)
+		return 0;
+
+	memset(&info, 0, sizeof(info));
+	snprintf(info.name, PPS_MAX_NAME_LEN, "%s%d", men_uart_reg.dev_name,
+			 ox->port.line);
+	snprintf(info.path, PPS_MAX_NAME_LEN, "/dev/%s%d", 
+			 men_uart_reg.dev_name, ox->port.line);
+	info.mode 	= PPS_CAPTUREBOTH | PPS_OFFSETASSERT | PPS_OFFSETCLEAR | 
+		PPS_ECHOASSERT | PPS_CANWAIT | PPS_TSFMT_TSPEC;
+	info.owner 	= THIS_MODULE;
+	info.dev 	= ox->port.dev;
+
+	pps = pps_register_source(&info, PPS_CAPTUREBOTH | 
+							  PPS_OFFSETASSERT | PPS_OFFSETCLEAR);
+	if (IS_ERR_OR_NULL(pps))
+		return pps ? PTR_ERR(pps) : -ENOMEM;
+
+	spin_lock_irqsave(&ox->port.lock, flags);
+	ox->pps = pps;
+	spin_unlock_irqrestore(&ox->port.lock, flags);
+	printk(KERN_INFO "%s%d: DCD is PPS source %d\n", men_uart_reg.dev_name,
+		   ox->port.line, pps->id);
+	return 0;
+#else
+	return -EINVAL;		/* kernel without PPS support */
+#endif
 }
 
+
 /*******************************************************************/
-/** receive stop function
+/** remove the PPS source of a port
  *
- * \param port		\IN highlevel uart_port Struct (as in serial_core)
+ * \param ox		\IN Oxford 16C954 Port Struct
  *
  * \return 			-
  */
-static void men_uart_enable_ms(struct uart_port *port)
+static void men_uart_pps_unregister(struct ox16c954_port *ox)
 {
-	struct ox16c954_port *up = (struct ox16c954_port *)port;
-
-	/* no MSR capabilities */
-	if (up->bugs & UART_BUG_NOMSR)
-		return;
+#ifdef M77_HAS_PPS
+	struct pps_device *pps;
+	unsigned long flags;
 
-	up->ier |= UART_IER_MSI;
-	serial_out(up, UART_IER, up->ier);
+	spin_lock_irqsave(&ox->port.lock, flags);
+	pps = ox->pps;
+	ox->pps = NULL;
+	spin_unlock_irqrestore(&ox->port.lock, flags);
+	if (pps)
+		pps_unregister_source(pps);
+#endif
 }
 
+
 /*******************************************************************/
-/** receive chars function, called within ISR
+/** Ioctl function for the modem status events and the PPS source
  *
- * \param up			\IN		Oxford 16C954 Port Struct
- * \param status		\OUT	new Value of LSR Register
- * \param regs			\IN		pt_regs parameter from ISR (unused)
+ * \param up		\IN highlevel (serial core) Port Struct
+ * \param cmd		\IN M77_MSR_SET or M77_MSR_READ
+ * \param arg		\IN user pointer to struct m77_msr_set or m77_msr_read
  *
- * \return 			-
+ * \brief The modem status interrupt is enabled while events are queued
+ *        or DCD is a PPS source, the tty must be kept open for both.
+ *
+ * \return 			0 or negative error number
  */
-static inline void
-receive_chars(struct ox16c954_port *up, int *status, struct pt_regs *regs)
+static int men_uart_msr( struct uart_port *up, 
+						 unsigned int cmd,
+						 unsigned long arg)
 {
+	struct ox16c954_port *ox = &men_uart_ports[up->line];
+	struct m77_msr_read *rd;
+	struct m77_msr_set st;
+	unsigned long flags;
+	unsigned int i;
+	int retval = 0;
 
-#if LINUX_VERSION_CODE <= KERNEL_VERSION(2,6,27)
-	struct tty_struct *tty = up->port.info->tty;
-#elif LINUX_VERSION_CODE <= KERNEL_VERSION(2,6,31)
-	struct tty_struct *tty = up->port.info->port.tty;
-#elif LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,32) 
-	struct tty_struct *tty = up->port.state->port.tty;
-#endif
-
-	unsigned char ch, lsr = *status;
-	int max_count = 256;
-	char flag;
-
-	do {
-		ch = serial_in(up, UART_RX);
-		flag = TTY_NORMAL;
-		up->port.icount.rx++;
-
-		if (unlikely(lsr & (UART_LSR_BI | UART_LSR_PE |
-							UART_LSR_FE | UART_LSR_OE))) {
-			/*
-			 * For statistics only
-			 */
-			if (lsr & UART_LSR_BI) {
-				lsr &= ~(UART_LSR_FE | UART_LSR_PE);
-				up->port.icount.brk++;
-				/*
-				 * We do the SysRQ and SAK checking
-				 * here because otherwise the break
-				 * may get masked by ignore_status_mask
-				 * or read_status_mask.
-				 */
-				if (uart_handle_break(&up->port))
-					goto ignore_char;
-			} else if (lsr & UART_LSR_PE)
-				up->port.icount.parity++;
-			else if (lsr & UART_LSR_FE)
-				up->port.icount.frame++;
-			if (lsr & UART_LSR_OE)
-				up->port.icount.overrun++;
-
-			/*
-			 * Mask off conditions which should be ignored.
-			 */
-			lsr &= up->port.read_status_mask;
+	switch (cmd) {
+	case M77_MSR_SET:
+		if (copy_from_user(&st, (void __user *)arg, sizeof(st)))
+			return -EFAULT;
+		if (st.flags & ~(M77_MSR_PPS | M77_MSR_PPS_CLEAR))
+			return -EINVAL;
+		if (ox->bugs & UART_BUG_NOMSR)
+			return -ENODEV;
 
-			if (lsr & UART_LSR_BI) {
-				DEBUG_INTR("handling break....");
-				flag = TTY_BREAK;
-			} else if (lsr & UART_LSR_PE)
-				flag = TTY_PARITY;
-			else if (lsr & UART_LSR_FE)
-				flag = TTY_FRAME;
+		M77DBG2("M77_MSR_SET: en %d flags 0x%x\n", st.enable, st.flags);
+		mutex_lock(&m77_msr_mutex);
+		if (st.flags & M77_MSR_PPS)
+			retval = men_uart_pps_register(ox);
+		else
+			men_uart_pps_unregister(ox);
+
+		if (!retval) {
+			spin_lock_irqsave(&ox->port.lock, flags);
+			ox->msrOn 		= !!st.enable;
+			ox->msrFlags 	= st.flags;
+			ox->msrLost 	= 0;
+			ox->msrHead 	= ox->msrTail = 0;
+			if ((ox->msrOn || (st.flags & M77_MSR_PPS)) && 
+				!(ox->ier & UART_IER_MSI)) {
+				ox->ier |= UART_IER_MSI;
+				serial_out(ox, UART_IER, ox->ier);
+			}
+			spin_unlock_irqrestore(&ox->port.lock, flags);
 		}
+		mutex_unlock(&m77_msr_mutex);
+		break;
 
-#if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,19)
-		if (uart_handle_sysrq_char(&up->port, ch, regs))
-#else
-		if (uart_handle_sysrq_char(&up->port, ch))
-#endif
-			goto ignore_char;
+	case M77_MSR_READ:
+		rd = kmalloc(sizeof(*rd), GFP_KERNEL);
+		if (!rd)
+			return -ENOMEM;
+		if (copy_from_user(&rd->num, (void __user *)arg, sizeof(rd->num))) {
+			retval = -EFAULT;
+			goto read_out;
+		}
 
-		uart_insert_char(&up->port, lsr, UART_LSR_OE, ch, flag);
+		spin_lock_irqsave(&ox->port.lock, flags);
+		for (i = 0; i < rd->num && i < M77_MSR_NUM && 
+				 ox->msrTail != ox->msrHead; i++) {
+			rd->ev[i] = ox->msrEv[ox->msrTail];
+			ox->msrTail = (ox->msrTail + 1) % M77_MSR_NUM;
+		}
+		rd->num 	= i;
+		rd->enable 	= ox->msrOn;
+		rd->flags 	= ox->msrFlags;
+		rd->lost 	= ox->msrLost;
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+
+		if (copy_to_user((void __user *)arg, rd, 
+						 offsetof(struct m77_msr_read, ev) + 
+						 i * sizeof(rd->ev[0])))
+			retval = -EFAULT;
+	read_out:
+		kfree(rd);
+		break;
+	}
 
-	ignore_char:
-		lsr = serial_in(up, UART_LSR);
-	} while ((lsr & UART_LSR_DR) && (max_count-- > 0));
-	spin_unlock(&up->port.lock);
-#if LINUX_VERSION_CODE < KERNEL_VERSION(3,9,0)
-	tty_flip_buffer_push(tty);
-#else 
-	tty_flip_buffer_push(tty->port);
-#endif
-	spin_lock(&up->port.lock);
-	*status = lsr;
+	return retval;
 }
 
+
+#ifdef M77_HAS_BPF
 /*******************************************************************/
-/** check_modem_status Bits
+/** run the receive filter on a frame
  *
- * \param up			\IN Oxford 16C954 Port Struct
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param len		\IN chars in frmBuf
  *
- * \return 			-
+ * \brief The frame is copied into bpfSkb, the program sees it at 
+ *        offset 0 as a socket filter sees a packet. 
+ *        Must be called with the port lock held.
+ *
+ * \return 			chars to pass up, 0 drops the frame
  */
-static inline void check_modem_status(struct ox16c954_port *up)
+static unsigned int men_uart_bpf_run(struct ox16c954_port *up, 
+									 unsigned int len)
 {
-	int status;
-
-	status = serial_in(up, UART_MSR);
+	struct sk_buff *skb = up->bpfSkb;
+	unsigned int res;
 
-	if ((status & UART_MSR_ANY_DELTA) == 0)
-		return;
+	__skb_trim(skb, 0);
+	memcpy(skb_put(skb, len), up->frmBuf, len);
 
-	if (status & UART_MSR_TERI)
-		up->port.icount.rng++;
-	if (status & UART_MSR_DDSR)
-		up->port.icount.dsr++;
-	if (status & UART_MSR_DDCD)
-		uart_handle_dcd_change(&up->port, status & UART_MSR_DCD);
-	if (status & UART_MSR_DCTS)
-		uart_handle_cts_change(&up->port, status & UART_MSR_CTS);
+	rcu_read_lock();
+	res = bpf_prog_run_save_cb(up->bpfProg, skb);
+	rcu_read_unlock();
 
-#if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,32)
-	wake_up_interruptible(&up->port.info->delta_msr_wait);
-#else
-	wake_up_interruptible(&up->port.state->port.delta_msr_wait);
-#endif
+	up->bpfStats.runs++;
+	if (!res)
+		up->bpfStats.dropped++;
+	else if (res < len)
+		up->bpfStats.truncated++;
+	else
+		up->bpfStats.passed++;
+	return min(res, len);
 }
 
 
 /*******************************************************************/
-/** handles the interrupt from one port, within ISR
+/** free a receive filter program
  *
- * \param up		\IN 	Oxford 16C954 Port Struct
- * \param regs		\IN 	passed from ISR but unused
+ * \param prog		\IN program, NULL: none
+ * \param type		\IN M77_BPF_CLASSIC or M77_BPF_EBPF
  *
  * \return 			-
  */
-static inline void men_uart_handle_port(struct ox16c954_port *up, 
-										struct pt_regs *regs)
+static void men_uart_bpf_free(struct bpf_prog *prog, unsigned int type)
 {
-	unsigned int status = serial_in(up, UART_LSR);
-
-	DEBUG_INTR("status = %x...", status);
-
-	if (status & UART_LSR_DR)
-		receive_chars(up, &status, regs);
-
-	check_modem_status(up);
-
-	if (status & UART_LSR_THRE)
-		transmit_chars(up);
+	if (!prog)
+		return;
+	if (type == M77_BPF_EBPF)
+		bpf_prog_put(prog);
+	else
+		bpf_prog_destroy(prog);
 }
 
 
-
-/*****************************************************************************/
-/** handles the interrupt from one M-Module
+/*******************************************************************/
+/** detach the receive filter of a port
  *
- * \param data		\IN 	void Parameter from MDIS Irq handler
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \brief Called when the port is shut down or unregistered. May sleep.
  *
- * \brief The original 8250.c UART interrupt handler is now Registered via
- * mdis_install_external_irq(). Its taylored to match the Requirements
- * of serving the M45N/M69N/M77 Interrupts only. No calls to request_irq() are
- * done within this driver.
  * \return 			-
  */
-static int M77_IrqHandler(void *data)
+static void men_uart_bpf_detach(struct ox16c954_port *up)
 {
+	struct bpf_prog *prog;
+	struct sk_buff *skb;
+	unsigned long flags;
+	unsigned int type;
 
- 	UARTMOD_INFO *mmod 			= data;
-	struct pt_regs *regs = NULL;
-	unsigned int i;
-	struct ox16c954_port *up;
-	unsigned int iir;
-	unsigned char cpld_ir_reg;
-	unsigned int retcode 		= LL_IRQ_DEV_NOT;
-	struct list_head  *pos		= NULL;
+	spin_lock_irqsave(&up->port.lock, flags);
+	prog 			= up->bpfProg;
+	type 			= up->bpfType;
+	skb 			= up->bpfSkb;
+	up->bpfProg 	= NULL;
+	up->bpfType 	= M77_BPF_NONE;
+	up->bpfSkb 		= NULL;
+	spin_unlock_irqrestore(&up->port.lock, flags);
 
-	/* skip through the registered M-Modules List */
-    list_for_each( pos, &G_uartModListHead ) {
+	men_uart_bpf_free(prog, type);
+	kfree_skb(skb);
+}
 
-		mmod = list_entry(pos, UARTMOD_INFO, head);
 
-		cpld_ir_reg = MREAD_D16( mmod->memBase, M77_REG_IR ) & 0x00ff;
-		/* printk(KERN_ERR "cpld_ir_reg = 0x%02x\n", cpld_ir_reg); */
+/*******************************************************************/
+/** Ioctl function for the BPF receive filter
+ *
+ * \param up		\IN highlevel (serial core) Port Struct
+ * \param cmd		\IN M77_BPF_SET or M77_BPF_GET
+ * \param arg		\IN user pointer to struct m77_bpf
+ *
+ * \brief The program is swapped under the port lock, the ISR runs it
+ *        with the lock held, so the old one is freed when we got it.
+ *        The filter stays until it is detached or the port shut down.
+ *        Needs CAP_NET_ADMIN like attaching a socket filter to a device.
+ *
+ * \return 			0 or negative error number
+ */
+static int men_uart_bpf( struct uart_port *up, 
+						 unsigned int cmd,
+						 unsigned long arg)
+{
+	struct ox16c954_port *ox = &men_uart_ports[up->line];
+	struct bpf_prog *prog = NULL, *old;
+	struct sk_buff *skb = NULL;
+	struct sock_fprog fprog;
+	struct m77_bpf b;
+	unsigned long flags;
+	unsigned int oldType;
+	int retval = 0;
 
-		if ( cpld_ir_reg & 0x1 ) {
-			for (i = 0; i < mmod->nrChannels; i++) {
-				up = mmod->port8250[i];				
-				iir = serial_in(up, UART_IIR);
-				if ( !(iir & UART_IIR_NO_INT) ) {
-					spin_lock(&up->port.lock);
-					DEBUG_INTR("ISR: UART%d\n", i);
-					men_uart_handle_port(up, regs);
-					spin_unlock(&up->port.lock);
-				}
+	switch (cmd) {
+	case M77_BPF_SET:
+		if (!capable(CAP_NET_ADMIN))
+			return -EPERM;
+		if (copy_from_user(&b, (void __user *)arg, sizeof(b)))
+			return -EFAULT;
+
+		M77DBG2("M77_BPF_SET: type %d\n", b.type);
+		switch (b.type) {
+		case M77_BPF_NONE:
+			break;
+		case M77_BPF_CLASSIC:
+			if (!b.len || b.len > BPF_MAXINSNS)
+				return -EINVAL;
+			fprog.len 		= b.len;
+			fprog.filter 	= (struct sock_filter __user *)
+				(unsigned long)b.insns;
+			retval = bpf_prog_create_from_user(&prog, &fprog, NULL, false);
+			if (retval)
+				return retval;
+			break;
+		case M77_BPF_EBPF:
+			prog = bpf_prog_get_type(b.fd, BPF_PROG_TYPE_SOCKET_FILTER);
+			if (IS_ERR(prog))
+				return PTR_ERR(prog);
+			break;
+		default:
+			return -EINVAL;
+		}
+
+		/* frame handed to the program, kept while a filter is set */
+		if (prog && !ox->bpfSkb) {
+			skb = alloc_skb(M77_FRAME_MAX, GFP_KERNEL);
+			if (!skb) {
+				men_uart_bpf_free(prog, b.type);
+				return -ENOMEM;
 			}
-			/* clear Interrupt */
-			control_out( mmod->memBase, M77_REG_IR,	cpld_ir_reg);
-			retcode = LL_IRQ_DEVICE;
+			skb_reset_mac_header(skb);
+			skb_reset_network_header(skb);
 		}
 
-		/* If its an M45N check the second IR Register at 0xC8 too */
-		if (mmod->modtype == MOD_M45) {
+		spin_lock_irqsave(&ox->port.lock, flags);
+		old 		= ox->bpfProg;
+		oldType 	= ox->bpfType;
+		ox->bpfProg = prog;
+		ox->bpfType = prog ? b.type : M77_BPF_NONE;
+		memset(&ox->bpfStats, 0, sizeof(ox->bpfStats));
+		if (!ox->bpfSkb) {
+			ox->bpfSkb 	= skb;
+			skb 		= NULL;
+		} else if (!prog) {
+			skb 		= ox->bpfSkb;
+			ox->bpfSkb 	= NULL;
+		}
+		spin_unlock_irqrestore(&ox->port.lock, flags);
 
-			cpld_ir_reg = MREAD_D16(mmod->memBase, M45_REG_IR2 ) & 0x00ff;
-			/* printk(KERN_ERR "cpld_ir_reg(2) = 0x%02x\n", cpld_ir_reg); */
+		men_uart_bpf_free(old, oldType);
+		kfree_skb(skb);
+		break;
 
-			if ( cpld_ir_reg & 0x1 ) {
-				for (i = 0; i < mmod->nrChannels; i++) { 
-					/* optimal:check 4-7 only */
-					up = mmod->port8250[i];
-					iir = serial_in(up, UART_IIR);
-					if ( !(iir & UART_IIR_NO_INT) ) {
-						spin_lock(&up->port.lock);
-						men_uart_handle_port(up, regs);
-						spin_unlock(&up->port.lock);
-					}
-				}
-				/* clear Interrupt */
-				control_out( mmod->memBase, M45_REG_IR2, cpld_ir_reg);
-			}
-		}
+	case M77_BPF_GET:
+		spin_lock_irqsave(&ox->port.lock, flags);
+		b 		= ox->bpfStats;
+		b.type 	= ox->bpfType;
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		if (copy_to_user((void __user *)arg, &b, sizeof(b)))
+			return -EFAULT;
+		break;
 	}
-	return(retcode);
+
+	return retval;
 }
+#endif /* M77_HAS_BPF */
 
 
 /*******************************************************************/
-/** check if UART transmit Register is empty
+/** Ioctl function for the frame receive modes and frame infos
  *
- * \param port		\IN highlevel uart_port Struct (as in serial_core)
+ * \param up		\IN highlevel (serial core) Port Struct
+ * \param cmd		\IN M77_RTU_SET/GET, M77_IDLE_SET/GET, M77_CRC_SET/GET
+ *                      or M77_FRAME_INFO
+ * \param arg		\IN user pointer to struct m77_rtu, m77_idle, m77_crc
+ *                      or m77_frame_info
  *
- * \return 			TIOCSER_TEMT if empty or 0
+ * \return 			0 or negative error number
  */
-static unsigned int men_uart_tx_empty(struct uart_port *port)
+static int men_uart_frame( struct uart_port *up, 
+						   unsigned int cmd,
+						   unsigned long arg)
 {
-
+	struct ox16c954_port *ox = &men_uart_ports[up->line];
+	struct m77_frame_info fi;
+	struct m77_idle id;
+	struct m77_rtu rt;
+	struct m77_crc cr;
 	unsigned long flags;
-	unsigned int ret;
-	struct ox16c954_port *up;
+	int push = 0;
 
-	up = (struct ox16c954_port *)port;
+	switch (cmd) {
+	case M77_RTU_SET:
+		if (copy_from_user(&rt, (void __user *)arg, sizeof(rt)))
+			return -EFAULT;
+
+		/* both change when received data is passed up */
+		if (rt.enable && (ox->delimEnable || ox->linMode || 
+						  ox->mdEnable || men_uart_rx_bypass(ox)))
+			return -EBUSY;
+
+		M77DBG2("M77_RTU_SET: en %d flags 0x%x t1.5 %dus t3.5 %dus\n",
+				rt.enable, rt.flags, rt.t15Us, rt.t35Us);
+		if (!rt.enable)
+			hrtimer_cancel(&ox->frmTimer);
+
+		spin_lock_irqsave(&ox->port.lock, flags);
+		ox->rtuFlags 	= rt.flags;
+		ox->t15Us 		= rt.t15Us;
+		ox->t35Us 		= rt.t35Us;
+		push = men_uart_frame_mode(ox, rt.enable ? M77_FRM_RTU : M77_FRM_OFF);
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+
+		if (push)
+			men_uart_rx_push(ox);
+		break;
 
-	spin_lock_irqsave(&up->port.lock, flags);
-	ret = serial_in(up, UART_LSR) & UART_LSR_TEMT ? TIOCSER_TEMT : 0;
-	spin_unlock_irqrestore(&up->port.lock, flags);
+	case M77_RTU_GET:
+		memset(&rt, 0, sizeof(rt));
+		spin_lock_irqsave(&ox->port.lock, flags);
+		rt.enable 		= ox->frmMode == M77_FRM_RTU;
+		rt.flags 		= ox->rtuFlags;
+		rt.t15Us 		= ox->t15Ns / 1000;
+		rt.t35Us 		= ox->t35Ns / 1000;
+		rt.frames 		= ox->frmCount;
+		rt.crcErrors 	= ox->frmCrcErr;
+		rt.t15Errors 	= ox->frmT15Err;
+		rt.infoLost 	= ox->frmInfoLost;
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		if (copy_to_user((void __user *)arg, &rt, sizeof(rt)))
+			return -EFAULT;
+		break;
 
-	return ret;
+	case M77_IDLE_SET:
+		if (copy_from_user(&id, (void __user *)arg, sizeof(id)))
+			return -EFAULT;
+		if (id.enable && (!id.gap || id.unit > M77_IDLE_US))
+			return -EINVAL;
+		if (id.enable && (ox->delimEnable || ox->linMode || 
+						  ox->mdEnable || men_uart_rx_bypass(ox)))
+			return -EBUSY;
+
+		M77DBG2("M77_IDLE_SET: en %d gap %d%s\n", id.enable, id.gap,
+				id.unit == M77_IDLE_US ? "us" : " bits");
+		if (!id.enable)
+			hrtimer_cancel(&ox->frmTimer);
+
+		spin_lock_irqsave(&ox->port.lock, flags);
+		if (id.enable) {
+			ox->idleUnit 	= id.unit;
+			ox->idleGap 	= id.gap;
+		}
+		push = men_uart_frame_mode(ox, id.enable ? M77_FRM_IDLE : M77_FRM_OFF);
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+
+		if (push)
+			men_uart_rx_push(ox);
+		break;
+
+	case M77_IDLE_GET:
+		memset(&id, 0, sizeof(id));
+		spin_lock_irqsave(&ox->port.lock, flags);
+		id.enable 		= ox->frmMode == M77_FRM_IDLE;
+		id.unit 		= ox->idleUnit;
+		id.gap 			= ox->idleGap;
+		id.gapUs 		= id.enable ? ox->t35Ns / 1000 : 0;
+		id.telegrams 	= ox->frmCount;
+		id.infoLost 	= ox->frmInfoLost;
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		if (copy_to_user((void __user *)arg, &id, sizeof(id)))
+			return -EFAULT;
+		break;
+
+	case M77_CRC_SET:
+		if (copy_from_user(&cr, (void __user *)arg, sizeof(cr)))
+			return -EFAULT;
+		if (cr.type > M77_CRC32)
+			return -EINVAL;
+
+		M77DBG2("M77_CRC_SET: type %d flags 0x%x\n", cr.type, cr.flags);
+		spin_lock_irqsave(&ox->port.lock, flags);
+		/* the CRC register of the current frame is of the old type */
+		push = men_uart_frame_end(ox);
+		ox->crcType 	= cr.type;
+		ox->crcFlags 	= cr.flags & M77_CRC_DROP;
+		ox->frmCrcOk 	= ox->frmCrcErr = ox->frmDropped = 0;
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+
+		if (push)
+			men_uart_rx_push(ox);
+		break;
+
+	case M77_CRC_GET:
+		memset(&cr, 0, sizeof(cr));
+		spin_lock_irqsave(&ox->port.lock, flags);
+		cr.type 		= ox->crcType;
+		cr.flags 		= ox->crcFlags;
+		cr.good 		= ox->frmCrcOk;
+		cr.bad 			= ox->frmCrcErr;
+		cr.dropped 		= ox->frmDropped;
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		if (copy_to_user((void __user *)arg, &cr, sizeof(cr)))
+			return -EFAULT;
+		break;
+
+	case M77_FRAME_INFO:
+		spin_lock_irqsave(&ox->port.lock, flags);
+		if (ox->infoHead == ox->infoTail) {
+			spin_unlock_irqrestore(&ox->port.lock, flags);
+			return -EAGAIN;
+		}
+		fi = ox->frmInfo[ox->infoTail];
+		ox->infoTail = (ox->infoTail + 1) % M77_FRAME_INFO_NUM;
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		if (copy_to_user((void __user *)arg, &fi, sizeof(fi)))
+			return -EFAULT;
+		break;
+	}
+
+	return 0;
 }
 
 
-/******************************************************************************/
-/** return Modem Control Register and return as TIO* Values, for ioctl call
+/*******************************************************************/
+/** Ioctl function for the priority TX queue
  *
- * \param port		\IN 	Oxford 16C954 Port Struct
+ * \param up		\IN highlevel (serial core) Port Struct
+ * \param cmd		\IN M77_PRIO_SEND or M77_PRIO_STATS
+ * \param arg		\IN user pointer to struct m77_prio_frame / 
+ *                      m77_prio_stats
  *
- * \return 			encoded MSR Bits
+ * \return 			0 or negative error number
  */
-static unsigned int men_uart_get_mctrl(struct uart_port *port)
+static int men_uart_prio( struct uart_port *up, 
+						  unsigned int cmd,
+						  unsigned long arg)
 {
-	unsigned char status;
-	unsigned int ret;
-	struct ox16c954_port *up = (struct ox16c954_port *)port;
-	status = serial_in(up, UART_MSR);
+	struct ox16c954_port *ox = &men_uart_ports[up->line];
+	struct m77_prio_frame *pf;
+	struct m77_prio_stats st;
+	struct m77_prio *p;
+	unsigned long flags;
+	unsigned int clear;
+	int retval = 0;
 
-	ret = 0;
-	if (status & UART_MSR_DCD)
-		ret |= TIOCM_CAR;
-	if (status & UART_MSR_RI)
-		ret |= TIOCM_RNG;
-	if (status & UART_MSR_DSR)
-		ret |= TIOCM_DSR;
-	if (status & UART_MSR_CTS)
-		ret |= TIOCM_CTS;
-	return ret;
-}
+	switch (cmd) {
+	case M77_PRIO_SEND:
+		pf = kmalloc(sizeof(*pf), GFP_KERNEL);
+		if (!pf)
+			return -ENOMEM;
+		if (copy_from_user(pf, (void __user *)arg, sizeof(*pf))) {
+			retval = -EFAULT;
+			goto send_out;
+		}
+		if (!pf->len || pf->len > M77_PRIO_MAX) {
+			retval = -EINVAL;
+			goto send_out;
+		}
+
+		spin_lock_irqsave(&ox->port.lock, flags);
+		if (ox->linMode)
+			retval = -EBUSY;	/* would go out within a LIN frame */
+		else if ((ox->prioHead + 1) % M77_PRIO_NUM == ox->prioTail) {
+			ox->prioStats.full++;
+			retval = -EAGAIN;
+		} else {
+			p = &ox->prio[ox->prioHead];
+			p->len = pf->len;
+			memcpy(p->data, pf->data, pf->len);
+			p->queued = ktime_get();
+			ox->prioHead = (ox->prioHead + 1) % M77_PRIO_NUM;
+			men_uart_oob_kick(ox);
+		}
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+	send_out:
+		kfree(pf);
+		break;
+
+	case M77_PRIO_STATS:
+		if (copy_from_user(&st, (void __user *)arg, sizeof(st)))
+			return -EFAULT;
+		clear = st.clear;
+
+		spin_lock_irqsave(&ox->port.lock, flags);
+		st = ox->prioStats;
+		st.queued = (ox->prioHead - ox->prioTail + M77_PRIO_NUM) % 
+			M77_PRIO_NUM;
+		st.avgNs = st.count ? div_u64(ox->prioSumNs, st.count) : 0;
+		if (clear) {
+			memset(&ox->prioStats, 0, sizeof(ox->prioStats));
+			ox->prioSumNs = 0;
+		}
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		st.clear = clear;
+		if (copy_to_user((void __user *)arg, &st, sizeof(st)))
+			return -EFAULT;
+		break;
+	}
 
+	return retval;
+}
 
 
-/******************************************************************************/
-/** set Modem Control Register, called from core ioctl function
+/*******************************************************************/
+/** Ioctl function for the LIN master mode
  *
- * \param port		\IN 	Oxford 16C954 Port Struct
- * \param mctrl		\IN 	MSR Bits to set
+ * \param up		\IN highlevel (serial core) Port Struct
+ * \param cmd		\IN M77_LIN_SET/GET, M77_LIN_TABLE or M77_LIN_RESULT
+ * \param arg		\IN user pointer to struct m77_lin, m77_lin_table or
+ *                      m77_lin_result
  *
- * \return 			-
+ * \brief While the LIN master is active the port belongs to it: the RX
+ *        trigger level is 1 and written data is held back. Refused while
+ *        anything else sends or takes the chars on the port.
+ *
+ * \return 			0 or negative error number
  */
-static void men_uart_set_mctrl(struct uart_port *port, unsigned int mctrl)
+static int men_uart_lin( struct uart_port *up, 
+						 unsigned int cmd,
+						 unsigned long arg)
 {
-	struct ox16c954_port *up = (struct ox16c954_port *)port;
-	unsigned char mcr = 0;
+	struct ox16c954_port *ox = &men_uart_ports[up->line];
+	struct m77_lin_table *tab;
+	struct m77_lin_result res;
+	struct m77_lin ln;
+	unsigned long flags;
+	unsigned int i;
+	ktime_t expires;
+	int retval = 0, busy;
 
-	if (mctrl & TIOCM_RTS)
-		mcr |= UART_MCR_RTS;
+	switch (cmd) {
+	case M77_LIN_SET:
+		if (copy_from_user(&ln, (void __user *)arg, sizeof(ln)))
+			return -EFAULT;
+		if (!ln.breakBits)
+			ln.breakBits = M77_LIN_BREAK_DEFAULT;
+		if (!ln.delimBits)
+			ln.delimBits = 1;
+		if (ln.breakBits < M77_LIN_BREAK_DEFAULT || ln.breakBits > 26 || 
+			ln.delimBits > 4)
+			return -EINVAL;
 
-	if (mctrl & TIOCM_DTR)
-		mcr |= UART_MCR_DTR;
+		/* 
+		 * all of them use the received chars on their own or send 
+		 * between header and response
+		 */
+		spin_lock_irqsave(&ox->port.lock, flags);
+		busy = ox->frmMode || ox->delimEnable || ox->mdEnable || 
+			ox->echoEnable || men_uart_rx_bypass(ox) || ox->kcli ||
+			ox->schedCur || ox->schedPend || ox->prioHead != ox->prioTail;
+		for (i = 0; i < M77_SCHED_SLOTS && !busy; i++)
+			busy = ox->sched[i].len;
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		if (ln.enable && busy)
+			return -EBUSY;
+
+		M77DBG2("M77_LIN_SET: en %d break %d delim %d flags 0x%x\n", 
+				ln.enable, ln.breakBits, ln.delimBits, ln.flags);
+		/* stop a running table first */
+		hrtimer_cancel(&ox->linTimer);
+
+		spin_lock_irqsave(&ox->port.lock, flags);
+		if (ox->linState == M77_LIN_BRK) {
+			ox->lcr &= ~UART_LCR_SBC;
+			serial_out(ox, UART_LCR, ox->lcr);
+		}
+		ox->linState = M77_LIN_IDLE;
 
-	if (mctrl & TIOCM_OUT1)
-		mcr |= UART_MCR_OUT1;
+		if (ln.enable) {
+			if (!ox->linNum) {
+				spin_unlock_irqrestore(&ox->port.lock, flags);
+				return -EINVAL;		/* M77_LIN_TABLE first */
+			}
+			if (!ox->linMode) {
+				ox->linMode = 1;
+				men_uart_set_trigger_levels(ox, 1);
+				/* the LIN timer writes the FIFO, no THRE interrupts */
+				__stop_tx(ox);
+			}
+			ox->linBreak 	= ln.breakBits;
+			ox->linDelim 	= ln.delimBits;
+			ox->linFlags 	= ln.flags;
+			ox->linIdx 		= 0;
+			if (men_uart_lin_frame(ox, &expires))
+				hrtimer_start(&ox->linTimer, expires, HRTIMER_MODE_ABS);
+		} else if (ox->linMode) {
+			ox->linMode = 0;
+			men_uart_set_trigger_levels(ox, (ox->baud < 2400) ? 1 : 
+										M77_RTL_DEFAULT);
+			/* send what was written meanwhile */
+#if LINUX_VERSION_CODE < Z025_SERIAL_DIFF
+			men_uart_start_tx(&ox->port, 0);
+#else
+			men_uart_start_tx(&ox->port);
+#endif
+		}
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		break;
 
-	if (mctrl & TIOCM_OUT2)
-		mcr |= UART_MCR_OUT2;
+	case M77_LIN_GET:
+		memset(&ln, 0, sizeof(ln));
+		spin_lock_irqsave(&ox->port.lock, flags);
+		ln.enable 		= ox->linMode;
+		ln.breakBits 	= ox->linBreak;
+		ln.delimBits 	= ox->linDelim;
+		ln.flags 		= ox->linFlags;
+		ln.running 		= ox->linState != M77_LIN_IDLE;
+		ln.frames 		= ox->linFrames;
+		ln.noResponse 	= ox->linNoResp;
+		ln.checksumErrors = ox->linCsErr;
+		ln.bitErrors 	= ox->linBitErr;
+		ln.resultsLost 	= ox->linResLost;
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		if (copy_to_user((void __user *)arg, &ln, sizeof(ln)))
+			return -EFAULT;
+		break;
 
-	if (mctrl & TIOCM_LOOP)
-		mcr |= UART_MCR_LOOP;
+	case M77_LIN_TABLE:
+		tab = kmalloc(sizeof(*tab), GFP_KERNEL);
+		if (!tab)
+			return -ENOMEM;
+		if (copy_from_user(tab, (void __user *)arg, sizeof(*tab))) {
+			retval = -EFAULT;
+			goto tab_out;
+		}
+		if (tab->num > M77_LIN_ENTRIES) {
+			retval = -EINVAL;
+			goto tab_out;
+		}
+		for (i = 0; i < tab->num; i++) {
+			if (tab->entry[i].id > 0x3f || tab->entry[i].dir > 1 ||
+				!tab->entry[i].len || tab->entry[i].len > 8) {
+				retval = -EINVAL;
+				goto tab_out;
+			}
+		}
 
-	mcr = (mcr & up->mcr_mask) | up->mcr_force | up->mcr;
+		M77DBG2("M77_LIN_TABLE: %d entries\n", tab->num);
+		spin_lock_irqsave(&ox->port.lock, flags);
+		if (ox->linState != M77_LIN_IDLE)
+			retval = -EBUSY;
+		else {
+			memcpy(ox->linTab, tab->entry, 
+				   tab->num * sizeof(struct m77_lin_entry));
+			ox->linNum = tab->num;
+			ox->linResHead = ox->linResTail = 0;
+		}
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+	tab_out:
+		kfree(tab);
+		break;
 
-	serial_out(up, UART_MCR, mcr);
+	case M77_LIN_RESULT:
+		spin_lock_irqsave(&ox->port.lock, flags);
+		if (ox->linResHead == ox->linResTail) {
+			spin_unlock_irqrestore(&ox->port.lock, flags);
+			return -EAGAIN;
+		}
+		res = ox->linRes[ox->linResTail];
+		ox->linResTail = (ox->linResTail + 1) % M77_LIN_RESULTS;
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		if (copy_to_user((void __user *)arg, &res, sizeof(res)))
+			return -EFAULT;
+		break;
+	}
+
+	return retval;
 }
 
 
-/******************************************************************************/
-/** set Set break control 
+/*******************************************************************/
+/** Ioctl function for the port-to-port bridge
  *
- * \param port			\IN 	Oxford 16C954 Port Struct
- * \param break_state	\IN     state to set, -1: set break, != -1:clear
+ * \param up		\IN highlevel (serial core) Port Struct
+ * \param cmd		\IN M77_BRIDGE_SET or M77_BRIDGE_GET
+ * \param arg		\IN user pointer to struct m77_bridge
  *
- * \return 			-
+ * \brief The peer must be open, its xmit buffer exists then only. A bridge
+ *        is removed when either port is closed. Setting up a bridge needs
+ *        CAP_SYS_ADMIN, it takes over the RX or TX of another tty.
+ *
+ * \return 			0 or negative error number
  */
-static void men_uart_break_ctl(struct uart_port *port, int break_state)
+static int men_uart_bridge( struct uart_port *up, 
+							unsigned int cmd,
+							unsigned long arg)
 {
-	struct ox16c954_port *up = (struct ox16c954_port *)port;
+	struct ox16c954_port *ox = &men_uart_ports[up->line];
+	struct ox16c954_port *peer;
+	struct m77_bridge br;
 	unsigned long flags;
+	int retval = 0;
 
-	spin_lock_irqsave(&up->port.lock, flags);
-	if (break_state == -1)
-		up->lcr |= UART_LCR_SBC;
-	else
-		up->lcr &= ~UART_LCR_SBC;
-	serial_out(up, UART_LCR, up->lcr);
-	spin_unlock_irqrestore(&up->port.lock, flags);
-}
+	switch (cmd) {
+	case M77_BRIDGE_SET:
+		if (copy_from_user(&br, (void __user *)arg, sizeof(br)))
+			return -EFAULT;
+
+		M77DBG2("M77_BRIDGE_SET: en %d line %d flags 0x%x\n", 
+				br.enable, br.line, br.flags);
+		if (!br.enable) {
+			men_uart_bridge_unlink(ox);
+			break;
+		}
+		if (!capable(CAP_SYS_ADMIN))
+			return -EPERM;
+		if (br.line >= MAX_SNGL_UARTS || br.line == up->line ||
+			(br.flags & ~(M77_BRIDGE_BIDIR | M77_BRIDGE_FLOW)))
+			return -EINVAL;
+		peer = &men_uart_ports[br.line];
 
+		/* the received chars are forwarded instead of being passed up */
+		if (men_uart_rx_bypass(ox) || ox->frmMode || ox->linMode || 
+			ox->delimEnable)
+			return -EBUSY;
 
+		spin_lock(&m77_bridge_lock);
+		spin_lock_irqsave(&peer->port.lock, flags);
+		if (!men_uart_port_xmit(peer))
+			retval = -ENODEV;
+		else if ((br.flags & M77_BRIDGE_BIDIR) && 
+				 (men_uart_rx_bypass(peer) || peer->frmMode || 
+				  peer->linMode || peer->delimEnable))
+			retval = -EBUSY;
+		else if (br.flags & M77_BRIDGE_BIDIR) {
+			peer->brgFlags 		= br.flags;
+			peer->brgRoom 		= UART_XMIT_SIZE;
+			peer->brgFwd = peer->brgDropped = peer->brgHolds = 0;
+			peer->brgPeer 		= ox;
+		}
+		spin_unlock_irqrestore(&peer->port.lock, flags);
+
+		if (!retval) {
+			spin_lock_irqsave(&ox->port.lock, flags);
+			ox->brgFlags 	= br.flags;
+			ox->brgRoom 	= UART_XMIT_SIZE;
+			ox->brgFwd = ox->brgDropped = ox->brgHolds = 0;
+			ox->brgPeer 	= peer;
+			spin_unlock_irqrestore(&ox->port.lock, flags);
+		}
+		spin_unlock(&m77_bridge_lock);
+		break;
 
-/*****************************************************************************/
-/** central UART channel startup function, called upon each open to /dev/ttyDx
- *
- * \param port			\IN 	Oxford 16C954 Port Struct
+	case M77_BRIDGE_GET:
+		memset(&br, 0, sizeof(br));
+		spin_lock_irqsave(&ox->port.lock, flags);
+		if (ox->brgPeer) {
+			br.enable 	= 1;
+			br.line 	= ox->brgPeer->port.line;
+			br.flags 	= ox->brgFlags;
+		}
+		br.forwarded 	= ox->brgFwd;
+		br.dropped 		= ox->brgDropped;
+		br.holds 		= ox->brgHolds;
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		if (copy_to_user((void __user *)arg, &br, sizeof(br)))
+			return -EFAULT;
+		break;
+	}
+
+	return retval;
+}
+
+
+/*******************************************************************/
+/** Ioctl function for port groups
  *
- * \return 				0 or error code
+ * \param up		\IN highlevel (serial core) Port Struct
+ * \param cmd		\IN M77_GROUP_SET/GET or M77_GROUP_WRITE
+ * \param arg		\IN user pointer to struct m77_group or m77_group_write
  *
- * \brief	Wakes up and initialize UART. Gets called whenever a process opens
- *          /dev/ttyDx. When passed at module load time the ACR is set such
- *          that for M077
+ * \brief The groups are global, they can be used on any open channel.
+ *        M77_GROUP_WRITE copies the data into the xmit buffer of each open
+ *        member with room for all of it first, then starts TX on all of 
+ *        them with local interrupts off. The THRE interrupts are pending 
+ *        together then, and the ISR loads the TX FIFOs in one pass.
  *
+ * \return 			0 or negative error number
  */
-static int men_uart_startup(struct uart_port *port)
+static int men_uart_group( struct uart_port *up, 
+						   unsigned int cmd,
+						   unsigned long arg)
 {
-	struct ox16c954_port *up = (struct ox16c954_port *)port;
+	struct m77_group_write *gw;
+	struct ox16c954_port *p;
+	struct circ_buf *xmit;
+	struct m77_group gr;
+	unsigned int lines[2];
 	unsigned long flags;
-	unsigned char lsr, iir;
-
-	up->capabilities = uart_config[up->port.type].flags;
-	up->mcr = 0;
-
-	serial_out(up, 	UART_IER, 	0);
-	serial_out(up, 	UART_LCR, 	0);
-	serial_icr_write(up, UART_CSR, 	0); /* Reset the UART */
-
-	/* Set Enhanced Mode */
-	serial_efr_write(up, UART_EFR, UART_EFR_ECB);
-
-	up->acr = up->acrShadow;
-	M77DBG3("%s: up=%p up->type=0x%x up->m77Mode=0x%x up->acr=0x%02x\n", 
-			__FUNCTION__, up, up->type, up->m77Mode, up->acr);
-	
-	if ( up->type == MOD_M77 && \
-		 ((up->m77Mode == M77_RS485_HD) || (up->m77Mode == M77_RS422_HD ))) {
-		M77DBG3("%s: up->acr = 0x%02x\n", __FUNCTION__, up->acr);		
-		up->acr |= 0x18;
-		serial_icr_write(up, UART_ACR, up->acr);
-	}
-
-	/* Clear FIFO buffers & disable them. Theyre reenabled in set_termios */
-	men_uart_clear_fifos(up);
+	int retval = 0, i;
 
-	/* Clear the interrupt registers. */
-	(void) serial_in(up, UART_LSR);
-	(void) serial_in(up, UART_RX);
-	(void) serial_in(up, UART_IIR);
-	(void) serial_in(up, UART_MSR);
+	/* the groups are global and reach ttys of other users */
+	if (cmd != M77_GROUP_GET && !capable(CAP_SYS_ADMIN))
+		return -EPERM;
 
-	/* Now, initialize the UART */
-	serial_out(up, UART_LCR, UART_LCR_WLEN8);
+	switch (cmd) {
+	case M77_GROUP_SET:
+		if (copy_from_user(&gr, (void __user *)arg, sizeof(gr)))
+			return -EFAULT;
+		if (gr.group >= M77_GROUPS)
+			return -EINVAL;
 
-	spin_lock_irqsave(&up->port.lock, flags);
+		M77DBG2("M77_GROUP_SET: group %d lines 0x%08x%08x\n", 
+				gr.group, gr.lines[1], gr.lines[0]);
+		spin_lock(&m77_group_lock);
+		m77Groups[gr.group][0] = gr.lines[0];
+		m77Groups[gr.group][1] = gr.lines[1];
+		spin_unlock(&m77_group_lock);
+		break;
 
-	up->port.mctrl |= TIOCM_OUT2;
-	men_uart_set_mctrl(&up->port, up->port.mctrl);
+	case M77_GROUP_GET:
+		if (copy_from_user(&gr, (void __user *)arg, sizeof(gr)))
+			return -EFAULT;
+		if (gr.group >= M77_GROUPS)
+			return -EINVAL;
 
-	/* quick test to see if we receive an IRQ when we enable the TX irq. */
-	serial_out(up, UART_IER, UART_IER_THRI);
-	lsr = serial_in(up, UART_LSR);
-	iir = serial_in(up, UART_IIR);
-	serial_out(up, UART_IER, 0);
+		spin_lock(&m77_group_lock);
+		gr.lines[0] = m77Groups[gr.group][0];
+		gr.lines[1] = m77Groups[gr.group][1];
+		spin_unlock(&m77_group_lock);
+		if (copy_to_user((void __user *)arg, &gr, sizeof(gr)))
+			return -EFAULT;
+		break;
 
-	if (lsr & UART_LSR_TEMT && iir & UART_IIR_NO_INT) {
-		if (!(up->bugs & UART_BUG_TXEN)) {
-			up->bugs |= UART_BUG_TXEN;
-			pr_debug("ttyS%d - enabling bad tx status workarounds\n",
-				 port->line);
+	case M77_GROUP_WRITE:
+		gw = kmalloc(sizeof(*gw), GFP_KERNEL);
+		if (!gw)
+			return -ENOMEM;
+		if (copy_from_user(gw, (void __user *)arg, sizeof(*gw))) {
+			retval = -EFAULT;
+			goto write_out;
+		}
+		if (gw->group >= M77_GROUPS || !gw->len || gw->len > M77_GROUP_MAX) {
+			retval = -EINVAL;
+			goto write_out;
 		}
-	} else {
-		up->bugs &= ~UART_BUG_TXEN;
-	}
 
-	spin_unlock_irqrestore(&up->port.lock, flags);
+		spin_lock(&m77_group_lock);
+		lines[0] = m77Groups[gw->group][0];
+		lines[1] = m77Groups[gw->group][1];
+		spin_unlock(&m77_group_lock);
+
+		/* queue on every member, all of the data or nothing */
+		gw->queued[0] = gw->queued[1] = 0;
+		for (i = 0; i < MAX_SNGL_UARTS; i++) {
+			if (!(lines[i / 32] & (1U << (i % 32))))
+				continue;
+			p = &men_uart_ports[i];
+			spin_lock_irqsave(&p->port.lock, flags);
+			xmit = men_uart_port_xmit(p);
+			if (xmit && uart_circ_chars_free(xmit) >= gw->len) {
+				men_uart_xmit_put(xmit, gw->data, gw->len);
+				gw->queued[i / 32] |= 1U << (i % 32);
+			}
+			spin_unlock_irqrestore(&p->port.lock, flags);
+		}
 
-	/*
-	 * Finally, enable interrupts.  Note: Modem status interrupts
-	 * are set via set_termios(), which will be occurring imminently
-	 * anyway, so we don't enable them here.
-	 */
-	up->ier = UART_IER_RLSI | UART_IER_RDI;
-	serial_out(up, UART_IER, up->ier);
+		/* then start them together */
+		local_irq_save(flags);
+		for (i = 0; i < MAX_SNGL_UARTS; i++) {
+			if (!(gw->queued[i / 32] & (1U << (i % 32))))
+				continue;
+			p = &men_uart_ports[i];
+			spin_lock(&p->port.lock);
+#if LINUX_VERSION_CODE < Z025_SERIAL_DIFF
+			men_uart_start_tx(&p->port, 0);
+#else
+			men_uart_start_tx(&p->port);
+#endif
+			spin_unlock(&p->port.lock);
+		}
+		local_irq_restore(flags);
 
-	/*
-	 * And clear the interrupt registers again for luck.
-	 */
-	(void) serial_in(up, UART_LSR);
-	(void) serial_in(up, UART_RX);
-	(void) serial_in(up, UART_IIR);
-	(void) serial_in(up, UART_MSR);
+		if (copy_to_user((void __user *)arg, gw, 
+						 offsetof(struct m77_group_write, data)))
+			retval = -EFAULT;
+	write_out:
+		kfree(gw);
+		break;
+	}
 
-	return 0;
+	return retval;
 }
 
 
-/******************************************************************************/
-/** central UART shutdown function, called upon funal close of port /dev/ttyDx
+/*******************************************************************/
+/** Ioctl function for the frame TX mode
  *
- * \param port			\IN 	Oxford 16C954 Port Struct
+ * \param up		\IN highlevel (serial core) Port Struct
+ * \param cmd		\IN M77_FRAMETX_SET or M77_FRAMETX_GET
+ * \param arg		\IN user pointer to struct m77_frametx
  *
- * \return 				0 or error code
+ * \return 			0 or negative error number
  */
-static void men_uart_shutdown(struct uart_port *port)
+static int men_uart_frametx( struct uart_port *up, 
+							 unsigned int cmd,
+							 unsigned long arg)
 {
-
-	struct ox16c954_port *up = (struct ox16c954_port *)port;
+	struct ox16c954_port *ox = &men_uart_ports[up->line];
+	struct m77_frametx ft;
 	unsigned long flags;
 
-	/*
-	 * Disable interrupts from this port
-	 */
-	up->ier = 0;
-	serial_out(up, UART_IER, 0);
-
-	spin_lock_irqsave(&up->port.lock, flags);
-
-	
-	up->port.mctrl &= ~TIOCM_OUT2;
-	
-	men_uart_set_mctrl(&up->port, up->port.mctrl);
-	spin_unlock_irqrestore(&up->port.lock, flags);
-
-	/*
-	 * Disable break condition and FIFOs
-	 */
-	serial_out(up, UART_LCR, serial_in(up, UART_LCR) & ~UART_LCR_SBC);
-	men_uart_clear_fifos(up);
+	switch (cmd) {
+	case M77_FRAMETX_SET:
+		if (copy_from_user(&ft, (void __user *)arg, sizeof(ft)))
+			return -EFAULT;
 
+		if (!ft.ttl)
+			ft.ttl = M77_FRAMETX_TTL_DEFAULT;
+		if (ft.ttl >= ox->port.fifosize)
+			return -EINVAL;
 
-	/*
-	 * Read data port to reset things
-	 */
-	(void) serial_in(up, UART_RX);
+		M77DBG2("M77_FRAMETX_SET: en %d ttl %d\n", ft.enable, ft.ttl);
+		spin_lock_irqsave(&ox->port.lock, flags);
+		men_uart_frametx_enable(ox, ft.enable, ft.ttl);
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		break;
 
+	case M77_FRAMETX_GET:
+		memset(&ft, 0, sizeof(ft));
+		spin_lock_irqsave(&ox->port.lock, flags);
+		ft.enable 		= ox->frameTx;
+		ft.ttl 			= ox->ttl;
+		ft.frames 		= ox->frameCount;
+		ft.underruns 	= ox->frameUnderruns;
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		if (copy_to_user((void __user *)arg, &ft, sizeof(ft)))
+			return -EFAULT;
+		break;
+	}
 
+	return 0;
 }
 
 
-/******************************************************************************/
-/** Calculate Baudrate Divisor
+/*******************************************************************/
+/** next time of a cyclic slot
  *
- * \param port			\IN 	Oxford 16C954 Port Struct
- * \param baud			\IN 	Baudrate Value, 300-1152000
+ * \param periodNs	\IN cycle
+ * \param phaseNs	\IN offset to the multiples of the cycle
+ * \param now		\IN current time
  *
- * \return 				Divisor with respect to Clock 18,432 MHz
+ * \brief The slots are aligned to CLOCK_MONOTONIC, so slots with equal
+ *        period and phase run in step on all channels.
+ *
+ * \return 			first slot time after now
  */
-static unsigned int men_uart_get_divisor(struct uart_port *port, 
-										 unsigned int baud)
+static ktime_t men_uart_sched_cycle(u64 periodNs, u64 phaseNs, ktime_t now)
 {
-	/* No magic handling needed for M Modules, Clock is always 18,432 MHz */
-	return uart_get_divisor(port, baud);
-}
+	u64 t = ktime_to_ns(now);
 
+	if (t < phaseNs)
+		return ns_to_ktime(phaseNs);
 
+	return ns_to_ktime((div64_u64(t - phaseNs, periodNs) + 1) * periodNs + 
+					   phaseNs);
+}
 
-/******************************************************************************/
-/** function to set changed tty settings
+
+/*******************************************************************/
+/** find the next time a slot is due
  *
- * \param port			\IN 	highlevel UART Port Struct
- * \param termios		\IN 	termios struct with new settings
- * \param old			\IN 	termios struct to keep old settings(?)
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param next		\OUT earliest due time of the active slots
  *
- * \brief this is the central link between higher tty layer and the UART 
- *        Hardware to change all aspects of the Channel like Baudrate, data bit
- *        settings etc. Its called everytime a property of the channel is 
- *		  changed e.g. with stty.
+ * \brief Must be called with the port lock held.
  *
- * \return 				-
+ * \return 			1 if a slot is active, else 0
  */
-#if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,19)
-static void men_uart_set_termios(struct uart_port *port,struct termios *termios, struct termios *old)
-#else
-static void men_uart_set_termios(struct uart_port *port,struct ktermios *termios, struct ktermios *old)
-#endif
+static int men_uart_sched_next(struct ox16c954_port *up, ktime_t *next)
 {
-	unsigned char efr = 0;
-	struct ox16c954_port *up = (struct ox16c954_port *)port;
-	unsigned char cval, fcr = 0;
+	int i, any = 0;
+
+	for (i = 0; i < M77_SCHED_SLOTS; i++) {
+		if (!up->sched[i].enable)
+			continue;
+		if (!any || ktime_before(up->sched[i].due, *next))
+			*next = up->sched[i].due;
+		any = 1;
+	}
+
+	return any;
+}
+
+
+/*******************************************************************/
+/** Ioctl function for the TX scheduler
+ *
+ * \param up		\IN highlevel (serial core) Port Struct
+ * \param cmd		\IN M77_SCHED_SET or M77_SCHED_STAT
+ * \param arg		\IN user pointer to struct m77_sched_slot / 
+ *                      m77_sched_stat
+ *
+ * \return 			0 or negative error number
+ */
+static int men_uart_sched( struct uart_port *up, 
+						   unsigned int cmd,
+						   unsigned long arg)
+{
+	struct ox16c954_port *ox = &men_uart_ports[up->line];
+	struct m77_sched_slot *sl;
+	struct m77_sched_stat st;
+	struct m77_sched *s;
 	unsigned long flags;
-	unsigned int baud, quot;
+	ktime_t next;
+	int any, clear, retval = 0;
 
-	M77DBG3("%s: c_iflag = 0x%04x c_cflag = 0x%04x  Settings:\n",
-			   __FUNCTION__, termios->c_iflag, termios->c_cflag );
+	switch (cmd) {
+	case M77_SCHED_SET:
+		/* too big for the kernel stack */
+		sl = kmalloc(sizeof(*sl), GFP_KERNEL);
+		if (!sl)
+			return -ENOMEM;
+		if (copy_from_user(sl, (void __user *)arg, sizeof(*sl))) {
+			retval = -EFAULT;
+			goto set_out;
+		}
+		if (sl->slot >= M77_SCHED_SLOTS || (sl->enable && 
+			(!sl->len || sl->len > M77_SCHED_FRAME_MAX || 
+			 (!(sl->flags & M77_SCHED_ONESHOT) && 
+			  sl->periodUs < M77_SCHED_PERIOD_MIN)))) {
+			retval = -EINVAL;
+			goto set_out;
+		}
 
-	/* 
-	 * Set Word Length: 5..8 bit 
-	 */
-	switch (termios->c_cflag & CSIZE) {
-	case CS5:
-		cval = UART_LCR_WLEN5;
-		M77DBG3(" - 5 Data Bits\n");
+		M77DBG2("M77_SCHED_SET: slot %d en %d flags 0x%x period %dus "
+				"phase %dus len %d\n", sl->slot, sl->enable, sl->flags, 
+				sl->periodUs, sl->phaseUs, sl->len);
+		s = &ox->sched[sl->slot];
+		spin_lock_irqsave(&ox->port.lock, flags);
+		/* frame is queued or going out, or the LIN master owns the line */
+		if (ox->schedCur == s || (ox->schedPend & (1 << sl->slot)) ||
+			(sl->enable && ox->linMode)) {
+			spin_unlock_irqrestore(&ox->port.lock, flags);
+			retval = -EBUSY;
+			goto set_out;
+		}
+
+		memset(s, 0, sizeof(*s));
+		if (sl->enable) {
+			s->len = sl->len;
+			memcpy(s->data, sl->data, sl->len);
+			if (sl->flags & M77_SCHED_ONESHOT)
+				s->due = ktime_set(sl->startSec, sl->startNsec);
+			else {
+				s->periodNs = (u64)sl->periodUs * NSEC_PER_USEC;
+				s->phaseNs 	= (u64)(sl->phaseUs % sl->periodUs) * 
+					NSEC_PER_USEC;
+				s->due = men_uart_sched_cycle(s->periodNs, s->phaseNs, 
+											  ktime_get());
+			}
+			s->enable = 1;
+		}
+
+		any = men_uart_sched_next(ox, &next);
+		if (any)
+			hrtimer_start(&ox->schedTimer, next, HRTIMER_MODE_ABS);
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+
+		if (!any)
+			hrtimer_cancel(&ox->schedTimer);
+	set_out:
+		kfree(sl);
 		break;
-	case CS6:
-		cval = UART_LCR_WLEN6;
-		M77DBG3(" - 6 Data Bits\n");
+
+	case M77_SCHED_STAT:
+		if (copy_from_user(&st, (void __user *)arg, sizeof(st)))
+			return -EFAULT;
+		if (st.slot >= M77_SCHED_SLOTS)
+			return -EINVAL;
+
+		s = &ox->sched[st.slot];
+		clear = st.clear;
+		spin_lock_irqsave(&ox->port.lock, flags);
+		st = s->st;
+		st.enable = s->enable;
+		if (clear)
+			memset(&s->st, 0, sizeof(s->st));
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		st.slot = s - ox->sched;
+		if (copy_to_user((void __user *)arg, &st, sizeof(st)))
+			return -EFAULT;
 		break;
-	case CS7:
-		cval = UART_LCR_WLEN7;
-		M77DBG3(" - 7 Data Bits\n");
+	}
+
+	return retval;
+}
+
+
+/*******************************************************************/
+/** Ioctl function for the delimiter wakeup mode
+ *
+ * \param up		\IN highlevel (serial core) Port Struct
+ * \param cmd		\IN M77_DELIM_SET or M77_DELIM_GET
+ * \param arg		\IN user pointer to struct m77_delim
+ *
+ * \return 			0 or negative error number
+ */
+static int men_uart_delim( struct uart_port *up, 
+						   unsigned int cmd,
+						   unsigned long arg)
+{
+	struct ox16c954_port *ox = &men_uart_ports[up->line];
+	struct m77_delim dl;
+	unsigned long flags;
+
+	switch (cmd) {
+	case M77_DELIM_SET:
+		if (copy_from_user(&dl, (void __user *)arg, sizeof(dl)))
+			return -EFAULT;
+
+		/* XOFF2 is already used by XON/XOFF or multidrop addresses */
+		if (dl.enable && ((ox->iflag & (IXON|IXOFF)) || ox->mdEnable))
+			return -EBUSY;
+
+		/* frame mode decides itself when data is passed up */
+		if (dl.enable && (ox->frmMode || ox->linMode || 
+						  men_uart_rx_bypass(ox)))
+			return -EBUSY;
+
+		if (dl.idleUs > M77_DELIM_IDLE_MAX)
+			return -EINVAL;
+
+		M77DBG2("M77_DELIM_SET: en %d delim 0x%02x idle %dus\n",
+				dl.enable, dl.delim, dl.idleUs);
+		spin_lock_irqsave(&ox->port.lock, flags);
+		ox->delimEnable = dl.enable;
+		ox->delim 		= dl.delim;
+		ox->delimIdleUs = dl.idleUs ? dl.idleUs : M77_DELIM_IDLE_DEFAULT;
+		men_uart_spchr_program(ox);
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+
+		/* deliver what was held back so far */
+		if (!dl.enable) {
+			hrtimer_cancel(&ox->rxTimer);
+			men_uart_rx_push(ox);
+		}
 		break;
-	default:
-	case CS8:
-		cval = UART_LCR_WLEN8;
-		M77DBG3(" - 8 Data Bits\n");
+
+	case M77_DELIM_GET:
+		memset(&dl, 0, sizeof(dl));
+		spin_lock_irqsave(&ox->port.lock, flags);
+		dl.enable 		= ox->delimEnable;
+		dl.delim 		= ox->delim;
+		dl.idleUs 		= ox->delimIdleUs;
+		dl.frameCount 	= ox->delimFrames;
+		dl.idleCount 	= ox->delimIdles;
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		if (copy_to_user((void __user *)arg, &dl, sizeof(dl)))
+			return -EFAULT;
 		break;
 	}
 
-	/* 
-	 * Set 1 or 2 Stop Bits
-	 * Oxford Data Sheet states that its actually 1.5 Stopbits at 5 Databits,
-	 * 2 Bits at 6,7,8 Data bits
-	 */
-	if (termios->c_cflag & CSTOPB){
-		cval |= UART_LCR_STOP;
-		M77DBG3(" - 2 Stop Bits\n");
-	} else {
-		M77DBG3(" - 1 Stop Bit\n");
+	return 0;
+}
+
+
+/*******************************************************************/
+/** Switch the line driver in software timed RS485 mode
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param on		\IN 1: enable driver for sending, 0: back to receive
+ *
+ * \brief M77: The line driver enable is the DTR# pin. With ACR[4:3] = 00
+ *        it follows MCR[0] inverted, the levels are taken from the flags 
+ *        SER_RS485_RTS_ON_SEND and SER_RS485_RTS_AFTER_SEND.
+ *        M45N (automatic tristate): the channel's TCR bit.
+ *        Must be called with the port lock held.
+ *
+ * \return 			-
+ */
+static void men_uart_rs485_drive(struct ox16c954_port *up, int on)
+{
+	unsigned int level = on ? (up->rs485.flags & SER_RS485_RTS_ON_SEND) :
+		(up->rs485.flags & SER_RS485_RTS_AFTER_SEND);
+
+	if (up->triAuto) {
+		men_uart_m45_tristate(up, !on);
+		return;
 	}
 
+	if (level)
+		up->mcr &= ~UART_MCR_DTR;
+	else
+		up->mcr |= UART_MCR_DTR;
 
-	/* 
-	 * Set Parity (none/odd/even)
-	 */
-	if (termios->c_cflag & PARENB)
-		cval |= UART_LCR_PARITY;
-	if (!(termios->c_cflag & PARODD))
-		cval |= UART_LCR_EPAR;
+	men_uart_set_mctrl(&up->port, up->port.mctrl);
+}
 
-	/* Report the Parity setting according to LCR[5:3] Data Sheet */
 
-	if(!(cval & UART_LCR_PARITY)){
-		M77DBG3(" - No Parity\n");
-	} else {
-		if( ((cval & 0x38) >> 3) == 1 ) /* Mask Bits 5,4,3:  0x38=0011 1000 */
-			M77DBG3(" - Odd Parity\n");
+/*******************************************************************/
+/** account one measured RS485 turnaround
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \brief Software timed mode only, measured from the poll that found 
+ *        LSR[TEMT] set. The stop bit ended up to taStats.resNs before.
+ *
+ * \return 			-
+ */
+static void men_uart_rs485_account(struct ox16c954_port *up)
+{
+	struct m77_rs485_stats *st = &up->taStats;
+	unsigned int ta = (unsigned int)ktime_to_ns(ktime_sub(ktime_get(), 
+														   up->rs485Temt));
+
+	st->lastNs = ta;
+	if (!st->count || ta < st->minNs)
+		st->minNs = ta;
+	if (ta > st->maxNs)
+		st->maxNs = ta;
+	st->count++;
+
+	/* a slave may answer after the idle gap, while we still drive */
+	if (up->net && ta > up->t35Ns)
+		up->netTaLate++;
+}
 
-		if( ((cval & 0x38) >> 3) == 3 )
-			M77DBG3(" - Even Parity\n");
 
-		if( ((cval & 0x38) >> 3) == 5 )
-			M77DBG3(" - Parity forced 1\n");
+/*******************************************************************/
+/** End of transmission in software timed RS485 mode
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \brief The 16C954 gives no interrupt when the shift register ran empty,
+ *        so LSR[TEMT] is polled from rs485Timer. The first poll is done
+ *        when the chars loaded last are out at the earliest.
+ *        Must be called with the port lock held.
+ *
+ * \return 			-
+ */
+static void men_uart_rs485_stop_tx(struct ox16c954_port *up)
+{
+	if (!up->rs485Soft || up->rs485State != M77_RS485_TX)
+		return;
 
-		if( ((cval & 0x38) >> 3) == 7 )
-			M77DBG3(" - Parity forced 0\n");
+	up->rs485State 	= M77_RS485_TEMT;
+	up->pollNs 		= up->charNs;
+	hrtimer_start(&up->rs485Timer, 
+				  ns_to_ktime((u64)(up->txLoaded ? up->txLoaded : 1) * 
+							  up->charNs),
+				  HRTIMER_MODE_REL);
+}
+
+
+/*******************************************************************/
+/** RS485 timer: delay before send, TEMT polling and delay after send
+ *
+ * \param timer		\IN rs485Timer of the Oxford 16C954 Port Struct
+ *
+ * \return 			HRTIMER_RESTART while polling/delaying, else NORESTART
+ */
+static enum hrtimer_restart men_uart_rs485_timer(struct hrtimer *timer)
+{
+	struct ox16c954_port *up = 
+		container_of(timer, struct ox16c954_port, rs485Timer);
+	enum hrtimer_restart ret = HRTIMER_NORESTART;
+	unsigned long flags;
+	unsigned char lsr;
+
+	spin_lock_irqsave(&up->port.lock, flags);
+
+	switch (up->rs485State) {
+	case M77_RS485_BEFORE:
+		/* driver enabled long enough, now send */
+		up->rs485State = M77_RS485_TX;
+		__start_tx(up);
+		break;
+
+	case M77_RS485_TEMT:
+		lsr = serial_in(up, UART_LSR);
+		if (!(lsr & UART_LSR_TEMT)) {
+			/* FIFO empty, only the last char is shifted out: poll finer */
+			up->pollNs = (lsr & UART_LSR_THRE) ? up->taStats.resNs : 
+				up->charNs;
+			hrtimer_forward_now(timer, ns_to_ktime(up->pollNs));
+			ret = HRTIMER_RESTART;
+			break;
+		}
+
+		/* the stop bit ended within the last poll interval */
+		up->rs485Temt = ktime_get();
+		if (up->drvAfterNs) {
+			up->rs485State = M77_RS485_AFTER;
+			hrtimer_forward_now(timer, ns_to_ktime(up->drvAfterNs));
+			ret = HRTIMER_RESTART;
+			break;
+		}
+		fallthrough;
+	case M77_RS485_AFTER:
+		men_uart_rs485_drive(up, 0);
+		men_uart_rs485_account(up);
+		up->rs485State = M77_RS485_IDLE;
+		break;
 	}
 
-	/*
-	 * Ask the core to calculate the divisor for us.
-	 */
-	baud = uart_get_baud_rate(port, termios, old, 0, port->uartclk/16); 
-	quot = men_uart_get_divisor(port, baud);
-	M77DBG3(" - Baudrate: %d (quot=%d)\n", baud, quot);
+	spin_unlock_irqrestore(&up->port.lock, flags);
+	return ret;
+}
 
-	/*
-	 * Oxford Semi 952 rev B workaround
-	 */
-	if (up->bugs & UART_BUG_QUOT && (quot & 0xff) == 0)
-		quot ++;
 
-	if (up->capabilities & UART_CAP_FIFO && up->port.fifosize > 1) {
-		if (baud < 2400)
-			fcr = UART_FCR_ENABLE_FIFO | UART_FCR_TRIGGER_1;
-		else
-			fcr = uart_config[up->port.type].fcr;
+/*******************************************************************/
+/** Apply RS485 settings to M77 DCR and 16C954 ACR
+ *
+ * \param ox		\IN Oxford 16C954 Port Struct
+ * \param rs485		\INOUT requested settings, unsupported bits cleared
+ *
+ * \brief Without RTS delays the UART switches the driver by itself through
+ *        ACR[4:3] exactly at the end of the stop bit. With delays the DTR#
+ *        pin is driven from MCR, timed by rs485Timer. M77 has no switchable
+ *        bus termination and no RS485 addressing, these flags are cleared.
+ *        Must be called with the port lock held.
+ *
+ * \return 			0 or negative error number
+ */
+static int men_uart_rs485_apply(struct ox16c954_port *ox, 
+								struct serial_rs485 *rs485)
+{
+	unsigned char dcr;
+
+	if (ox->type != MOD_M77)
+		return -ENOTTY;
+
+	/* don't switch the driver away under a running frame */
+	if (ox->rs485State != M77_RS485_IDLE)
+		return -EBUSY;
+
+	rs485->flags &= SER_RS485_ENABLED | SER_RS485_RTS_ON_SEND | 
+		SER_RS485_RTS_AFTER_SEND | SER_RS485_RX_DURING_TX;
+	if (!(rs485->flags & SER_RS485_RTS_ON_SEND) == 
+		!(rs485->flags & SER_RS485_RTS_AFTER_SEND)) {
+		/* equal levels make no sense, use M77 default (active high) */
+		rs485->flags |= SER_RS485_RTS_ON_SEND;
+		rs485->flags &= ~SER_RS485_RTS_AFTER_SEND;
 	}
+	if (rs485->delay_rts_before_send > M77_RS485_DELAY_MAX)
+		rs485->delay_rts_before_send = M77_RS485_DELAY_MAX;
+	if (rs485->delay_rts_after_send > M77_RS485_DELAY_MAX)
+		rs485->delay_rts_after_send = M77_RS485_DELAY_MAX;
+	memset(rs485->padding, 0, sizeof(rs485->padding));
+
+	dcr = serial_in(ox, ox->dcrReg);
+
+	if (rs485->flags & SER_RS485_ENABLED) {
+		if (!ox->rs485Set) {
+			ox->rs485PrevDcr  = dcr;
+			ox->rs485PrevAcr  = ox->acr & OX954_ACR_DTR;
+			ox->rs485PrevMode = ox->m77Mode;
+		}
 
-	/*
-	 * MCR-based auto flow control.  When AFE is enabled, RTS will be
-	 * deasserted when the receive FIFO contains more characters than
-	 * the trigger, or the MCR RTS bit is cleared.  In the case where
-	 * the remote UART is not using CTS auto flow control, we must
-	 * have sufficient FIFO entries for the latency of the remote
-	 * UART to respond.  IOW, at least 32 bytes of FIFO.
-	 */
-	if (up->capabilities & UART_CAP_AFE && up->port.fifosize >= 32) {
-		up->mcr &= ~UART_MCR_AFE;
-		if (termios->c_cflag & CRTSCTS)
-			up->mcr |= UART_MCR_AFE;
+		/* RS485 HD, receive line on during TX gives the echo */
+		dcr = (dcr & 0xF0) | M77_RS485_HD;
+		if (rs485->flags & SER_RS485_RX_DURING_TX)
+			dcr |= M77_RX_EN;
+		ox->m77Mode = M77_RS485_HD;
+
+		ox->rs485Soft = rs485->delay_rts_before_send || 
+			rs485->delay_rts_after_send;
+		ox->drvBeforeNs = rs485->delay_rts_before_send * 1000000;
+		ox->drvAfterNs  = rs485->delay_rts_after_send * 1000000;
+		ox->acr &= ~OX954_ACR_DTR;
+		if (!ox->rs485Soft)
+			ox->acr |= (rs485->flags & SER_RS485_RTS_ON_SEND) ? 
+				OX954_ACR_DTR : OX954_ACR_DTR_ACTLOW;
+	} else if (ox->rs485Set) {
+		/* back to the PHY mode used before */
+		dcr = ox->rs485PrevDcr;
+		ox->m77Mode = ox->rs485PrevMode;
+		ox->acr = (ox->acr & ~OX954_ACR_DTR) | ox->rs485PrevAcr;
+		ox->rs485Soft = 0;
+	}
+	ox->rs485Set = !!(rs485->flags & SER_RS485_ENABLED);
+	if (!ox->rs485Set)
+		rs485->flags = men_uart_rs485_phy_flags(ox, dcr);
+
+	M77DBG2("%s: flags 0x%x delays %d/%dms DCR 0x%02x ACR 0x%02x\n",
+			__FUNCTION__, rs485->flags, rs485->delay_rts_before_send,
+			rs485->delay_rts_after_send, dcr, ox->acr);
+
+	ox->rs485 = *rs485;
+	serial_out(ox, ox->dcrReg, dcr);
+	ox->acrShadow = ox->acr;
+	serial_icr_write(ox, UART_ACR, ox->acr);
+
+	/* DTR# is ours in software timed mode, start in receive direction */
+	if (ox->rs485Soft) {
+		ox->mcr_mask = ~UART_MCR_DTR;
+		men_uart_rs485_drive(ox, 0);
+	} else {
+		ox->mcr_mask = ~0;
+		ox->mcr &= ~UART_MCR_DTR;
+		men_uart_set_mctrl(&ox->port, ox->port.mctrl);
+	}
+	ox->taStats.swCtrl = ox->rs485Soft;
+
+	return 0;
+}
+
+
+#ifdef M77_HAS_RS485_CONFIG
+/*******************************************************************/
+/** serial core hook for TIOCSRS485, called with the port lock held
+ *
+ * \param up		\IN highlevel (serial core) Port Struct
+ * \param termios	\IN current termios (since 6.0)
+ * \param rs485		\INOUT requested RS485 settings
+ *
+ * \return 			0 or negative error number
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6,0,0)
+static int men_uart_rs485_config(struct uart_port *up, 
+								 struct ktermios *termios,
+								 struct serial_rs485 *rs485)
+{
+	return men_uart_rs485_apply(&men_uart_ports[up->line], rs485);
+}
+
+static const struct serial_rs485 men_uart_rs485_supported = {
+	.flags = SER_RS485_ENABLED | SER_RS485_RTS_ON_SEND | 
+			 SER_RS485_RTS_AFTER_SEND | SER_RS485_RX_DURING_TX,
+	.delay_rts_before_send = 1,
+	.delay_rts_after_send = 1,
+};
+#else
+static int men_uart_rs485_config(struct uart_port *up, 
+								 struct serial_rs485 *rs485)
+{
+	int retval = men_uart_rs485_apply(&men_uart_ports[up->line], rs485);
+
+	if (!retval)
+		up->rs485 = *rs485;
+	return retval;
+}
+#endif
+#endif /* M77_HAS_RS485_CONFIG */
+
+
+/*******************************************************************/
+/** channel sharing the TCR tristate bit of a M45N channel
+ *
+ * \param ox		\IN Oxford 16C954 Port Struct
+ *
+ * \brief Channels 2/3, 4/5 and 6/7 share one bit, their registers are
+ *        0x10 apart.
+ *
+ * \return 			the other channel or NULL
+ */
+static struct ox16c954_port *men_uart_m45_sibling(struct ox16c954_port *ox)
+{
+	struct ox16c954_port *p;
+	unsigned int i;
+
+	for (i = 0; i < MAX_SNGL_UARTS; i++) {
+		p = &men_uart_ports[i];
+		if (p != ox && p->type == MOD_M45 && p->port.membase &&
+			p->tcrReg == ox->tcrReg && p->tcrBit == ox->tcrBit &&
+			(p->port.membase == ox->port.membase + 0x10 ||
+			 p->port.membase + 0x10 == ox->port.membase))
+			return p;
 	}
+	return NULL;
+}
+
+
+/*******************************************************************/
+/** take the TCR bit pair of a M45N channel when it's opened
+ *
+ * \param ox		\IN Oxford 16C954 Port Struct
+ *
+ * \brief Refused while the channel sharing the bit switches it in 
+ *        automatic tristate mode.
+ *
+ * \return 			0 or -EBUSY
+ */
+static int men_uart_m45_claim(struct ox16c954_port *ox)
+{
+	struct ox16c954_port *sib;
+	unsigned long flags;
+	int retval = 0;
+
+	if (ox->type != MOD_M45)
+		return 0;
+
+	sib = men_uart_m45_sibling(ox);
+	spin_lock_irqsave(&m45_tcr_lock, flags);
+	if (sib && sib->triAuto)
+		retval = -EBUSY;
+	else
+		ox->triOpen = 1;
+	spin_unlock_irqrestore(&m45_tcr_lock, flags);
+	return retval;
+}
+
+
+/*******************************************************************/
+/** give back the TCR bit pair of a M45N channel when it's closed
+ *
+ * \param ox		\IN Oxford 16C954 Port Struct
+ *
+ * \brief Automatic tristate ends with the last close, so the channel 
+ *        sharing the bit can be opened again.
+ *
+ * \return 			-
+ */
+static void men_uart_m45_release(struct ox16c954_port *ox)
+{
+	unsigned long flags;
+
+	if (ox->type != MOD_M45)
+		return;
+
+	spin_lock_irqsave(&ox->port.lock, flags);
+	/* leaving auto mode: don't stay tristated */
+	if (ox->triAuto) {
+		men_uart_m45_tristate(ox, 0);
+		ox->rs485Soft 		= 0;
+		ox->taStats.swCtrl 	= 0;
+	}
+	spin_lock(&m45_tcr_lock);
+	ox->triAuto = 0;
+	ox->triOpen = 0;
+	spin_unlock(&m45_tcr_lock);
+	spin_unlock_irqrestore(&ox->port.lock, flags);
+}
+
+
+/*******************************************************************/
+/** Ioctl function for the M45N automatic tristate
+ *
+ * \param up		\IN highlevel (serial core) Port Struct
+ * \param cmd		\IN M45_TIO_TRI_AUTO_SET or M45_TIO_TRI_AUTO_GET
+ * \param arg		\IN user pointer to struct m45_tri_auto
+ *
+ * \brief The channel leaves tristate in start_tx and goes back after the
+ *        transmitter is empty plus guard time, both done by rs485Timer 
+ *        like the software timed RS485 mode of M77. Not possible while
+ *        a channel sharing the TCR bit is open, its driver would be
+ *        switched too, the other channel can't be opened while it's on
+ *        (men_uart_m45_claim()).
+ *
+ * \return 			0 or negative error number
+ */
+static int men_uart_tri_auto( struct uart_port *up, 
+							  unsigned int cmd,
+							  unsigned long arg)
+{
+	struct ox16c954_port *ox = &men_uart_ports[up->line];
+	struct ox16c954_port *sib;
+	struct m45_tri_auto ta;
+	unsigned long flags;
+	int busy, was;
+
+	if (ox->type != MOD_M45)
+		return -ENOTTY;
+
+	switch (cmd) {
+	case M45_TIO_TRI_AUTO_SET:
+		if (copy_from_user(&ta, (void __user *)arg, sizeof(ta)))
+			return -EFAULT;
+
+		M77DBG2("M45_TIO_TRI_AUTO_SET: en %d guard %dus\n", 
+				ta.enable, ta.guardUs);
+		if ((u64)ta.guardUs * NSEC_PER_USEC > UINT_MAX)
+			return -EINVAL;
+
+		sib = men_uart_m45_sibling(ox);
+		spin_lock_irqsave(&ox->port.lock, flags);
+		spin_lock(&m45_tcr_lock);
+		busy = ox->rs485State != M77_RS485_IDLE || 
+			(ta.enable && sib && sib->triOpen);
+		was = ox->triAuto;
+		if (!busy)
+			ox->triAuto = !!ta.enable;
+		spin_unlock(&m45_tcr_lock);
+		if (busy) {
+			spin_unlock_irqrestore(&ox->port.lock, flags);
+			return -EBUSY;
+		}
+		/* leaving auto mode: don't stay tristated */
+		if (was && !ox->triAuto)
+			men_uart_m45_tristate(ox, 0);
+		ox->rs485Soft 		= ox->triAuto;
+		ox->drvBeforeNs 	= 0;
+		ox->drvAfterNs 		= (u64)ta.guardUs * NSEC_PER_USEC;
+		ox->taStats.swCtrl 	= ox->triAuto;
+		if (ox->triAuto)
+			men_uart_rs485_drive(ox, 0);
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		break;
+
+	case M45_TIO_TRI_AUTO_GET:
+		ta.enable  = ox->triAuto;
+		ta.guardUs = ox->drvAfterNs / 1000;
+		if (copy_to_user((void __user *)arg, &ta, sizeof(ta)))
+			return -EFAULT;
+		break;
+	}
+
+	return 0;
+}
+
+
+/*******************************************************************/
+/** Ioctl function for the RS485 settings and turnaround statistics
+ *
+ * \param up		\IN highlevel (serial core) Port Struct
+ * \param cmd		\IN M77_RS485_STATS, TIOCSRS485 or TIOCGRS485
+ * \param arg		\IN user pointer to argument struct
+ *
+ * \brief TIOCSRS485/TIOCGRS485 reach this only on kernels without
+ *        uart_port.rs485_config.
+ *
+ * \return 			0 or negative error number
+ */
+static int men_uart_rs485( struct uart_port *up, 
+						   unsigned int cmd,
+						   unsigned long arg)
+{
+	struct ox16c954_port *ox = &men_uart_ports[up->line];
+	struct m77_rs485_stats st;
+	struct serial_rs485 rs485;
+	unsigned long flags;
+	int retval = 0;
+
+	switch (cmd) {
+	case M77_RS485_STATS:
+		if (copy_from_user(&st, (void __user *)arg, sizeof(st)))
+			return -EFAULT;
+
+		spin_lock_irqsave(&ox->port.lock, flags);
+		ox->taStats.clear = st.clear;
+		st = ox->taStats;
+		if (st.clear) {
+			ox->taStats.count = ox->taStats.lastNs = 0;
+			ox->taStats.minNs = ox->taStats.maxNs = 0;
+		}
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+
+		if (copy_to_user((void __user *)arg, &st, sizeof(st)))
+			return -EFAULT;
+		break;
+
+	case TIOCSRS485:
+		if (copy_from_user(&rs485, (void __user *)arg, sizeof(rs485)))
+			return -EFAULT;
+
+		spin_lock_irqsave(&ox->port.lock, flags);
+		retval = men_uart_rs485_apply(ox, &rs485);
+		spin_unlock_irqrestore(&ox->port.lock, flags);
+		if (retval)
+			return retval;
+		/* return what was set */
+		fallthrough;
+	case TIOCGRS485:
+		if (copy_to_user((void __user *)arg, &ox->rs485, sizeof(rs485)))
+			return -EFAULT;
+		break;
+	}
+
+	return retval;
+}
+
+
+/*******************************************************************/
+/** Main HW dependent Ioctl function
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param cmd		\IN ioctl type, see serial_m77.h
+ * \param arg		\IN ioctl argument, see serial_m77.h
+ *
+ * \return 			0 or negative error number
+ */
+static int men_uart_ioctl(struct uart_port *up, unsigned int cmd, 
+						  unsigned long arg)
+{
+	int retval = 0;
+
+	/* M77DBG("%s: cmd = 0x%x arg = 0x%x ", __FUNCTION__, cmd, arg ); */
+
+	switch (cmd) {
+
+	case M77_PHYS_INT_SET:
+	case M77_ECHO_SUPPRESS:
+	case M45_TIO_TRI_MODE:
+		retval = men_uart_m77phy( up, cmd, arg);
+		break;
+
+	case M77_INBAND_SET:
+	case M77_INBAND_GET:
+		retval = men_uart_inband( up, cmd, arg);
+		break;
+
+	case M77_MULTIDROP_SET:
+	case M77_MULTIDROP_GET:
+		retval = men_uart_multidrop( up, cmd, arg);
+		break;
+
+	case M77_DELIM_SET:
+	case M77_DELIM_GET:
+		retval = men_uart_delim( up, cmd, arg);
+		break;
+
+	case M77_ECHO_CANCEL_SET:
+	case M77_ECHO_CANCEL_GET:
+		retval = men_uart_echo( up, cmd, arg);
+		break;
+
+	case M77_FRAMETX_SET:
+	case M77_FRAMETX_GET:
+		retval = men_uart_frametx( up, cmd, arg);
+		break;
+
+	case M77_RTU_SET:
+	case M77_RTU_GET:
+	case M77_IDLE_SET:
+	case M77_IDLE_GET:
+	case M77_CRC_SET:
+	case M77_CRC_GET:
+	case M77_FRAME_INFO:
+		retval = men_uart_frame( up, cmd, arg);
+		break;
+
+	case M77_RXTS_SET:
+	case M77_RXTS_READ:
+		retval = men_uart_rxts( up, cmd, arg);
+		break;
+
+	case M77_MSR_SET:
+	case M77_MSR_READ:
+		retval = men_uart_msr( up, cmd, arg);
+		break;
+
+#ifdef M77_HAS_BPF
+	case M77_BPF_SET:
+	case M77_BPF_GET:
+		retval = men_uart_bpf( up, cmd, arg);
+		break;
+#endif
+
+	case M77_SCHED_SET:
+	case M77_SCHED_STAT:
+		retval = men_uart_sched( up, cmd, arg);
+		break;
+
+	case M77_PRIO_SEND:
+	case M77_PRIO_STATS:
+		retval = men_uart_prio( up, cmd, arg);
+		break;
+
+	case M77_LIN_SET:
+	case M77_LIN_GET:
+	case M77_LIN_TABLE:
+	case M77_LIN_RESULT:
+		retval = men_uart_lin( up, cmd, arg);
+		break;
+
+	case M77_BRIDGE_SET:
+	case M77_BRIDGE_GET:
+		retval = men_uart_bridge( up, cmd, arg);
+		break;
+
+	case M77_GROUP_SET:
+	case M77_GROUP_GET:
+	case M77_GROUP_WRITE:
+		retval = men_uart_group( up, cmd, arg);
+		break;
+
+	case M45_TIO_TRI_AUTO_SET:
+	case M45_TIO_TRI_AUTO_GET:
+		retval = men_uart_tri_auto( up, cmd, arg);
+		break;
+
+	case M77_RS485_STATS:
+#ifndef M77_HAS_RS485_CONFIG
+	case TIOCSRS485:
+	case TIOCGRS485:
+#endif
+		retval = men_uart_rs485( up, cmd, arg);
+		break;
+            
+	default:
+		retval = -ENOIOCTLCMD;
+	}
+	return retval;
+
+}
+
+
+/*******************************************************************/
+/** Toplevel 16550 + compatibles autoconfig function
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \return 			-
+ */
+static void autoconfig_16550a(struct ox16c954_port *up)
+{
+	unsigned int id1, id2, id3, rev;
+	up->port.type = PORT_16C950;
+ 	up->capabilities |= UART_CAP_FIFO; 
+
+	serial_out(up, UART_LCR, 0xBF);
+	if (serial_in(up, UART_EFR) == 0 ) {
+		printk("EFRv2 ");
+
+		/* Everything with an EFR has SLEEP */
+		up->capabilities |= UART_CAP_FIFO|UART_CAP_EFR | UART_CAP_SLEEP;
+
+		/* Check for Oxford Semiconductor 16C95x (true for M45N/69N/77) */
+		up->acr = 0;	
+		up->acrShadow = up->acr;
+		
+		/* Set Enhanced Mode */
+		serial_efr_write(up, UART_EFR, UART_EFR_ECB);
+		id1 = serial_icr_read(up, UART_ID1);
+		id2 = serial_icr_read(up, UART_ID2);
+		id3 = serial_icr_read(up, UART_ID3);
+		rev = serial_icr_read(up, UART_REV);
+		M77DBG("16c950 ID: %02x:%02x:%02x:%02x ", id1, id2, id3, rev);
+		if (id1==0x16 && id2 == 0xC9 && (id3==0x50 || id3==0x52 || id3==0x54)) 
+			up->port.type = PORT_16C950;
+		
+		return;
+	}
+}
+
+
+/*******************************************************************/
+/** Toplevel Autoconfig function
+ *
+ * \param up			\IN Oxford 16C954 Port Struct
+ * \param probeflags	\IN one of UPF_*, see serial_core.h
+ *
+ * \brief This is called to determine what type of UART chip this serial 
+ *        port is, using: 8250, 16450, 16550, 16550A.
+ *
+ * \return 			-
+ */
+static void autoconfig(struct ox16c954_port *up, unsigned int probeflags)
+{
+	unsigned char status1, scratch, scratch2, scratch3;
+	unsigned char save_lcr, save_mcr;
+	unsigned long flags;
+
+	if (!up->port.iobase && !up->port.mapbase && !up->port.membase)
+		return;
+
+	M77DBG( UART_NAME_PREFIX"%d: autoconf: ", up->port.line);
+
+	/*
+	 * We really do need global IRQs disabled here - we're going to
+	 * be frobbing the chips IRQ enable register to see if it exists.
+	 */
+	spin_lock_irqsave(&up->port.lock, flags);
+
+	up->capabilities = 0;
+	up->bugs = 0;
+
+	scratch = serial_in(up, UART_IER);
+	serial_out(up, UART_IER, 0);
+
+	scratch2 = serial_in(up, UART_IER);
+	serial_out(up, UART_IER, 0x0F);
+
+	scratch3 = serial_in(up, UART_IER);
+	serial_out(up, UART_IER, scratch);
+
+	if (scratch2 != 0 || scratch3 != 0x0F) {
+		/* We failed; there's nothing here */
+		M77DBG("IER test failed (%02x, %02x) ",scratch2, scratch3);
+		goto out;
+	}
+
+	save_mcr = serial_in(up, UART_MCR);
+	save_lcr = serial_in(up, UART_LCR);
+
+	/* 
+	 * Check to see if a UART is really there.
+	 */
+	serial_out(up, UART_MCR, UART_MCR_LOOP | 0x0A);
+	status1 = serial_in(up, UART_MSR) & 0xF0;
+	serial_out(up, UART_MCR, save_mcr);
+	if (status1 != 0x90) {
+		M77DBG("LOOP test failed (%02x) ", status1);
+		goto out;
+	}
+
+
+	/*
+	 * We're pretty sure there's a port here.  Lets find out what
+	 * type of port it is.  The IIR top two bits allows us to find
+	 * out if it's 8250 or 16450, 16550, 16550A or later.  This
+	 * determines what we test for next.
+	 *
+	 * We also initialise the EFR (if any) to zero for later.  The
+	 * EFR occupies the same register location as the FCR and IIR.
+	 */
+
+	/* Set Enhanced Mode */
+	serial_efr_write(up, UART_EFR, UART_EFR_ECB);
+
+	serial_out(up, UART_FCR, UART_FCR_ENABLE_FIFO);
+	scratch = serial_in(up, UART_IIR) >> 6;
+
+	M77DBG3("iir=%d ", scratch);
+
+	switch (scratch) {
+	case 3:
+		autoconfig_16550a(up);
+		break;
+	default:
+		printk("*** unknown iir value:=%d (should be 3)", scratch);
+		break;
+	}
+
+	serial_out(up, UART_LCR, save_lcr);
+
+	if (up->capabilities != uart_config[up->port.type].flags) {
+
+		printk(KERN_WARNING UART_NAME_PREFIX
+			   "%d: detected caps %08x should be %08x\n",
+			   up->port.line, up->capabilities,
+			   uart_config[up->port.type].flags);
+	}
+
+	up->port.fifosize = uart_config[up->port.type].fifo_size;
+	up->capabilities = uart_config[up->port.type].flags;
+	up->tx_loadsz = uart_config[up->port.type].tx_loadsz;
+
+	if (up->port.type == PORT_UNKNOWN)
+		goto out;
+
+	/*
+	 * Reset the UART.
+	 */
+
+	serial_out(up, UART_MCR, save_mcr);
+	men_uart_clear_fifos(up);
+	(void)serial_in(up, UART_RX);
+	if (up->capabilities & UART_CAP_UUE)
+		serial_out(up, UART_IER, UART_IER_UUE);
+	else
+		serial_out(up, UART_IER, 0);
+
+ out:	
+	spin_unlock_irqrestore(&up->port.lock, flags);
+//	restore_flags(flags);
+
+}
+
+
+/*******************************************************************/
+/** lowlevel TX Stop function, by clearing Threshold IRQ
+ *
+ * \param p			\IN Oxford 16C954 Port Struct
+ *
+ * \return 			-
+ */
+static inline void __stop_tx(struct ox16c954_port *p)
+{
+	if (p->ier & UART_IER_THRI) {
+		p->ier &= ~UART_IER_THRI;
+		serial_out(p, UART_IER, p->ier);
+	}
+	p->frameActive = 0;
+	men_uart_rs485_stop_tx(p);
+}
+
+/*******************************************************************/
+/** highlevel TX stop function called by serial_core
+ *
+ * \param port		\IN highlevel uart_port Struct (as in serial_core)
+ *
+ * \return 			-
+ */
+#if LINUX_VERSION_CODE < Z025_SERIAL_DIFF
+static void men_uart_stop_tx(struct uart_port *port, unsigned int tty_stop)
+#else
+static void men_uart_stop_tx(struct uart_port *port)
+#endif
+{
+	struct ox16c954_port *up = (struct ox16c954_port *)port;
+
+	__stop_tx(up);
+
+	/*
+	 * We really want to stop the transmitter from sending.
+	 */
+	if (up->port.type == PORT_16C950) {
+		up->acr |= UART_ACR_TXDIS;
+		serial_icr_write(up, UART_ACR, up->acr);
+		up->acrShadow = up->acr;
+	}
+}
+
+
+/*******************************************************************/
+/** remember a sent char for echo cancellation
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param ch		\IN char written to the TX FIFO
+ *
+ * \return 			-
+ */
+static inline void men_uart_echo_put(struct ox16c954_port *up, 
+									 unsigned char ch)
+{
+	up->echoBuf[up->echoHead] = ch;
+	up->echoHead = (up->echoHead + 1) & (M77_ECHO_SIZE - 1);
+
+	/* shadow full: the oldest echo didn't come back */
+	if (up->echoHead == up->echoTail) {
+		up->echoTail = (up->echoTail + 1) & (M77_ECHO_SIZE - 1);
+		up->echoLost++;
+	}
+}
+
+
+/*******************************************************************/
+/** echo cancellation, called for each received char
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param ch		\IN received char
+ * \param lsr		\IN LSR status of this char
+ * \param flag		\OUT TTY_FRAME for garbled echoes with M77_ECHO_MARKERR
+ *
+ * \brief While sent chars are outstanding every received char is the
+ *        echo of the oldest of them. If it differs or has an error 
+ *        another station sent at the same time: a bus collision.
+ *
+ * \return 			1: pass char up, 0: drop it
+ */
+static inline int men_uart_echo_filter(struct ox16c954_port *up, 
+									   unsigned char ch, unsigned char lsr,
+									   char *flag)
+{
+	unsigned char sent;
+
+	if (up->echoHead == up->echoTail)
+		return 1;		/* nothing sent, from the peer */
+
+	sent = up->echoBuf[up->echoTail];
+	up->echoTail = (up->echoTail + 1) & (M77_ECHO_SIZE - 1);
+
+	if (ch == sent && !(lsr & (UART_LSR_BI | UART_LSR_PE | UART_LSR_FE))) {
+		up->echoDropped++;
+		return 0;
+	}
+
+	up->echoCollisions++;
+	up->echoColl = 1;
+	if (up->echoFlags & M77_ECHO_MARKERR) {
+		*flag = TTY_FRAME;
+		return 1;
+	}
+	return 0;
+}
+
+
+/*******************************************************************/
+/** set the time all outstanding echoes must be back
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \return 			-
+ */
+static inline void men_uart_echo_deadline(struct ox16c954_port *up)
+{
+	/* all echoes must be back when the shadow is sent and received */
+	up->echoDeadline = ktime_add_ns(ktime_get(), 
+		(u64)(((up->echoHead - up->echoTail) & (M77_ECHO_SIZE - 1)) + 
+			  M77_ECHO_MARGIN) * up->charNs + M77_ECHO_SLACK_NS);
+}
+
+
+/*******************************************************************/
+/** copy into a ring with a power of 2 data area
+ *
+ * \param data		\IN data area
+ * \param mask		\IN data area size - 1
+ * \param head		\INOUT write position, not masked
+ * \param buf		\IN data
+ * \param len		\IN number of bytes, the room was checked before
+ *
+ * \return 			-
+ */
+static void men_uart_ring_put(unsigned char *data, unsigned int mask,
+							  unsigned int *head, const void *buf,
+							  unsigned int len)
+{
+	unsigned int off = *head & mask;
+	unsigned int c = min_t(unsigned int, len, mask + 1 - off);
+
+	memcpy(data + off, buf, c);
+	memcpy(data, (const unsigned char *)buf + c, len - c);
+	*head += len;
+}
+
+
+/*******************************************************************/
+/** write one record into the traffic tap ring
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param dir		\IN M77_TAP_RX or M77_TAP_TX
+ * \param lsr		\IN LSR errors of the chars
+ * \param b1		\IN chars
+ * \param l1		\IN number of chars in b1
+ * \param b2		\IN chars following b1 (wrap of the xmit buffer)
+ * \param l2		\IN number of chars in b2
+ *
+ * \brief The time stamp is taken here, right after the FIFO was drained
+ *        or loaded. A record not fitting is lost completely.
+ *        Must be called with the port lock held.
+ *
+ * \return 			-
+ */
+static void men_uart_tap_rec(struct ox16c954_port *up, unsigned int dir,
+							 unsigned char lsr, const unsigned char *b1,
+							 unsigned int l1, const unsigned char *b2,
+							 unsigned int l2)
+{
+	struct m77_tap_rec rec;
+	unsigned int used, need = sizeof(rec) + ALIGN(l1 + l2, 4), nsec;
+	struct m77_raw_ring *ring;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.tsSec 	= div_u64_rem(ktime_to_ns(ktime_get()), NSEC_PER_SEC, &nsec);
+	rec.tsNsec 	= nsec;
+	rec.line 	= up->port.line;
+	rec.dir 	= dir;
+	rec.lsr 	= lsr;
+	rec.len 	= l1 + l2;
+
+	spin_lock(&m77_tap_lock);
+	ring = m77TapRing;
+	if (!ring)
+		goto out;
+
+	/* the reader owns tail, don't trust it further than needed */
+	used = m77TapHead - READ_ONCE(ring->tail);
+	if (used > m77TapMask + 1 || need > m77TapMask + 1 - used) {
+		ring->lost += l1 + l2;
+		goto out;
+	}
+
+	men_uart_ring_put(m77TapData, m77TapMask, &m77TapHead, &rec, sizeof(rec));
+	men_uart_ring_put(m77TapData, m77TapMask, &m77TapHead, b1, l1);
+	men_uart_ring_put(m77TapData, m77TapMask, &m77TapHead, b2, l2);
+	m77TapHead = ALIGN(m77TapHead, 4);	/* padding */
+
+	/* data before head */
+	smp_wmb();
+	WRITE_ONCE(ring->head, m77TapHead);
+	wake_up_interruptible(&m77_tap_wait);
+ out:
+	spin_unlock(&m77_tap_lock);
+}
+
+
+/*******************************************************************/
+/** count the receive errors of a char in the port statistics
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param lsr		\IN LSR of the char
+ *
+ * \brief A break is counted as break only, as in the 8250 driver.
+ *
+ * \return 			error bits of lsr not ignored by termios (IGNBRK, 
+ *                  IGNPAR)
+ */
+static inline unsigned char men_uart_lsr_count(struct ox16c954_port *up,
+											   unsigned char lsr)
+{
+	if (likely(!(lsr & M77_LSR_ERRORS)))
+		return 0;
+
+	if (lsr & UART_LSR_BI)
+		up->port.icount.brk++;
+	else if (lsr & UART_LSR_PE)
+		up->port.icount.parity++;
+	else if (lsr & UART_LSR_FE)
+		up->port.icount.frame++;
+	if (lsr & UART_LSR_OE)
+		up->port.icount.overrun++;
+
+	return lsr & ~up->port.ignore_status_mask & M77_LSR_ERRORS;
+}
+
+
+/*******************************************************************/
+/** collect a received char for the traffic tap
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param ch		\IN char read
+ * \param lsr		\IN LSR of the char
+ *
+ * \brief Chars of all RX modes are collected and recorded together when
+ *        the ISR is done with the port.
+ *
+ * \return 			-
+ */
+static inline void men_uart_tap_rx(struct ox16c954_port *up, 
+								   unsigned char ch, unsigned char lsr)
+{
+	if (M77_TAP_ACTIVE(up) && up->tapCnt < sizeof(up->tapBuf)) {
+		up->tapBuf[up->tapCnt++] = ch;
+		up->tapLsr |= lsr & M77_LSR_ERRORS;
+	}
+}
+
+
+/*******************************************************************/
+/** load chars from the xmit buffer into the TX FIFO
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param xmit		\IN serial core transmit buffer
+ * \param count		\IN max. number of chars to load
+ *
+ * \return 			number of chars loaded
+ */
+static inline int men_uart_tx_load(struct ox16c954_port *up,
+								   struct circ_buf *xmit, int count)
+{
+	int n = 0, start = xmit->tail, l1;
+
+	/* 9-bit mode: SPR[0] is sent as 9th bit, data chars have it cleared */
+	if (up->mdEnable)
+		serial_out(up, UART_SCR, 0);
+
+	while (n < count && !uart_circ_empty(xmit)) {
+		serial_out(up, UART_TX, xmit->buf[xmit->tail]);
+		if (up->echoEnable)
+			men_uart_echo_put(up, xmit->buf[xmit->tail]);
+		xmit->tail = (xmit->tail + 1) & (UART_XMIT_SIZE - 1);
+		up->port.icount.tx++;
+		n++;
+	}
+	up->txLoaded = n;
+
+	if (up->echoEnable)
+		men_uart_echo_deadline(up);
+
+	if (M77_TAP_ACTIVE(up) && n) {
+		/* the chars stay in the xmit buffer while we hold the lock */
+		l1 = min_t(int, n, UART_XMIT_SIZE - start);
+		men_uart_tap_rec(up, M77_TAP_TX, 0, &xmit->buf[start], l1,
+						 xmit->buf, n - l1);
+	}
+	return n;
+}
+
+
+/*******************************************************************/
+/** load a driver internal buffer into the TX FIFO
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param buf		\IN chars to send
+ * \param len		\IN number of chars, must fit into the FIFO
+ *
+ * \return 			-
+ */
+static inline void men_uart_tx_buf(struct ox16c954_port *up,
+								   const unsigned char *buf, unsigned int len)
+{
+	unsigned int i;
+
+	if (up->mdEnable)
+		serial_out(up, UART_SCR, 0);
+
+	for (i = 0; i < len; i++) {
+		serial_out(up, UART_TX, buf[i]);
+		if (up->echoEnable)
+			men_uart_echo_put(up, buf[i]);
+	}
+	up->port.icount.tx += len;
+
+	if (up->echoEnable)
+		men_uart_echo_deadline(up);
+
+	if (M77_TAP_ACTIVE(up) && len)
+		men_uart_tap_rec(up, M77_TAP_TX, 0, buf, len, NULL, 0);
+}
+
+
+/*******************************************************************/
+/** load (the rest of) a due scheduled frame into the TX FIFO
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param count		\IN free space in the TX FIFO
+ *
+ * \brief Due frames go out in slot order. The TX time and its delay to
+ *        the scheduled time are taken when the 1st char is written.
+ *        Must be called with the port lock held.
+ *
+ * \return 			number of chars loaded
+ */
+static unsigned int men_uart_sched_load(struct ox16c954_port *up, 
+										unsigned int count)
+{
+	struct m77_sched_stat *st;
+	struct m77_sched *s;
+	unsigned int n, i;
+	ktime_t now;
+	s64 late;
+	u32 nsec;
+
+	if (!up->schedCur) {
+		for (i = 0; !(up->schedPend & (1 << i)); i++)
+			;
+		up->schedPend &= ~(1 << i);
+		up->schedCur = s = &up->sched[i];
+		up->schedOff = 0;
+
+		now = ktime_get();
+		late = ktime_to_ns(ktime_sub(now, s->txDue));
+		st = &s->st;
+		st->lateNs = (late > 0) ? late : 0;
+		if (!st->count || st->lateNs < st->minLateNs)
+			st->minLateNs = st->lateNs;
+		if (st->lateNs > st->maxLateNs)
+			st->maxLateNs = st->lateNs;
+		st->lastSec 	= div_u64_rem(ktime_to_ns(now), NSEC_PER_SEC, &nsec);
+		st->lastNsec 	= nsec;
+		st->count++;
+	}
+
+	s = up->schedCur;
+	n = min(count, s->len - up->schedOff);
+	men_uart_tx_buf(up, s->data + up->schedOff, n);
+	up->schedOff += n;
+	if (up->schedOff == s->len)
+		up->schedCur = NULL;
+
+	return n;
+}
+
+
+/*******************************************************************/
+/** load (the rest of) the oldest priority frame into the TX FIFO
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param count		\IN free space in the TX FIFO
+ *
+ * \brief The queueing latency is taken when the 1st char is written.
+ *        Must be called with the port lock held.
+ *
+ * \return 			number of chars loaded
+ */
+static unsigned int men_uart_prio_load(struct ox16c954_port *up, 
+									   unsigned int count)
+{
+	struct m77_prio *p = &up->prio[up->prioTail];
+	struct m77_prio_stats *st = &up->prioStats;
+	unsigned int n;
+	s64 lat;
+
+	if (!up->prioOff) {
+		lat = ktime_to_ns(ktime_sub(ktime_get(), p->queued));
+		st->lastNs = (lat > 0) ? lat : 0;
+		if (!st->count || st->lastNs < st->minNs)
+			st->minNs = st->lastNs;
+		if (st->lastNs > st->maxNs)
+			st->maxNs = st->lastNs;
+		up->prioSumNs += st->lastNs;
+		st->count++;
+	}
+
+	n = min(count, p->len - up->prioOff);
+	men_uart_tx_buf(up, p->data + up->prioOff, n);
+	up->prioOff += n;
+	if (up->prioOff == p->len) {
+		up->prioOff = 0;
+		up->prioTail = (up->prioTail + 1) % M77_PRIO_NUM;
+	}
+
+	return n;
+}
+
+
+/*******************************************************************/
+/** load driver internal frames into the TX FIFO ahead of xmit
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param count		\IN free space in the TX FIFO
+ * \param hold		\IN a written frame is being sent (frame TX mode)
+ *
+ * \brief A frame once started is completed first. Then due scheduled 
+ *        frames go out, then priority frames. Frames longer than the free
+ *        space are continued with the next TX interrupt. With hold set
+ *        new scheduled and priority frames wait for the end of the 
+ *        written frame.
+ *        Must be called with the port lock held.
+ *
+ * \return 			-
+ */
+static void men_uart_oob_load(struct ox16c954_port *up, unsigned int count,
+							  int hold)
+{
+	unsigned int n, loaded = 0;
+
+	while (count) {
+		if (up->prioOff)
+			n = men_uart_prio_load(up, count);
+		else if (up->schedCur || (!hold && up->schedPend))
+			n = men_uart_sched_load(up, count);
+		else if (!hold && up->prioHead != up->prioTail)
+			n = men_uart_prio_load(up, count);
+		else
+			break;
+		loaded += n;
+		count -= n;
+	}
+
+	up->txLoaded = loaded;
+}
+
+
+/*******************************************************************/
+/** check for driver internal frames to send
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \return 			1 if scheduled or priority frames are queued, else 0
+ */
+static inline int men_uart_oob_pending(struct ox16c954_port *up)
+{
+	return up->schedCur || up->schedPend || up->prioHead != up->prioTail;
+}
+
+
+/*******************************************************************/
+/** check if a frame written to the tty is being sent in frame TX mode
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param xmit		\IN xmit buffer of the port
+ *
+ * \brief The frame ends when xmit runs empty, driver internal frames 
+ *        loaded before would go out in the middle of it.
+ *
+ * \return 			1 if a written frame is not complete in the FIFO
+ */
+static inline int men_uart_frame_busy(struct ox16c954_port *up,
+									  struct circ_buf *xmit)
+{
+	return up->frameTx && up->frameActive && !uart_circ_empty(xmit);
+}
+
+
+/*******************************************************************/
+/** stage a frame in the TX FIFO with the transmitter disabled
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \brief Only done when the transmitter is empty, else the new data is
+ *        appended to the frame still going out. The caller releases the
+ *        transmitter (ACR TXDIS) after enabling the TX interrupt, from then
+ *        on the FIFO is refilled whenever it falls to the TX trigger level.
+ *        Must be called with the port lock held.
+ *
+ * \return 			-
+ */
+static void men_uart_frame_stage(struct ox16c954_port *up)
+{
+#if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,32)
+	struct circ_buf *xmit = &up->port.info->xmit;
+#else
+	struct circ_buf *xmit = &up->port.state->xmit;
+#endif
+
+	if (uart_circ_empty(xmit) || uart_tx_stopped(&up->port) || 
+		up->port.x_char)
+		return;
+
+	if (!(serial_in(up, UART_LSR) & UART_LSR_TEMT))
+		return;
+
+	up->acr |= UART_ACR_TXDIS;
+	serial_icr_write(up, UART_ACR, up->acr);
+	up->acrShadow = up->acr;
+
+	men_uart_tx_load(up, xmit, up->port.fifosize);
+	up->frameActive = 1;
+	up->frameCount++;
+}
+
+
+/*******************************************************************/
+/** central transmit function, called in ISR 
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \return 			-
+ */
+static inline void transmit_chars(struct ox16c954_port *up)
+{
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,32)
+	struct circ_buf *xmit = &up->port.info->xmit;
+#else
+	struct circ_buf *xmit = &up->port.state->xmit;
+#endif
+
+	int count, hold;
+
+	/* the LIN master owns the line, x_char and xmit wait until it's off */
+	if (up->linMode) {
+		__stop_tx(up);
+		return;
+	}
+
+	/* an in-kernel client sends from its own buffer */
+	if (up->kcli)
+		xmit = &up->kcXmit;
+
+	if (up->port.x_char) {
+		serial_out(up, UART_TX, up->port.x_char);
+		if (up->echoEnable)
+			men_uart_echo_put(up, up->port.x_char);
+		if (M77_TAP_ACTIVE(up))
+			men_uart_tap_rec(up, M77_TAP_TX, 0, &up->port.x_char, 1, 
+							 NULL, 0);
+		up->port.icount.tx++;
+		up->port.x_char = 0;
+		return;
+	}
+
+	/* without tty there is no tty->stopped */
+	if (up->kcli ? up->port.hw_stopped : uart_tx_stopped(&up->port)) {
+#if LINUX_VERSION_CODE < Z025_SERIAL_DIFF
+		men_uart_stop_tx(&up->port, 0);
+#else
+		men_uart_stop_tx(&up->port);
+#endif
+		return;
+	}
+
+	/* 
+	 * scheduled and priority frames go out ahead of xmit, in frame TX 
+	 * mode not into a written frame
+	 */
+	if (men_uart_oob_pending(up)) {
+		hold = men_uart_frame_busy(up, xmit);
+		men_uart_oob_load(up, (serial_in(up, UART_LSR) & UART_LSR_TEMT) ? 
+						  up->port.fifosize : up->tx_loadsz, hold);
+		if (up->txLoaded || !hold)
+			return;
+	}
+
+	if (uart_circ_empty(xmit)) {
+		__stop_tx(up);
+		return;
+	}
+
+	count = up->tx_loadsz;
+	if (up->frameTx) {
+		/* refill exactly up to the top, check if we came too late */
+		if (up->frameActive && 
+			(serial_in(up, UART_LSR) & UART_LSR_TEMT))
+			up->frameUnderruns++;
+		up->frameActive = 1;
+	}
+
+	men_uart_tx_load(up, xmit, count);
+
+#ifdef M77_HAS_NETDEV
+	if (up->net && uart_circ_empty(xmit))
+		men_uart_net_tx_done(up);
+#endif
+
+	if (uart_circ_chars_pending(xmit) < WAKEUP_CHARS) {
+		if (!up->kcli)
+			uart_write_wakeup(&up->port);
+		else if (up->kcli->write_wakeup)
+			up->kcWake = 1;		/* called without the lock, it may write */
+	}
+
+	DEBUG_INTR("THRE ");
+
+	/* the frame is complete, held frames follow with the next THRE */
+	if (uart_circ_empty(xmit)) {
+		if (men_uart_oob_pending(up))
+			up->frameActive = 0;
+		else
+			__stop_tx(up);
+	}
+}
+
+
+/*******************************************************************/
+/** enable TX interrupt and transmitter
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \return 			-
+ */
+static void __start_tx(struct ox16c954_port *up)
+{
+	if (up->frameTx && !(up->ier & UART_IER_THRI))
+		men_uart_frame_stage(up);
+
+	if (!(up->ier & UART_IER_THRI)) {
+		up->ier |= UART_IER_THRI;
+		serial_out(up, UART_IER, up->ier);
+
+		if (up->bugs & UART_BUG_TXEN) {
+			unsigned char lsr, iir;
+			lsr = serial_in(up, UART_LSR);
+			iir = serial_in(up, UART_IIR);
+			if (lsr & UART_LSR_TEMT && iir & UART_IIR_NO_INT)
+				transmit_chars(up);
+		}
+	}
+
+	/* Re-enable the transmitter if we disabled it. */
+	if ( up->acr & UART_ACR_TXDIS) {
+		up->acr &= ~UART_ACR_TXDIS;
+		serial_icr_write(up, UART_ACR, up->acr);
+		up->acrShadow = up->acr;
+	}
+}
+
+
+/*******************************************************************/
+/** transmit start function
+ *
+ * \param port		\IN highlevel (serial core) Port Struct
+ *
+ * \return 			-
+ */
+#if LINUX_VERSION_CODE < Z025_SERIAL_DIFF
+static void men_uart_start_tx(struct uart_port *port, unsigned int tty_start)
+#else
+static void men_uart_start_tx(struct uart_port *port)
+#endif
+{
+	struct ox16c954_port *up = (struct ox16c954_port *)port;
+
+	/* the port belongs to the LIN master, data is sent when it's off */
+	if (up->linMode)
+		return;
+
+	if (up->rs485Soft) {
+		switch (up->rs485State) {
+		case M77_RS485_BEFORE:
+			return;		/* TX starts when the delay expired */
+
+		case M77_RS485_IDLE:
+			men_uart_rs485_drive(up, 1);
+			if (up->drvBeforeNs) {
+				up->rs485State = M77_RS485_BEFORE;
+				hrtimer_start(&up->rs485Timer, ns_to_ktime(up->drvBeforeNs),
+							  HRTIMER_MODE_REL);
+				return;
+			}
+			break;
+
+		default:
+			/* driver is still enabled from the last frame */
+			hrtimer_try_to_cancel(&up->rs485Timer);
+			break;
+		}
+		up->rs485State = M77_RS485_TX;
+	}
+
+	__start_tx(up);
+}
+
+
+/*******************************************************************/
+/** start sending queued scheduled or priority frames
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \brief The FIFO is loaded right here if the transmitter has room,
+ *        without waiting for the THRE interrupt.
+ *        Must be called with the port lock held.
+ *
+ * \return 			-
+ */
+static void men_uart_oob_kick(struct ox16c954_port *up)
+{
+#if LINUX_VERSION_CODE < Z025_SERIAL_DIFF
+	men_uart_start_tx(&up->port, 0);
+#else
+	men_uart_start_tx(&up->port);
+#endif
+	if ((up->ier & UART_IER_THRI) && 
+		(serial_in(up, UART_LSR) & UART_LSR_THRE))
+		transmit_chars(up);
+}
+
+
+/*******************************************************************/
+/** move a slot to its next due time
+ *
+ * \param s			\IN scheduled frame
+ * \param now		\IN current time
+ *
+ * \brief One-shot slots are done. Cyclic slots which fell behind (e.g.
+ *        timer delayed) skip the missed cycles and stay aligned.
+ *
+ * \return 			-
+ */
+static void men_uart_sched_advance(struct m77_sched *s, ktime_t now)
+{
+	ktime_t next, aligned;
+
+	if (!s->periodNs) {
+		s->enable = 0;
+		return;
+	}
+
+	next = ktime_add_ns(s->due, s->periodNs);
+	if (!ktime_after(next, now)) {
+		aligned = men_uart_sched_cycle(s->periodNs, s->phaseNs, now);
+		s->st.missed += div64_u64(ktime_to_ns(ktime_sub(aligned, next)), 
+								  s->periodNs);
+		next = aligned;
+	}
+	s->due = next;
+}
+
+
+/*******************************************************************/
+/** TX scheduler timer, queues the due slots and starts sending
+ *
+ * \param timer		\IN schedTimer of the Oxford 16C954 Port Struct
+ *
+ * \brief A slot whose last frame is still queued misses this cycle. The
+ *        FIFO is loaded directly from here if the transmitter is free,
+ *        else with the next TX interrupt ahead of the xmit data.
+ *
+ * \return 			HRTIMER_RESTART while slots are active
+ */
+static enum hrtimer_restart men_uart_sched_timer(struct hrtimer *timer)
+{
+	struct ox16c954_port *up = 
+		container_of(timer, struct ox16c954_port, schedTimer);
+	struct m77_sched *s;
+	ktime_t now = ktime_get(), next;
+	unsigned long flags;
+	int i, any;
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	for (i = 0; i < M77_SCHED_SLOTS; i++) {
+		s = &up->sched[i];
+		if (!s->enable || ktime_after(s->due, now))
+			continue;
+
+		if ((up->schedPend & (1 << i)) || up->schedCur == s)
+			s->st.missed++;
+		else {
+			up->schedPend |= 1 << i;
+			s->txDue = s->due;
+		}
+		men_uart_sched_advance(s, now);
+	}
+
+	if (up->schedPend)
+		men_uart_oob_kick(up);
+
+	any = men_uart_sched_next(up, &next);
+	if (any)
+		hrtimer_set_expires(timer, next);
+	spin_unlock_irqrestore(&up->port.lock, flags);
+
+	return any ? HRTIMER_RESTART : HRTIMER_NORESTART;
+}
+
+
+/*******************************************************************/
+/** receive stop function
+ *
+ * \param port		\IN highlevel (serial core) Port Struct
+ *
+ * \return 			-
+ */
+static void men_uart_stop_rx(struct uart_port *port)
+{
+	struct ox16c954_port *up = (struct ox16c954_port *)port;
+
+	up->ier &= ~UART_IER_RLSI;
+	up->port.read_status_mask &= ~UART_LSR_DR;
+	serial_out(up, UART_IER, up->ier);
+}
+
+#ifdef M77_HAS_THROTTLE
+/*******************************************************************/
+/** throttle function, called by serial core when the tty can't take data
+ *
+ * \param port		\IN highlevel (serial core) Port Struct
+ *
+ * \brief The RX interrupts are masked and the FIFO is not drained any more.
+ *        Once it fills up to FCH the UART itself drops RTS (auto-RTS) or
+ *        sends XOFF (IXOFF), so nothing is lost and no interrupts are taken
+ *        for data the tty can't accept.
+ *
+ * \return 			-
+ */
+static void men_uart_throttle(struct uart_port *port)
+{
+	struct ox16c954_port *up = (struct ox16c954_port *)port;
+	unsigned long flags;
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	if (!up->throttled) {
+		up->throttled = up->ier & (UART_IER_RDI | UART_IER_RLSI);
+		up->ier &= ~(UART_IER_RDI | UART_IER_RLSI);
+		serial_out(up, UART_IER, up->ier);
+	}
+	spin_unlock_irqrestore(&up->port.lock, flags);
+}
+
+/*******************************************************************/
+/** unthrottle function, called by serial core when the tty has room again
+ *
+ * \param port		\IN highlevel (serial core) Port Struct
+ *
+ * \brief Restores the RX interrupts. Data left in the FIFO raises the RX
+ *        data or timeout interrupt right away, and once the FIFO drains
+ *        below FCL the UART reasserts RTS or sends XON by itself.
+ *
+ * \return 			-
+ */
+static void men_uart_unthrottle(struct uart_port *port)
+{
+	struct ox16c954_port *up = (struct ox16c954_port *)port;
+	unsigned long flags;
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	if (up->throttled) {
+		up->ier |= up->throttled;
+		up->throttled = 0;
+		serial_out(up, UART_IER, up->ier);
+	}
+	spin_unlock_irqrestore(&up->port.lock, flags);
+}
+#endif
+
+/*******************************************************************/
+/** receive stop function
+ *
+ * \param port		\IN highlevel uart_port Struct (as in serial_core)
+ *
+ * \return 			-
+ */
+static void men_uart_enable_ms(struct uart_port *port)
+{
+	struct ox16c954_port *up = (struct ox16c954_port *)port;
+
+	/* no MSR capabilities */
+	if (up->bugs & UART_BUG_NOMSR)
+		return;
+
+	up->ier |= UART_IER_MSI;
+	serial_out(up, UART_IER, up->ier);
+}
+
+/*******************************************************************/
+/** CRC type checked on the received frames
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \return 			M77_CRC_*
+ */
+static inline unsigned int men_uart_crc_type(struct ox16c954_port *up)
+{
+	return (up->frmMode == M77_FRM_RTU) ? M77_CRC16_MODBUS : up->crcType;
+}
+
+
+/*******************************************************************/
+/** preset the CRC register at the start of a frame
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \return 			-
+ */
+static inline void men_uart_crc_preset(struct ox16c954_port *up)
+{
+	up->frmCrc = (men_uart_crc_type(up) == M77_CRC32) ? 0xffffffff : 0xffff;
+}
+
+
+/*******************************************************************/
+/** update the CRC of the current frame by a received chunk
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param buf		\IN received chars
+ * \param len		\IN number of chars
+ *
+ * \brief The register was preset by men_uart_crc_preset() when the 
+ *        frame started.
+ *
+ * \return 			-
+ */
+static inline void men_uart_crc_update(struct ox16c954_port *up, 
+									   const unsigned char *buf, 
+									   unsigned int len)
+{
+	switch (men_uart_crc_type(up)) {
+	case M77_CRC16_MODBUS:
+		up->frmCrc = crc16(up->frmCrc, buf, len);
+		break;
+	case M77_CRC16_CCITT:
+		up->frmCrc = crc_itu_t(up->frmCrc, buf, len);
+		break;
+	case M77_CRC32:
+		up->frmCrc = crc32_le(up->frmCrc, buf, len);
+		break;
+	}
+}
+
+
+/*******************************************************************/
+/** check the CRC of the current frame
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \brief The CRC runs over the frame including its own CRC, a good frame
+ *        leaves the fixed residue of the CRC type.
+ *
+ * \return 			M77_FRM_CRCOK, M77_FRM_CRCERR or 0 if not checked
+ */
+static unsigned int men_uart_crc_check(struct ox16c954_port *up)
+{
+	unsigned int res;
+
+	switch (men_uart_crc_type(up)) {
+	case M77_CRC16_MODBUS:
+		if (up->frmMode == M77_FRM_RTU && up->frmLen < M77_RTU_MINLEN)
+			return M77_FRM_CRCERR;
+		res = M77_CRC16_MODBUS_RES;
+		break;
+	case M77_CRC16_CCITT:
+		res = M77_CRC16_CCITT_RES;
+		break;
+	case M77_CRC32:
+		res = M77_CRC32_RES;
+		break;
+	default:
+		return 0;
+	}
+
+	return (up->frmCrc == res) ? M77_FRM_CRCOK : M77_FRM_CRCERR;
+}
+
+
+/*******************************************************************/
+/** complete the current frame and pass it up
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \brief Checks the CRC computed while receiving, puts the frame into the
+ *        flip buffer in one go and queues its frame info with the start
+ *        time. A bad frame is dropped with M77_RTU_CRCDROP/M77_CRC_DROP, 
+ *        else its last char is marked TTY_FRAME. 
+ *        Must be called with the port lock held.
+ *
+ * \return 			1 if the flip buffer must be pushed, else 0
+ */
+static int men_uart_frame_end(struct ox16c954_port *up)
+{
+	struct m77_frame_info *fi;
+	unsigned int i, len = up->frmLen;
+	char flag = TTY_NORMAL;
+	u32 nsec;
+
+	if (!len)
+		return 0;
+
+	up->frmStat |= men_uart_crc_check(up);
+	up->frmLen = 0;
+
+	if (up->frmStat & M77_FRM_CRCERR)
+		up->frmCrcErr++;
+	else if (up->frmStat & M77_FRM_CRCOK)
+		up->frmCrcOk++;
+	if (up->frmStat & M77_FRM_T15)
+		up->frmT15Err++;
+
+#ifdef M77_HAS_NETDEV
+	/* network interface: the frame is a packet */
+	if (up->net) {
+		men_uart_net_rx(up, len);
+		up->frmCount++;
+		up->frmStat = up->frmLsr = 0;
+		return 0;
+	}
+#endif
+
+	if ((up->frmStat & M77_FRM_CRCERR) && 
+		((up->crcFlags & M77_CRC_DROP) || 
+		 (up->frmMode == M77_FRM_RTU && (up->rtuFlags & M77_RTU_CRCDROP)))) {
+		up->frmDropped++;
+		up->frmStat = up->frmLsr = 0;
+		return 0;
+	}
+
+#ifdef M77_HAS_BPF
+	/* receive filter: drop, truncate or pass */
+	if (up->bpfProg && !(len = men_uart_bpf_run(up, len))) {
+		up->frmStat = up->frmLsr = 0;
+		return 0;
+	}
+#endif
+
+	for (i = 0; i < len; i++) {
+		if (i == len - 1 && (up->frmStat & M77_FRM_CRCERR))
+			flag = TTY_FRAME;
+		uart_insert_char(&up->port, 0, 0, up->frmBuf[i], flag);
+	}
+
+	fi = &up->frmInfo[up->infoHead];
+	fi->len 	= len;
+	fi->flags 	= up->frmStat;
+	fi->lsr 	= up->frmLsr;
+	fi->tsSec 	= div_u64_rem(ktime_to_ns(up->frmStart), NSEC_PER_SEC, &nsec);
+	fi->tsNsec 	= nsec;
+	up->infoHead = (up->infoHead + 1) % M77_FRAME_INFO_NUM;
+	if (up->infoHead == up->infoTail) {
+		up->infoTail = (up->infoTail + 1) % M77_FRAME_INFO_NUM;
+		up->frmInfoLost++;
+	}
+
+	up->frmCount++;
+	up->frmStat = up->frmLsr = 0;
+	return 1;
+}
+
+
+/*******************************************************************/
+/** receive chars in frame mode, called within ISR or frmTimer
+ *
+ * \param up		\IN	Oxford 16C954 Port Struct
+ * \param status	\INOUT	LSR Register
+ *
+ * \brief The chars of one interrupt are collected in frmBuf. The end of
+ *        the last char is the ISR time, or for a RX timeout interrupt 
+ *        M77_RXTO_CHARS char times earlier, the chars before are assumed
+ *        back-to-back. Frames are cut when frmTimer finds the line idle for
+ *        t3.5 (the idle gap) after the last char, gaps above t1.5 within
+ *        a frame are flagged. Must be called with the port lock held.
+ *
+ * \return 			1 if the flip buffer must be pushed, else 0
+ */
+static int men_uart_frame_rx(struct ox16c954_port *up, int *status)
+{
+	ktime_t now = ktime_get(), end;
+	unsigned char ch, lsr = *status, clsr = 0, ign;
+	unsigned int n = 0, cnt = 0, i, s;
+	char flag = TTY_NORMAL;
+	s64 gap;
+	int push = 0;
+
+	do {
+		ch = serial_in(up, UART_RX);
+		up->port.icount.rx++;
+		men_uart_tap_rx(up, ch, lsr);
+		cnt++;
+
+		/* IGNBRK/IGNPAR drop the char as in receive_chars() */
+		ign = lsr & up->port.ignore_status_mask & 
+			(UART_LSR_BI | UART_LSR_PE | UART_LSR_FE);
+
+		clsr |= men_uart_lsr_count(up, lsr);
+
+		if (!ign && 
+			(!up->echoEnable || men_uart_echo_filter(up, ch, lsr, &flag)))
+			up->frmChunk[n++] = ch;
+
+		lsr = serial_in(up, UART_LSR);
+	} while ((lsr & UART_LSR_DR) && (cnt < sizeof(up->frmChunk)));
+	*status = lsr;
+
+	if (!n)
+		return 0;		/* only own echoes */
+
+	end = up->rxTimeout ? 
+		ktime_sub_ns(now, M77_RXTO_CHARS * up->charNs) : now;
+
+	if (up->frmLen) {
+		/* silence between the last frame part and the 1st char read now */
+		gap = ktime_to_ns(ktime_sub(end, up->frmLast)) - 
+			(s64)cnt * up->charNs;
+		if (gap > up->t35Ns)
+			push = men_uart_frame_end(up);	/* frmTimer came too late */
+		else if (gap > up->t15Ns)
+			up->frmStat |= M77_FRM_T15;
+	}
+
+	if (!up->frmLen) {
+		up->frmStart = ktime_sub_ns(end, (s64)cnt * up->charNs);
+		men_uart_crc_preset(up);
+	}
+
+	for (i = s = 0; i < n; i++) {
+		if (up->frmLen < M77_FRAME_MAX)
+			up->frmBuf[up->frmLen++] = up->frmChunk[i];
+		else
+			up->frmStat |= M77_FRM_TRUNC;
+
+		/* network interface: the delimiter ends a packet too */
+		if (up->net && up->frmChunk[i] == up->netDelim) {
+			men_uart_crc_update(up, &up->frmChunk[s], i + 1 - s);
+			up->frmLsr |= clsr;
+			push |= men_uart_frame_end(up);
+			up->frmStart = ktime_sub_ns(end, (s64)(n - 1 - i) * up->charNs);
+			men_uart_crc_preset(up);
+			s = i + 1;
+		}
+	}
+	men_uart_crc_update(up, &up->frmChunk[s], n - s);
+	up->frmLsr |= clsr;
+	up->frmLast = end;
+
+	hrtimer_start(&up->frmTimer, ktime_add_ns(end, up->t35Ns), 
+				  HRTIMER_MODE_ABS);
+	return push;
+}
+
+
+/*******************************************************************/
+/** frame timer, line was idle for t3.5 after the last char
+ *
+ * \param timer		\IN frmTimer of the Oxford 16C954 Port Struct
+ *
+ * \return 			HRTIMER_NORESTART
+ */
+static enum hrtimer_restart men_uart_frame_timer(struct hrtimer *timer)
+{
+	struct ox16c954_port *up = 
+		container_of(timer, struct ox16c954_port, frmTimer);
+	unsigned long flags;
+	int lsr, push = 0;
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	if (up->frmMode) {
+		lsr = serial_in(up, UART_LSR);
+		if ((lsr & UART_LSR_DR) && !up->throttled) {
+			/* chars below RX trigger, not signalled yet: frame goes on */
+			up->rxTimeout = 0;
+			push = men_uart_frame_rx(up, &lsr);
+		} else if (!ktime_before(ktime_get(), 
+								 ktime_add_ns(up->frmLast, up->t35Ns)))
+			push = men_uart_frame_end(up);
+		/* else: the ISR got chars while we waited for the lock and
+		   restarted the timer, the frame isn't over yet */
+	}
+	spin_unlock_irqrestore(&up->port.lock, flags);
+
+	if (push)
+		men_uart_rx_push(up);
+	return HRTIMER_NORESTART;
+}
+
+
+/*******************************************************************/
+/** LIN protected identifier
+ *
+ * \param id		\IN frame identifier 0..0x3f
+ *
+ * \return 			identifier with parity bits P0 (bit 6) and P1 (bit 7)
+ */
+static unsigned char men_uart_lin_pid(unsigned char id)
+{
+	unsigned char p0 = (id ^ (id >> 1) ^ (id >> 2) ^ (id >> 4)) & 1;
+	unsigned char p1 = ~((id >> 1) ^ (id >> 3) ^ (id >> 4) ^ (id >> 5)) & 1;
+
+	return (id & 0x3f) | (p0 << 6) | (p1 << 7);
+}
+
+
+/*******************************************************************/
+/** LIN checksum of a response
+ *
+ * \param e			\IN schedule table entry
+ * \param pid		\IN protected identifier
+ * \param data		\IN response data
+ *
+ * \brief Enhanced checksum (LIN 2.x, includes the PID) except for the
+ *        diagnostic frames 0x3c/0x3d and entries with M77_LIN_CLASSIC.
+ *
+ * \return 			inverted sum with carry
+ */
+static unsigned char men_uart_lin_checksum(struct m77_lin_entry *e,
+										   unsigned char pid,
+										   const unsigned char *data)
+{
+	unsigned int i, sum = 0;
+
+	if (e->id < 0x3c && !(e->flags & M77_LIN_CLASSIC))
+		sum = pid;
+
+	for (i = 0; i < e->len; i++) {
+		sum += data[i];
+		if (sum > 0xff)
+			sum -= 0xff;
+	}
+
+	return ~sum & 0xff;
+}
+
+
+/*******************************************************************/
+/** start the frame of the current schedule table entry
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param expires	\OUT end of the break, linTimer is (re)armed with it
+ *
+ * \brief Puts the break on the line and prepares the header and, for
+ *        M77_LIN_PUBLISH, the response. The response window ends at 1.4
+ *        times the nominal frame time after the break started.
+ *        Must be called with the port lock held.
+ *
+ * \return 			1 if the frame was started, 0 if LIN is stopped
+ */
+static int men_uart_lin_frame(struct ox16c954_port *up, ktime_t *expires)
+{
+	struct m77_lin_entry *e = &up->linTab[up->linIdx];
+	unsigned int bitNs, bits;
+	unsigned char pid;
+
+	if (!up->linMode || !up->linNum || !up->baud) {
+		up->linState = M77_LIN_IDLE;
+		return 0;
+	}
+	bitNs = NSEC_PER_SEC / up->baud;
+
+	pid = men_uart_lin_pid(e->id);
+	up->linTxBuf[0] = 0x55;		/* sync */
+	up->linTxBuf[1] = pid;
+	up->linTxLen = 2;
+	if (e->dir == M77_LIN_PUBLISH) {
+		memcpy(&up->linTxBuf[2], e->data, e->len);
+		up->linTxBuf[2 + e->len] = men_uart_lin_checksum(e, pid, e->data);
+		up->linTxLen += e->len + 1;
+	}
+	/* published responses are read back like the header */
+	up->linExpect 	= 2 + e->len + 1;
+	up->linRx 		= 0;
+	up->linLsr 		= 0;
+
+	up->lcr |= UART_LCR_SBC;
+	serial_out(up, UART_LCR, up->lcr);
+	up->linStart = ktime_get();
+	up->linState = M77_LIN_BRK;
+
+	/* header: break, delimiter, sync, PID; response: data, checksum */
+	bits = up->linBreak + up->linDelim + 20 + 10 * (e->len + 1);
+	up->linTmo 	= ktime_add_ns(up->linStart, (u64)bits * 14 / 10 * bitNs);
+	up->linNext = ktime_add_ns(up->linStart, (u64)e->slotUs * NSEC_PER_USEC);
+
+	*expires = ktime_add_ns(up->linStart, (u64)up->linBreak * bitNs);
+	return 1;
+}
+
+
+/*******************************************************************/
+/** check a completely received LIN frame
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \return 			M77_LIN_OK, M77_LIN_BITERR or M77_LIN_CHECKSUM
+ */
+static unsigned char men_uart_lin_check(struct ox16c954_port *up)
+{
+	struct m77_lin_entry *e = &up->linTab[up->linIdx];
+	unsigned char *rx = up->linRxBuf;
+
+	/* the header read back must be ours */
+	if (up->linLsr || memcmp(rx, up->linTxBuf, 2))
+		return M77_LIN_BITERR;
+
+	if (e->dir == M77_LIN_PUBLISH)
+		return memcmp(&rx[2], &up->linTxBuf[2], e->len + 1) ? 
+			M77_LIN_BITERR : M77_LIN_OK;
+
+	return (rx[2 + e->len] == men_uart_lin_checksum(e, rx[1], &rx[2])) ?
+		M77_LIN_OK : M77_LIN_CHECKSUM;
+}
+
+
+/*******************************************************************/
+/** complete the current LIN frame
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param status	\IN M77_LIN_OK, M77_LIN_NORESP ...
+ *
+ * \brief Queues the result and moves to the next table entry. The next
+ *        frame starts at the end of the slot (state M77_LIN_WAIT).
+ *        Must be called with the port lock held.
+ *
+ * \return 			-
+ */
+static void men_uart_lin_done(struct ox16c954_port *up, unsigned char status)
+{
+	struct m77_lin_entry *e = &up->linTab[up->linIdx];
+	struct m77_lin_result *res = &up->linRes[up->linResHead];
+	unsigned int n = (up->linRx > 2) ? up->linRx - 2 : 0;
+	u32 nsec;
+
+	if (n > e->len)
+		n = e->len;		/* without checksum */
+
+	res->id 	= e->id;
+	res->status = status;
+	res->len 	= n;
+	memcpy(res->data, &up->linRxBuf[2], n);
+	res->tsSec 	= div_u64_rem(ktime_to_ns(up->linStart), NSEC_PER_SEC, &nsec);
+	res->tsNsec = nsec;
+	up->linResHead = (up->linResHead + 1) % M77_LIN_RESULTS;
+	if (up->linResHead == up->linResTail) {
+		up->linResTail = (up->linResTail + 1) % M77_LIN_RESULTS;
+		up->linResLost++;
+	}
+
+	up->linFrames++;
+	switch (status) {
+	case M77_LIN_NORESP:
+	case M77_LIN_INCOMPLETE:
+		up->linNoResp++;
+		break;
+	case M77_LIN_CHECKSUM:
+		up->linCsErr++;
+		break;
+	case M77_LIN_BITERR:
+		up->linBitErr++;
+		break;
+	}
+
+	up->linState = M77_LIN_WAIT;
+	if (++up->linIdx >= up->linNum) {
+		up->linIdx = 0;
+		if (up->linFlags & M77_LIN_ONCE)
+			up->linState = M77_LIN_IDLE;
+	}
+}
+
+
+/*******************************************************************/
+/** receive chars in LIN master mode, called within ISR or linTimer
+ *
+ * \param up		\IN	Oxford 16C954 Port Struct
+ * \param status	\INOUT	LSR Register
+ *
+ * \brief The own break (0 with BI) and chars outside the response window
+ *        are dropped. Must be called with the port lock held.
+ *
+ * \return 			1 if the frame was completed, else 0
+ */
+static int men_uart_lin_rx(struct ox16c954_port *up, int *status)
+{
+	unsigned char ch, lsr = *status;
+	int cnt = 0;
+
+	do {
+		ch = serial_in(up, UART_RX);
+		up->port.icount.rx++;
+		men_uart_tap_rx(up, ch, lsr);
+
+		if (!(lsr & UART_LSR_BI) && up->linState == M77_LIN_RESP && 
+			up->linRx < up->linExpect) {
+			up->linRxBuf[up->linRx++] = ch;
+			up->linLsr |= lsr & (UART_LSR_PE | UART_LSR_FE | UART_LSR_OE);
+		}
+
+		lsr = serial_in(up, UART_LSR);
+	} while ((lsr & UART_LSR_DR) && (++cnt < 256));
+	*status = lsr;
+
+	if (up->linState != M77_LIN_RESP || up->linRx < up->linExpect)
+		return 0;
+
+	men_uart_lin_done(up, men_uart_lin_check(up));
+	return 1;
+}
+
+
+/*******************************************************************/
+/** LIN timer: end of break, end of delimiter, response timeout, slot end
+ *
+ * \param timer		\IN linTimer of the Oxford 16C954 Port Struct
+ *
+ * \return 			HRTIMER_RESTART while the schedule table runs
+ */
+static enum hrtimer_restart men_uart_lin_timer(struct hrtimer *timer)
+{
+	struct ox16c954_port *up = 
+		container_of(timer, struct ox16c954_port, linTimer);
+	enum hrtimer_restart ret = HRTIMER_RESTART;
+	unsigned long flags;
+	ktime_t now, expires;
+	int lsr;
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	now = ktime_get();
+
+	switch (up->linState) {
+	case M77_LIN_BRK:
+		up->lcr &= ~UART_LCR_SBC;
+		serial_out(up, UART_LCR, up->lcr);
+		up->linState = M77_LIN_DELIM;
+		hrtimer_set_expires(timer, ktime_add_ns(now, (u64)up->linDelim * 
+			(NSEC_PER_SEC / up->baud)));
+		break;
+
+	case M77_LIN_DELIM:
+		up->linState = M77_LIN_RESP;
+		men_uart_tx_buf(up, up->linTxBuf, up->linTxLen);
+		hrtimer_set_expires(timer, up->linTmo);
+		break;
+
+	case M77_LIN_RESP:
+		/* fetch chars still below the RX trigger level */
+		lsr = serial_in(up, UART_LSR);
+		if (!(lsr & UART_LSR_DR) || !men_uart_lin_rx(up, &lsr))
+			men_uart_lin_done(up, (up->linRx <= 2) ? M77_LIN_NORESP : 
+							  M77_LIN_INCOMPLETE);
+		if (up->linState != M77_LIN_WAIT) {
+			ret = HRTIMER_NORESTART;
+			break;
+		}
+		fallthrough;
+	case M77_LIN_WAIT:
+		if (ktime_before(now, up->linNext))
+			hrtimer_set_expires(timer, up->linNext);
+		else if (men_uart_lin_frame(up, &expires))
+			hrtimer_set_expires(timer, expires);
+		else
+			ret = HRTIMER_NORESTART;
+		break;
+
+	default:
+		ret = HRTIMER_NORESTART;
+		break;
+	}
+
+	spin_unlock_irqrestore(&up->port.lock, flags);
+	return ret;
+}
+
+
+/*******************************************************************/
+/** xmit buffer of another port, for bridge and group writes
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \brief Must be called with the port lock held.
+ *
+ * \return 			xmit circ_buf, NULL if the port is closed
+ */
+static struct circ_buf *men_uart_port_xmit(struct ox16c954_port *up)
+{
+	struct circ_buf *xmit;
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,32)
+	xmit = up->port.info ? &up->port.info->xmit : NULL;
+#else
+	xmit = up->port.state ? &up->port.state->xmit : NULL;
+#endif
+	return (xmit && xmit->buf) ? xmit : NULL;
+}
+
+
+/*******************************************************************/
+/** copy chars into a xmit buffer
+ *
+ * \param xmit		\IN xmit circ_buf of the port
+ * \param buf		\IN chars
+ * \param cnt		\IN number of chars
+ *
+ * \brief TX is not started. Must be called with the port lock held.
+ *
+ * \return 			number of chars copied, less if xmit is full
+ */
+static unsigned int men_uart_xmit_put(struct circ_buf *xmit,
+									  const unsigned char *buf,
+									  unsigned int cnt)
+{
+	unsigned int n = 0, c;
+
+	while (n < cnt) {
+		c = CIRC_SPACE_TO_END(xmit->head, xmit->tail, UART_XMIT_SIZE);
+		if (c > cnt - n)
+			c = cnt - n;
+		if (!c)
+			break;
+		memcpy(xmit->buf + xmit->head, buf + n, c);
+		xmit->head = (xmit->head + c) & (UART_XMIT_SIZE - 1);
+		n += c;
+	}
+	return n;
+}
+
+
+/*******************************************************************/
+/** put received chars into the xmit buffer of the bridge peer
+ *
+ * \param peer		\IN Oxford 16C954 Port Struct of the peer
+ * \param buf		\IN received chars
+ * \param cnt		\IN number of chars, 0 to get the room only
+ * \param room		\OUT free xmit space, UART_XMIT_SIZE if peer is closed
+ *
+ * \brief Takes the port lock of the peer, so the lock of the receiving
+ *        port must not be held: two bridged ports receiving at the same
+ *        time would deadlock otherwise. The peer's FIFO is loaded right
+ *        away if its transmitter has room.
+ *
+ * \return 			number of chars taken
+ */
+static unsigned int men_uart_bridge_tx(struct ox16c954_port *peer,
+									   const unsigned char *buf,
+									   unsigned int cnt,
+									   unsigned int *room)
+{
+	struct circ_buf *xmit;
+	unsigned long flags;
+	unsigned int n = 0;
+
+	spin_lock_irqsave(&peer->port.lock, flags);
+	xmit = men_uart_port_xmit(peer);
+	if (!xmit) {
+		/* peer closed: chars are lost, but RX is not held for it */
+		*room = UART_XMIT_SIZE;
+		goto tx_out;
+	}
+
+	n = men_uart_xmit_put(xmit, buf, cnt);
+	if (n)
+		men_uart_oob_kick(peer);
+	*room = uart_circ_chars_free(xmit);
+
+ tx_out:
+	spin_unlock_irqrestore(&peer->port.lock, flags);
+	return n;
+}
+
+
+/*******************************************************************/
+/** hold the RX of a bridged port until the peer has room again
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \brief Same as men_uart_throttle(): the FIFO is not drained any more,
+ *        at FCH the UART drops RTS or sends XOFF if flow control is set
+ *        with termios. brgTimer polls the peer meanwhile.
+ *        Must be called with the port lock held.
+ *
+ * \return 			-
+ */
+static void men_uart_bridge_hold(struct ox16c954_port *up)
+{
+	u64 ns = (u64)M77_BRIDGE_POLL_CHARS * up->brgPeer->charNs;
+
+	if (up->brgHeld)
+		return;
+
+	up->brgHeld = 1;
+	up->brgHolds++;
+	if (!up->throttled) {
+		up->throttled = up->ier & (UART_IER_RDI | UART_IER_RLSI);
+		up->ier &= ~(UART_IER_RDI | UART_IER_RLSI);
+		serial_out(up, UART_IER, up->ier);
+	}
+	hrtimer_start(&up->brgTimer, ns_to_ktime(ns ? ns : NSEC_PER_MSEC), 
+				  HRTIMER_MODE_REL);
+}
+
+
+/*******************************************************************/
+/** release the RX of a bridged port
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \brief Must be called with the port lock held.
+ *
+ * \return 			-
+ */
+static void men_uart_bridge_release(struct ox16c954_port *up)
+{
+	if (!up->brgHeld)
+		return;
+
+	up->brgHeld = 0;
+	if (up->throttled) {
+		up->ier |= up->throttled;
+		up->throttled = 0;
+		serial_out(up, UART_IER, up->ier);
+	}
+}
+
+
+/*******************************************************************/
+/** bridge timer, checks if the peer has room for held RX chars
+ *
+ * \param timer		\IN brgTimer of the Oxford 16C954 Port Struct
+ *
+ * \brief RX is released when half of the peer's xmit buffer is free.
+ *
+ * \return 			HRTIMER_RESTART while RX is held
+ */
+static enum hrtimer_restart men_uart_bridge_timer(struct hrtimer *timer)
+{
+	struct ox16c954_port *up = 
+		container_of(timer, struct ox16c954_port, brgTimer);
+	enum hrtimer_restart ret = HRTIMER_NORESTART;
+	struct ox16c954_port *peer;
+	unsigned int room = UART_XMIT_SIZE;
+	unsigned long flags;
+	u64 ns;
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	peer = up->brgHeld ? up->brgPeer : NULL;
+	spin_unlock_irqrestore(&up->port.lock, flags);
+
+	/* one port lock at a time, see men_uart_bridge_tx() */
+	if (peer)
+		men_uart_bridge_tx(peer, NULL, 0, &room);
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	if (up->brgHeld) {
+		up->brgRoom = room;
+		if (room >= UART_XMIT_SIZE / 2) {
+			men_uart_bridge_release(up);
+		} else {
+			ns = (u64)M77_BRIDGE_POLL_CHARS * up->brgPeer->charNs;
+			hrtimer_forward_now(timer, ns_to_ktime(ns ? ns : NSEC_PER_MSEC));
+			ret = HRTIMER_RESTART;
+		}
+	}
+	spin_unlock_irqrestore(&up->port.lock, flags);
+	return ret;
+}
+
+
+/*******************************************************************/
+/** remove the bridge of a port, and the way back if bidirectional
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \brief Held RX is released. Called from process context only.
+ *
+ * \return 			-
+ */
+static void men_uart_bridge_unlink(struct ox16c954_port *up)
+{
+	struct ox16c954_port *peer;
+	unsigned long flags;
+
+	spin_lock(&m77_bridge_lock);
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	peer = (up->brgFlags & M77_BRIDGE_BIDIR) ? up->brgPeer : NULL;
+	up->brgPeer = NULL;
+	men_uart_bridge_release(up);
+	spin_unlock_irqrestore(&up->port.lock, flags);
+
+	if (peer) {
+		spin_lock_irqsave(&peer->port.lock, flags);
+		if (peer->brgPeer == up) {
+			peer->brgPeer = NULL;
+			men_uart_bridge_release(peer);
+		}
+		spin_unlock_irqrestore(&peer->port.lock, flags);
+	}
+
+	spin_unlock(&m77_bridge_lock);
+}
+
+
+/*******************************************************************/
+/** remove the bridges of a port that is closed
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \brief Besides its own bridge, unidirectional bridges of other ports
+ *        into this one are removed, their RX would be dropped else.
+ *        Called from process context only.
+ *
+ * \return 			-
+ */
+static void men_uart_bridge_close(struct ox16c954_port *up)
+{
+	struct ox16c954_port *p;
+	unsigned long flags;
+	unsigned int i;
+
+	men_uart_bridge_unlink(up);
+
+	spin_lock(&m77_bridge_lock);
+	for (i = 0; i < MAX_SNGL_UARTS; i++) {
+		p = &men_uart_ports[i];
+		spin_lock_irqsave(&p->port.lock, flags);
+		if (p->brgPeer == up) {
+			p->brgPeer = NULL;
+			men_uart_bridge_release(p);
+		}
+		spin_unlock_irqrestore(&p->port.lock, flags);
+	}
+	spin_unlock(&m77_bridge_lock);
+}
+
+
+/*******************************************************************/
+/** receive chars of a bridged port, called within ISR
+ *
+ * \param up		\IN	Oxford 16C954 Port Struct
+ * \param status	\INOUT	LSR Register
+ *
+ * \brief The chars are read into frmChunk (frame mode is off while 
+ *        bridged) and put into the peer's xmit buffer, nothing goes to
+ *        the tty. Errors are counted only, the chars are passed as they
+ *        are. With M77_BRIDGE_FLOW no more chars are read than the peer
+ *        had room for, and RX is held when it falls below a FIFO size.
+ *        Must be called with the port lock held, it is dropped meanwhile.
+ *
+ * \return 			-
+ */
+static void men_uart_bridge_rx(struct ox16c954_port *up, int *status)
+{
+	struct ox16c954_port *peer = up->brgPeer;
+	unsigned char lsr = *status;
+	unsigned int cnt = 0, n = 0, max = sizeof(up->frmChunk);
+	unsigned int room = up->brgRoom;
+
+	if ((up->brgFlags & M77_BRIDGE_FLOW) && room < max)
+		max = room;
+
+	while ((lsr & UART_LSR_DR) && cnt < max) {
+		up->frmChunk[cnt++] = serial_in(up, UART_RX);
+		up->port.icount.rx++;
+		men_uart_tap_rx(up, up->frmChunk[cnt - 1], lsr);
+
+		men_uart_lsr_count(up, lsr);
+		lsr = serial_in(up, UART_LSR);
+	}
+	*status = lsr;
+
+	if (cnt) {
+		spin_unlock(&up->port.lock);
+		n = men_uart_bridge_tx(peer, up->frmChunk, cnt, &room);
+		spin_lock(&up->port.lock);
+	}
+	up->brgFwd 		+= n;
+	up->brgDropped 	+= cnt - n;
+
+	/* bridge removed meanwhile */
+	if (up->brgPeer != peer)
+		return;
+
+	up->brgRoom = room;
+	if ((up->brgFlags & M77_BRIDGE_FLOW) && room < up->port.fifosize)
+		men_uart_bridge_hold(up);
+}
+
+
+/*******************************************************************/
+/** receive chars of a port attached to the control device, within ISR
+ *
+ * \param up		\IN	Oxford 16C954 Port Struct
+ * \param status	\INOUT	LSR Register
+ *
+ * \brief The chars go into batchBuf instead of the tty and are read with
+ *        M77_BATCH_IO. Chars not fitting are counted as buf_overrun.
+ *        Must be called with the port lock held.
+ *
+ * \return 			-
+ */
+static void men_uart_batch_rx(struct ox16c954_port *up, int *status)
+{
+	unsigned char ch, lsr = *status;
+	int max_count = 256;
+
+	do {
+		ch = serial_in(up, UART_RX);
+		up->port.icount.rx++;
+		men_uart_tap_rx(up, ch, lsr);
+
+		men_uart_lsr_count(up, lsr);
+
+		if (CIRC_SPACE(up->batchHead, up->batchTail, M77_BATCH_RING)) {
+			up->batchBuf[up->batchHead] = ch;
+			up->batchHead = (up->batchHead + 1) & (M77_BATCH_RING - 1);
+		} else
+			up->port.icount.buf_overrun++;
+
+		lsr = serial_in(up, UART_LSR);
+	} while ((lsr & UART_LSR_DR) && (max_count-- > 0));
+	*status = lsr;
+
+	wake_up_interruptible(&m77_batch_wait);
+}
+
+
+/*******************************************************************/
+/** receive chars in raw mode, called within ISR
+ *
+ * \param up		\IN	Oxford 16C954 Port Struct
+ * \param status	\INOUT	LSR Register
+ *
+ * \brief The chars of one interrupt go into the mapped ring, with 
+ *        M77_RAW_CHUNKS as one record with the time of the 1st char (as
+ *        in frame mode) and the LSR errors. A chunk not fitting is lost
+ *        completely. Must be called with the port lock held.
+ *
+ * \return 			-
+ */
+static void men_uart_raw_rx(struct ox16c954_port *up, int *status)
+{
+	struct m77_raw_ring *ring = up->rawRing;
+	unsigned char lsr = *status, clsr = 0;
+	struct m77_raw_chunk ch;
+	unsigned int cnt = 0, used, need, nsec;
+	ktime_t now = ktime_get(), start;
+
+	do {
+		up->frmChunk[cnt++] = serial_in(up, UART_RX);
+		up->port.icount.rx++;
+		men_uart_tap_rx(up, up->frmChunk[cnt - 1], lsr);
+
+		men_uart_lsr_count(up, lsr);
+		clsr |= lsr & M77_LSR_ERRORS;
+		lsr = serial_in(up, UART_LSR);
+	} while ((lsr & UART_LSR_DR) && (cnt < sizeof(up->frmChunk)));
+	*status = lsr;
+
+	need = cnt;
+	if (up->rawFlags & M77_RAW_CHUNKS)
+		need = sizeof(ch) + ALIGN(cnt, 4);
+
+	/* the reader owns tail, don't trust it further than needed */
+	used = up->rawHead - READ_ONCE(ring->tail);
+	if (used > up->rawMask + 1 || need > up->rawMask + 1 - used) {
+		ring->lost += cnt;
+		up->port.icount.buf_overrun += cnt;
+		return;
+	}
+
+	if (up->rawFlags & M77_RAW_CHUNKS) {
+		start = up->rxTimeout ? 
+			ktime_sub_ns(now, M77_RXTO_CHARS * up->charNs) : now;
+		start = ktime_sub_ns(start, (s64)cnt * up->charNs);
+		memset(&ch, 0, sizeof(ch));
+		ch.tsSec 	= div_u64_rem(ktime_to_ns(start), NSEC_PER_SEC, &nsec);
+		ch.tsNsec 	= nsec;
+		ch.len 		= cnt;
+		ch.lsr 		= clsr;
+		men_uart_ring_put(up->rawData, up->rawMask, &up->rawHead, 
+						  &ch, sizeof(ch));
+	}
+	men_uart_ring_put(up->rawData, up->rawMask, &up->rawHead, 
+					  up->frmChunk, cnt);
+	if (up->rawFlags & M77_RAW_CHUNKS)
+		up->rawHead = ALIGN(up->rawHead, 4);	/* padding */
+
+	/* data before head */
+	smp_wmb();
+	WRITE_ONCE(ring->head, up->rawHead);
+	wake_up_interruptible(&up->rawWait);
+}
+
+
+/*******************************************************************/
+/** receive chars of a channel owned by an in-kernel client, within ISR
+ *
+ * \param up		\IN	Oxford 16C954 Port Struct
+ * \param status	\INOUT	LSR Register
+ *
+ * \brief The chars of one interrupt are passed to receive_buf with the
+ *        port lock dropped, so it can write. Chars not taken are counted
+ *        as buf_overrun. Must be called with the port lock held.
+ *
+ * \return 			-
+ */
+static void men_uart_kcli_rx(struct ox16c954_port *up, int *status)
+{
+	struct m77_kclient *kc = up->kcli;
+	unsigned char lsr = *status;
+	unsigned int cnt = 0;
+	int n;
+
+	do {
+		up->frmChunk[cnt++] = serial_in(up, UART_RX);
+		up->port.icount.rx++;
+		men_uart_tap_rx(up, up->frmChunk[cnt - 1], lsr);
+
+		men_uart_lsr_count(up, lsr);
+		lsr = serial_in(up, UART_LSR);
+	} while ((lsr & UART_LSR_DR) && (cnt < sizeof(up->frmChunk)));
+	*status = lsr;
+
+	/* m77_kclient_close() waits until we are out */
+	up->kcInCb = 1;
+	spin_unlock(&up->port.lock);
+	n = kc->receive_buf(kc, up->frmChunk, cnt);
+	spin_lock(&up->port.lock);
+	up->kcInCb = 0;
+	/* kcli cleared: m77_kclient_close() waits for us */
+	if (!up->kcli)
+		wake_up(&up->kcWait);
+
+	if (n >= 0 && n < cnt)
+		up->port.icount.buf_overrun += cnt - n;
+}
+
+
+/*******************************************************************/
+/** call write_wakeup of an in-kernel client, within ISR
+ *
+ * \param up		\IN	Oxford 16C954 Port Struct
+ *
+ * \brief Due when transmit_chars() drained the client's buffer. Called 
+ *        after the port was served, with the port lock released, so the
+ *        client can refill it with m77_kclient_write().
+ *
+ * \return 			-
+ */
+static inline void men_uart_kcli_wakeup(struct ox16c954_port *up)
+{
+	struct m77_kclient *kc;
+
+	if (likely(!up->kcWake))
+		return;
+
+	spin_lock(&up->port.lock);
+	kc = up->kcli;
+	up->kcWake = 0;
+	if (kc)
+		up->kcInCb = 1;		/* m77_kclient_close() waits until we are out */
+	spin_unlock(&up->port.lock);
+	if (!kc)
+		return;
+
+	kc->write_wakeup(kc);
+
+	spin_lock(&up->port.lock);
+	up->kcInCb = 0;
+	if (!up->kcli)
+		wake_up(&up->kcWait);
+	spin_unlock(&up->port.lock);
+}
+
+
+/*******************************************************************/
+/** queue the time stamp of the chars of one RX interrupt
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param entry		\IN time taken before the FIFO was drained
+ * \param cnt		\IN chars drained
+ * \param n			\IN chars of them passed to the tty
+ * \param lsr		\IN LSR errors of the chars
+ *
+ * \brief The chars which arrived while draining are no part of the FIFO
+ *        level at entry, so the level is cnt minus the drain time in char
+ *        times. The 1st char started level char times before entry (and
+ *        before the RX timeout). The oldest stamp is overwritten when the
+ *        queue is full. Must be called with the port lock held.
+ *
+ * \return 			-
+ */
+static void men_uart_rxts_put(struct ox16c954_port *up, ktime_t entry,
+							  unsigned int cnt, unsigned int n,
+							  unsigned char lsr)
+{
+	struct m77_rxts *ts = &up->rxts[up->rxtsHead];
+	unsigned int late = 0, nsec;
+	ktime_t start;
+
+	if (up->charNs)
+		late = div_u64(ktime_to_ns(ktime_sub(ktime_get(), entry)), 
+					   up->charNs);
+	cnt = (late < cnt) ? cnt - late : 1;
+
+	start = up->rxTimeout ? 
+		ktime_sub_ns(entry, M77_RXTO_CHARS * up->charNs) : entry;
+	start = ktime_sub_ns(start, (s64)cnt * up->charNs);
+
+	ts->tsSec 	= div_u64_rem(ktime_to_ns(start), NSEC_PER_SEC, &nsec);
+	ts->tsNsec 	= nsec;
+	ts->pos 	= up->rxtsPos;
+	ts->len 	= n;
+	ts->lsr 	= lsr;
+	up->rxtsPos += n;
+
+	up->rxtsHead = (up->rxtsHead + 1) % M77_RXTS_NUM;
+	if (up->rxtsHead == up->rxtsTail) {
+		up->rxtsTail = (up->rxtsTail + 1) % M77_RXTS_NUM;
+		up->rxtsLost++;
+	}
+}
+
+
+/*******************************************************************/
+/** receive chars function, called within ISR
+ *
+ * \param up			\IN		Oxford 16C954 Port Struct
+ * \param status		\OUT	new Value of LSR Register
+ * \param regs			\IN		pt_regs parameter from ISR (unused)
+ *
+ * \return 			-
+ */
+static inline void
+receive_chars(struct ox16c954_port *up, int *status, struct pt_regs *regs)
+{
+	unsigned char ch, lsr = *status, clsr = 0;
+	int max_count = 256;
+	char flag;
+	int delimSeen = up->rxPushNow;
+	unsigned int cnt = 0, n = 0;
+	ktime_t entry = ktime_set(0, 0);
+
+	up->rxPushNow = 0;
+
+	/* echoes overdue (e.g. lost by an overrun): forget them */
+	if (up->echoEnable && up->echoHead != up->echoTail && 
+		ktime_after(ktime_get(), up->echoDeadline)) {
+		up->echoLost += (up->echoHead - up->echoTail) & (M77_ECHO_SIZE - 1);
+		up->echoTail = up->echoHead;
+	}
+
+	/* LIN master: chars belong to the running frame */
+	if (up->linMode) {
+		if (men_uart_lin_rx(up, status) && up->linState == M77_LIN_WAIT)
+			hrtimer_start(&up->linTimer, up->linNext, HRTIMER_MODE_ABS);
+		return;
+	}
+
+	/* in-kernel client: chars go to its receive_buf, a network interface
+	   gets them through the frame receive engine */
+	if (up->kcli && !up->net) {
+		men_uart_kcli_rx(up, status);
+		return;
+	}
+
+	/* raw mode: chars go into the mapped ring of a /dev/m77ctl file */
+	if (up->rawRing) {
+		men_uart_raw_rx(up, status);
+		return;
+	}
+
+	/* attached to the control device: read with M77_BATCH_IO */
+	if (up->batchBuf) {
+		men_uart_batch_rx(up, status);
+		return;
+	}
+
+	/* bridge: chars go to the peer port, not to the tty */
+	if (up->brgPeer) {
+		men_uart_bridge_rx(up, status);
+		return;
+	}
+
+	/* frame mode: pass up complete frames only */
+	if (up->frmMode) {
+		if (men_uart_frame_rx(up, status)) {
+			spin_unlock(&up->port.lock);
+			men_uart_rx_push(up);
+			spin_lock(&up->port.lock);
+		}
+		return;
+	}
+
+	/* as close to the ISR entry as possible, before the FIFO drains */
+	if (up->rxtsOn)
+		entry = ktime_get();
+
+	do {
+		ch = serial_in(up, UART_RX);
+		flag = TTY_NORMAL;
+		up->port.icount.rx++;
+		men_uart_tap_rx(up, ch, lsr);
+		cnt++;
+
+		if (up->mdEnable) {
+			if (!men_uart_md_filter(up, ch, lsr))
+				goto ignore_char;
+			lsr &= ~M77_LSR_9BIT;	/* 9th bit, not a parity error */
+		}
+
+		if (up->echoEnable && !men_uart_echo_filter(up, ch, lsr, &flag))
+			goto ignore_char;
+
+		if (unlikely(lsr & M77_LSR_ERRORS)) {
+			clsr |= lsr & M77_LSR_ERRORS;
+			/*
+			 * For statistics only
+			 */
+			men_uart_lsr_count(up, lsr);
+			if (lsr & UART_LSR_BI) {
+				lsr &= ~(UART_LSR_FE | UART_LSR_PE);
+				/*
+				 * We do the SysRQ and SAK checking
+				 * here because otherwise the break
+				 * may get masked by ignore_status_mask
+				 * or read_status_mask.
+				 */
+				if (uart_handle_break(&up->port))
+					goto ignore_char;
+			}
+
+			/*
+			 * Mask off conditions which should be ignored.
+			 */
+			lsr &= up->port.read_status_mask;
+
+			if (lsr & UART_LSR_BI) {
+				DEBUG_INTR("handling break....");
+				flag = TTY_BREAK;
+			} else if (lsr & UART_LSR_PE)
+				flag = TTY_PARITY;
+			else if (lsr & UART_LSR_FE)
+				flag = TTY_FRAME;
+		}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,19)
+		if (uart_handle_sysrq_char(&up->port, ch, regs))
+#else
+		if (uart_handle_sysrq_char(&up->port, ch))
+#endif
+			goto ignore_char;
+
+		uart_insert_char(&up->port, lsr, UART_LSR_OE, ch, flag);
+		n++;
+		if (ch == up->delim)
+			delimSeen = 1;
+
+	ignore_char:
+		lsr = serial_in(up, UART_LSR);
+	} while ((lsr & UART_LSR_DR) && (max_count-- > 0));
+	*status = lsr;
+
+	if (up->rxtsOn && n)
+		men_uart_rxts_put(up, entry, cnt, n, clsr);
+
+	/* delimiter mode: wake up the reader on frame end or line idle only */
+	if (up->delimEnable) {
+		if (!delimSeen) {
+			hrtimer_start(&up->rxTimer, 
+						  ns_to_ktime((u64)up->delimIdleUs * NSEC_PER_USEC),
+						  HRTIMER_MODE_REL);
+			return;
+		}
+		hrtimer_try_to_cancel(&up->rxTimer);
+		up->delimFrames++;
+	}
+
+	spin_unlock(&up->port.lock);
+	men_uart_rx_push(up);
+	spin_lock(&up->port.lock);
+}
+
+/* modem status read at ISR entry, before the RX FIFO is drained */
+struct men_uart_msr_stamp {
+	unsigned int			msr;
+	ktime_t					t;		/* for the event queue			*/
+#ifdef M77_HAS_PPS
+	struct pps_event_time	pps;	/* DCD edge						*/
+#endif
+};
+
+/*******************************************************************/
+/** queue a modem status event, within ISR
+ *
+ * \param up			\IN Oxford 16C954 Port Struct
+ * \param st			\IN MSR with the deltas and its time
+ *
+ * \brief The oldest event is overwritten when the queue is full.
+ *
+ * \return 			-
+ */
+static void men_uart_msr_put(struct ox16c954_port *up,
+							 const struct men_uart_msr_stamp *st)
+{
+	struct m77_msr_event *ev = &up->msrEv[up->msrHead];
+	unsigned int nsec;
+
+	ev->tsSec 	= div_u64_rem(ktime_to_ns(st->t), NSEC_PER_SEC, &nsec);
+	ev->tsNsec 	= nsec;
+	ev->msr 	= st->msr;
+
+	up->msrHead = (up->msrHead + 1) % M77_MSR_NUM;
+	if (up->msrHead == up->msrTail) {
+		up->msrTail = (up->msrTail + 1) % M77_MSR_NUM;
+		up->msrLost++;
+	}
+}
+
+/*******************************************************************/
+/** read MSR and time stamp its changes, 1st thing in the ISR
+ *
+ * \param up			\IN Oxford 16C954 Port Struct
+ * \param st			\OUT MSR and time stamps
+ *
+ * \return 			-
+ */
+static inline void men_uart_msr_stamp(struct ox16c954_port *up,
+									  struct men_uart_msr_stamp *st)
+{
+	st->msr = serial_in(up, UART_MSR);
+	if (!(st->msr & UART_MSR_ANY_DELTA))
+		return;
+
+#ifdef M77_HAS_PPS
+	/* 1st thing on a DCD change: the PPS time stamp */
+	if (up->pps && (st->msr & UART_MSR_DDCD))
+		pps_get_ts(&st->pps);
+#endif
+	if (up->msrOn)
+		st->t = ktime_get();
+}
+
+
+/*******************************************************************/
+/** check_modem_status Bits
+ *
+ * \param up			\IN Oxford 16C954 Port Struct
+ * \param st			\IN MSR read at ISR entry, see men_uart_msr_stamp()
+ *
+ * \brief Deltas get_mctrl() read before count for the tty only, their
+ *        time is unknown: no PPS and modem status events from them.
+ *
+ * \return 			-
+ */
+static inline void check_modem_status(struct ox16c954_port *up,
+									  struct men_uart_msr_stamp *st)
+{
+	int status;
+#ifdef M77_HAS_PPS
+	int assert;
+#endif
+
+	status = st->msr | up->msrSaved;
+	up->msrSaved = 0;
+
+	if ((status & UART_MSR_ANY_DELTA) == 0)
+		return;
+
+#ifdef M77_HAS_PPS
+	if (up->pps && (st->msr & UART_MSR_DDCD)) {
+		assert = !(st->msr & UART_MSR_DCD) == 
+			!!(up->msrFlags & M77_MSR_PPS_CLEAR);
+		pps_event(up->pps, &st->pps, 
+				  assert ? PPS_CAPTUREASSERT : PPS_CAPTURECLEAR, NULL);
+	}
+#endif
+	if (up->msrOn && (st->msr & UART_MSR_ANY_DELTA))
+		men_uart_msr_put(up, st);
+
+	if (status & UART_MSR_TERI)
+		up->port.icount.rng++;
+	if (status & UART_MSR_DDSR)
+		up->port.icount.dsr++;
+	if (status & UART_MSR_DDCD)
+		uart_handle_dcd_change(&up->port, status & UART_MSR_DCD);
+	if (status & UART_MSR_DCTS)
+		uart_handle_cts_change(&up->port, status & UART_MSR_CTS);
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,32)
+	wake_up_interruptible(&up->port.info->delta_msr_wait);
+#else
+	wake_up_interruptible(&up->port.state->port.delta_msr_wait);
+#endif
+}
+
+
+/*******************************************************************/
+/** modem status interrupts needed by the port
+ *
+ * \param up			\IN Oxford 16C954 Port Struct
+ * \param cflag			\IN termios c_cflag
+ *
+ * \return 			1 if IER MSI must be set
+ */
+static inline int men_uart_want_ms(struct ox16c954_port *up, 
+								   unsigned int cflag)
+{
+	if (up->bugs & UART_BUG_NOMSR)
+		return 0;
+	return UART_ENABLE_MS(&up->port, cflag) || up->msrOn || 
+		(up->msrFlags & M77_MSR_PPS);
+}
+
+
+/*******************************************************************/
+/** handle a XOFF/special character interrupt (IIR = 0x10), within ISR
+ *
+ * \param up			\IN Oxford 16C954 Port Struct
+ *
+ * \brief Reading the IIR already cleared the interrupt. With in-band flow
+ *        control active the UART has stopped its transmitter by itself.
+ *
+ * \return 			-
+ */
+static inline void men_uart_special_char(struct ox16c954_port *up)
+{
+	if (up->delimEnable) {
+		/* frame delimiter arrived, drain and push now */
+		up->rxPushNow = 1;
+		return;
+	}
+
+	/*
+	 * our station address was seen. Without HWGATE the FIFO may still 
+	 * hold chars of a foreign frame ahead of it, men_uart_md_filter()
+	 * finds the address in order. With HWGATE the receiver was off, the
+	 * FIFO has nothing before the frame: open the receiver for it.
+	 */
+	if (up->mdEnable) {
+		if (up->acr & UART_ACR_RXDIS) {
+			up->mdAddressed = 1;
+			up->acr &= ~UART_ACR_RXDIS;
+			up->acrShadow = up->acr;
+			serial_icr_write(up, UART_ACR, up->acr);
+		}
+		return;
+	}
+
+	if (up->iflag & IXON)
+		up->xoffCount++;
+}
+
+
+/*******************************************************************/
+/** handles the interrupt from one port, within ISR
+ *
+ * \param up		\IN 	Oxford 16C954 Port Struct
+ * \param iir		\IN 	IIR value read by the ISR
+ * \param regs		\IN 	passed from ISR but unused
+ *
+ * \return 			-
+ */
+static inline void men_uart_handle_port(struct ox16c954_port *up, 
+										unsigned int iir,
+										struct pt_regs *regs)
+{
+	struct men_uart_msr_stamp msr;
+	unsigned int status;
+
+	/* DCD edges are stamped before up to 256 RX chars are drained */
+	men_uart_msr_stamp(up, &msr);
+	status = serial_in(up, UART_LSR);
+
+	DEBUG_INTR("status = %x...", status);
+
+	if ((iir & M77_IIR_ID_MASK) == M77_IIR_SPECIAL)
+		men_uart_special_char(up);
+	up->rxTimeout = (iir & M77_IIR_ID_MASK) == UART_IIR_RX_TIMEOUT;
+
+	if ((status & UART_LSR_DR) && !up->throttled) {
+		receive_chars(up, &status, regs);
+		if (M77_TAP_ACTIVE(up) && up->tapCnt) {
+			men_uart_tap_rec(up, M77_TAP_RX, up->tapLsr, up->tapBuf,
+							 up->tapCnt, NULL, 0);
+			up->tapCnt = 0;
+			up->tapLsr = 0;
+		}
+	} else if (up->rxPushNow) {
+		/* delimiter already drained by an earlier RX interrupt */
+		up->rxPushNow = 0;
+		spin_unlock(&up->port.lock);
+		men_uart_rx_push(up);
+		spin_lock(&up->port.lock);
+	}
+
+	check_modem_status(up, &msr);
+
+	if (status & UART_LSR_THRE)
+		transmit_chars(up);
+}
+
+
+
+/*******************************************************************/
+/** register window of one channel of a M-Module
+ *
+ * \param mod		\IN  per-module struct of M-Module data
+ * \param nrChan	\IN  channel on the M-Module
+ *
+ * \return 			address of UART register 0
+ */
+static void *men_uart_chan_base(UARTMOD_INFO *mod, unsigned int nrChan)
+{
+	void *baseAdr = mod->memBase + (0x10 * nrChan);
+
+	/* correct M45N Adress Gap between chan. 0-3 and 4-7 */
+	if ( (mod->modtype == MOD_M45 ) && (nrChan > 3) )
+		baseAdr+=0x40;
+	return baseAdr;
+}
+
+
+#ifdef M77_HAS_UIO
+/*******************************************************************/
+/** interrupt of a M-Module handed to userspace
+ *
+ * \param mmod		\IN  per-module struct of M-Module data
+ *
+ * \brief The UARTs keep their interrupt asserted until userspace served
+ *        them, so the CPLD interrupt is masked and the pending bit 
+ *        cleared. Writing 1 to /dev/uioN unmasks it again.
+ *
+ * \return 			1 if the M-Module interrupted, else 0
+ */
+static int men_uart_uio_irq(UARTMOD_INFO *mmod)
+{
+	unsigned char ir, ir2 = 0;
+
+	ir = MREAD_D16(mmod->memBase, M77_REG_IR) & 0x00ff;
+	if (mmod->modtype == MOD_M45)
+		ir2 = MREAD_D16(mmod->memBase, M45_REG_IR2) & 0x00ff;
+	if (!((ir | ir2) & M77_IR_IRQ) || !mmod->uioOn)
+		return 0;
+
+	control_out(mmod->memBase, M77_REG_IR, ir & ~M77_IR_IMASK);
+	if (mmod->modtype == MOD_M45)
+		control_out(mmod->memBase, M45_REG_IR2, ir2 & ~M77_IR_IMASK);
+
+	uio_event_notify(&mmod->uioInfo);
+	return 1;
+}
+
+
+/*******************************************************************/
+/** mask or unmask the interrupt of a M-Module, write() to /dev/uioN
+ *
+ * \param info		\IN UIO device of the M-Module
+ * \param irq_on	\IN 1: unmask, 0: mask
+ *
+ * \return 			0
+ */
+static int men_uart_uio_irqcontrol(struct uio_info *info, s32 irq_on)
+{
+	UARTMOD_INFO *mmod = info->priv;
+	unsigned char ir = irq_on ? M77_IR_IMASK : 0;
+
+	/* keep the galvanic isolated drivers of the M77 on */
+	if (mmod->modtype == MOD_M77)
+		ir |= M77_IR_DRVEN;
+
+	control_out(mmod->memBase, M77_REG_IR, ir);
+	if (mmod->modtype == MOD_M45)
+		control_out(mmod->memBase, M45_REG_IR2, ir);
+	return 0;
+}
+
+
+/*******************************************************************/
+/** hand the M-Modules passed with uio=1 to userspace
+ *
+ * \param parent	\IN device the UIO devices are put under, or NULL
+ *
+ * \brief MDIS gives the ioremapped register window only, so the
+ *        physical address for the mmap() of /dev/uioN is passed with
+ *        uioaddr=. mmap() maps whole pages: a Module is refused if its
+ *        window doesn't start a page or another Module of the driver is
+ *        in that page. MDIS maps the slots of a carrier through one
+ *        window, so the distance of two ioremapped bases on the same
+ *        carrier is their distance on the bus. A refused Module gets
+ *        its ttys instead (see \ref uio).
+ *
+ * \return 			-
+ */
+static void men_uart_uio_register(struct device *parent)
+{
+	UARTMOD_INFO *mmod, *other;
+	struct uio_info *info;
+	phys_addr_t phys;
+	long dist;
+	int shared;
+
+	list_for_each_entry(mmod, &G_uartModListHead, head) {
+		if (!mmod->uio)
+			continue;
+		phys = mmod->uioPhys;
+		if (!phys) {
+			printk(KERN_ERR "*** %s: no uioaddr given\n", mmod->deviceName);
+			goto ttys;
+		}
+
+		shared = offset_in_page(phys) != 0;
+		list_for_each_entry(other, &G_uartModListHead, head) {
+			if (other == mmod)
+				continue;
+			if (other->uio && other->uioPhys && 
+				(other->uioPhys >> PAGE_SHIFT) == (phys >> PAGE_SHIFT))
+				shared = 1;
+			dist = (char *)other->memBase - (char *)mmod->memBase;
+			if (!strcmp(other->brdName, mmod->brdName) && 
+				dist > -(long)PAGE_SIZE && dist < (long)PAGE_SIZE)
+				shared = 1;
+		}
+		if (shared) {
+			printk(KERN_ERR "*** %s: register window not alone in its "
+				   "page\n", mmod->deviceName);
+			goto ttys;
+		}
+
+		info = &mmod->uioInfo;
+		info->name 				= mmod->deviceName;
+		info->version 			= IdentString;
+		info->mem[0].name 		= "registers";
+		info->mem[0].addr 		= phys;
+		info->mem[0].offs 		= 0;
+		info->mem[0].size 		= PAGE_SIZE;
+		info->mem[0].memtype 	= UIO_MEM_PHYS;
+		info->mem[0].internal_addr = mmod->memBase;
+		info->irq 				= UIO_IRQ_CUSTOM;
+		info->irqcontrol 		= men_uart_uio_irqcontrol;
+		info->priv 				= mmod;
+
+		if (uio_register_device(parent, info)) {
+			printk(KERN_ERR "*** %s: can't register UIO device\n",
+				   mmod->deviceName);
+			goto ttys;
+		}
+		mmod->uioOn = 1;
+		printk(KERN_INFO "%s: %d channels handed to userspace (UIO)\n",
+			   mmod->deviceName, mmod->nrChannels);
+		continue;
+
+	ttys:
+		/* the UART IERs are still 0, nothing for the ISR before this */
+		mmod->uio = 0;
+		if (register_uarts(mmod) < 0)
+			printk(KERN_ERR "*** %s: no UIO and no ttys\n", 
+				   mmod->deviceName);
+		else
+			printk(KERN_ERR "*** %s: no UIO, channels are ttys\n",
+				   mmod->deviceName);
+	}
+}
+
+
+/*******************************************************************/
+/** remove the UIO devices of the M-Modules
+ *
+ * \return 			-
+ */
+static void men_uart_uio_unregister(void)
+{
+	UARTMOD_INFO *mmod;
+
+	list_for_each_entry(mmod, &G_uartModListHead, head) {
+		if (!mmod->uioOn)
+			continue;
+		men_uart_uio_irqcontrol(&mmod->uioInfo, 0);
+		mmod->uioOn = 0;
+		uio_unregister_device(&mmod->uioInfo);
+	}
+}
+#endif /* M77_HAS_UIO */
+
+
+/*****************************************************************************/
+/** handles the interrupt from one M-Module
+ *
+ * \param data		\IN 	void Parameter from MDIS Irq handler
+ *
+ * \brief The original 8250.c UART interrupt handler is now Registered via
+ * mdis_install_external_irq(). Its taylored to match the Requirements
+ * of serving the M45N/M69N/M77 Interrupts only. No calls to request_irq() are
+ * done within this driver.
+ * \return 			-
+ */
+static int M77_IrqHandler(void *data)
+{
+
+ 	UARTMOD_INFO *mmod 			= data;
+	struct pt_regs *regs = NULL;
+	unsigned int i;
+	struct ox16c954_port *up;
+	unsigned int iir;
+	unsigned char cpld_ir_reg;
+	unsigned int retcode 		= LL_IRQ_DEV_NOT;
+	struct list_head  *pos		= NULL;
+
+	/* skip through the registered M-Modules List */
+    list_for_each( pos, &G_uartModListHead ) {
+
+		mmod = list_entry(pos, UARTMOD_INFO, head);
+
+#ifdef M77_HAS_UIO
+		/* userspace serves the UARTs */
+		if (mmod->uio) {
+			if (men_uart_uio_irq(mmod))
+				retcode = LL_IRQ_DEVICE;
+			continue;
+		}
+#endif
+
+		cpld_ir_reg = MREAD_D16( mmod->memBase, M77_REG_IR ) & 0x00ff;
+		/* printk(KERN_ERR "cpld_ir_reg = 0x%02x\n", cpld_ir_reg); */
+
+		if ( cpld_ir_reg & 0x1 ) {
+			for (i = 0; i < mmod->nrChannels; i++) {
+				up = mmod->port8250[i];				
+				iir = serial_in(up, UART_IIR);
+				if ( !(iir & UART_IIR_NO_INT) ) {
+					spin_lock(&up->port.lock);
+					DEBUG_INTR("ISR: UART%d\n", i);
+					men_uart_handle_port(up, iir, regs);
+					spin_unlock(&up->port.lock);
+					men_uart_kcli_wakeup(up);
+				}
+			}
+			/* clear Interrupt */
+			control_out( mmod->memBase, M77_REG_IR,	cpld_ir_reg);
+			retcode = LL_IRQ_DEVICE;
+		}
+
+		/* If its an M45N check the second IR Register at 0xC8 too */
+		if (mmod->modtype == MOD_M45) {
+
+			cpld_ir_reg = MREAD_D16(mmod->memBase, M45_REG_IR2 ) & 0x00ff;
+			/* printk(KERN_ERR "cpld_ir_reg(2) = 0x%02x\n", cpld_ir_reg); */
+
+			if ( cpld_ir_reg & 0x1 ) {
+				for (i = 0; i < mmod->nrChannels; i++) { 
+					/* optimal:check 4-7 only */
+					up = mmod->port8250[i];
+					iir = serial_in(up, UART_IIR);
+					if ( !(iir & UART_IIR_NO_INT) ) {
+						spin_lock(&up->port.lock);
+						men_uart_handle_port(up, iir, regs);
+						spin_unlock(&up->port.lock);
+						men_uart_kcli_wakeup(up);
+					}
+				}
+				/* clear Interrupt */
+				control_out( mmod->memBase, M45_REG_IR2, cpld_ir_reg);
+			}
+		}
+	}
+	return(retcode);
+}
+
+
+/*******************************************************************/
+/** check if UART transmit Register is empty
+ *
+ * \param port		\IN highlevel uart_port Struct (as in serial_core)
+ *
+ * \return 			TIOCSER_TEMT if empty or 0
+ */
+static unsigned int men_uart_tx_empty(struct uart_port *port)
+{
+
+	unsigned long flags;
+	unsigned int ret;
+	struct ox16c954_port *up;
+
+	up = (struct ox16c954_port *)port;
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	ret = serial_in(up, UART_LSR) & UART_LSR_TEMT ? TIOCSER_TEMT : 0;
+	spin_unlock_irqrestore(&up->port.lock, flags);
+
+	return ret;
+}
+
+
+/******************************************************************************/
+/** return Modem Control Register and return as TIO* Values, for ioctl call
+ *
+ * \param port		\IN 	Oxford 16C954 Port Struct
+ *
+ * \return 			encoded MSR Bits
+ */
+static unsigned int men_uart_get_mctrl(struct uart_port *port)
+{
+	unsigned char status;
+	unsigned int ret;
+	struct ox16c954_port *up = (struct ox16c954_port *)port;
+	status = serial_in(up, UART_MSR);
+
+	/* reading MSR clears the deltas, the ISR shall see them still */
+	up->msrSaved |= status & UART_MSR_ANY_DELTA;
+
+	ret = 0;
+	if (status & UART_MSR_DCD)
+		ret |= TIOCM_CAR;
+	if (status & UART_MSR_RI)
+		ret |= TIOCM_RNG;
+	if (status & UART_MSR_DSR)
+		ret |= TIOCM_DSR;
+	if (status & UART_MSR_CTS)
+		ret |= TIOCM_CTS;
+	return ret;
+}
+
+
+
+/******************************************************************************/
+/** set Modem Control Register, called from core ioctl function
+ *
+ * \param port		\IN 	Oxford 16C954 Port Struct
+ * \param mctrl		\IN 	MSR Bits to set
+ *
+ * \return 			-
+ */
+static void men_uart_set_mctrl(struct uart_port *port, unsigned int mctrl)
+{
+	struct ox16c954_port *up = (struct ox16c954_port *)port;
+	unsigned char mcr = 0;
+
+	if (mctrl & TIOCM_RTS)
+		mcr |= UART_MCR_RTS;
+
+	if (mctrl & TIOCM_DTR)
+		mcr |= UART_MCR_DTR;
+
+	if (mctrl & TIOCM_OUT1)
+		mcr |= UART_MCR_OUT1;
+
+	if (mctrl & TIOCM_OUT2)
+		mcr |= UART_MCR_OUT2;
+
+	if (mctrl & TIOCM_LOOP)
+		mcr |= UART_MCR_LOOP;
+
+	mcr = (mcr & up->mcr_mask) | up->mcr_force | up->mcr;
+
+	serial_out(up, UART_MCR, mcr);
+}
+
+
+/******************************************************************************/
+/** set Set break control 
+ *
+ * \param port			\IN 	Oxford 16C954 Port Struct
+ * \param break_state	\IN     state to set, -1: set break, != -1:clear
+ *
+ * \return 			-
+ */
+static void men_uart_break_ctl(struct uart_port *port, int break_state)
+{
+	struct ox16c954_port *up = (struct ox16c954_port *)port;
+	unsigned long flags;
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	if (break_state == -1)
+		up->lcr |= UART_LCR_SBC;
+	else
+		up->lcr &= ~UART_LCR_SBC;
+	serial_out(up, UART_LCR, up->lcr);
+	spin_unlock_irqrestore(&up->port.lock, flags);
+}
+
+
+
+/*****************************************************************************/
+/** central UART channel startup function, called upon each open to /dev/ttyDx
+ *
+ * \param port			\IN 	Oxford 16C954 Port Struct
+ *
+ * \return 				0 or error code
+ *
+ * \brief	Wakes up and initialize UART. Gets called whenever a process opens
+ *          /dev/ttyDx. When passed at module load time the ACR is set such
+ *          that for M077
+ *
+ */
+static int men_uart_startup(struct uart_port *port)
+{
+	struct ox16c954_port *up = (struct ox16c954_port *)port;
+
+	/* the channel belongs to an in-kernel client or network interface */
+	if (up->kcli)
+		return -EBUSY;
+	/* M45N: the channel sharing the TCR bit is in automatic tristate */
+	if (men_uart_m45_claim(up))
+		return -EBUSY;
+
+	return __men_uart_startup(port);
+}
+
+
+/******************************************************************************/
+/** wake up and initialize the UART, for the tty and in-kernel clients
+ *
+ * \param port			\IN 	Oxford 16C954 Port Struct
+ *
+ * \return 				0
+ */
+static int __men_uart_startup(struct uart_port *port)
+{
+	struct ox16c954_port *up = (struct ox16c954_port *)port;
+	unsigned long flags;
+	unsigned char lsr, iir;
+
+	up->capabilities = uart_config[up->port.type].flags;
+	up->mcr = 0;
+	up->rs485State = M77_RS485_IDLE;
+	up->echoHead = up->echoTail = 0;
+
+	serial_out(up, 	UART_IER, 	0);
+	serial_out(up, 	UART_LCR, 	0);
+	serial_icr_write(up, UART_CSR, 	0); /* Reset the UART */
+
+	/* Set Enhanced Mode */
+	serial_efr_write(up, UART_EFR, UART_EFR_ECB);
+
+	up->acr = up->acrShadow;
+	M77DBG3("%s: up=%p up->type=0x%x up->m77Mode=0x%x up->acr=0x%02x\n", 
+			__FUNCTION__, up, up->type, up->m77Mode, up->acr);
+	
+	if (up->rs485Set) {
+		/* DTR# configuration as set with TIOCSRS485 */
+		serial_icr_write(up, UART_ACR, up->acr);
+	} else if ( up->type == MOD_M77 && \
+		 ((up->m77Mode == M77_RS485_HD) || (up->m77Mode == M77_RS422_HD ))) {
+		M77DBG3("%s: up->acr = 0x%02x\n", __FUNCTION__, up->acr);		
+		up->acr |= 0x18;
+		serial_icr_write(up, UART_ACR, up->acr);
+	}
+
+	/* Clear FIFO buffers & disable them. Theyre reenabled in set_termios */
+	men_uart_clear_fifos(up);
+
+	/* Clear the interrupt registers. */
+	(void) serial_in(up, UART_LSR);
+	(void) serial_in(up, UART_RX);
+	(void) serial_in(up, UART_IIR);
+	(void) serial_in(up, UART_MSR);
+
+	/* Now, initialize the UART */
+	serial_out(up, UART_LCR, UART_LCR_WLEN8);
+
+	spin_lock_irqsave(&up->port.lock, flags);
+
+	up->port.mctrl |= TIOCM_OUT2;
+	if (up->rs485Soft)
+		men_uart_rs485_drive(up, 0);
+	else
+		men_uart_set_mctrl(&up->port, up->port.mctrl);
+
+	/* quick test to see if we receive an IRQ when we enable the TX irq. */
+	serial_out(up, UART_IER, UART_IER_THRI);
+	lsr = serial_in(up, UART_LSR);
+	iir = serial_in(up, UART_IIR);
+	serial_out(up, UART_IER, 0);
+
+	if (lsr & UART_LSR_TEMT && iir & UART_IIR_NO_INT) {
+		if (!(up->bugs & UART_BUG_TXEN)) {
+			up->bugs |= UART_BUG_TXEN;
+			pr_debug("ttyS%d - enabling bad tx status workarounds\n",
+				 port->line);
+		}
+	} else {
+		up->bugs &= ~UART_BUG_TXEN;
+	}
+
+	spin_unlock_irqrestore(&up->port.lock, flags);
+
+	/*
+	 * Finally, enable interrupts.  Note: Modem status interrupts
+	 * are set via set_termios(), which will be occurring imminently
+	 * anyway, so we don't enable them here.
+	 */
+	up->ier = UART_IER_RLSI | UART_IER_RDI;
+	up->throttled = 0;
+	serial_out(up, UART_IER, up->ier);
+
+	/*
+	 * And clear the interrupt registers again for luck.
+	 */
+	(void) serial_in(up, UART_LSR);
+	(void) serial_in(up, UART_RX);
+	(void) serial_in(up, UART_IIR);
+	(void) serial_in(up, UART_MSR);
+
+	return 0;
+}
+
+
+/******************************************************************************/
+/** central UART shutdown function, called upon funal close of port /dev/ttyDx
+ *
+ * \param port			\IN 	Oxford 16C954 Port Struct
+ *
+ * \return 				0 or error code
+ */
+static void men_uart_shutdown(struct uart_port *port)
+{
+
+	struct ox16c954_port *up = (struct ox16c954_port *)port;
+	unsigned long flags;
+
+	/* before IER is cleared, releasing held RX sets it again */
+	men_uart_bridge_close(up);
+	men_uart_batch_detach(up, NULL);
+#ifdef M77_HAS_BPF
+	men_uart_bpf_detach(up);
+#endif
+
+	/*
+	 * Disable interrupts from this port
+	 */
+	up->ier = 0;
+	serial_out(up, UART_IER, 0);
+	hrtimer_cancel(&up->rxTimer);
+	hrtimer_cancel(&up->rs485Timer);
+	hrtimer_cancel(&up->frmTimer);
+	hrtimer_cancel(&up->schedTimer);
+	hrtimer_cancel(&up->linTimer);
+	hrtimer_cancel(&up->brgTimer);
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	up->frmLen = up->frmStat = up->frmLsr = 0;
+	up->rawRing = NULL;		/* the bound file sees POLLHUP */
+	wake_up_interruptible(&up->rawWait);
+	memset(up->sched, 0, sizeof(up->sched));
+	up->linMode = 0;
+	up->linState = M77_LIN_IDLE;
+	up->lcr &= ~UART_LCR_SBC;
+	up->schedPend = 0;
+	up->schedCur = NULL;
+	up->prioHead = up->prioTail = up->prioOff = 0;
+	up->rs485State = M77_RS485_IDLE;
+	if (up->rs485Soft)
+		men_uart_rs485_drive(up, 0);
+
+	
+	up->port.mctrl &= ~TIOCM_OUT2;
+	
+	men_uart_set_mctrl(&up->port, up->port.mctrl);
+	spin_unlock_irqrestore(&up->port.lock, flags);
+
+	/*
+	 * Disable break condition and FIFOs
+	 */
+	serial_out(up, UART_LCR, serial_in(up, UART_LCR) & ~UART_LCR_SBC);
+	men_uart_clear_fifos(up);
+	men_uart_m45_release(up);
+
+
+	/*
+	 * Read data port to reset things
+	 */
+	(void) serial_in(up, UART_RX);
+
+
+}
+
+
+/******************************************************************************/
+/** Calculate Baudrate Divisor
+ *
+ * \param port			\IN 	Oxford 16C954 Port Struct
+ * \param baud			\IN 	Baudrate Value, 300-1152000
+ *
+ * \return 				Divisor with respect to Clock 18,432 MHz
+ */
+static unsigned int men_uart_get_divisor(struct uart_port *port, 
+										 unsigned int baud)
+{
+	/* No magic handling needed for M Modules, Clock is always 18,432 MHz */
+	return uart_get_divisor(port, baud);
+}
+
+
+
+/******************************************************************************/
+/** function to set changed tty settings
+ *
+ * \param port			\IN 	highlevel UART Port Struct
+ * \param termios		\IN 	termios struct with new settings
+ * \param old			\IN 	termios struct to keep old settings(?)
+ *
+ * \brief this is the central link between higher tty layer and the UART 
+ *        Hardware to change all aspects of the Channel like Baudrate, data bit
+ *        settings etc. Its called everytime a property of the channel is 
+ *		  changed e.g. with stty.
+ *
+ * \return 				-
+ */
+#if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,19)
+static void men_uart_set_termios(struct uart_port *port,struct termios *termios, struct termios *old)
+#else
+static void men_uart_set_termios(struct uart_port *port,struct ktermios *termios, struct ktermios *old)
+#endif
+{
+	unsigned char efr = UART_EFR_ECB;	/* stay in enhanced (650) mode */
+	struct ox16c954_port *up = (struct ox16c954_port *)port;
+	unsigned char cval, fcr = 0;
+	unsigned long flags;
+	unsigned int baud, quot;
+
+	M77DBG3("%s: c_iflag = 0x%04x c_cflag = 0x%04x  Settings:\n",
+			   __FUNCTION__, termios->c_iflag, termios->c_cflag );
+
+	/* 
+	 * Set Word Length: 5..8 bit 
+	 */
+	switch (termios->c_cflag & CSIZE) {
+	case CS5:
+		cval = UART_LCR_WLEN5;
+		M77DBG3(" - 5 Data Bits\n");
+		break;
+	case CS6:
+		cval = UART_LCR_WLEN6;
+		M77DBG3(" - 6 Data Bits\n");
+		break;
+	case CS7:
+		cval = UART_LCR_WLEN7;
+		M77DBG3(" - 7 Data Bits\n");
+		break;
+	default:
+	case CS8:
+		cval = UART_LCR_WLEN8;
+		M77DBG3(" - 8 Data Bits\n");
+		break;
+	}
+
+	/* 
+	 * Set 1 or 2 Stop Bits
+	 * Oxford Data Sheet states that its actually 1.5 Stopbits at 5 Databits,
+	 * 2 Bits at 6,7,8 Data bits
+	 */
+	if (termios->c_cflag & CSTOPB){
+		cval |= UART_LCR_STOP;
+		M77DBG3(" - 2 Stop Bits\n");
+	} else {
+		M77DBG3(" - 1 Stop Bit\n");
+	}
+
+
+	/* 
+	 * Set Parity (none/odd/even)
+	 */
+	if (termios->c_cflag & PARENB)
+		cval |= UART_LCR_PARITY;
+	if (!(termios->c_cflag & PARODD))
+		cval |= UART_LCR_EPAR;
+
+	/* Report the Parity setting according to LCR[5:3] Data Sheet */
+
+	if(!(cval & UART_LCR_PARITY)){
+		M77DBG3(" - No Parity\n");
+	} else {
+		if( ((cval & 0x38) >> 3) == 1 ) /* Mask Bits 5,4,3:  0x38=0011 1000 */
+			M77DBG3(" - Odd Parity\n");
+
+		if( ((cval & 0x38) >> 3) == 3 )
+			M77DBG3(" - Even Parity\n");
+
+		if( ((cval & 0x38) >> 3) == 5 )
+			M77DBG3(" - Parity forced 1\n");
+
+		if( ((cval & 0x38) >> 3) == 7 )
+			M77DBG3(" - Parity forced 0\n");
+	}
+
+	/* 9-bit multidrop: 8 data bits, the parity bit carries the 9th bit */
+	up->mdLcr = cval;
+	if (up->mdEnable) {
+		cval &= ~(UART_LCR_PARITY|UART_LCR_EPAR|UART_LCR_SPAR|UART_LCR_WLEN8);
+		cval |= UART_LCR_WLEN8;
+		M77DBG3(" - 9-bit multidrop mode, parity setting ignored\n");
+	}
+
+	/*
+	 * Ask the core to calculate the divisor for us.
+	 */
+	baud = uart_get_baud_rate(port, termios, old, 0, port->uartclk/16); 
+	quot = men_uart_get_divisor(port, baud);
+	M77DBG3(" - Baudrate: %d (quot=%d)\n", baud, quot);
+
+	/* time of one char: start, data, parity or 9th bit, stop bits */
+	up->charNs = 1 + (cval & UART_LCR_WLEN8) + 5 + 
+		((cval & UART_LCR_STOP) ? 2 : 1) + 
+		((up->mdEnable || (cval & UART_LCR_PARITY)) ? 1 : 0);
+	up->charNs *= NSEC_PER_SEC / baud;
+	up->baud = baud;
+	men_uart_frame_times(up);
+	up->taStats.resNs = up->charNs / 4;
+	if (up->taStats.resNs < M77_RS485_POLL_MIN)
+		up->taStats.resNs = M77_RS485_POLL_MIN;
+
+	/*
+	 * Oxford Semi 952 rev B workaround
+	 */
+	if (up->bugs & UART_BUG_QUOT && (quot & 0xff) == 0)
+		quot ++;
+
+	if (up->capabilities & UART_CAP_FIFO && up->port.fifosize > 1) {
+		if (baud < 2400)
+			fcr = UART_FCR_ENABLE_FIFO | UART_FCR_TRIGGER_1;
+		else
+			fcr = uart_config[up->port.type].fcr;
+	}
+
+	/*
+	 * MCR-based auto flow control.  When AFE is enabled, RTS will be
+	 * deasserted when the receive FIFO contains more characters than
+	 * the trigger, or the MCR RTS bit is cleared.  In the case where
+	 * the remote UART is not using CTS auto flow control, we must
+	 * have sufficient FIFO entries for the latency of the remote
+	 * UART to respond.  IOW, at least 32 bytes of FIFO.
+	 */
+	if (up->capabilities & UART_CAP_AFE && up->port.fifosize >= 32) {
+		up->mcr &= ~UART_MCR_AFE;
+		if (termios->c_cflag & CRTSCTS)
+			up->mcr |= UART_MCR_AFE;
+	}
+
+	/* Ok, we're now changing the port state. Do it with interrupts disabled. */
+	spin_lock_irqsave(&up->port.lock, flags);
+
+	/* Update the per-port timeout. */
+	uart_update_timeout(port, termios->c_cflag, baud);
+
+	up->port.read_status_mask = UART_LSR_OE | UART_LSR_THRE | UART_LSR_DR;
+	if (termios->c_iflag & INPCK)
+		up->port.read_status_mask |= UART_LSR_FE | UART_LSR_PE;
+	if (termios->c_iflag & (BRKINT | PARMRK))
+		up->port.read_status_mask |= UART_LSR_BI;
+
+	/* Characteres to ignore */
+	up->port.ignore_status_mask = 0;
+	if (termios->c_iflag & IGNPAR)
+		up->port.ignore_status_mask |= UART_LSR_PE | UART_LSR_FE;
+	if (termios->c_iflag & IGNBRK) {
+		up->port.ignore_status_mask |= UART_LSR_BI;
+		/*
+		 * If we're ignoring parity and break indicators,
+		 * ignore overruns too (for real raw support).
+		 */
+		if (termios->c_iflag & IGNPAR)
+			up->port.ignore_status_mask |= UART_LSR_OE;
+	}
+
+	/* ignore all characters if CREAD is not set */
+	if ((termios->c_cflag & CREAD) == 0)
+		up->port.ignore_status_mask |= UART_LSR_DR;
+
+	/* CTS flow control flag and modem status interrupts */
+	up->ier &= ~UART_IER_MSI;
+	if (men_uart_want_ms(up, termios->c_cflag))
+		up->ier |= UART_IER_MSI;
+	if (up->capabilities & UART_CAP_UUE)
+		up->ier |= UART_IER_UUE | UART_IER_RTOIE;
+	serial_out(up, UART_IER, up->ier);
+
+	if ( termios->c_cflag & CRTSCTS ) {
+		if ( up->type != MOD_M77 ) {
+
+			/* auto-CTS, and auto-RTS dropping RTS at FIFO level FCH */
+			efr |= UART_EFR_CTS | UART_EFR_RTS;
+			M77DBG3(" - HW Flow Control (RTS/CTS)\n");
+		} else {
+			/* Dont use RTS/CTS Handshake setting on M77! */
+			printk(KERN_INFO "*** Module is a M77 - ignoring Flag CRTSCTS\n");
+		}
+	}
+
+	/* Apply to Register */
+	serial_efr_write(up, UART_EFR, efr );
+
+	/* 
+	 * Tell serial core which flow control the UART does by itself, so it
+	 * calls men_uart_throttle() instead of sending XOFF/dropping RTS
+	 */
+#ifdef UPSTAT_AUTOXOFF
+	up->port.status &= ~(UPSTAT_AUTORTS | UPSTAT_AUTOCTS | UPSTAT_AUTOXOFF);
+	if (efr & UART_EFR_RTS)
+		up->port.status |= UPSTAT_AUTORTS | UPSTAT_AUTOCTS;
+	if (termios->c_iflag & IXOFF)
+		up->port.status |= UPSTAT_AUTOXOFF;
+#elif defined(UPF_SOFT_FLOW)
+	up->port.flags &= ~(UPF_HARD_FLOW | UPF_SOFT_FLOW);
+	if (efr & UART_EFR_RTS)
+		up->port.flags |= UPF_HARD_FLOW;
+	if (termios->c_iflag & IXOFF)
+		up->port.flags |= UPF_SOFT_FLOW;
+#endif
+
+	/* Inband XON/XOFF Flow Control, characters as set in termios */
+	up->iflag = termios->c_iflag;
+	up->xon1  = termios->c_cc[VSTART];
+	up->xoff1 = termios->c_cc[VSTOP];
+	if (termios->c_iflag & (IXON|IXOFF))
+		M77DBG3(" - SW Flow Control IXON/IXOFF (XON 0x%02x XOFF 0x%02x)\n",
+				up->xon1, up->xoff1);
+	if ((up->mdEnable || up->delimEnable) && 
+		(termios->c_iflag & (IXON|IXOFF))) {
+		printk(KERN_INFO "*** "UART_NAME_PREFIX"%d in multidrop/delimiter "
+			   "mode - ignoring IXON/IXOFF\n", up->port.line);
+		up->iflag &= ~(IXON|IXOFF);
+	}
+	set_inband_flowctrl(up, up->iflag);
+	men_uart_spchr_program(up);
+	
+	/*  Set Baudrate Divider. M45N/69N/77 uartclk is always 18,432 MHz */
+	serial_out(up, UART_LCR, cval | UART_LCR_DLAB);
+	serial_out(up, UART_DLL, quot & 0xff);			
+	serial_out(up, UART_DLM, quot >> 8);			
+
+	/*
+	 * LCR DLAB must be set to enable 64-byte FIFO mode. If the FCR
+	 * is written without DLAB set, this mode will be disabled.
+	 */
+	if (up->port.type == PORT_16750)
+		serial_out(up, UART_FCR, fcr);
+
+	serial_out(up, UART_LCR, cval);		/* reset DLAB */
+
+	up->lcr = cval;					    /* Save LCR */
+	if (up->port.type != PORT_16750) {
+
+		if (fcr & UART_FCR_ENABLE_FIFO) {
+			/* emulated UARTs (Lucent Venus 167x) need two steps */
+			serial_out(up, UART_FCR, UART_FCR_ENABLE_FIFO);
+		}
+		serial_out(up, UART_FCR, fcr);		/* set fcr */
+	}
+
+	/* 950 trigger levels, also thresholds for the UARTs XON/XOFF sending */
+	men_uart_set_trigger_levels(up, (baud < 2400 || up->linMode) ? 1 : 
+								M77_RTL_DEFAULT);
+
+	men_uart_set_mctrl(&up->port, up->port.mctrl);
+	spin_unlock_irqrestore(&up->port.lock, flags);
+}
+
+
+static void
+men_uart_pm(struct uart_port *port, unsigned int state, unsigned int oldstate)
+{
+	/* No special Powermanagement for our M Modules */
+	do { } while (0);
+
+}
+
+
+static void men_uart_release_port(struct uart_port *port)
+{
+	/* Not necessary for M-Modules */
+}
+
+static int men_uart_request_port(struct uart_port *port)
+{
+	/* Not necessary for M-Modules */
+	return 0;
+}
+
+
+/******************************************************************************/
+/** highlevel UART Port config function
+ *
+ * \param port			\IN 	highlevel UART Port Struct
+ * \param flags			\IN 	optional flags to control probing
+ *
+ * \return 				-
+ */
+static void men_uart_config_port(struct uart_port *port, int flags)
+{
+	struct ox16c954_port *up = (struct ox16c954_port *)port;
+	int probeflags = ~0;
+
+	if (flags & UART_CONFIG_TYPE)
+		autoconfig(up, probeflags);
+
+}
+
+
+/*****************************************************************************/
+/** return next free UART from internal UART Array
+ *
+ * \param port			\IN 	highlevel UART Port Struct
+ *
+ * \brief  We are free to use the ttyDxx entries by ourselves 
+ * 		   So just return the next free men_uart_ports[i].port.
+ * 		   This is simplified from serial8250_find_match_or_unused().
+ *
+ * \return 				pointer to port struct
+ */
+static struct 
+ox16c954_port *men_uart_find_match_or_unused(struct uart_port *port)
+{
+	int i;
+	/* simply return the first entry which hasnt already a membase entry */
+	for (i = 0; i < MAX_SNGL_UARTS; i++) {
+		if ( !men_uart_ports[i].port.membase ) {
+			M77DBG3("%s: return UART nr. %d\n", __FUNCTION__, i);
+			return &men_uart_ports[i];
+		}	
+	}
+	return NULL;
+}
+
+
+
+static int men_uart_verify_port(struct uart_port *port, 
+								struct serial_struct *ser)
+{
+	/* shouldnt hurt to report us to serial core as always existing */
+	return 0;
+}
+
+
+
+/*****************************************************************************/
+/** Function to register each 4 or 8 UART Channels of a M-Module at serial core
+ *
+ * \param port		\IN    highlevel UART Port Struct
+ * \param modtype	\IN    Module ID as in 13m07790.xml
+ * \param nrLine	\IN    UART Line number as in /dev/ttyDn
+ * \param glob		\OUT   returned OX16C954 UART, stored in UARTMOD_INFO array
+ *
+ * \return 				0 or negative error number
+ */
+int men_uart_register_port(struct uart_port *port, 
+						   unsigned int modtype,
+						   unsigned int nrLine, 
+						   struct ox16c954_port **glob )
+{
+	struct ox16c954_port *uart;
+	int ret = -ENOSPC;
+	
+	/* For M45N: helper for TCRbit-to-Channelnumber mapping */
+	unsigned int tcr[8] = {M45_TCR_TRISTATE0, M45_TCR_TRISTATE1, 
+						   M45_TCR_TRISTATE2, M45_TCR_TRISTATE2,
+						   M45_TCR_TRISTATE3, M45_TCR_TRISTATE3,
+						   M45_TCR_TRISTATE4, M45_TCR_TRISTATE4 };
+
+	if (port->uartclk == 0)
+		return -EINVAL;
+
+	down( &serial_sem );
+
+	/* take one UART from the global ox16c954_port array */
+	uart = men_uart_find_match_or_unused(port);
+
+	if (uart) {
+		uart->port.iobase   	= port->iobase;
+		uart->port.membase  	= port->membase;
+		uart->port.irq      	= port->irq;
+		uart->port.uartclk  	= port->uartclk;
+		uart->port.fifosize 	= port->fifosize;
+		uart->port.regshift 	= port->regshift;
+		uart->port.iotype   	= port->iotype;
+		uart->port.flags    	= port->flags;
+		uart->port.mapbase  	= port->mapbase;
+
+		/* for runtime-ioctl calls remember if we are a M45N, M69N or M77 */
+		uart->type				= modtype;
+
+		switch (uart->type) {
+		case MOD_M77:
+			uart->dcrReg = M77_DCR_REG_BASE + nrLine;
+			break;
+
+		case MOD_M45:
+			uart->tcrReg = (nrLine < 4) ? M45_TCR1_REG : M45_TCR2_REG;
+			uart->tcrBit = tcr[nrLine];	
+			break;
+		}
+
+#if 0
+		printk( KERN_INFO "men_uart_register_port:\n");
+		printk( KERN_INFO "uart->port.iobase   = 0x%08x\n",uart->port.iobase);
+		printk( KERN_INFO "uart->port.membase  = 0x%08x\n",uart->port.membase);
+		printk( KERN_INFO "uart->port.irq      = 0x%02x\n",uart->port.irq);
+		printk( KERN_INFO "uart->port.uartclk  = %ld\n",uart->port.uartclk);
+		printk( KERN_INFO "uart->port.fifosize = %d\n", uart->port.fifosize );
+		printk( KERN_INFO "uart->port.regshift = %d\n", uart->port.regshift );
+		printk( KERN_INFO "uart->port.iotype   = 0x%08x\n", uart->port.iotype);
+		printk( KERN_INFO "uart->port.flags    = 0x%08x\n",uart->port.flags );
+		printk( KERN_INFO "uart->port.mapbase  = 0x%08x\n",uart->port.mapbase);
+#endif
+
+		if (port->dev)
+			uart->port.dev = port->dev;
+
+		ret = uart_add_one_port(&men_uart_reg, &uart->port);
+		
+		/* give back this OX16C954 UART for storing in UARTMOD_INFO array */
+		*glob = uart;
+
+		if (ret == 0)
+			ret = uart->port.line;
+	} 
+
+	up(&serial_sem);
+	return ret;
+}
+
+/*******************************************************************/
+/** Remove one serial port
+ *
+ * \param line		\IN serial line number
+ *
+ * \return 			-
+ */
+void men_uart_unregister_port(int line)
+{
+	struct ox16c954_port *uart = &men_uart_ports[line];
+	
+	men_uart_pps_unregister(uart);
+	uart->msrFlags = 0;
+#ifdef M77_HAS_BPF
+	men_uart_bpf_detach(uart);
+#endif
+
+	down(&serial_sem);
+	uart_remove_one_port( &men_uart_reg, &uart->port);
+	uart->port.dev = NULL;
+	up(&serial_sem);
+}
+
+
+
+/*******************************************************************/
+/** return Port type name
+ *
+ * \param port		\IN 	highlevel UART Port Struct
+ *
+ * \return 			char pointer to string, typically "16C954" here
+ */
+static const char *men_uart_type(struct uart_port *port)
+{
+	int type = port->type;
+
+	if (type >= ARRAY_SIZE(uart_config))
+		type = 0;
+	return uart_config[type].name;
+}
+
+
+
+/*******************************************************************/
+/** Initialize the global Array of Oxford UARTs
+ *
+ */
+static void men_uart_init_ports(void)
+{
+
+	unsigned int i;
+
+	for (i = 0; i < MAX_SNGL_UARTS; i++) {
+		struct ox16c954_port *up = &men_uart_ports[i];
+
+		up->port.line 		= 	i;
+		spin_lock_init(&up->port.lock);
+
+		up->timer.function 	= NULL /* serial8250_timeout */;
+		hrtimer_init(&up->rxTimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		up->rxTimer.function = men_uart_rx_timer;
+		hrtimer_init(&up->rs485Timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		up->rs485Timer.function = men_uart_rs485_timer;
+		hrtimer_init(&up->frmTimer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+		up->frmTimer.function = men_uart_frame_timer;
+		hrtimer_init(&up->schedTimer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+		up->schedTimer.function = men_uart_sched_timer;
+		hrtimer_init(&up->linTimer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+		up->linTimer.function = men_uart_lin_timer;
+		hrtimer_init(&up->brgTimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		up->brgTimer.function = men_uart_bridge_timer;
+		init_waitqueue_head(&up->rawWait);
+		init_waitqueue_head(&up->kcWait);
+		up->netDelim 		= -1;
+		up->mcr_mask 		= ~0;
+		up->mcr_force 		= 0;
+		up->rtl 			= M77_RTL_DEFAULT;
+		up->ttl 			= M77_TTL_DEFAULT;
+		up->port.ops 		= &men_uart_pops;
+	}
+}
+
+
+/*******************************************************************/
+/** Deinitialize all registered M-Modules
+ *
+ * \return 			-
+ */
+static void deinit_devices(void)
+{
+
+ 	UARTMOD_INFO *mmod;
+	struct list_head *tmp, *element;
+	struct ox16c954_port *up;
+	unsigned int i;
+
+	/*
+	 * 1. shutdown all UARTs physically 
+	 */
+	for (i=0; i < MAX_SNGL_UARTS ; i++) {
+		if ( men_uart_ports[i].port.membase ) 
+		{
+			M77DBG3(KERN_INFO "deinit port %d\n", i);
+			up = (struct ox16c954_port *)&men_uart_ports[i].port;
+			serial_out(up, 	UART_IER, 0);
+			serial_out(up, 	UART_LCR, 0);
+			serial_icr_write(up, UART_CSR, 0); /* Reset the UART */
+			/* unregister the UARTs from the driver subsystem */
+			men_uart_unregister_port( i );
+		}	
+	}
+
+	/*
+	 * 2. Unregister everything in the MDIS context (external MDIS devices) 
+	 */
+	M77DBG2(KERN_INFO "Unregister external MDIS devices\n");
+    list_for_each( tmp, &G_uartModListHead ) {
+		mmod = list_entry(tmp, UARTMOD_INFO, head);
+		if (mmod->mdisDev) {			
+			M77DBG2(KERN_INFO "Closing Device %s \n",mmod->deviceName);
+
+			/* UARTs left by userspace: reset them as in step 1 */
+			for (i = 0; mmod->uio && i < mmod->nrChannels; i++) {
+				void *base = men_uart_chan_base(mmod, i);
+				control_out(base, UART_IER << 1, 0);
+				control_out(base, UART_LCR << 1, 0);
+				control_out(base, UART_SCR << 1, UART_CSR);
+				control_out(base, UART_ICR << 1, 0);
+			}
+
+			/* clear any left Interrupt & disable them */
+			control_out(mmod->memBase, M77_REG_IR, 0x01 );
+			control_out(mmod->memBase, M77_REG_IR, 0x00 );
+
+			/* Clear TCR/DCR Registers back to powerup values*/
+			if (mmod->modtype == MOD_M77) {
+				for (i = M77_DCR_REG_BASE; i < M77_DCR_REG_BASE + 4; i++ )
+					control_out(mmod->memBase, i << 1, M77_RS422_HD );
+			}
+
+			if (mmod->modtype == MOD_M45) {
+				control_out(mmod->memBase, M45_REG_IR2, 		0x01 );
+				control_out(mmod->memBase, M45_REG_IR2, 		0x00 );
+				control_out(mmod->memBase, M45_TCR1_REG << 1, 	0x00 );
+				control_out(mmod->memBase, M45_TCR2_REG << 1, 	0x00 );
+			}
+			M77DBG2(KERN_INFO "Closing external device %s \n",mmod->deviceName);
+			mdis_close_external_dev( mmod->mdisDev );
+		}
+	}
+	/*
+	 * 3. kfree kmalloc'ed memory and resources
+	 */
+	list_for_each_safe(element, tmp, &G_uartModListHead) { // Liste freigeben
+		mmod = list_entry(element, UARTMOD_INFO, head);
+		M77DBG2(KERN_INFO "Now freeing space for '%s'\n", mmod->deviceName );
+		list_del( element );
+		kfree( list_entry( element, UARTMOD_INFO, head));
+    }
+
+}
+
+
+/*******************************************************************/
+/** Select the M77 phymode
+ *
+ * \param mod		\IN  per-module struct of M-Module data
+ *
+ * \return 			-
+ */
+static void	parse_m77_phyinfo( UARTMOD_INFO *mmod_data, unsigned int idx )
+{
+
+    unsigned int j = 0, m77mode=0;
+	for ( j = 0; j < 4; j++ ) {
+
+		mmod_data->mode[j] = 0;
+		mmod_data->echo[j] = 0;
+		m77mode = mode[(idx*4) + j];
+
+		if (m77mode) {
+			/* sanity check of passed mode */
+			if ( (m77mode == M77_RS422_FD) || (m77mode == M77_RS422_HD) ||
+				 (m77mode == M77_RS485_HD) || (m77mode == M77_RS485_FD) ||
+				 (m77mode == M77_RS232)) {
+				mmod_data->mode[j] = m77mode;
+				mmod_data->echo[j] = !!echo[(idx*4) + j];
+				M77DBG("mmod_data->mode[%d] = %d  ", j, mmod_data->mode[j] );
+				M77DBG("mmod_data->echo[%d] = %d\n", j, mmod_data->echo[j] );
+			} else {
+				printk(KERN_ERR "** Parameter mode[%d]=%d invalid, ignored\n",
+					   j, m77mode );
+				mmod_data->mode[j] = 0;
+				mmod_data->echo[j] = 0;
+			}
+		}
+	}
+}
+
+
+/*******************************************************************/
+/** DCR value of a M77 channel from the mode and echo parameters
+ *
+ * \param mod		\IN  per-module struct of M-Module data
+ * \param nrChan	\IN  channel 0..3
+ *
+ * \return 			DCR value
+ */
+static unsigned char men_uart_m77_dcr(UARTMOD_INFO *mod, int nrChan)
+{
+	unsigned int tmpmode = mod->mode[nrChan];
+	unsigned char dcr_val = tmpmode;
+
+	/* echoing only for HD modes! unknown effects at other modes.. */
+	if ( (( tmpmode==M77_RS422_HD) || (tmpmode==M77_RS485_HD )) && (mod->echo[nrChan])) 
+	{
+		dcr_val |= M77_RX_EN;
+	}
+	return dcr_val;
+}
+
+
+/*******************************************************************/
+/** Register the 4 or 8 UART Channels of this M-Module 
+ *
+ * \param mod		\IN  per-module struct of M-Module data
+ *
+ * \return 			0 on success or error code
+ */
+static int register_uarts(UARTMOD_INFO *mod )
+{
+	int retval = 0, nrChan = 0 ;
+	unsigned char dcr_val = 0;
+	unsigned int tmpmode = 0;
+	struct ox16c954_port *ox; 
+	void *baseAdr;
+
+	switch ( mod->modtype ) {
+	case MOD_M45:
+		mod->nrChannels = MOD_M45_CHAN_NUM;
+		break;
+	case MOD_M69:
+		mod->nrChannels = MOD_M69_CHAN_NUM;
+		break;
+	case MOD_M77:
+		mod->nrChannels = MOD_M77_CHAN_NUM;
+		break;
+	default: 
+		printk(KERN_ERR "*** invalid M-Module type 0x%04x!\n", mod->modtype );
+		return -ENODEV;
+	}
+
+	/*
+	 *	Enable Interrupts in the additional IR Registers on locations:
+	 *	M77:	0x48
+	 *	M69N:	0x48
+	 *	M45N:	0x48, 0xc8
+	 */
+	switch ( mod->modtype ) {
+	case MOD_M45:
+		M77DBG2("Init M45N Registers\n");
+		control_out( mod->memBase, M45_REG_IR1, M77_IR_IMASK );
+		control_out( mod->memBase, M45_REG_IR2, M77_IR_IMASK );
+		break;
+
+	case MOD_M69:
+		M77DBG2("Init M69N Register\n");
+		control_out( mod->memBase, M69_REG_IR, M77_IR_IMASK );
+		break;
+
+	case MOD_M77:
+		/* On M77 also enable the galvanic isolated Drivers */
+		M77DBG2("Init M77 Register \n");		
+		control_out( mod->memBase, M77_REG_IR, M77_IR_IMASK | M77_IR_DRVEN );
+		break;
+	}
+
+	/* 
+	 * UIO: the interrupt stays masked until userspace enables it, only
+	 * the phy mode is set up, no ttys
+	 */
+	if (mod->uio) {
+		control_out( mod->memBase, M77_REG_IR, 
+					 mod->modtype == MOD_M77 ? M77_IR_DRVEN : 0 );
+		if (mod->modtype == MOD_M45)
+			control_out( mod->memBase, M45_REG_IR2, 0 );
+
+		for ( nrChan = 0; mod->modtype == MOD_M77 && nrChan < 4; nrChan++ )
+			if (mod->mode[nrChan])
+				control_out(mod->memBase, (M77_DCR_REG_BASE+nrChan) << 1, 
+							men_uart_m77_dcr(mod, nrChan));
+		return 0;
+	}
+
+
+	/*  Register all channels of this M-Module  */
+	for ( nrChan = 0; nrChan < mod->nrChannels; nrChan++ ) {
+		dcr_val = 0;
+		mod->uart.flags 	= UPF_SHARE_IRQ | UPF_BOOT_AUTOCONF;
+		mod->uart.uartclk 	= MM_UARTCLK;
+		mod->uart.iotype 	= UPIO_MEM;
+		mod->uart.irq 		= 0xff; /* dummy Info, unused by this driver */
+		mod->uart.regshift 	= 1;	/* already done in serial_in/out */
+		mod->uart.fifosize 	= 128;
+		mod->uart.type 		= PORT_16C950;
+
+		baseAdr = men_uart_chan_base(mod, nrChan);
+
+		/* use same address for mem/mapbase, shown as "MMIO" at loading */
+		mod->uart.membase 	= baseAdr;
+		mod->uart.mapbase 	= (unsigned long)(unsigned long*)baseAdr;
+		
+		if ((retval=men_uart_register_port(&mod->uart, mod->modtype, nrChan, 
+										   &mod->port8250[nrChan]))<0) {
+
+			printk(KERN_ERR "*** Error during registering UART %d!\n", nrChan);
+			return retval;
+		} else
+			mod->line = retval;
+
+		ox = mod->port8250[nrChan]; /* is valid now */
+
+		/* on M77, also set phy mode and echo and switch it on */
+		tmpmode = mod->mode[nrChan];
+		if ( mod->modtype == MOD_M77 && tmpmode ) {
+			dcr_val = men_uart_m77_dcr(mod, nrChan);
+			control_out(mod->memBase, (M77_DCR_REG_BASE+nrChan) << 1, dcr_val);
+			
+			/* save M77 mode */
+			ox->m77Mode = tmpmode;
+
+			/* RS485 HD given at load time: report it with TIOCGRS485 too */
+			if (tmpmode == M77_RS485_HD) {
+				ox->rs485.flags = men_uart_rs485_phy_flags(ox, dcr_val);
+				ox->rs485PrevDcr  = M77_RS422_HD;	/* power up value */
+				ox->rs485PrevAcr  = 0;
+				ox->rs485PrevMode = 0;
+				ox->acrShadow 	  = OX954_ACR_DTR;
+			}
+		}
+
+#ifdef M77_HAS_RS485_CONFIG
+		if ( mod->modtype == MOD_M77 ) {
+			ox->port.rs485_config = men_uart_rs485_config;
+# if LINUX_VERSION_CODE >= KERNEL_VERSION(6,0,0)
+			ox->port.rs485_supported = men_uart_rs485_supported;
+# endif
+			ox->port.rs485 = ox->rs485;
+		}
+#endif
+	}
+	return retval;
+}
+
+
+/*******************************************************************/
+/** main enumeration and initialization Function of all Modules
+ *
+ * \brief
+ * The passed module Parameters are parsed and for each given Module
+ * and a call to mdis_open_external_dev() is done. For each new 
+ * carrier board a call to mdis_install_external_irq() is done because
+ * from CPU View the IRQ s of all M-Modules on the same Carrier are
+ * equal.
+ *
+ * \return 			0 on success or negative error code
+ */
+static int m77_init_devices(void)
+{
+
+	u_int32 modtype = 0, devid = 0, devrev = 0, modnr = 0;
+	char moddevname[64];
+    unsigned int m_idx = 0;
+	int retval = 0;
+    char device[ARRLEN];
+	char prevBrdName[ARRLEN];
+	UARTMOD_INFO *mmod_data = NULL;
+
+	memset( device, 0x0, sizeof(device));
+	memset( prevBrdName, 0x0, sizeof(prevBrdName));
+
+    INIT_LIST_HEAD( &G_uartModListHead );	
+
+	if ( brdName[m_idx] == NULL ) {
+		printk(KERN_ERR 
+			   " *** Error: No BBIS device specified, e.g.'brdName=d201_1'\n");
+		retval = -EINVAL;
+		goto errout;
+	}
+
+	/*-----------------------------+
+	 |  For each M-Module do..     |
+     +-----------------------------*/
+    while( devName[m_idx] )  {
+		
+		strncpy( device, devName[m_idx], ARRLEN-1 );
+
+		/* kmalloc one UARTMOD_INFO struct per M-Module   */	
+		if ((mmod_data = kmalloc(sizeof(UARTMOD_INFO), GFP_KERNEL)) == NULL ){
+			retval = -ENOMEM;
+			goto errout;
+		}
+		memset( mmod_data, 0x0, sizeof(UARTMOD_INFO) );
+
+		/* store index, devicename, list element etc */
+		mmod_data->modnum = m_idx;	
+		strncpy( mmod_data->brdName, brdName[m_idx], ARRLEN-1 );
+		list_add(&mmod_data->head, &G_uartModListHead );
+
+		if ( slotNo[m_idx] > 3 ) {
+			printk(KERN_ERR " *** Error: Slotnumber %d invalid (use 0..3)\n", 
+				   slotNo[m_idx]);
+			retval = -EINVAL;
+			goto errout;
+		}
+
+		retval=mdis_open_external_dev( device, 
+					       brdName[m_idx],
+					       slotNo[m_idx], 
+					       MDIS_MA08, 
+					       MDIS_MD08, 
+					       256, 
+					       &mmod_data->memBase,
+					       NULL, 
+					       &mmod_data->mdisDev );
+		
+		M77DBG3("called mdis_open_external_dev for '%s' board '%s' slot %d.\n",
+				devName[m_idx], brdName[m_idx], slotNo[m_idx] );
+		M77DBG3("returnvalue %d. membase=0x%08x\n",retval, mmod_data->memBase);
+
+		if (retval < 0) {
+			printk(KERN_ERR "*** open '%s' failed: board %s slot %d!\n",
+				   devName[m_idx], brdName[m_idx], slotNo[m_idx] );
+			printk(KERN_ERR "hint: forgot mdis_createdev -b %s ?\n",
+				   brdName[m_idx]);
+
+			retval 	= -EIO;
+			goto errout;
+		}
+
+		if ( m_getmodinfo( (unsigned long)((unsigned long*)mmod_data->memBase), 
+				   &modtype, &devid, 
+				   &devrev, moddevname) == 0) {
+			M77DBG3("getmodinfo found: '%s' devID: 0x%08x\n",moddevname,devid);
+
+			modnr = devid & 0xffff;
+			mmod_data->modtype = modnr;
+			strncpy( mmod_data->deviceName, device, ARRLEN-1 );
+			mmod_data->deviceName[ARRLEN-1] = '\0';
+
+			/*  sanity checks against wrong driver insertion */
+			if (strncmp("m45" ,devName[m_idx], 3 ) && (modnr == MOD_M45)){
+				printk(KERN_ERR "*** Error: passed '%s' but found '%s'\n",
+					   devName[m_idx], moddevname );
+				retval = -ENODEV;
+				goto errout;	
+			}
+			
+			if (strncmp("m69" ,devName[m_idx], 3) && (modnr == MOD_M69)) {
+				printk(KERN_ERR "*** Error: passed '%s' but found '%s'\n",
+					   devName[m_idx], moddevname );
+				retval = -ENODEV;
+				goto errout;
+			} 
+			
+			if (strncmp("m77" ,devName[m_idx], 3) && (modnr == MOD_M77)) {
+				printk(KERN_ERR "*** Error: passed '%s' but found '%s'\n",
+					   devName[m_idx], moddevname );
+				retval = -ENODEV;
+				goto errout;				
+			} 
+
+			if ((modnr != MOD_M45) && (modnr != MOD_M69) &&(modnr != MOD_M77)){
+				printk(KERN_ERR "*** Error: unknown Module (0x%04x)!\n", devid);
+				retval = -ENODEV;
+				goto errout;				
+			} 
+
+		} else {
+			printk("*** Error identifying M-Module!\n");
+			retval = -ENODEV;
+			goto errout;
+		}
+		
+		M77DBG("Carrier now %s: Registering new ISR\n", brdName[m_idx] );
+		retval = mdis_install_external_irq(	mmod_data->mdisDev,	M77_IrqHandler,
+											(void*)mmod_data);
+		if ( retval < 0 ) {	
+			printk(KERN_ERR "*** install irq error: %d\n", retval);
+			retval = -EBUSY;
+			goto errout;
+		}
+
+		if ( mmod_data->modtype == MOD_M77 ) 		
+			parse_m77_phyinfo(mmod_data, m_idx);
+
+#ifdef M77_HAS_UIO
+		mmod_data->uio = !!uio[m_idx];
+		mmod_data->uioPhys = uioaddr[m_idx];
+#else
+		if (uio[m_idx])
+			printk(KERN_ERR "*** %s: kernel without UIO, channels are ttys\n",
+				   device);
+#endif
+
+		/* Register all UART channels of this M-Module */
+		register_uarts(mmod_data);
+
+		retval = mdis_enable_external_irq( mmod_data->mdisDev );
+		if ( retval < 0 ) {	
+			printk(KERN_ERR "*** enable irq error: %d\n", retval);
+			retval = -EBUSY;
+			goto errout;
+		}
+		/* current carrier becomes old one  */
+		strncpy(prevBrdName, brdName[m_idx], ARRLEN-1);
+		prevBrdName[ARRLEN-1] = '\0';
+
+		m_idx++; 
+
+	} /* end while(brdname... */
+
+	/* was any M-Module processed at all ?  */
+	if (!m_idx) {
+		printk(KERN_ERR 
+			   " *** Error: No MDIS Device specified, e.g. 'devName=m45_1'\n");
+		retval = -ENODEV;
+		goto errout;
+	}
+
+	return 0; 
+ errout:
+	deinit_devices();	
+	return retval;
+}
+
+/*******************************************************************/
+/** give the RX of a port back to the tty
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param cf		\IN only if attached by this control file, NULL: any
+ *
+ * \brief Chars not read yet are lost. Called from process context only.
+ *
+ * \return 			-
+ */
+static void men_uart_batch_detach(struct ox16c954_port *up, 
+								  struct m77_ctl_file *cf)
+{
+	unsigned char *buf = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	if (!cf || up->batchFile == cf) {
+		buf = up->batchBuf;
+		up->batchBuf 	= NULL;
+		up->batchFile 	= NULL;
+	}
+	spin_unlock_irqrestore(&up->port.lock, flags);
+	kfree(buf);
+}
+
+
+/*******************************************************************/
+/** take the RX of an open port away from the tty
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param cf		\IN control file, owns the port until it detaches it
+ *                      or is closed
+ *
+ * \return 			0 or negative error number
+ */
+static int men_uart_batch_attach(struct ox16c954_port *up, 
+								 struct m77_ctl_file *cf)
+{
+	unsigned char *buf;
+	unsigned long flags;
+	int retval = 0;
+
+	buf = kmalloc(M77_BATCH_RING, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	if (!men_uart_port_xmit(up))
+		retval = -ENODEV;
+	else if (up->batchBuf)
+		retval = (up->batchFile == cf) ? 0 : -EBUSY;
+	else if (men_uart_rx_bypass(up) || up->frmMode || up->linMode || 
+			 up->delimEnable)
+		retval = -EBUSY;	/* they use the received chars on their own */
+	else {
+		up->batchHead = up->batchTail = 0;
+		up->batchBuf 	= buf;
+		up->batchFile 	= cf;
+		buf = NULL;
+	}
+	spin_unlock_irqrestore(&up->port.lock, flags);
+
+	kfree(buf);
+	return retval;
+}
+
+
+/*******************************************************************/
+/** check if M77_BATCH_WAIT can return
+ *
+ * \param ent		\IN entries of M77_BATCH_IO
+ * \param num		\IN number of entries
+ *
+ * \return 			1 if a read entry has data or there is no read entry
+ */
+static int men_uart_batch_ready(struct m77_batch_entry *ent, unsigned int num)
+{
+	struct ox16c954_port *p;
+	unsigned int i, reads = 0;
+
+	for (i = 0; i < num; i++) {
+		if (ent[i].dir != M77_BATCH_READ || ent[i].line >= MAX_SNGL_UARTS)
+			continue;
+		reads++;
+		p = &men_uart_ports[ent[i].line];
+		if (p->batchBuf && p->batchHead != p->batchTail)
+			return 1;
+	}
+	return !reads;
+}
+
+
+/*******************************************************************/
+/** do one entry of M77_BATCH_IO
+ *
+ * \param e			\IN entry
+ * \param bounce	\IN kernel buffer of M77_BATCH_RING bytes
+ *
+ * \brief Writes go into the xmit buffer of the port, as by write(), and
+ *        the TX FIFO is loaded right away if the transmitter has room.
+ *        Reads take what is in the batchBuf of an attached port. Neither
+ *        waits, entries may be done partially.
+ *
+ * \return 			chars written/read or negative error number
+ */
+static int men_uart_batch_entry(struct m77_batch_entry *e, 
+								unsigned char *bounce)
+{
+	void __user *ubuf = (void __user *)(unsigned long)e->buf;
+	unsigned int len = min_t(unsigned int, e->len, M77_BATCH_RING);
+	struct ox16c954_port *p;
+	struct circ_buf *xmit;
+	unsigned long flags;
+	unsigned int c;
+	int n = 0;
+
+	if (e->line >= MAX_SNGL_UARTS)
+		return -EINVAL;
+	p = &men_uart_ports[e->line];
+
+	switch (e->dir) {
+	case M77_BATCH_WRITE:
+		if (copy_from_user(bounce, ubuf, len))
+			return -EFAULT;
+		spin_lock_irqsave(&p->port.lock, flags);
+		xmit = men_uart_port_xmit(p);
+		if (!xmit)
+			n = -ENODEV;
+		else if ((n = men_uart_xmit_put(xmit, bounce, len)))
+			men_uart_oob_kick(p);
+		spin_unlock_irqrestore(&p->port.lock, flags);
+		break;
+
+	case M77_BATCH_READ:
+		spin_lock_irqsave(&p->port.lock, flags);
+		if (!p->batchBuf)
+			n = -ENODEV;
+		while (p->batchBuf && n < len) {
+			c = CIRC_CNT_TO_END(p->batchHead, p->batchTail, M77_BATCH_RING);
+			if (c > len - n)
+				c = len - n;
+			if (!c)
+				break;
+			memcpy(bounce + n, p->batchBuf + p->batchTail, c);
+			p->batchTail = (p->batchTail + c) & (M77_BATCH_RING - 1);
+			n += c;
+		}
+		spin_unlock_irqrestore(&p->port.lock, flags);
+		if (n > 0 && copy_to_user(ubuf, bounce, n))
+			return -EFAULT;
+		break;
+
+	default:
+		n = -EINVAL;
+		break;
+	}
+
+	return n;
+}
+
+
+/*******************************************************************/
+/** M77_RAW_SET/GET on a /dev/m77ctl file
+ *
+ * \param cf		\IN state of the file
+ * \param cmd		\IN M77_RAW_SET or M77_RAW_GET
+ * \param arg		\IN user pointer to struct m77_raw
+ *
+ * \brief The first M77_RAW_SET binds the file to the channel and
+ *        allocates the ring, line and size can't be changed after. The
+ *        channel must be open to switch raw mode on, the hardware is set up
+ *        by its tty. Flags can only be changed with raw mode off.
+ *
+ * \return 			0 or negative error number
+ */
+static long men_uart_raw(struct m77_ctl_file *cf, unsigned int cmd,
+						 unsigned long arg)
+{
+	struct m77_raw_ring *ring;
+	struct ox16c954_port *p;
+	struct m77_raw rw;
+	unsigned long flags;
+	long retval = 0;
+
+	switch (cmd) {
+	case M77_RAW_SET:
+		if (copy_from_user(&rw, (void __user *)arg, sizeof(rw)))
+			return -EFAULT;
+		if (!rw.size)
+			rw.size = M77_RAW_SIZE_DEFAULT;
+		if (rw.line >= MAX_SNGL_UARTS || (rw.flags & ~M77_RAW_CHUNKS) ||
+			!is_power_of_2(rw.size) || rw.size < PAGE_SIZE || 
+			rw.size > M77_RAW_SIZE_MAX)
+			return -EINVAL;
+
+		mutex_lock(&cf->lock);
+		if (cf->tap) {
+			retval = -EBUSY;	/* file has the traffic tap */
+			goto set_out;
+		}
+		if (!cf->raw) {
+			ring = vmalloc_user(M77_RAW_DATA_OFF + rw.size);
+			if (!ring) {
+				retval = -ENOMEM;
+				goto set_out;
+			}
+			ring->size = rw.size;
+			cf->ring = ring;
+			cf->size = rw.size;
+			cf->raw = &men_uart_ports[rw.line];
+		} else if (rw.line != cf->raw->port.line || rw.size != cf->size) {
+			retval = -EINVAL;
+			goto set_out;
+		}
+		p 		= cf->raw;
+		ring 	= cf->ring;
+
+		spin_lock_irqsave(&p->port.lock, flags);
+		if (!rw.enable) {
+			if (p->rawRing == ring)
+				p->rawRing = NULL;
+		} else if (p->rawRing == ring) {
+			if (rw.flags != p->rawFlags)
+				retval = -EBUSY;
+		} else if (!men_uart_port_xmit(p))
+			retval = -ENODEV;
+		else if (men_uart_rx_bypass(p) || p->frmMode || p->linMode || 
+				 p->delimEnable)
+			retval = -EBUSY;	/* they use the received chars too */
+		else {
+			p->rawData 		= (unsigned char *)ring + M77_RAW_DATA_OFF;
+			p->rawMask 		= cf->size - 1;
+			p->rawFlags 	= rw.flags;
+			/* any head is fine, it is masked on every put */
+			p->rawHead 		= READ_ONCE(ring->head);
+			if (rw.flags & M77_RAW_CHUNKS)
+				p->rawHead = ALIGN(p->rawHead, 4);
+			ring->head 		= p->rawHead;
+			ring->flags 	= rw.flags;
+			p->rawRing 		= ring;
+		}
+		spin_unlock_irqrestore(&p->port.lock, flags);
+		wake_up_interruptible(&p->rawWait);
+	set_out:
+		mutex_unlock(&cf->lock);
+		break;
+
+	case M77_RAW_GET:
+		memset(&rw, 0, sizeof(rw));
+		mutex_lock(&cf->lock);
+		if (cf->raw) {
+			rw.enable 	= cf->raw->rawRing == cf->ring;
+			rw.line 	= cf->raw->port.line;
+			rw.size 	= cf->size;
+			rw.flags 	= cf->ring->flags;
+			rw.lost 	= cf->ring->lost;
+		}
+		mutex_unlock(&cf->lock);
+		if (copy_to_user((void __user *)arg, &rw, sizeof(rw)))
+			return -EFAULT;
+		break;
+	}
+
+	return retval;
+}
+
+
+/*******************************************************************/
+/** select the channels of the traffic tap
+ *
+ * \param lines		\IN bit n of lines[n / 32] for /dev/ttyDn
+ *
+ * \return 			-
+ */
+static void men_uart_tap_lines(const unsigned int *lines)
+{
+	struct ox16c954_port *p;
+	unsigned long flags;
+	unsigned int i;
+
+	for (i = 0; i < MAX_SNGL_UARTS; i++) {
+		p = &men_uart_ports[i];
+		spin_lock_irqsave(&p->port.lock, flags);
+		p->tapOn 	= !!(lines[i / 32] & (1U << (i % 32)));
+		p->tapCnt 	= 0;
+		p->tapLsr 	= 0;
+		spin_unlock_irqrestore(&p->port.lock, flags);
+	}
+}
+
+
+/*******************************************************************/
+/** M77_TAP_SET/GET on a /dev/m77ctl file
+ *
+ * \param cf		\IN state of the file
+ * \param cmd		\IN M77_TAP_SET or M77_TAP_GET
+ * \param arg		\IN user pointer to struct m77_tap
+ *
+ * \brief The first M77_TAP_SET allocates the tap ring, the size can't be
+ *        changed after. There is one tap for all channels, it ends when 
+ *        the file is closed.
+ *
+ * \return 			0 or negative error number
+ */
+static long men_uart_tap(struct m77_ctl_file *cf, unsigned int cmd,
+						 unsigned long arg)
+{
+	struct m77_raw_ring *ring;
+	struct m77_tap tp;
+	unsigned long flags;
+	long retval = 0;
+	unsigned int i;
+
+	switch (cmd) {
+	case M77_TAP_SET:
+		if (copy_from_user(&tp, (void __user *)arg, sizeof(tp)))
+			return -EFAULT;
+		if (!tp.size)
+			tp.size = M77_RAW_SIZE_DEFAULT;
+		if (!is_power_of_2(tp.size) || tp.size < PAGE_SIZE || 
+			tp.size > M77_RAW_SIZE_MAX)
+			return -EINVAL;
+
+		mutex_lock(&cf->lock);
+		if (cf->raw) {
+			retval = -EBUSY;	/* file is bound to a raw channel */
+			goto set_out;
+		}
+		if (!cf->tap) {
+			ring = vmalloc_user(M77_RAW_DATA_OFF + tp.size);
+			if (!ring) {
+				retval = -ENOMEM;
+				goto set_out;
+			}
+			ring->size = tp.size;
+
+			spin_lock_irqsave(&m77_tap_lock, flags);
+			if (m77TapRing)
+				retval = -EBUSY;	/* tap of another file */
+			else {
+				m77TapData 	= (unsigned char *)ring + M77_RAW_DATA_OFF;
+				m77TapMask 	= tp.size - 1;
+				m77TapHead 	= 0;
+				m77TapRing 	= ring;
+			}
+			spin_unlock_irqrestore(&m77_tap_lock, flags);
+			if (retval) {
+				vfree(ring);
+				goto set_out;
+			}
+			cf->ring 	= ring;
+			cf->size 	= tp.size;
+			cf->tap 	= 1;
+			M77_TAP_KEY(1);
+		} else if (tp.size != cf->size) {
+			retval = -EINVAL;
+			goto set_out;
+		}
+		men_uart_tap_lines(tp.lines);
+	set_out:
+		mutex_unlock(&cf->lock);
+		break;
 
-	/* Ok, we're now changing the port state. Do it with interrupts disabled. */
-	spin_lock_irqsave(&up->port.lock, flags);
+	case M77_TAP_GET:
+		memset(&tp, 0, sizeof(tp));
+		mutex_lock(&cf->lock);
+		if (cf->tap) {
+			for (i = 0; i < MAX_SNGL_UARTS; i++)
+				if (men_uart_ports[i].tapOn)
+					tp.lines[i / 32] |= 1U << (i % 32);
+			tp.size = cf->size;
+			tp.lost = cf->ring->lost;
+		}
+		mutex_unlock(&cf->lock);
+		if (copy_to_user((void __user *)arg, &tp, sizeof(tp)))
+			return -EFAULT;
+		break;
+	}
 
-	/* Update the per-port timeout. */
-	uart_update_timeout(port, termios->c_cflag, baud);
+	return retval;
+}
 
-	up->port.read_status_mask = UART_LSR_OE | UART_LSR_THRE | UART_LSR_DR;
-	if (termios->c_iflag & INPCK)
-		up->port.read_status_mask |= UART_LSR_FE | UART_LSR_PE;
-	if (termios->c_iflag & (BRKINT | PARMRK))
-		up->port.read_status_mask |= UART_LSR_BI;
 
-	/* Characteres to ignore */
-	up->port.ignore_status_mask = 0;
-	if (termios->c_iflag & IGNPAR)
-		up->port.ignore_status_mask |= UART_LSR_PE | UART_LSR_FE;
-	if (termios->c_iflag & IGNBRK) {
-		up->port.ignore_status_mask |= UART_LSR_BI;
-		/*
-		 * If we're ignoring parity and break indicators,
-		 * ignore overruns too (for real raw support).
-		 */
-		if (termios->c_iflag & IGNPAR)
-			up->port.ignore_status_mask |= UART_LSR_OE;
-	}
+/*******************************************************************/
+/** Ioctl function of the control device /dev/m77ctl
+ *
+ * \param filp		\IN file of the control device
+ * \param cmd		\IN M77_BATCH_ATTACH, M77_BATCH_IO, M77_RAW_SET/GET or
+ *                      M77_TAP_SET/GET
+ * \param arg		\IN user pointer to struct m77_batch_lines, m77_batch,
+ *                      m77_raw or m77_tap
+ *
+ * \brief M77_BATCH_IO does reads and writes on many channels with one 
+ *        call. The structs are the same for 32 and 64 bit processes.
+ *
+ * \return 			0 or negative error number
+ */
+static long m77_ctl_ioctl(struct file *filp, unsigned int cmd, 
+						  unsigned long arg)
+{
+	struct m77_ctl_file *cf = filp->private_data;
+	struct m77_batch_entry *ent;
+	struct m77_batch_lines bl;
+	unsigned char *bounce;
+	struct m77_batch b;
+	unsigned long tmo;
+	long retval = 0, rv;
+	unsigned int i;
 
-	/* ignore all characters if CREAD is not set */
-	if ((termios->c_cflag & CREAD) == 0)
-		up->port.ignore_status_mask |= UART_LSR_DR;
+	switch (cmd) {
+	case M77_BATCH_ATTACH:
+		if (copy_from_user(&bl, (void __user *)arg, sizeof(bl)))
+			return -EFAULT;
+
+		for (i = 0; i < MAX_SNGL_UARTS; i++) {
+			if (bl.lines[i / 32] & (1U << (i % 32))) {
+				if (men_uart_batch_attach(&men_uart_ports[i], cf))
+					bl.lines[i / 32] &= ~(1U << (i % 32));
+			} else
+				men_uart_batch_detach(&men_uart_ports[i], cf);
+		}
+		if (copy_to_user((void __user *)arg, &bl, sizeof(bl)))
+			return -EFAULT;
+		break;
 
-	/* CTS flow control flag and modem status interrupts */
-	up->ier &= ~UART_IER_MSI;
-	if (!(up->bugs & UART_BUG_NOMSR) &&
-			UART_ENABLE_MS(&up->port, termios->c_cflag))
-		up->ier |= UART_IER_MSI;
-	if (up->capabilities & UART_CAP_UUE)
-		up->ier |= UART_IER_UUE | UART_IER_RTOIE;
-	serial_out(up, UART_IER, up->ier);
+	case M77_BATCH_IO:
+		if (copy_from_user(&b, (void __user *)arg, sizeof(b)))
+			return -EFAULT;
+		if (!b.num || b.num > M77_BATCH_MAX)
+			return -EINVAL;
 
-	if ( termios->c_cflag & CRTSCTS ) {
-		if ( up->type != MOD_M77 ) {
+		ent = kmalloc(b.num * sizeof(*ent), GFP_KERNEL);
+		bounce = kmalloc(M77_BATCH_RING, GFP_KERNEL);
+		if (!ent || !bounce) {
+			retval = -ENOMEM;
+			goto io_out;
+		}
+		if (copy_from_user(ent, (void __user *)(unsigned long)b.entries,
+						   b.num * sizeof(*ent))) {
+			retval = -EFAULT;
+			goto io_out;
+		}
 
-			efr |= UART_EFR_CTS;
-			M77DBG3(" - HW Flow Control (RTS/CTS)\n");
-		} else {
-			/* Dont use RTS/CTS Handshake setting on M77! */
-			printk(KERN_INFO "*** Module is a M77 - ignoring Flag CRTSCTS\n");
+		if (b.flags & M77_BATCH_WAIT) {
+			tmo = b.timeoutMs ? msecs_to_jiffies(b.timeoutMs) : 
+				MAX_SCHEDULE_TIMEOUT;
+			rv = wait_event_interruptible_timeout(m77_batch_wait,
+						men_uart_batch_ready(ent, b.num), tmo);
+			if (rv < 0) {
+				retval = rv;
+				goto io_out;
+			}
 		}
-	}
 
-	/* Apply to Register */
-	serial_efr_write(up, UART_EFR, efr );
+		for (i = 0; i < b.num; i++)
+			ent[i].result = men_uart_batch_entry(&ent[i], bounce);
 
-	/* Inband XON/XOFF Flow Control desired? */
-	if (termios->c_iflag & (IXON|IXOFF)) {
-		serial_efr_write(up, M77_XON1_OFFSET, 	M77_XON_CHAR );
-		serial_efr_write(up, M77_XON2_OFFSET, 	M77_XON_CHAR );        
-		serial_efr_write(up, M77_XOFF1_OFFSET, 	M77_XOFF_CHAR );       
- 		serial_efr_write(up, M77_XOFF2_OFFSET, 	M77_XOFF_CHAR );       
-		M77DBG3(" - SW Flow Control IXON/IXOFF\n");
-		set_inband_flowctrl(up, 1 );
- 	} else {
-		set_inband_flowctrl(up, 0 );
-	}
-	
-	/*  Set Baudrate Divider. M45N/69N/77 uartclk is always 18,432 MHz */
-	serial_out(up, UART_LCR, cval | UART_LCR_DLAB);
-	serial_out(up, UART_DLL, quot & 0xff);			
-	serial_out(up, UART_DLM, quot >> 8);			
+		if (copy_to_user((void __user *)(unsigned long)b.entries, ent,
+						 b.num * sizeof(*ent)))
+			retval = -EFAULT;
+	io_out:
+		kfree(bounce);
+		kfree(ent);
+		break;
 
-	/*
-	 * LCR DLAB must be set to enable 64-byte FIFO mode. If the FCR
-	 * is written without DLAB set, this mode will be disabled.
-	 */
-	if (up->port.type == PORT_16750)
-		serial_out(up, UART_FCR, fcr);
+	case M77_RAW_SET:
+	case M77_RAW_GET:
+		retval = men_uart_raw(filp->private_data, cmd, arg);
+		break;
 
-	serial_out(up, UART_LCR, cval);		/* reset DLAB */
+	case M77_TAP_SET:
+	case M77_TAP_GET:
+		retval = men_uart_tap(filp->private_data, cmd, arg);
+		break;
 
-	up->lcr = cval;					    /* Save LCR */
-	if (up->port.type != PORT_16750) {
+#ifdef M77_HAS_NETDEV
+	case M77_NET_SET:
+		retval = men_uart_net_set(arg);
+		break;
+#endif
 
-		if (fcr & UART_FCR_ENABLE_FIFO) {
-			/* emulated UARTs (Lucent Venus 167x) need two steps */
-			serial_out(up, UART_FCR, UART_FCR_ENABLE_FIFO);
-		}
-		serial_out(up, UART_FCR, fcr);		/* set fcr */
+	default:
+		retval = -ENOTTY;
+		break;
 	}
 
-	men_uart_set_mctrl(&up->port, up->port.mctrl);
-	spin_unlock_irqrestore(&up->port.lock, flags);
+	return retval;
 }
 
-
-static void
-men_uart_pm(struct uart_port *port, unsigned int state, unsigned int oldstate)
+/*******************************************************************/
+/** open function of the control device
+ *
+ * \param inode		\IN inode of /dev/m77ctl
+ * \param filp		\IN new file
+ *
+ * \return 			0 or negative error number
+ */
+static int m77_ctl_open(struct inode *inode, struct file *filp)
 {
-	/* No special Powermanagement for our M Modules */
-	do { } while (0);
+	struct m77_ctl_file *cf = kzalloc(sizeof(*cf), GFP_KERNEL);
 
+	if (!cf)
+		return -ENOMEM;
+	mutex_init(&cf->lock);
+	filp->private_data = cf;
+	return 0;
 }
 
 
-static void men_uart_release_port(struct uart_port *port)
+/*******************************************************************/
+/** release function of the control device
+ *
+ * \param inode		\IN inode of /dev/m77ctl
+ * \param filp		\IN file, unmapped already
+ *
+ * \brief A channel in raw mode goes back to tty mode, the traffic tap
+ *        of the file ends, channels attached for batch I/O are given 
+ *        back to their tty.
+ *
+ * \return 			0
+ */
+static int m77_ctl_release(struct inode *inode, struct file *filp)
 {
-	/* Not necessary for M-Modules */
-}
+	struct m77_ctl_file *cf = filp->private_data;
+	static const unsigned int none[2];
+	unsigned long flags;
+	unsigned int i;
 
-static int men_uart_request_port(struct uart_port *port)
-{
-	/* Not necessary for M-Modules */
+	for (i = 0; i < MAX_SNGL_UARTS; i++)
+		men_uart_batch_detach(&men_uart_ports[i], cf);
+
+	if (cf->tap) {
+		men_uart_tap_lines(none);
+		spin_lock_irqsave(&m77_tap_lock, flags);
+		m77TapRing = NULL;
+		spin_unlock_irqrestore(&m77_tap_lock, flags);
+		M77_TAP_KEY(0);
+		vfree(cf->ring);
+	}
+
+	if (cf->raw) {
+		spin_lock_irqsave(&cf->raw->port.lock, flags);
+		if (cf->raw->rawRing == cf->ring)
+			cf->raw->rawRing = NULL;
+		spin_unlock_irqrestore(&cf->raw->port.lock, flags);
+		vfree(cf->ring);
+	}
+	kfree(cf);
 	return 0;
 }
 
 
-/******************************************************************************/
-/** highlevel UART Port config function
+/*******************************************************************/
+/** mmap function of the control device, maps the raw or tap ring
  *
- * \param port			\IN 	highlevel UART Port Struct
- * \param flags			\IN 	optional flags to control probing
+ * \param filp		\IN file set up with M77_RAW_SET or M77_TAP_SET
+ * \param vma		\IN user mapping
  *
- * \return 				-
+ * \return 			0 or negative error number
  */
-static void men_uart_config_port(struct uart_port *port, int flags)
+static int m77_ctl_mmap(struct file *filp, struct vm_area_struct *vma)
 {
-	struct ox16c954_port *up = (struct ox16c954_port *)port;
-	int probeflags = ~0;
-
-	if (flags & UART_CONFIG_TYPE)
-		autoconfig(up, probeflags);
+	struct m77_ctl_file *cf = filp->private_data;
+	int retval = -EINVAL;
 
+	mutex_lock(&cf->lock);
+	if (cf->ring)
+		retval = remap_vmalloc_range(vma, cf->ring, vma->vm_pgoff);
+	mutex_unlock(&cf->lock);
+	return retval;
 }
 
 
-/*****************************************************************************/
-/** return next free UART from internal UART Array
- *
- * \param port			\IN 	highlevel UART Port Struct
+/*******************************************************************/
+/** poll function of the control device, the only syscall of a raw reader
  *
- * \brief  We are free to use the ttyDxx entries by ourselves 
- * 		   So just return the next free men_uart_ports[i].port.
- * 		   This is simplified from serial8250_find_match_or_unused().
+ * \param filp		\IN file set up with M77_RAW_SET or M77_TAP_SET
+ * \param wait		\IN poll table
  *
- * \return 				pointer to port struct
+ * \return 			POLLIN if the raw/tap ring isn't empty, POLLHUP if the
+ *                  channel is not in raw mode (any more)
  */
-static struct 
-ox16c954_port *men_uart_find_match_or_unused(struct uart_port *port)
+static unsigned int m77_ctl_poll(struct file *filp, poll_table *wait)
 {
-	int i;
-	/* simply return the first entry which hasnt already a membase entry */
-	for (i = 0; i < MAX_SNGL_UARTS; i++) {
-		if ( !men_uart_ports[i].port.membase ) {
-			M77DBG3("%s: return UART nr. %d\n", __FUNCTION__, i);
-			return &men_uart_ports[i];
-		}	
+	struct m77_ctl_file *cf = filp->private_data;
+	struct ox16c954_port *p;
+	unsigned int mask = 0;
+
+	/* M77_RAW_SET/M77_TAP_SET may free the ring meanwhile */
+	mutex_lock(&cf->lock);
+	p = cf->raw;
+	if (cf->tap) {
+		poll_wait(filp, &m77_tap_wait, wait);
+		if (READ_ONCE(cf->ring->head) != READ_ONCE(cf->ring->tail))
+			mask = POLLIN | POLLRDNORM;
+	} else if (!p)
+		mask = POLLERR;
+	else {
+		poll_wait(filp, &p->rawWait, wait);
+		if (READ_ONCE(cf->ring->head) != READ_ONCE(cf->ring->tail))
+			mask = POLLIN | POLLRDNORM;
+		else if (p->rawRing != cf->ring)
+			mask = POLLHUP;
 	}
-	return NULL;
+	mutex_unlock(&cf->lock);
+	return mask;
 }
 
 
+static const struct file_operations m77_ctl_fops = {
+	.owner			= THIS_MODULE,
+	.open			= m77_ctl_open,
+	.release		= m77_ctl_release,
+	.mmap			= m77_ctl_mmap,
+	.poll			= m77_ctl_poll,
+	.unlocked_ioctl	= m77_ctl_ioctl,
+	.compat_ioctl	= m77_ctl_ioctl,
+};
 
-static int men_uart_verify_port(struct uart_port *port, 
-								struct serial_struct *ser)
-{
-	/* shouldnt hurt to report us to serial core as always existing */
-	return 0;
-}
+static struct miscdevice m77_ctl_dev = {
+	.minor			= MISC_DYNAMIC_MINOR,
+	.name			= M77_CTL_NAME,
+	.fops			= &m77_ctl_fops,
+};
 
 
+#ifdef M77_HAS_KCLIENT
+/* serializes open, close and setting up of in-kernel clients */
+static DEFINE_MUTEX(m77_kcli_mutex);
 
-/*****************************************************************************/
-/** Function to register each 4 or 8 UART Channels of a M-Module at serial core
+/*******************************************************************/
+/** find the channel of an in-kernel client in the kclient parameter
  *
- * \param port		\IN    highlevel UART Port Struct
- * \param modtype	\IN    Module ID as in 13m07790.xml
- * \param nrLine	\IN    UART Line number as in /dev/ttyDn
- * \param glob		\OUT   returned OX16C954 UART, stored in UARTMOD_INFO array
+ * \param name		\IN client name
+ * \param line		\OUT channel
+ * \param baud		\OUT baud rate, 9600 if not given
  *
- * \return 				0 or negative error number
+ * \return 			0 or -ENODEV
  */
-int men_uart_register_port(struct uart_port *port, 
-						   unsigned int modtype,
-						   unsigned int nrLine, 
-						   struct ox16c954_port **glob )
+static int men_uart_kcli_lookup(const char *name, unsigned int *line,
+								unsigned int *baud)
 {
-	struct ox16c954_port *uart;
-	int ret = -ENOSPC;
-	
-	/* For M45N: helper for TCRbit-to-Channelnumber mapping */
-	unsigned int tcr[8] = {M45_TCR_TRISTATE0, M45_TCR_TRISTATE1, 
-						   M45_TCR_TRISTATE2, M45_TCR_TRISTATE2,
-						   M45_TCR_TRISTATE3, M45_TCR_TRISTATE3,
-						   M45_TCR_TRISTATE4, M45_TCR_TRISTATE4 };
+	size_t len = strlen(name);
+	unsigned int i;
 
-	if (port->uartclk == 0)
-		return -EINVAL;
+	for (i = 0; i < M77_KCLIENT_MAX; i++) {
+		if (!kclient[i] || strncmp(kclient[i], name, len) || 
+			kclient[i][len] != ':')
+			continue;
+		*baud = 9600;
+		if (sscanf(kclient[i] + len + 1, "%u:%u", line, baud) >= 1 &&
+			*line < MAX_SNGL_UARTS && *baud)
+			return 0;
+	}
+	return -ENODEV;
+}
 
-	down( &serial_sem );
 
-	/* take one UART from the global ox16c954_port array */
-	uart = men_uart_find_match_or_unused(port);
+/*******************************************************************/
+/** channel of an in-kernel client
+ *
+ * \param kc		\IN client
+ *
+ * \return 			Oxford 16C954 Port Struct, NULL if kc doesn't own it
+ */
+static struct ox16c954_port *men_uart_kcli_port(struct m77_kclient *kc)
+{
+	if (kc->line < 0 || kc->line >= MAX_SNGL_UARTS || 
+		men_uart_ports[kc->line].kcli != kc)
+		return NULL;
+	return &men_uart_ports[kc->line];
+}
 
-	if (uart) {
-		uart->port.iobase   	= port->iobase;
-		uart->port.membase  	= port->membase;
-		uart->port.irq      	= port->irq;
-		uart->port.uartclk  	= port->uartclk;
-		uart->port.fifosize 	= port->fifosize;
-		uart->port.regshift 	= port->regshift;
-		uart->port.iotype   	= port->iotype;
-		uart->port.flags    	= port->flags;
-		uart->port.mapbase  	= port->mapbase;
 
-		/* for runtime-ioctl calls remember if we are a M45N, M69N or M77 */
-		uart->type				= modtype;
+/*******************************************************************/
+/** set 8N1, baud rate and flow control of an in-kernel client
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \return 			baud rate set
+ */
+static unsigned int men_uart_kcli_termios(struct ox16c954_port *up)
+{
+	struct ktermios t;
 
-		switch (uart->type) {
-		case MOD_M77:
-			uart->dcrReg = M77_DCR_REG_BASE + nrLine;
-			break;
+	memset(&t, 0, sizeof(t));
+	t.c_cflag = CS8 | CREAD | CLOCAL | (up->kcFlow ? CRTSCTS : 0);
+	tty_termios_encode_baud_rate(&t, up->kcBaud, up->kcBaud);
+	men_uart_set_termios(&up->port, &t, NULL);
 
-		case MOD_M45:
-			uart->tcrReg = (nrLine < 4) ? M45_TCR1_REG : M45_TCR2_REG;
-			uart->tcrBit = tcr[nrLine];	
-			break;
-		}
+	/* uart_get_baud_rate() put in what the UART can do */
+	up->kcBaud = tty_termios_baud_rate(&t);
+	return up->kcBaud;
+}
 
-#if 0
-		printk( KERN_INFO "men_uart_register_port:\n");
-		printk( KERN_INFO "uart->port.iobase   = 0x%08x\n",uart->port.iobase);
-		printk( KERN_INFO "uart->port.membase  = 0x%08x\n",uart->port.membase);
-		printk( KERN_INFO "uart->port.irq      = 0x%02x\n",uart->port.irq);
-		printk( KERN_INFO "uart->port.uartclk  = %ld\n",uart->port.uartclk);
-		printk( KERN_INFO "uart->port.fifosize = %d\n", uart->port.fifosize );
-		printk( KERN_INFO "uart->port.regshift = %d\n", uart->port.regshift );
-		printk( KERN_INFO "uart->port.iotype   = 0x%08x\n", uart->port.iotype);
-		printk( KERN_INFO "uart->port.flags    = 0x%08x\n",uart->port.flags );
-		printk( KERN_INFO "uart->port.mapbase  = 0x%08x\n",uart->port.mapbase);
-#endif
 
-		if (port->dev)
-			uart->port.dev = port->dev;
+/*******************************************************************/
+/** start a channel for an in-kernel client
+ *
+ * \param kc		\IN client
+ * \param line		\IN channel
+ * \param baud		\IN baud rate
+ *
+ * \brief The channel is started as the tty would do it, the tty can't
+ *        be opened until m77_kclient_close(). May sleep.
+ *
+ * \return 			0 or negative error number
+ */
+static int men_uart_kcli_attach(struct m77_kclient *kc, unsigned int line,
+								unsigned int baud)
+{
+	struct ox16c954_port *up = &men_uart_ports[line];
+	unsigned long flags;
+	char *buf;
+	int retval = 0;
+
+	if (up->port.type == PORT_UNKNOWN)
+		return -ENODEV;
+
+	buf = kmalloc(UART_XMIT_SIZE, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
 
-		ret = uart_add_one_port(&men_uart_reg, &uart->port);
-		
-		/* give back this OX16C954 UART for storing in UARTMOD_INFO array */
-		*glob = uart;
+	mutex_lock(&m77_kcli_mutex);
+	spin_lock_irqsave(&up->port.lock, flags);
+	if (up->kcli || men_uart_port_xmit(up))
+		retval = -EBUSY;	/* client or tty have it */
+	else if ((retval = men_uart_m45_claim(up)) == 0) {
+		up->kcXmit.buf 	= buf;
+		up->kcXmit.head = up->kcXmit.tail = 0;
+		up->kcBaud 		= baud;
+		up->kcFlow 		= 0;
+		up->kcWake 		= 0;
+		up->kcli 		= kc;
+	}
+	spin_unlock_irqrestore(&up->port.lock, flags);
+	if (retval) {
+		mutex_unlock(&m77_kcli_mutex);
+		kfree(buf);
+		return retval;
+	}
 
-		if (ret == 0)
-			ret = uart->port.line;
-	} 
+	kc->line = line;
+	__men_uart_startup(&up->port);
+	men_uart_kcli_termios(up);
 
-	up(&serial_sem);
-	return ret;
+	spin_lock_irqsave(&up->port.lock, flags);
+	up->port.mctrl |= TIOCM_DTR | TIOCM_RTS;
+	men_uart_set_mctrl(&up->port, up->port.mctrl);
+	spin_unlock_irqrestore(&up->port.lock, flags);
+	mutex_unlock(&m77_kcli_mutex);
+
+	printk(KERN_INFO "%s%d: in-kernel client %s, %u baud\n", 
+		   men_uart_reg.dev_name, line, kc->name, up->kcBaud);
+	return 0;
 }
 
+
 /*******************************************************************/
-/** Remove one serial port
+/** take the channel of an in-kernel client
  *
- * \param line		\IN serial line number
+ * \param kc		\IN client, name set
  *
- * \return 			-
+ * \brief The channel is given by the kclient module parameter. May sleep.
+ *
+ * \return 			0 or negative error number
  */
-void men_uart_unregister_port(int line)
+int m77_kclient_open(struct m77_kclient *kc)
 {
-	struct ox16c954_port *uart = &men_uart_ports[line];
-	
-	down(&serial_sem);
-	uart_remove_one_port( &men_uart_reg, &uart->port);
-	uart->port.dev = NULL;
-	up(&serial_sem);
-}
+	unsigned int line, baud;
 
+	kc->line = -1;
+	if (!kc->name || !kc->receive_buf || 
+		men_uart_kcli_lookup(kc->name, &line, &baud))
+		return -ENODEV;
+	return men_uart_kcli_attach(kc, line, baud);
+}
+EXPORT_SYMBOL_GPL(m77_kclient_open);
 
 
 /*******************************************************************/
-/** return Port type name
+/** give back the channel of an in-kernel client
  *
- * \param port		\IN 	highlevel UART Port Struct
+ * \param kc		\IN client opened with m77_kclient_open()
  *
- * \return 			char pointer to string, typically "16C954" here
+ * \brief Chars not sent yet are lost. receive_buf is not called any more
+ *        when this returns. May sleep.
+ *
+ * \return 			-
  */
-static const char *men_uart_type(struct uart_port *port)
+void m77_kclient_close(struct m77_kclient *kc)
 {
-	int type = port->type;
+	struct ox16c954_port *up;
+	unsigned long flags;
+	char *buf;
 
-	if (type >= ARRAY_SIZE(uart_config))
-		type = 0;
-	return uart_config[type].name;
-}
+	mutex_lock(&m77_kcli_mutex);
+	up = men_uart_kcli_port(kc);
+	if (!up) {
+		mutex_unlock(&m77_kcli_mutex);
+		return;
+	}
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	up->port.mctrl &= ~(TIOCM_DTR | TIOCM_RTS);
+	men_uart_set_mctrl(&up->port, up->port.mctrl);
+	spin_unlock_irqrestore(&up->port.lock, flags);
+	men_uart_shutdown(&up->port);
+
+	spin_lock_irqsave(&up->port.lock, flags);
+	up->kcli 		= NULL;
+	buf 			= up->kcXmit.buf;
+	up->kcXmit.buf 	= NULL;
+	spin_unlock_irqrestore(&up->port.lock, flags);
 
+	/* an ISR on another CPU may still be in receive_buf */
+	wait_event(up->kcWait, !READ_ONCE(up->kcInCb));
+	mutex_unlock(&m77_kcli_mutex);
+	kfree(buf);
+}
+EXPORT_SYMBOL_GPL(m77_kclient_close);
 
 
 /*******************************************************************/
-/** Initialize the global Array of Oxford UARTs
+/** send chars of an in-kernel client
  *
+ * \param kc		\IN client opened with m77_kclient_open()
+ * \param buf		\IN chars
+ * \param count		\IN number of chars
+ *
+ * \brief Can be called from any context, also from receive_buf.
+ *
+ * \return 			number of chars queued, less if the buffer is full,
+ *                  or negative error number
  */
-static void men_uart_init_ports(void)
+int m77_kclient_write(struct m77_kclient *kc, const unsigned char *buf,
+					  size_t count)
 {
+	struct ox16c954_port *up = men_uart_kcli_port(kc);
+	unsigned long flags;
+	int n = -ENODEV;
 
-	unsigned int i;
+	if (!up)
+		return n;
 
-	for (i = 0; i < MAX_SNGL_UARTS; i++) {
-		struct ox16c954_port *up = &men_uart_ports[i];
+	spin_lock_irqsave(&up->port.lock, flags);
+	if (up->kcli == kc) {
+		n = men_uart_xmit_put(&up->kcXmit, buf, 
+							  min_t(size_t, count, UART_XMIT_SIZE));
+		if (n)
+			men_uart_oob_kick(up);
+	}
+	spin_unlock_irqrestore(&up->port.lock, flags);
+	return n;
+}
+EXPORT_SYMBOL_GPL(m77_kclient_write);
 
-		up->port.line 		= 	i;
-		spin_lock_init(&up->port.lock);
 
-		up->timer.function 	= NULL /* serial8250_timeout */;
-		up->mcr_mask 		= ~0;
-		up->mcr_force 		= 0;
-		up->port.ops 		= &men_uart_pops;
+/*******************************************************************/
+/** change the baud rate of an in-kernel client
+ *
+ * \param kc		\IN client opened with m77_kclient_open()
+ * \param baud		\IN baud rate
+ *
+ * \brief May sleep.
+ *
+ * \return 			baud rate set, 0 if not open
+ */
+unsigned int m77_kclient_set_baudrate(struct m77_kclient *kc,
+									  unsigned int baud)
+{
+	struct ox16c954_port *up;
+	unsigned int ret = 0;
+
+	mutex_lock(&m77_kcli_mutex);
+	if ((up = men_uart_kcli_port(kc))) {
+		up->kcBaud = baud;
+		ret = men_uart_kcli_termios(up);
 	}
+	mutex_unlock(&m77_kcli_mutex);
+	return ret;
 }
+EXPORT_SYMBOL_GPL(m77_kclient_set_baudrate);
 
 
 /*******************************************************************/
-/** Deinitialize all registered M-Modules
+/** switch RTS/CTS flow control of an in-kernel client
+ *
+ * \param kc		\IN client opened with m77_kclient_open()
+ * \param enable	\IN 1: on, 0: off
+ *
+ * \brief May sleep.
  *
  * \return 			-
  */
-static void deinit_devices(void)
+void m77_kclient_set_flow_control(struct m77_kclient *kc, int enable)
 {
-
- 	UARTMOD_INFO *mmod;
-	struct list_head *tmp, *element;
 	struct ox16c954_port *up;
-	unsigned int i;
 
-	/*
-	 * 1. shutdown all UARTs physically 
-	 */
-	for (i=0; i < MAX_SNGL_UARTS ; i++) {
-		if ( men_uart_ports[i].port.membase ) 
-		{
-			M77DBG3(KERN_INFO "deinit port %d\n", i);
-			up = (struct ox16c954_port *)&men_uart_ports[i].port;
-			serial_out(up, 	UART_IER, 0);
-			serial_out(up, 	UART_LCR, 0);
-			serial_icr_write(up, UART_CSR, 0); /* Reset the UART */
-			/* unregister the UARTs from the driver subsystem */
-			men_uart_unregister_port( i );
-		}	
+	mutex_lock(&m77_kcli_mutex);
+	if ((up = men_uart_kcli_port(kc))) {
+		up->kcFlow = !!enable;
+		men_uart_kcli_termios(up);
 	}
+	mutex_unlock(&m77_kcli_mutex);
+}
+EXPORT_SYMBOL_GPL(m77_kclient_set_flow_control);
+#endif /* M77_HAS_KCLIENT */
+
+
+#ifdef M77_HAS_NETDEV
+/** network interface of a channel, netdev_priv() */
+struct m77_net_priv {
+	struct m77_kclient	kc;			/* owns the channel while up		*/
+	struct net_device	*dev;
+	struct hrtimer		txTimer;	/* wakes the queue after the gap	*/
+	unsigned int		line;		/* channel							*/
+	unsigned int		baud;		/* baud rate						*/
+	unsigned int		gap;		/* idle gap in unit					*/
+	unsigned char		unit;		/* M77_IDLE_BITS or M77_IDLE_US		*/
+	int					delim;		/* packet end char, -1: gap only	*/
+	unsigned int		ttyGap;		/* idle gap of the tty, given back	*/
+	unsigned char		ttyUnit;	/* its unit							*/
+	unsigned long		overBase;	/* icount.overrun - rx_fifo_errors	*/
+	unsigned long		collBase;	/* echoCollisions - collisions		*/
+	unsigned long		lateBase;	/* netTaLate - tx_window_errors		*/
+};
 
-	/*
-	 * 2. Unregister everything in the MDIS context (external MDIS devices) 
-	 */
-	M77DBG2(KERN_INFO "Unregister external MDIS devices\n");
-    list_for_each( tmp, &G_uartModListHead ) {
-		mmod = list_entry(tmp, UARTMOD_INFO, head);
-		if (mmod->mdisDev) {			
-			M77DBG2(KERN_INFO "Closing Device %s \n",mmod->deviceName);
+/* network interfaces by channel, changed under m77_net_mutex */
+static struct net_device *m77Net[MAX_SNGL_UARTS];
+static DEFINE_MUTEX(m77_net_mutex);
 
-			/* clear any left Interrupt & disable them */
-			control_out(mmod->memBase, M77_REG_IR, 0x01 );
-			control_out(mmod->memBase, M77_REG_IR, 0x00 );
+/*******************************************************************/
+/** receive_buf of a network interface before the frame engine is on
+ *
+ * \param kc		\IN client of the interface
+ * \param buf		\IN chars
+ * \param count		\IN number of chars
+ *
+ * \return 			count, the chars are dropped
+ */
+static int men_uart_net_kcli_rx(struct m77_kclient *kc, 
+								const unsigned char *buf, size_t count)
+{
+	return count;
+}
 
-			/* Clear TCR/DCR Registers back to powerup values*/
-			if (mmod->modtype == MOD_M77) {
-				for (i = M77_DCR_REG_BASE; i < M77_DCR_REG_BASE + 4; i++ )
-					control_out(mmod->memBase, i << 1, M77_RS422_HD );
-			}
 
-			if (mmod->modtype == MOD_M45) {
-				control_out(mmod->memBase, M45_REG_IR2, 		0x01 );
-				control_out(mmod->memBase, M45_REG_IR2, 		0x00 );
-				control_out(mmod->memBase, M45_TCR1_REG << 1, 	0x00 );
-				control_out(mmod->memBase, M45_TCR2_REG << 1, 	0x00 );
-			}
-			M77DBG2(KERN_INFO "Closing external device %s \n",mmod->deviceName);
-			mdis_close_external_dev( mmod->mdisDev );
-		}
+/*******************************************************************/
+/** pass a received frame up as packet
+ *
+ * \param up		\IN Oxford 16C954 Port Struct
+ * \param len		\IN chars in frmBuf
+ *
+ * \brief Frames with LSR or CRC errors and truncated frames are dropped
+ *        and counted in the netdev error stats. 
+ *        Must be called with the port lock held.
+ *
+ * \return 			-
+ */
+static void men_uart_net_rx(struct ox16c954_port *up, unsigned int len)
+{
+	struct net_device *dev = up->net;
+	struct sk_buff *skb;
+
+	if ((up->frmStat & (M77_FRM_CRCERR | M77_FRM_TRUNC)) || up->frmLsr) {
+		dev->stats.rx_errors++;
+		if (up->frmStat & M77_FRM_CRCERR)
+			dev->stats.rx_crc_errors++;
+		if (up->frmStat & M77_FRM_TRUNC)
+			dev->stats.rx_length_errors++;
+		if (up->frmLsr & UART_LSR_OE)
+			dev->stats.rx_over_errors++;
+		if (up->frmLsr & (UART_LSR_BI | UART_LSR_PE | UART_LSR_FE))
+			dev->stats.rx_frame_errors++;
+		return;
 	}
-	/*
-	 * 3. kfree kmalloc'ed memory and resources
-	 */
-	list_for_each_safe(element, tmp, &G_uartModListHead) { // Liste freigeben
-		mmod = list_entry(element, UARTMOD_INFO, head);
-		M77DBG2(KERN_INFO "Now freeing space for '%s'\n", mmod->deviceName );
-		list_del( element );
-		kfree( list_entry( element, UARTMOD_INFO, head));
-    }
 
+	skb = dev_alloc_skb(len);
+	if (!skb) {
+		dev->stats.rx_dropped++;
+		return;
+	}
+	memcpy(skb_put(skb, len), up->frmBuf, len);
+	skb->dev 		= dev;
+	skb->protocol 	= htons(ETH_P_SLIP);
+	skb_reset_mac_header(skb);
+
+	if (netif_rx(skb) == NET_RX_DROP)
+		dev->stats.rx_dropped++;
+	else {
+		dev->stats.rx_packets++;
+		dev->stats.rx_bytes += len;
+	}
 }
 
 
 /*******************************************************************/
-/** Select the M77 phymode
+/** last chars of a packet loaded into the FIFO
  *
- * \param mod		\IN  per-module struct of M-Module data
+ * \param up		\IN Oxford 16C954 Port Struct
+ *
+ * \brief The next packet may go out when the FIFO ran empty and the line
+ *        was idle for the gap, else the receivers would see one packet.
+ *        The FIFO holds the chars loaded now plus at most the TX trigger
+ *        level left from before. Must be called with the port lock held.
  *
  * \return 			-
  */
-static void	parse_m77_phyinfo( UARTMOD_INFO *mmod_data, unsigned int idx )
+static void men_uart_net_tx_done(struct ox16c954_port *up)
 {
+	struct m77_net_priv *np = netdev_priv(up->net);
 
-    unsigned int j = 0, m77mode=0;
-	for ( j = 0; j < 4; j++ ) {
-
-		mmod_data->mode[j] = 0;
-		mmod_data->echo[j] = 0;
-		m77mode = mode[(idx*4) + j];
-
-		if (m77mode) {
-			/* sanity check of passed mode */
-			if ( (m77mode == M77_RS422_FD) || (m77mode == M77_RS422_HD) ||
-				 (m77mode == M77_RS485_HD) || (m77mode == M77_RS485_FD) ||
-				 (m77mode == M77_RS232)) {
-				mmod_data->mode[j] = m77mode;
-				mmod_data->echo[j] = !!echo[(idx*4) + j];
-				M77DBG("mmod_data->mode[%d] = %d  ", j, mmod_data->mode[j] );
-				M77DBG("mmod_data->echo[%d] = %d\n", j, mmod_data->echo[j] );
-			} else {
-				printk(KERN_ERR "** Parameter mode[%d]=%d invalid, ignored\n",
-					   j, m77mode );
-				mmod_data->mode[j] = 0;
-				mmod_data->echo[j] = 0;
-			}
-		}
-	}
+	hrtimer_start(&np->txTimer, 
+				  ns_to_ktime((u64)(up->txLoaded + up->ttl) * up->charNs + 
+							  up->t35Ns), HRTIMER_MODE_REL);
 }
 
 
 /*******************************************************************/
-/** Register the 4 or 8 UART Channels of this M-Module 
+/** TX timer of a network interface, the line is idle again
  *
- * \param mod		\IN  per-module struct of M-Module data
+ * \param timer		\IN txTimer of the interface
  *
- * \return 			0 on success or error code
+ * \return 			HRTIMER_NORESTART
  */
-static int register_uarts(UARTMOD_INFO *mod )
+static enum hrtimer_restart men_uart_net_tx_timer(struct hrtimer *timer)
 {
-	int retval = 0, nrChan = 0 ;
-	unsigned char dcr_val = 0;
-	unsigned int tmpmode = 0;
-	struct ox16c954_port *ox; 
-	void *baseAdr;
+	struct m77_net_priv *np = 
+		container_of(timer, struct m77_net_priv, txTimer);
 
-	switch ( mod->modtype ) {
-	case MOD_M45:
-		mod->nrChannels = MOD_M45_CHAN_NUM;
-		break;
-	case MOD_M69:
-		mod->nrChannels = MOD_M69_CHAN_NUM;
-		break;
-	case MOD_M77:
-		mod->nrChannels = MOD_M77_CHAN_NUM;
-		break;
-	default: 
-		printk(KERN_ERR "*** invalid M-Module type 0x%04x!\n", mod->modtype );
-		return -ENODEV;
-	}
+	netif_wake_queue(np->dev);
+	return HRTIMER_NORESTART;
+}
 
-	/*
-	 *	Enable Interrupts in the additional IR Registers on locations:
-	 *	M77:	0x48
-	 *	M69N:	0x48
-	 *	M45N:	0x48, 0xc8
-	 */
-	switch ( mod->modtype ) {
-	case MOD_M45:
-		M77DBG2("Init M45N Registers\n");
-		control_out( mod->memBase, M45_REG_IR1, M77_IR_IMASK );
-		control_out( mod->memBase, M45_REG_IR2, M77_IR_IMASK );
-		break;
 
-	case MOD_M69:
-		M77DBG2("Init M69N Register\n");
-		control_out( mod->memBase, M69_REG_IR, M77_IR_IMASK );
-		break;
+/*******************************************************************/
+/** send a packet, ndo_start_xmit
+ *
+ * \param skb		\IN packet
+ * \param dev		\IN network interface
+ *
+ * \brief The packet is queued in one go, so it goes out without gaps as
+ *        in frame TX mode. The queue stays stopped until it is out.
+ *
+ * \return 			NETDEV_TX_OK
+ */
+static netdev_tx_t men_uart_net_xmit(struct sk_buff *skb, 
+									 struct net_device *dev)
+{
+	struct m77_net_priv *np = netdev_priv(dev);
+	struct ox16c954_port *up = &men_uart_ports[np->line];
+	struct circ_buf *xmit = &up->kcXmit;
+	unsigned long flags;
 
-	case MOD_M77:
-		/* On M77 also enable the galvanic isolated Drivers */
-		M77DBG2("Init M77 Register \n");		
-		control_out( mod->memBase, M77_REG_IR, M77_IR_IMASK | M77_IR_DRVEN );
-		break;
+	spin_lock_irqsave(&up->port.lock, flags);
+	if (up->net != dev || !skb->len || 
+		CIRC_SPACE(xmit->head, xmit->tail, UART_XMIT_SIZE) < skb->len)
+		dev->stats.tx_dropped++;
+	else {
+		men_uart_xmit_put(xmit, skb->data, skb->len);
+		dev->stats.tx_packets++;
+		dev->stats.tx_bytes += skb->len;
+		netif_stop_queue(dev);
+		men_uart_oob_kick(up);
 	}
+	spin_unlock_irqrestore(&up->port.lock, flags);
 
+	dev_kfree_skb(skb);
+	return NETDEV_TX_OK;
+}
 
-	/*  Register all channels of this M-Module  */
-	for ( nrChan = 0; nrChan < mod->nrChannels; nrChan++ ) {
-		dcr_val = 0;
-		mod->uart.flags 	= UPF_SHARE_IRQ | UPF_BOOT_AUTOCONF;
-		mod->uart.uartclk 	= MM_UARTCLK;
-		mod->uart.iotype 	= UPIO_MEM;
-		mod->uart.irq 		= 0xff; /* dummy Info, unused by this driver */
-		mod->uart.regshift 	= 1;	/* already done in serial_in/out */
-		mod->uart.fifosize 	= 128;
-		mod->uart.type 		= PORT_16C950;
 
-		baseAdr = mod->memBase + (0x10 * nrChan);
+/*******************************************************************/
+/** TX watchdog, ndo_tx_timeout
+ *
+ * \param dev		\IN network interface
+ *
+ * \brief The packet didn't go out within watchdog_timeo, e.g. held by 
+ *        CTS. What is left of it is dropped and the queue woken.
+ *
+ * \return 			-
+ */
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5,6,0)
+static void men_uart_net_tx_timeout(struct net_device *dev)
+#else
+static void men_uart_net_tx_timeout(struct net_device *dev, 
+									unsigned int txqueue)
+#endif
+{
+	struct m77_net_priv *np = netdev_priv(dev);
+	struct ox16c954_port *up = &men_uart_ports[np->line];
+	unsigned long flags;
 
-		/* correct M45N Adress Gap between chan. 0-3 and 4-7 */
-		if ( (mod->modtype == MOD_M45 ) && (nrChan > 3) )
-			baseAdr+=0x40;
+	spin_lock_irqsave(&up->port.lock, flags);
+	if (up->net == dev) {
+		up->kcXmit.head = up->kcXmit.tail = 0;
+		__stop_tx(up);
+	}
+	dev->stats.tx_errors++;
+	spin_unlock_irqrestore(&up->port.lock, flags);
 
-		/* use same address for mem/mapbase, shown as "MMIO" at loading */
-		mod->uart.membase 	= baseAdr;
-		mod->uart.mapbase 	= (unsigned long)(unsigned long*)baseAdr;
-		
-		if ((retval=men_uart_register_port(&mod->uart, mod->modtype, nrChan, 
-										   &mod->port8250[nrChan]))<0) {
+	netif_wake_queue(dev);
+}
 
-			printk(KERN_ERR "*** Error during registering UART %d!\n", nrChan);
-			return retval;
-		} else
-			mod->line = retval;
 
-		ox = mod->port8250[nrChan]; /* is valid now */
+/*******************************************************************/
+/** netdev stats, ndo_get_stats
+ *
+ * \param dev		\IN network interface
+ *
+ * \brief UART overruns, echo collisions and late RS485 turnarounds are
+ *        taken from the channel while the interface is up.
+ *
+ * \return 			stats of the interface
+ */
+static struct net_device_stats *men_uart_net_stats(struct net_device *dev)
+{
+	struct m77_net_priv *np = netdev_priv(dev);
+	struct ox16c954_port *up = &men_uart_ports[np->line];
+	unsigned long flags;
 
-		/* on M77, also set phy mode and echo and switch it on */
-		tmpmode = mod->mode[nrChan];
-		if ( mod->modtype == MOD_M77 && tmpmode ) {
-			dcr_val |= tmpmode;
-			/* echoing only for HD modes! unknown effects at other modes.. */
-			if ( (( tmpmode==M77_RS422_HD) || (tmpmode==M77_RS485_HD )) && (mod->echo[nrChan])) 
-			{
-				dcr_val |= M77_RX_EN;
-			}
-			control_out(mod->memBase, (M77_DCR_REG_BASE+nrChan) << 1, dcr_val);
-			
-			/* save M77 mode */
-			ox->m77Mode = tmpmode;
-		}
+	spin_lock_irqsave(&up->port.lock, flags);
+	if (up->net == dev) {
+		dev->stats.rx_fifo_errors 	= up->port.icount.overrun - np->overBase;
+		dev->stats.collisions 		= up->echoCollisions - np->collBase;
+		dev->stats.tx_window_errors = up->netTaLate - np->lateBase;
 	}
-	return retval;
+	spin_unlock_irqrestore(&up->port.lock, flags);
+	return &dev->stats;
 }
 
 
 /*******************************************************************/
-/** main enumeration and initialization Function of all Modules
+/** bring a network interface up, ndo_open
  *
- * \brief
- * The passed module Parameters are parsed and for each given Module
- * and a call to mdis_open_external_dev() is done. For each new 
- * carrier board a call to mdis_install_external_irq() is done because
- * from CPU View the IRQ s of all M-Modules on the same Carrier are
- * equal.
+ * \param dev		\IN network interface
  *
- * \return 			0 on success or negative error code
+ * \brief Takes the channel as in-kernel client and switches the frame 
+ *        engine to idle gap mode. The tty can't be opened until the
+ *        interface is down. Refused if the tty left a frame mode on,
+ *        the idle gap of the tty is given back by men_uart_net_stop().
+ *
+ * \return 			0 or negative error number
  */
-static int m77_init_devices(void)
+static int men_uart_net_open(struct net_device *dev)
 {
+	struct m77_net_priv *np = netdev_priv(dev);
+	struct ox16c954_port *up = &men_uart_ports[np->line];
+	unsigned long flags;
+	int retval;
 
-	u_int32 modtype = 0, devid = 0, devrev = 0, modnr = 0;
-	char moddevname[64];
-    unsigned int m_idx = 0;
-	int retval = 0;
-    char device[ARRLEN];
-	char prevBrdName[ARRLEN];
-	UARTMOD_INFO *mmod_data = NULL;
-
-	memset( device, 0x0, sizeof(device));
-	memset( prevBrdName, 0x0, sizeof(prevBrdName));
-
-    INIT_LIST_HEAD( &G_uartModListHead );	
+	np->kc.line = -1;
+	retval = men_uart_kcli_attach(&np->kc, np->line, np->baud);
+	if (retval)
+		return retval;
 
-	if ( brdName[m_idx] == NULL ) {
-		printk(KERN_ERR 
-			   " *** Error: No BBIS device specified, e.g.'brdName=d201_1'\n");
-		retval = -EINVAL;
-		goto errout;
+	/* 
+	 * left on by the tty, they change what the frame engine gets; the
+	 * tty is closed now, so they can't be switched meanwhile
+	 */
+	spin_lock_irqsave(&up->port.lock, flags);
+	if (up->delimEnable || up->linMode || up->mdEnable || up->frmMode ||
+		men_uart_rx_bypass(up)) {
+		spin_unlock_irqrestore(&up->port.lock, flags);
+		m77_kclient_close(&np->kc);
+		return -EBUSY;
 	}
+	up->frmLen = up->frmStat = up->frmLsr = 0;
+	np->ttyUnit 	= up->idleUnit;
+	np->ttyGap 		= up->idleGap;
+	up->idleUnit 	= np->unit;
+	up->idleGap 	= np->gap;
+	up->netDelim 	= np->delim;
+	np->overBase 	= up->port.icount.overrun - dev->stats.rx_fifo_errors;
+	np->collBase 	= up->echoCollisions - dev->stats.collisions;
+	np->lateBase 	= up->netTaLate - dev->stats.tx_window_errors;
+	up->net 		= dev;
+	men_uart_frame_mode(up, M77_FRM_IDLE);
+	spin_unlock_irqrestore(&up->port.lock, flags);
 
-	/*-----------------------------+
-	 |  For each M-Module do..     |
-     +-----------------------------*/
-    while( devName[m_idx] )  {
-		
-		strncpy( device, devName[m_idx], ARRLEN-1 );
+	/* a longest packet twice, plus margin for the gap and flow control */
+	dev->watchdog_timeo = HZ + msecs_to_jiffies(2 * M77_FRAME_MAX * 11 * 
+												MSEC_PER_SEC / np->baud);
+	netif_start_queue(dev);
+	return 0;
+}
 
-		/* kmalloc one UARTMOD_INFO struct per M-Module   */	
-		if ((mmod_data = kmalloc(sizeof(UARTMOD_INFO), GFP_KERNEL)) == NULL ){
-			retval = -ENOMEM;
-			goto errout;
-		}
-		memset( mmod_data, 0x0, sizeof(UARTMOD_INFO) );
 
-		/* store index, devicename, list element etc */
-		mmod_data->modnum = m_idx;	
-		strncpy( mmod_data->brdName, brdName[m_idx], ARRLEN-1 );
-		list_add(&mmod_data->head, &G_uartModListHead );
+/*******************************************************************/
+/** take a network interface down, ndo_stop
+ *
+ * \param dev		\IN network interface
+ *
+ * \brief A packet partly received or sent is lost. The channel is given
+ *        back with the frame engine off.
+ *
+ * \return 			0
+ */
+static int men_uart_net_stop(struct net_device *dev)
+{
+	struct m77_net_priv *np = netdev_priv(dev);
+	struct ox16c954_port *up = &men_uart_ports[np->line];
+	unsigned long flags;
 
-		if ( slotNo[m_idx] > 3 ) {
-			printk(KERN_ERR " *** Error: Slotnumber %d invalid (use 0..3)\n", 
-				   slotNo[m_idx]);
-			retval = -EINVAL;
-			goto errout;
-		}
+	netif_stop_queue(dev);
+	men_uart_net_stats(dev);	/* keep the counters of the channel */
 
-		retval=mdis_open_external_dev( device, 
-					       brdName[m_idx],
-					       slotNo[m_idx], 
-					       MDIS_MA08, 
-					       MDIS_MD08, 
-					       256, 
-					       &mmod_data->memBase,
-					       NULL, 
-					       &mmod_data->mdisDev );
-		
-		M77DBG3("called mdis_open_external_dev for '%s' board '%s' slot %d.\n",
-				devName[m_idx], brdName[m_idx], slotNo[m_idx] );
-		M77DBG3("returnvalue %d. membase=0x%08x\n",retval, mmod_data->memBase);
+	spin_lock_irqsave(&up->port.lock, flags);
+	up->frmLen = up->frmStat = up->frmLsr = 0;
+	men_uart_frame_mode(up, M77_FRM_OFF);
+	up->idleUnit 	= np->ttyUnit;
+	up->idleGap 	= np->ttyGap;
+	up->net 		= NULL;
+	up->netDelim 	= -1;
+	spin_unlock_irqrestore(&up->port.lock, flags);
 
-		if (retval < 0) {
-			printk(KERN_ERR "*** open '%s' failed: board %s slot %d!\n",
-				   devName[m_idx], brdName[m_idx], slotNo[m_idx] );
-			printk(KERN_ERR "hint: forgot mdis_createdev -b %s ?\n",
-				   brdName[m_idx]);
+	hrtimer_cancel(&up->frmTimer);
+	hrtimer_cancel(&np->txTimer);
+	m77_kclient_close(&np->kc);
+	return 0;
+}
 
-			retval 	= -EIO;
-			goto errout;
-		}
 
-		if ( m_getmodinfo( (unsigned long)((unsigned long*)mmod_data->memBase), 
-				   &modtype, &devid, 
-				   &devrev, moddevname) == 0) {
-			M77DBG3("getmodinfo found: '%s' devID: 0x%08x\n",moddevname,devid);
+/*******************************************************************/
+/** change the MTU, ndo_change_mtu
+ *
+ * \param dev		\IN network interface
+ * \param mtu		\IN new MTU
+ *
+ * \return 			0 or -EINVAL, longer frames are truncated on RX
+ */
+static int men_uart_net_change_mtu(struct net_device *dev, int mtu)
+{
+	if (mtu < 1 || mtu > M77_FRAME_MAX)
+		return -EINVAL;
+	dev->mtu = mtu;
+	return 0;
+}
 
-			modnr = devid & 0xffff;
-			mmod_data->modtype = modnr;
-			strncpy( mmod_data->deviceName, device, ARRLEN-1 );
-			mmod_data->deviceName[ARRLEN-1] = '\0';
+static const struct net_device_ops men_uart_net_ops = {
+	.ndo_open			= men_uart_net_open,
+	.ndo_stop			= men_uart_net_stop,
+	.ndo_start_xmit		= men_uart_net_xmit,
+	.ndo_tx_timeout		= men_uart_net_tx_timeout,
+	.ndo_get_stats		= men_uart_net_stats,
+	.ndo_change_mtu		= men_uart_net_change_mtu,
+};
 
-			/*  sanity checks against wrong driver insertion */
-			if (strncmp("m45" ,devName[m_idx], 3 ) && (modnr == MOD_M45)){
-				printk(KERN_ERR "*** Error: passed '%s' but found '%s'\n",
-					   devName[m_idx], moddevname );
-				retval = -ENODEV;
-				goto errout;	
-			}
-			
-			if (strncmp("m69" ,devName[m_idx], 3) && (modnr == MOD_M69)) {
-				printk(KERN_ERR "*** Error: passed '%s' but found '%s'\n",
-					   devName[m_idx], moddevname );
-				retval = -ENODEV;
-				goto errout;
-			} 
-			
-			if (strncmp("m77" ,devName[m_idx], 3) && (modnr == MOD_M77)) {
-				printk(KERN_ERR "*** Error: passed '%s' but found '%s'\n",
-					   devName[m_idx], moddevname );
-				retval = -ENODEV;
-				goto errout;				
-			} 
 
-			if ((modnr != MOD_M45) && (modnr != MOD_M69) &&(modnr != MOD_M77)){
-				printk(KERN_ERR "*** Error: unknown Module (0x%04x)!\n", devid);
-				retval = -ENODEV;
-				goto errout;				
-			} 
+/*******************************************************************/
+/** set up a network interface, alloc_netdev() callback
+ *
+ * \param dev		\IN network interface
+ *
+ * \return 			-
+ */
+static void men_uart_net_setup(struct net_device *dev)
+{
+	dev->netdev_ops 		= &men_uart_net_ops;
+	dev->type 				= ARPHRD_NONE;
+	dev->flags 				= IFF_NOARP;
+	dev->hard_header_len 	= 0;
+	dev->addr_len 			= 0;
+	dev->mtu 				= M77_FRAME_MAX;
+	dev->tx_queue_len 		= 16;
+	dev->watchdog_timeo 	= 5 * HZ;	/* set for the baud rate on open */
+}
 
-		} else {
-			printk("*** Error identifying M-Module!\n");
-			retval = -ENODEV;
-			goto errout;
-		}
-		
-		M77DBG("Carrier now %s: Registering new ISR\n", brdName[m_idx] );
-		retval = mdis_install_external_irq(	mmod_data->mdisDev,	M77_IrqHandler,
-											(void*)mmod_data);
-		if ( retval < 0 ) {	
-			printk(KERN_ERR "*** install irq error: %d\n", retval);
-			retval = -EBUSY;
-			goto errout;
-		}
 
-		if ( mmod_data->modtype == MOD_M77 ) 		
-			parse_m77_phyinfo(mmod_data, m_idx);
+/*******************************************************************/
+/** remove the network interface of a channel
+ *
+ * \param line		\IN channel
+ *
+ * \brief Must be called with m77_net_mutex held.
+ *
+ * \return 			-
+ */
+static void men_uart_net_remove(unsigned int line)
+{
+	struct net_device *dev = m77Net[line];
 
-		/* Register all UART channels of this M-Module */
-		register_uarts(mmod_data);
+	if (!dev)
+		return;
+	m77Net[line] = NULL;
+	unregister_netdev(dev);		/* takes it down first */
+	free_netdev(dev);
+}
 
-		retval = mdis_enable_external_irq( mmod_data->mdisDev );
-		if ( retval < 0 ) {	
-			printk(KERN_ERR "*** enable irq error: %d\n", retval);
-			retval = -EBUSY;
-			goto errout;
-		}
-		/* current carrier becomes old one  */
-		strncpy(prevBrdName, brdName[m_idx], ARRLEN-1);
-		prevBrdName[ARRLEN-1] = '\0';
 
-		m_idx++; 
+/*******************************************************************/
+/** M77_NET_SET of the control device
+ *
+ * \param arg		\IN user pointer to struct m77_net
+ *
+ * \brief The interface is named m77n<line>, it can be renamed.
+ *
+ * \return 			0 or negative error number
+ */
+static int men_uart_net_set(unsigned long arg)
+{
+	struct m77_net_priv *np;
+	struct net_device *dev;
+	struct m77_net nt;
+	char name[IFNAMSIZ];
+	int retval = 0;
 
-	} /* end while(brdname... */
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+	if (copy_from_user(&nt, (void __user *)arg, sizeof(nt)))
+		return -EFAULT;
+	if (nt.line >= MAX_SNGL_UARTS || 
+		(nt.enable && (!nt.gap || nt.unit > M77_IDLE_US)))
+		return -EINVAL;
 
-	/* was any M-Module processed at all ?  */
-	if (!m_idx) {
-		printk(KERN_ERR 
-			   " *** Error: No MDIS Device specified, e.g. 'devName=m45_1'\n");
+	mutex_lock(&m77_net_mutex);
+	if (!nt.enable) {
+		men_uart_net_remove(nt.line);
+		goto set_out;
+	}
+	if (m77Net[nt.line]) {
+		retval = -EBUSY;
+		goto set_out;
+	}
+	if (men_uart_ports[nt.line].port.type == PORT_UNKNOWN) {
 		retval = -ENODEV;
-		goto errout;
+		goto set_out;
 	}
 
-	return 0; 
- errout:
-	deinit_devices();	
+	snprintf(name, sizeof(name), "m77n%u", nt.line);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,17,0)
+	dev = alloc_netdev(sizeof(*np), name, NET_NAME_PREDICTABLE, 
+					   men_uart_net_setup);
+#else
+	dev = alloc_netdev(sizeof(*np), name, men_uart_net_setup);
+#endif
+	if (!dev) {
+		retval = -ENOMEM;
+		goto set_out;
+	}
+
+	np = netdev_priv(dev);
+	np->dev 			= dev;
+	np->line 			= nt.line;
+	np->baud 			= nt.baud ? nt.baud : 9600;
+	np->unit 			= nt.unit;
+	np->gap 			= nt.gap;
+	np->delim 			= (nt.flags & M77_NET_DELIM) ? nt.delim : -1;
+	np->kc.name 		= dev->name;
+	np->kc.receive_buf 	= men_uart_net_kcli_rx;
+	np->kc.priv 		= np;
+	np->kc.line 		= -1;
+	hrtimer_init(&np->txTimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	np->txTimer.function = men_uart_net_tx_timer;
+
+	retval = register_netdev(dev);
+	if (retval) {
+		free_netdev(dev);
+		goto set_out;
+	}
+	m77Net[nt.line] = dev;
+
+	memset(nt.name, 0, sizeof(nt.name));
+	strncpy(nt.name, dev->name, sizeof(nt.name) - 1);
+	if (copy_to_user((void __user *)arg, &nt, sizeof(nt)))
+		retval = -EFAULT;
+ set_out:
+	mutex_unlock(&m77_net_mutex);
 	return retval;
 }
+#endif /* M77_HAS_NETDEV */
+
 
 /*******************************************************************/
 /** module init function
@@ -2526,6 +9341,17 @@ static int __init m77_serial_init(void)
 	} else if ( ret )
 		goto unreg;
 
+	/* 5. control device for batched I/O, the ttys work without it */
+	if (misc_register(&m77_ctl_dev))
+		printk(KERN_ERR "*** can't register /dev/%s\n", M77_CTL_NAME);
+	else
+		m77CtlRegistered = 1;
+
+#ifdef M77_HAS_UIO
+	/* 6. M-Modules for userspace, their UIO devices are under m77ctl */
+	men_uart_uio_register(m77CtlRegistered ? m77_ctl_dev.this_device : NULL);
+#endif
+
  out:
 	return ret;
 
@@ -2540,6 +9366,21 @@ static int __init m77_serial_init(void)
  */
 static void __exit m77_serial_cleanup(void)
 {
+#ifdef M77_HAS_NETDEV
+	unsigned int i;
+#endif
+
+#ifdef M77_HAS_UIO
+	men_uart_uio_unregister();
+#endif
+	if (m77CtlRegistered)
+		misc_deregister(&m77_ctl_dev);
+#ifdef M77_HAS_NETDEV
+	mutex_lock(&m77_net_mutex);
+	for (i = 0; i < MAX_SNGL_UARTS; i++)
+		men_uart_net_remove(i);
+	mutex_unlock(&m77_net_mutex);
+#endif
 	deinit_devices();
 	uart_unregister_driver(&men_uart_reg);
 	return;
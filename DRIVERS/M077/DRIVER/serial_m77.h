@@ -63,9 +63,30 @@
 #define M77_XON_CHAR			17		/* Xon character = ^Q */
 #define M77_XOFF_CHAR			19		/* Xoff character = ^S */
 
+/* NMR, nine-bit mode register (ICR 0x0d) */
+#define M77_NMR_9BIT_EN			0x01	/* 9-bit data mode 					*/
+#define M77_NMR_9BIT_INT		0x02	/* IRQ on received 9th bit set 		*/
+#define M77_NMR_9BIT_XOFF1		0x10	/* XOFF1 matches with 9th bit set	*/
+#define M77_NMR_9BIT_XOFF2		0x20	/* XOFF2 matches with 9th bit set	*/
+#define M77_LSR_9BIT			0x04	/* LSR[2]: 9th bit in 9-bit mode 	*/
+
+/* EFR[3:0] in-band flow control modes, see Data sheet "EFR" */
+#define M77_EFR_RXFLOW_XON1		0x02	/* compare XON1/XOFF1 on receive	*/
+#define M77_EFR_RXFLOW_SEQ		0x03	/* compare XON1,2/XOFF1,2 sequence	*/
+#define M77_EFR_TXFLOW_XON1		0x08	/* send XON1/XOFF1 					*/
+#define M77_EFR_TXFLOW_SEQ		0x0c	/* send XON1,2/XOFF1,2 sequence 	*/
+#define M77_EFR_FLOW_MASK		0x0f
+
+/* enhanced mode (EFR[4]=1) bits in MCR, IER and IIR */
+#define M77_MCR_XONANY			0x20	/* any received char acts as XON	*/
+#define M77_IER_SPECIAL			0x20	/* XOFF/special character interrupt */
+#define M77_IIR_ID_MASK			0x3e	/* 950 IIR[5:1] interrupt source	*/
+#define M77_IIR_SPECIAL			0x10	/* XOFF or special char received	*/
+
 
 /* see Data sheet p.38  "ACR[4:3] DTR# line Configuration" */
-#define OX954_ACR_DTR			(0x18)
+#define OX954_ACR_DTR			(0x18)	/* DTR# high while transmitting */
+#define OX954_ACR_DTR_ACTLOW	(0x10)	/* DTR# low while transmitting  */
 
 /* Module Type Identification:  */
 #define MOD_M45					0x7d2d
@@ -92,6 +113,132 @@
 /*  M77 special ioctl functions for echo Modes */
 #define M77_ECHO_SUPPRESS  _IO(M77_IOCTL_MAGIC, M77_IOCTLBASE + 0)
 
+/*  in-band flow control: second XON/XOFF characters and XOFF statistics */
+#define M77_INBAND_SET	_IOW(M77_IOCTL_MAGIC, M77_IOCTLBASE + 3, \
+							 struct m77_inband)
+#define M77_INBAND_GET	_IOR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 4, \
+							 struct m77_inband)
+
+/*  9-bit multidrop address filtering (e.g. RS485 HD busses) */
+#define M77_MULTIDROP_SET	_IOW(M77_IOCTL_MAGIC, M77_IOCTLBASE + 5, \
+								 struct m77_multidrop)
+#define M77_MULTIDROP_GET	_IOR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 6, \
+								 struct m77_multidrop)
+
+/*  wake up readers on a frame delimiter (special character detection) */
+#define M77_DELIM_SET	_IOW(M77_IOCTL_MAGIC, M77_IOCTLBASE + 7, \
+							 struct m77_delim)
+#define M77_DELIM_GET	_IOR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 8, \
+							 struct m77_delim)
+
+/*  drop own transmitted bytes echoed back in half duplex modes */
+#define M77_ECHO_CANCEL_SET	_IOW(M77_IOCTL_MAGIC, M77_IOCTLBASE + 10, \
+								 struct m77_echo)
+#define M77_ECHO_CANCEL_GET	_IOR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 11, \
+								 struct m77_echo)
+
+/*  M45N: leave tristate automatically while transmitting */
+#define M45_TIO_TRI_AUTO_SET	_IOW(M77_IOCTL_MAGIC, M77_IOCTLBASE + 12, \
+									 struct m45_tri_auto)
+#define M45_TIO_TRI_AUTO_GET	_IOR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 13, \
+									 struct m45_tri_auto)
+
+/*  send frames without gaps: stage in the FIFO with transmitter held */
+#define M77_FRAMETX_SET	_IOW(M77_IOCTL_MAGIC, M77_IOCTLBASE + 14, \
+							 struct m77_frametx)
+#define M77_FRAMETX_GET	_IOR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 15, \
+							 struct m77_frametx)
+
+/*  receive Modbus RTU frames: cut at t3.5, CRC check, frame info queue */
+#define M77_RTU_SET		_IOW(M77_IOCTL_MAGIC, M77_IOCTLBASE + 16, \
+							 struct m77_rtu)
+#define M77_RTU_GET		_IOR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 17, \
+							 struct m77_rtu)
+#define M77_FRAME_INFO	_IOR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 18, \
+							 struct m77_frame_info)
+#define M77_IDLE_SET	_IOW(M77_IOCTL_MAGIC, M77_IOCTLBASE + 19, \
+							 struct m77_idle)
+#define M77_IDLE_GET	_IOR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 20, \
+							 struct m77_idle)
+#define M77_CRC_SET		_IOW(M77_IOCTL_MAGIC, M77_IOCTLBASE + 21, \
+							 struct m77_crc)
+#define M77_CRC_GET		_IOR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 22, \
+							 struct m77_crc)
+#define M77_SCHED_SET	_IOW(M77_IOCTL_MAGIC, M77_IOCTLBASE + 23, \
+							 struct m77_sched_slot)
+#define M77_SCHED_STAT	_IOWR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 24, \
+							 struct m77_sched_stat)
+#define M77_LIN_SET		_IOW(M77_IOCTL_MAGIC, M77_IOCTLBASE + 25, \
+							 struct m77_lin)
+#define M77_LIN_GET		_IOR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 26, \
+							 struct m77_lin)
+#define M77_LIN_TABLE	_IOW(M77_IOCTL_MAGIC, M77_IOCTLBASE + 27, \
+							 struct m77_lin_table)
+#define M77_LIN_RESULT	_IOR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 28, \
+							 struct m77_lin_result)
+#define M77_PRIO_SEND	_IOW(M77_IOCTL_MAGIC, M77_IOCTLBASE + 29, \
+							 struct m77_prio_frame)
+#define M77_PRIO_STATS	_IOWR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 30, \
+							 struct m77_prio_stats)
+
+/* port-to-port bridge inside the driver */
+#define M77_BRIDGE_SET	_IOW(M77_IOCTL_MAGIC, M77_IOCTLBASE + 31, \
+							 struct m77_bridge)
+#define M77_BRIDGE_GET	_IOR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 32, \
+							 struct m77_bridge)
+
+/* port groups, one write queued on all members */
+#define M77_GROUP_SET	_IOW(M77_IOCTL_MAGIC, M77_IOCTLBASE + 33, \
+							 struct m77_group)
+#define M77_GROUP_GET	_IOWR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 34, \
+							 struct m77_group)
+#define M77_GROUP_WRITE	_IOWR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 35, \
+							 struct m77_group_write)
+
+/* batched I/O, on the control device /dev/m77ctl only */
+#define M77_BATCH_ATTACH _IOWR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 36, \
+							 struct m77_batch_lines)
+#define M77_BATCH_IO	_IOWR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 37, \
+							 struct m77_batch)
+
+/* raw RX ring, on a /dev/m77ctl file bound to a channel */
+#define M77_RAW_SET		_IOW(M77_IOCTL_MAGIC, M77_IOCTLBASE + 38, \
+							 struct m77_raw)
+#define M77_RAW_GET		_IOR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 39, \
+							 struct m77_raw)
+
+/* traffic tap of many channels, on /dev/m77ctl */
+#define M77_TAP_SET		_IOW(M77_IOCTL_MAGIC, M77_IOCTLBASE + 40, \
+							 struct m77_tap)
+#define M77_TAP_GET		_IOR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 41, \
+							 struct m77_tap)
+
+/* time stamps of the chars received by the tty */
+#define M77_RXTS_SET	_IOW(M77_IOCTL_MAGIC, M77_IOCTLBASE + 42, \
+							 struct m77_rxts_set)
+#define M77_RXTS_READ	_IOWR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 43, \
+							  struct m77_rxts_read)
+
+/* time stamped modem status events, PPS source on DCD */
+#define M77_MSR_SET		_IOW(M77_IOCTL_MAGIC, M77_IOCTLBASE + 44, \
+							 struct m77_msr_set)
+#define M77_MSR_READ	_IOWR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 45, \
+							  struct m77_msr_read)
+
+/* channel as network interface, on /dev/m77ctl */
+#define M77_NET_SET		_IOWR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 46, \
+							  struct m77_net)
+
+/* BPF receive filter of the frames (idle gap and Modbus RTU mode) */
+#define M77_BPF_SET		_IOW(M77_IOCTL_MAGIC, M77_IOCTLBASE + 47, \
+							 struct m77_bpf)
+#define M77_BPF_GET		_IOR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 48, \
+							 struct m77_bpf)
+
+/*  RS485 turnaround measurement (RS485 itself is set with TIOCSRS485) */
+#define M77_RS485_STATS	_IOWR(M77_IOCTL_MAGIC, M77_IOCTLBASE + 9, \
+							  struct m77_rs485_stats)
+
 
 /* M77 special M77_PHYS_INT_SET ioctl arguments */
 #define M77_RS423        0x00  /*  arg for RS423 , OBSOLETE on new M77 */
@@ -106,6 +253,511 @@
 #define M77_IR_IMASK     0x02  /* IR Register IRQ Mask (IRQ dis/enable bit) */
 #define M77_IR_IRQ     	 0x01  /* IR Register IRQ pending bit				*/
 
+/* M77_INBAND_SET/GET modes. XON1/XOFF1 are always taken from termios
+ * c_cc[VSTART]/c_cc[VSTOP], IXON/IXOFF/IXANY select what is enabled */
+#define M77_INBAND_SINGLE	0x00	/* XON2/XOFF2 = XON1/XOFF1 (default) */
+#define M77_INBAND_SEQ		0x01	/* two-char sequences XON1,XON2 etc. */
+
+/** argument of M77_INBAND_SET / M77_INBAND_GET */
+struct m77_inband {
+	unsigned char	mode;		/* M77_INBAND_SINGLE or M77_INBAND_SEQ	*/
+	unsigned char	xon2;		/* second XON char in sequence mode		*/
+	unsigned char	xoff2;		/* second XOFF char in sequence mode	*/
+	unsigned char	reserved;
+	unsigned int	xoffCount;	/* GET: XOFFs recognized by the UART	*/
+};
+
+/* M77_MULTIDROP_SET flags */
+#define M77_MD_HWGATE		0x01	/* keep receiver disabled between frames */
+
+/** argument of M77_MULTIDROP_SET / M77_MULTIDROP_GET */
+struct m77_multidrop {
+	unsigned char	enable;		/* 0: 8 bit operation, 1: 9-bit multidrop */
+	unsigned char	nrAddr;		/* number of station addresses (1 or 2)	*/
+	unsigned char	addr[2];	/* own station addresses				*/
+	unsigned int	flags;		/* M77_MD_HWGATE						*/
+	unsigned int	foreignCount; /* GET: frames for other stations		*/
+};
+
+/* default idle time after which data without delimiter is delivered */
+#define M77_DELIM_IDLE_DEFAULT	10000	/* us */
+#define M77_DELIM_IDLE_MAX		10000000 /* us */
+
+/** argument of M77_DELIM_SET / M77_DELIM_GET */
+struct m77_delim {
+	unsigned char	enable;		/* 1: deliver data on delimiter/idle only */
+	unsigned char	delim;		/* frame delimiter, e.g. '\n' or ETX	*/
+	unsigned char	reserved[2];
+	unsigned int	idleUs;		/* deliver anyway after this line idle	*/
+	unsigned int	frameCount;	/* GET: deliveries on delimiter			*/
+	unsigned int	idleCount;	/* GET: deliveries on idle timeout		*/
+};
+
+/* M77_ECHO_CANCEL_SET flags */
+#define M77_ECHO_MARKERR	0x01	/* pass garbled echoes up as TTY_FRAME	*/
+
+/** argument of M77_ECHO_CANCEL_SET / M77_ECHO_CANCEL_GET */
+struct m77_echo {
+	unsigned char	enable;		/* 1: drop echoes of own transmitted data */
+	unsigned char	collision;	/* GET: collision since last GET		*/
+	unsigned char	reserved[2];
+	unsigned int	flags;		/* M77_ECHO_MARKERR						*/
+	unsigned int	echoCount;	/* GET: echoed chars dropped			*/
+	unsigned int	collisions;	/* GET: echoes not matching sent chars	*/
+	unsigned int	lostCount;	/* GET: sent chars whose echo never came */
+};
+
+/** argument of M45_TIO_TRI_AUTO_SET / M45_TIO_TRI_AUTO_GET */
+struct m45_tri_auto {
+	unsigned int	enable;		/* 1: tristate except while transmitting */
+	unsigned int	guardUs;	/* keep driving this long after TEMT	*/
+};
+
+/* TX trigger level in frame TX mode: ISR has this many char times to refill */
+#define M77_FRAMETX_TTL_DEFAULT	96
+
+/** argument of M77_FRAMETX_SET / M77_FRAMETX_GET */
+struct m77_frametx {
+	unsigned char	enable;		/* 1: stage frames, release in one go	*/
+	unsigned char	reserved[3];
+	unsigned int	ttl;		/* TX FIFO refill level, 0 = default	*/
+	unsigned int	frames;		/* GET: frames staged					*/
+	unsigned int	underruns;	/* GET: FIFO ran empty within a frame	*/
+};
+
+#define M77_FRAME_MAX		512		/* longer frames are truncated 		 */
+#define M77_FRAME_INFO_NUM	32		/* frame infos queued per channel 	 */
+
+/* M77_RTU_SET flags */
+#define M77_RTU_CRCDROP		0x01	/* discard frames with bad CRC		 */
+
+/** argument of M77_RTU_SET / M77_RTU_GET */
+struct m77_rtu {
+	unsigned char	enable;		/* 1: receive whole frames, gapless TX	*/
+	unsigned char	reserved[3];
+	unsigned int	flags;		/* M77_RTU_CRCDROP						*/
+	unsigned int	t15Us;		/* max. gap within frame, 0 = Modbus	*/
+	unsigned int	t35Us;		/* min. gap between frames, 0 = Modbus	*/
+	unsigned int	frames;		/* GET: frames received					*/
+	unsigned int	crcErrors;	/* GET: frames with bad CRC				*/
+	unsigned int	t15Errors;	/* GET: frames with gaps > t1.5			*/
+	unsigned int	infoLost;	/* GET: frame infos not fetched in time	*/
+};
+
+/* struct m77_idle units */
+#define M77_IDLE_BITS		0		/* gap in bit times of current baudrate */
+#define M77_IDLE_US			1		/* gap in microseconds				 */
+
+/** argument of M77_IDLE_SET / M77_IDLE_GET */
+struct m77_idle {
+	unsigned char	enable;		/* 1: one telegram per read(), gapless TX */
+	unsigned char	unit;		/* M77_IDLE_BITS or M77_IDLE_US			*/
+	unsigned char	reserved[2];
+	unsigned int	gap;		/* line idle time ending a telegram		*/
+	unsigned int	gapUs;		/* GET: resulting gap in microseconds	*/
+	unsigned int	telegrams;	/* GET: telegrams received				*/
+	unsigned int	infoLost;	/* GET: frame infos not fetched in time	*/
+};
+
+/* struct m77_crc types */
+#define M77_CRC_NONE		0
+#define M77_CRC16_MODBUS	1		/* init 0xffff, reflected, LSB first */
+#define M77_CRC16_CCITT		2		/* CCITT-FALSE: init 0xffff, MSB first */
+#define M77_CRC32			3		/* IEEE 802.3, LSB first			 */
+
+/* struct m77_crc flags */
+#define M77_CRC_DROP		0x01	/* discard frames with bad CRC		 */
+
+/** argument of M77_CRC_SET / M77_CRC_GET, CRC over each received frame
+ *  (idle gap mode, Modbus RTU mode always uses CRC-16/MODBUS) */
+struct m77_crc {
+	unsigned char	type;		/* M77_CRC_*, CRC sent at frame end		*/
+	unsigned char	reserved[3];
+	unsigned int	flags;		/* M77_CRC_DROP							*/
+	unsigned int	good;		/* GET: frames with good CRC			*/
+	unsigned int	bad;		/* GET: frames with bad CRC				*/
+	unsigned int	dropped;	/* GET: bad frames discarded			*/
+};
+
+/* struct m77_frame_info flags */
+#define M77_FRM_CRCERR		0x01	/* CRC wrong or frame too short		 */
+#define M77_FRM_T15			0x02	/* gap > t1.5 within the frame		 */
+#define M77_FRM_TRUNC		0x04	/* longer than M77_FRAME_MAX		 */
+#define M77_FRM_CRCOK		0x08	/* CRC checked and good				 */
+
+/** argument of M77_FRAME_INFO, one per received frame (oldest first) */
+struct m77_frame_info {
+	unsigned int	len;		/* frame length as passed to read()		*/
+	unsigned int	flags;		/* M77_FRM_*							*/
+	unsigned int	lsr;		/* UART_LSR_OE/PE/FE/BI of all chars	*/
+	unsigned int	tsSec;		/* start of 1st char, CLOCK_MONOTONIC	*/
+	unsigned int	tsNsec;
+};
+
+#define M77_SCHED_SLOTS		8		/* scheduled frames per channel		 */
+#define M77_SCHED_FRAME_MAX	128		/* max. length of a scheduled frame	 */
+#define M77_SCHED_PERIOD_MIN 100	/* shortest cycle in us				 */
+
+/* struct m77_sched_slot flags */
+#define M77_SCHED_ONESHOT	0x01	/* send once at startSec/startNsec	 */
+
+/** argument of M77_SCHED_SET: frame sent by the driver at fixed times */
+struct m77_sched_slot {
+	unsigned char	slot;		/* 0..M77_SCHED_SLOTS-1					*/
+	unsigned char	enable;		/* 1: schedule, 0: remove the slot		*/
+	unsigned char	reserved[2];
+	unsigned int	flags;		/* M77_SCHED_ONESHOT, else cyclic		*/
+	unsigned int	startSec;	/* one-shot: CLOCK_MONOTONIC time		*/
+	unsigned int	startNsec;
+	unsigned int	periodUs;	/* cyclic: period						*/
+	unsigned int	phaseUs;	/* cyclic: offset to multiples of period */
+	unsigned int	len;		/* frame length							*/
+	unsigned char	data[M77_SCHED_FRAME_MAX];
+};
+
+/** argument of M77_SCHED_STAT: timing of a slot's frames, the TX time is
+ *  when the 1st char was written to the TX FIFO (CLOCK_MONOTONIC) */
+struct m77_sched_stat {
+	unsigned char	slot;		/* IN: slot number						*/
+	unsigned char	clear;		/* IN: 1 = reset statistics after reading */
+	unsigned char	enable;		/* slot active							*/
+	unsigned char	reserved;
+	unsigned int	count;		/* frames sent							*/
+	unsigned int	missed;		/* times skipped, frame still queued	*/
+	unsigned int	lastSec;	/* TX time of the last frame			*/
+	unsigned int	lastNsec;
+	unsigned int	lateNs;		/* TX time - scheduled time, last frame	*/
+	unsigned int	minLateNs;
+	unsigned int	maxLateNs;
+};
+
+#define M77_LIN_ENTRIES		16		/* frame slots in the schedule table */
+#define M77_LIN_RESULTS		32		/* results queued per channel		 */
+#define M77_LIN_BREAK_DEFAULT 13	/* break length in bit times		 */
+
+/* struct m77_lin flags */
+#define M77_LIN_ONCE		0x01	/* run the schedule table once		 */
+
+/** argument of M77_LIN_SET / M77_LIN_GET */
+struct m77_lin {
+	unsigned char	enable;		/* 1: LIN master, (re)start the table	*/
+	unsigned char	breakBits;	/* break length, 0 = 13, max. 26		*/
+	unsigned char	delimBits;	/* break delimiter, 0 = 1, max. 4		*/
+	unsigned char	reserved;
+	unsigned int	flags;		/* M77_LIN_ONCE							*/
+	unsigned int	running;	/* GET: schedule table running			*/
+	unsigned int	frames;		/* GET: frames completed				*/
+	unsigned int	noResponse;	/* GET: frames without response			*/
+	unsigned int	checksumErrors;/* GET: bad response checksum		*/
+	unsigned int	bitErrors;	/* GET: header/data read back wrong		*/
+	unsigned int	resultsLost;/* GET: results not fetched in time		*/
+};
+
+/* struct m77_lin_entry dir */
+#define M77_LIN_SUBSCRIBE	0		/* master sends header, slave responds */
+#define M77_LIN_PUBLISH		1		/* master sends header and response	 */
+
+/* struct m77_lin_entry flags */
+#define M77_LIN_CLASSIC		0x01	/* classic checksum (LIN 1.x slave)	 */
+
+/** one frame slot of the schedule table */
+struct m77_lin_entry {
+	unsigned char	id;			/* frame identifier 0..0x3f				*/
+	unsigned char	dir;		/* M77_LIN_SUBSCRIBE / M77_LIN_PUBLISH	*/
+	unsigned char	len;		/* response data bytes 1..8				*/
+	unsigned char	flags;		/* M77_LIN_CLASSIC						*/
+	unsigned int	slotUs;		/* break to break of the next slot		*/
+	unsigned char	data[8];	/* response sent with M77_LIN_PUBLISH	*/
+};
+
+/** argument of M77_LIN_TABLE */
+struct m77_lin_table {
+	unsigned int	num;		/* number of entries used				*/
+	struct m77_lin_entry entry[M77_LIN_ENTRIES];
+};
+
+/* struct m77_lin_result status */
+#define M77_LIN_OK			0
+#define M77_LIN_NORESP		1		/* no response in the response window */
+#define M77_LIN_INCOMPLETE	2		/* response too short				 */
+#define M77_LIN_CHECKSUM	3		/* response checksum wrong			 */
+#define M77_LIN_BITERR		4		/* read back differs, framing error	 */
+
+/** argument of M77_LIN_RESULT, one per frame slot (oldest first) */
+struct m77_lin_result {
+	unsigned char	id;			/* frame identifier						*/
+	unsigned char	status;		/* M77_LIN_OK, M77_LIN_NORESP ...		*/
+	unsigned char	len;		/* response data bytes received			*/
+	unsigned char	reserved;
+	unsigned char	data[8];	/* response data						*/
+	unsigned int	tsSec;		/* start of break, CLOCK_MONOTONIC		*/
+	unsigned int	tsNsec;
+};
+
+#define M77_PRIO_NUM		8		/* priority frames queued per channel */
+#define M77_PRIO_MAX		128		/* max. length of a priority frame	 */
+
+/** argument of M77_PRIO_SEND: frame sent ahead of the written data */
+struct m77_prio_frame {
+	unsigned int	len;		/* frame length							*/
+	unsigned char	data[M77_PRIO_MAX];
+};
+
+/** argument of M77_PRIO_STATS: latency from M77_PRIO_SEND until the 1st
+ *  char is written to the TX FIFO */
+struct m77_prio_stats {
+	unsigned int	clear;		/* IN: 1 = reset statistics after reading */
+	unsigned int	count;		/* frames sent							*/
+	unsigned int	queued;		/* frames waiting						*/
+	unsigned int	full;		/* M77_PRIO_SEND refused, queue full	*/
+	unsigned int	lastNs;		/* latency of the last frame			*/
+	unsigned int	minNs;
+	unsigned int	maxNs;
+	unsigned int	avgNs;
+};
+
+/* struct m77_bridge flags */
+#define M77_BRIDGE_BIDIR	0x01	/* peer's RX is sent on this channel too */
+#define M77_BRIDGE_FLOW		0x02	/* hold RX while the peer's xmit is full */
+
+/** argument of M77_BRIDGE_SET/GET: chars received on this channel are sent
+ *  on the peer channel by the driver, the tty sees no RX data */
+struct m77_bridge {
+	unsigned int	enable;		/* 1: bridge on, 0: off (both directions) */
+	unsigned int	line;		/* peer channel, n of /dev/ttyDn		*/
+	unsigned int	flags;		/* M77_BRIDGE_BIDIR, M77_BRIDGE_FLOW	*/
+	unsigned int	forwarded;	/* OUT: chars put into the peer's xmit	*/
+	unsigned int	dropped;	/* OUT: chars lost, peer full or closed	*/
+	unsigned int	holds;		/* OUT: RX held by flow control			*/
+};
+
+#define M77_GROUPS			8		/* port groups						 */
+#define M77_GROUP_MAX		1024	/* max. length of a group write		 */
+
+/** argument of M77_GROUP_SET/GET: member channels of a group, bit n of
+ *  lines[n / 32] for /dev/ttyDn */
+struct m77_group {
+	unsigned int	group;		/* 0..M77_GROUPS-1						*/
+	unsigned int	lines[2];	/* member channels						*/
+};
+
+/** argument of M77_GROUP_WRITE: data queued on all members of a group */
+struct m77_group_write {
+	unsigned int	group;		/* 0..M77_GROUPS-1						*/
+	unsigned int	len;		/* data length							*/
+	unsigned int	queued[2];	/* OUT: channels the data was queued on	*/
+	unsigned char	data[M77_GROUP_MAX];
+};
+
+#define M77_CTL_NAME		"m77ctl"	/* control device, /dev/m77ctl	 */
+#define M77_BATCH_MAX		128		/* entries per M77_BATCH_IO			 */
+#define M77_BATCH_RING		4096	/* RX ring per attached channel		 */
+
+/** argument of M77_BATCH_ATTACH: channels whose RX is read through the 
+ *  control device instead of the tty, bit n of lines[n / 32] for 
+ *  /dev/ttyDn */
+struct m77_batch_lines {
+	unsigned int	lines[2];	/* IN: channels wanted, OUT: attached	*/
+};
+
+/* struct m77_batch_entry dir */
+#define M77_BATCH_READ		0
+#define M77_BATCH_WRITE		1
+
+/** one entry of M77_BATCH_IO */
+struct m77_batch_entry {
+	unsigned int	line;		/* channel, n of /dev/ttyDn				*/
+	unsigned int	dir;		/* M77_BATCH_READ or M77_BATCH_WRITE	*/
+	unsigned int	len;		/* buffer size / chars to write			*/
+	int				result;		/* OUT: chars done or negative errno	*/
+	unsigned long long buf;		/* user buffer address					*/
+};
+
+/* struct m77_batch flags */
+#define M77_BATCH_WAIT		0x01	/* wait until a read entry has data	 */
+
+/** argument of M77_BATCH_IO */
+struct m77_batch {
+	unsigned int	num;		/* number of entries					*/
+	unsigned int	flags;		/* M77_BATCH_WAIT						*/
+	unsigned int	timeoutMs;	/* for M77_BATCH_WAIT, 0 = forever		*/
+	unsigned int	reserved;
+	unsigned long long entries;	/* address of struct m77_batch_entry[num] */
+};
+
+#define M77_RAW_SIZE_DEFAULT 0x10000	/* data area of the raw ring		 */
+#define M77_RAW_SIZE_MAX	0x400000
+#define M77_RAW_DATA_OFF	4096	/* data area offset in the mapping	 */
+
+/* struct m77_raw flags */
+#define M77_RAW_CHUNKS		0x01	/* records with timestamp and LSR	 */
+
+/** argument of M77_RAW_SET/GET on /dev/m77ctl. The first M77_RAW_SET
+ *  binds the file to the channel and allocates the ring, mmap() of the
+ *  file maps it then: struct m77_raw_ring at offset 0, the data at
+ *  M77_RAW_DATA_OFF */
+struct m77_raw {
+	unsigned int	enable;		/* 1: raw mode, 0: back to tty mode		*/
+	unsigned int	line;		/* channel, n of /dev/ttyDn				*/
+	unsigned int	size;		/* data area, power of 2, 0 = default	*/
+	unsigned int	flags;		/* M77_RAW_CHUNKS						*/
+	unsigned int	lost;		/* OUT: chars lost, ring full			*/
+};
+
+/** header of the mapped raw ring, head and tail count bytes free running,
+ *  the offset in the data area is head/tail & (size - 1) */
+struct m77_raw_ring {
+	unsigned int	head;		/* written by the driver				*/
+	unsigned int	tail;		/* written by the reader				*/
+	unsigned int	size;		/* data area size						*/
+	unsigned int	flags;		/* M77_RAW_CHUNKS						*/
+	unsigned int	lost;		/* chars lost, ring full				*/
+};
+
+/** record in the raw ring with M77_RAW_CHUNKS, followed by len chars and
+ *  padding to a multiple of 4 bytes. Records wrap at the end of the ring */
+struct m77_raw_chunk {
+	unsigned int	tsSec;		/* 1st char received, CLOCK_MONOTONIC	*/
+	unsigned int	tsNsec;
+	unsigned short	len;		/* chars following						*/
+	unsigned char	lsr;		/* LSR errors (BI, FE, PE, OE) of chunk	*/
+	unsigned char	reserved;
+};
+
+/** argument of M77_TAP_SET/GET on /dev/m77ctl. The first M77_TAP_SET
+ *  allocates the tap ring (one for the driver), mmap() of the file maps
+ *  it: struct m77_raw_ring at offset 0, the records at M77_RAW_DATA_OFF */
+struct m77_tap {
+	unsigned int	lines[2];	/* tapped channels, bit n of lines[n / 32] */
+	unsigned int	size;		/* ring size, power of 2, 0 = default	*/
+	unsigned int	lost;		/* OUT: chars lost, ring full			*/
+};
+
+/* struct m77_tap_rec dir */
+#define M77_TAP_RX			0
+#define M77_TAP_TX			1
+
+/** record in the tap ring, followed by len chars and padding to a 
+ *  multiple of 4 bytes. Records wrap at the end of the ring */
+struct m77_tap_rec {
+	unsigned int	tsSec;		/* FIFO drained/loaded, CLOCK_MONOTONIC	*/
+	unsigned int	tsNsec;
+	unsigned char	line;		/* channel, n of /dev/ttyDn				*/
+	unsigned char	dir;		/* M77_TAP_RX or M77_TAP_TX				*/
+	unsigned char	lsr;		/* RX: LSR errors (BI, FE, PE, OE)		*/
+	unsigned char	reserved;
+	unsigned short	len;		/* chars following						*/
+	unsigned short	reserved2;
+};
+
+#define M77_RXTS_NUM		64		/* RX time stamps queued per channel */
+
+/** argument of M77_RXTS_SET */
+struct m77_rxts_set {
+	unsigned int	enable;		/* 1: stamp each RX interrupt, clears	*/
+};
+
+/** time stamp of the chars of one RX interrupt as passed to the tty */
+struct m77_rxts {
+	unsigned int	tsSec;		/* start of 1st char, CLOCK_MONOTONIC	*/
+	unsigned int	tsNsec;
+	unsigned int	pos;		/* chars passed to the tty before		*/
+	unsigned short	len;		/* chars stamped						*/
+	unsigned char	lsr;		/* UART_LSR_OE/PE/FE/BI of the chars	*/
+	unsigned char	reserved;
+};
+
+/** argument of M77_RXTS_READ, fetches the oldest stamps */
+struct m77_rxts_read {
+	unsigned int	num;		/* IN: max. stamps, OUT: stamps in ts	*/
+	unsigned int	enable;		/* OUT: M77_RXTS_SET state				*/
+	unsigned int	pos;		/* OUT: chars passed to the tty so far	*/
+	unsigned int	lost;		/* OUT: stamps overwritten, not fetched	*/
+	struct m77_rxts	ts[M77_RXTS_NUM];
+};
+
+#define M77_MSR_NUM			64		/* modem status events per channel	 */
+
+/* struct m77_msr_set flags */
+#define M77_MSR_PPS			0x01	/* register DCD as PPS source, 
+									   assert on DCD active				 */
+#define M77_MSR_PPS_CLEAR	0x02	/* PPS assert on DCD inactive		 */
+
+/** argument of M77_MSR_SET */
+struct m77_msr_set {
+	unsigned int	enable;		/* 1: queue MSR events, clears the queue	*/
+	unsigned int	flags;		/* M77_MSR_PPS...						*/
+};
+
+/** one modem status interrupt */
+struct m77_msr_event {
+	unsigned int	tsSec;		/* MSR read in the ISR, CLOCK_MONOTONIC	*/
+	unsigned int	tsNsec;
+	unsigned char	msr;		/* MSR: line states and UART_MSR_Dxxx	*/
+	unsigned char	reserved[3];
+};
+
+/** argument of M77_MSR_READ, fetches the oldest events */
+struct m77_msr_read {
+	unsigned int	num;		/* IN: max. events, OUT: events in ev	*/
+	unsigned int	enable;		/* OUT: M77_MSR_SET state				*/
+	unsigned int	flags;		/* OUT: M77_MSR_PPS... as registered	*/
+	unsigned int	lost;		/* OUT: events overwritten, not fetched	*/
+	struct m77_msr_event ev[M77_MSR_NUM];
+};
+
+/* struct m77_net flags */
+#define M77_NET_DELIM		0x01	/* delim ends a packet too			 */
+
+/** argument of M77_NET_SET on /dev/m77ctl: creates or removes the network
+ *  interface of a channel. Bringing it up takes the channel like an 
+ *  in-kernel client, packets are cut at an idle gap as with M77_IDLE_SET */
+struct m77_net {
+	unsigned int	line;		/* channel, n of /dev/ttyDn				*/
+	unsigned int	enable;		/* 1: create interface, 0: remove it	*/
+	unsigned int	baud;		/* baud rate, 0 = 9600					*/
+	unsigned char	unit;		/* M77_IDLE_BITS or M77_IDLE_US			*/
+	unsigned char	delim;		/* packet end char with M77_NET_DELIM	*/
+	unsigned char	reserved[2];
+	unsigned int	gap;		/* line idle time ending a packet		*/
+	unsigned int	flags;		/* M77_NET_DELIM						*/
+	char			name[16];	/* OUT: interface name					*/
+};
+
+/* struct m77_bpf type */
+#define M77_BPF_NONE		0		/* no filter, SET: detach it		 */
+#define M77_BPF_CLASSIC		1		/* classic BPF as SO_ATTACH_FILTER	 */
+#define M77_BPF_EBPF		2		/* BPF_PROG_TYPE_SOCKET_FILTER		 */
+
+/** argument of M77_BPF_SET/GET: filter program run on each received 
+ *  frame before it is passed to the tty. As for sockets it returns the
+ *  chars to keep: 0 drops the frame, less than its length truncates it.
+ *  SET clears the counters */
+struct m77_bpf {
+	unsigned int	type;		/* M77_BPF_*							*/
+	int				fd;			/* M77_BPF_EBPF: program fd from bpf()	*/
+	unsigned int	len;		/* M77_BPF_CLASSIC: instructions		*/
+	unsigned int	reserved;
+	unsigned long long insns;	/* M77_BPF_CLASSIC: struct sock_filter[len] */
+	unsigned int	runs;		/* GET: frames filtered					*/
+	unsigned int	passed;		/* GET: frames passed whole				*/
+	unsigned int	truncated;	/* GET: frames passed truncated			*/
+	unsigned int	dropped;	/* GET: frames dropped					*/
+};
+
+/** argument of M77_RS485_STATS: turnaround from last stop bit to driver
+ *  disable, measured in software timed mode (RTS delays set or M45N
+ *  automatic tristate) only */
+struct m77_rs485_stats {
+	unsigned int	clear;		/* IN: 1 = reset statistics after reading */
+	unsigned int	swCtrl;		/* 1: driver switched by software timer	*/
+	unsigned int	count;		/* number of measured turnarounds		*/
+	unsigned int	lastNs;		/* last turnaround						*/
+	unsigned int	minNs;		/* shortest turnaround					*/
+	unsigned int	maxNs;		/* longest turnaround					*/
+	unsigned int	resNs;		/* resolution (end of stop bit polling)	*/
+};
+
 
 #endif /* _LINUX_SERIAL_M77_H */
 
@@ -111,6 +111,26 @@ crw-rw-r--  1 root root 19, 7 Jun 14  2007 /dev/ttyD7
 Code: M45_TIO_TRI_MODE    Arguments: 0 (Tristate off, normal Operation)
                                      1 (Tristate on, UART is idle)
 \endverbatim
+
+	On shared lines the driver can do this itself: with automatic tristate
+	the channel leaves tristate when transmission starts and goes back to
+	tristate when the transmitter is empty (end of last stop bit) plus an
+	optional guard time. This is done from the interrupt and a high 
+	resolution timer, the bus is released within about 1/4 character time.
+	M45_TIO_TRI_MODE is refused with EBUSY while the mode is active, the
+	release times can be read with M77_RS485_STATS (see \ref ioctl_rs485).
+	Channels 2/3, 4/5 and 6/7 share one TCR bit, so the mode is refused 
+	with EBUSY while the other channel of the pair is open, and opening
+	the other channel fails with EBUSY while it is on. The mode ends with
+	the last close of the channel. Switching it off leaves the channel out
+	of tristate. guardUs max. 4294967 (4.29 s).
+\verbatim
+Code: M45_TIO_TRI_AUTO_SET  Argument: struct m45_tri_auto *
+                                      enable: 1 = automatic, 0 = manual
+                                      guardUs: guard time after TEMT in us
+Code: M45_TIO_TRI_AUTO_GET  Argument: struct m45_tri_auto *, returns 
+                                      settings
+\endverbatim
 \n
     \subsection ioctl_m77 M77 ioctl codes
 
@@ -129,6 +149,617 @@ Code: M77_PHYS_INT_SET   Arguments:  M77_RS422_HD
 
     See LINUX/DRIVERS/M077/DRIVER/serial_m77.h for their definitions.
 
+    \subsection ioctl_inband In-band (XON/XOFF) flow control
+
+	XON/XOFF handshaking is done completely by the 16C954, the tty layer
+	never sees the flow characters. IXON lets the UART stop its transmitter
+	on a received XOFF1, IXOFF lets it send XOFF1/XON1 when its receive FIFO
+	passes the flow control thresholds, IXANY restarts the transmitter on any
+	received character. XON1/XOFF1 are the characters set with termios 
+	c_cc[VSTART]/c_cc[VSTOP] (e.g. 'stty start ^A stop ^B').
+	For peers using two-character sequences the second characters are set
+	with:
+\verbatim
+Code: M77_INBAND_SET     Argument: struct m77_inband *, mode is
+                                   M77_INBAND_SINGLE (XON2/XOFF2 unused) or
+                                   M77_INBAND_SEQ (XON1,XON2 / XOFF1,XOFF2)
+Code: M77_INBAND_GET     Argument: struct m77_inband *, returns settings and
+                                   xoffCount, the number of XOFFs received
+\endverbatim
+
+	When the reading application falls behind, the driver stops draining the
+	receive FIFO instead of dropping data. The FIFO then fills up and the
+	UART drops RTS (CRTSCTS, M45N/M69N) or sends XOFF (IXOFF) by itself.
+	Reception resumes as soon as the application reads again.
+
+    \subsection ioctl_multidrop 9-bit multidrop address filtering
+
+	On multidrop busses (e.g. M77 in RS485 HD mode) a channel can be put into
+	9-bit mode where address characters carry a set 9th bit. The UART
+	compares received address characters against one or two own station
+	addresses; only data following a matching address is passed to the
+	application, the address characters themselves are never passed up.
+	With flag M77_MD_HWGATE the receiver is kept disabled until the UART 
+	signals a matching address, so frames for other stations cause no
+	interrupts at all. In this case the interrupt latency must be below
+	one character time, else the first data byte of a frame is lost.
+	While the mode is active the termios parity setting and IXON/IXOFF are
+	ignored, transmitted characters are sent with the 9th bit cleared.
+\verbatim
+Code: M77_MULTIDROP_SET  Argument: struct m77_multidrop *
+                                   enable: 1 = 9-bit mode, 0 = normal mode
+                                   nrAddr, addr[]: own station address(es)
+                                   flags: M77_MD_HWGATE
+Code: M77_MULTIDROP_GET  Argument: struct m77_multidrop *, returns settings
+                                   and foreignCount, the number of frames
+                                   addressed to other stations (with
+                                   M77_MD_HWGATE only those seen while
+                                   the receiver is open, e.g. the one
+                                   ending a frame for this station)
+\endverbatim
+
+    \subsection ioctl_delim Delimiter wakeup
+
+	Normally received data is passed to the line discipline on every RX
+	interrupt, so a blocking read() may return with only a part of a
+	telegram. In delimiter mode the UART watches for a frame delimiter
+	character (e.g. '\\n' or ETX) as special character and the data is
+	passed up when the delimiter arrives. If the line stays idle for idleUs
+	microseconds without delimiter, the data received so far is passed up
+	anyway. The delimiter itself remains part of the data. The mode uses the
+	XOFF2 special character, so it can't be combined with IXON/IXOFF or 
+	multidrop mode.
+\verbatim
+Code: M77_DELIM_SET  Argument: struct m77_delim *
+                               enable: 1 = delimiter mode, 0 = normal mode
+                               delim: frame delimiter character
+                               idleUs: idle time, 0 = 10ms default,
+                               max. 10s
+Code: M77_DELIM_GET  Argument: struct m77_delim *, returns settings and
+                               frameCount/idleCount, the number of wakeups
+                               on delimiter and on idle timeout
+\endverbatim
+
+    \subsection ioctl_frametx Gapless frame transmission
+
+	Protocols like Modbus RTU don't allow gaps between the chars of a 
+	frame. Normally the TX FIFO is refilled from the interrupt, so a frame
+	can be split on the line when the interrupt is delayed. In frame TX mode
+	data written while the transmitter is empty is first staged in the TX
+	FIFO with the transmitter disabled (ACR TXDIS) and then released at 
+	once, so frames up to 128 bytes (FIFO size) always go out back-to-back.
+	Longer frames are refilled when the FIFO falls to the TX trigger level
+	ttl, so the interrupt has ttl character times to respond. A FIFO that 
+	ran empty within a frame is counted as underrun.
+	Write each frame with a single write() call.
+\verbatim
+Code: M77_FRAMETX_SET  Argument: struct m77_frametx *
+                                 enable: 1 = frame TX mode, 0 = normal
+                                 ttl: TX trigger level, 0 = 96 chars
+Code: M77_FRAMETX_GET  Argument: struct m77_frametx *, returns settings
+                                 and the counters frames and underruns
+\endverbatim
+
+    \subsection ioctl_rtu Modbus RTU frame mode
+
+	In Modbus RTU frames are separated by a line idle time of 3.5 char times
+	(t3.5), chars within a frame must not have gaps above 1.5 char times
+	(t1.5). Above 19200 baud fixed times of 1750us and 750us are used. This
+	can hardly be detected by the application through the tty layer. In 
+	RTU mode the driver collects the received chars and passes the frame 
+	up in one go when the line was idle for t3.5, so a blocking read() wakes
+	up once per frame and returns the complete frame. The time of the last
+	char is taken in the interrupt (for RX timeout interrupts corrected by
+	4 char times) and a high resolution timer fires t3.5 later. Frames 
+	with gaps above t1.5 are flagged.
+	The CRC-16 of each frame is checked. Frames with bad CRC are passed up
+	with the last char marked as framing error (seen with PARMRK), or are 
+	discarded with flag M77_RTU_CRCDROP. Transmission uses the frame TX mode
+	(see \ref ioctl_frametx), so sent frames up to 128 bytes have no gaps.
+	The mode can't be combined with the delimiter wakeup and the 9-bit
+	multidrop address filter (EBUSY). Chars with errors ignored by 
+	IGNBRK/IGNPAR are left out of the frame as on the tty.
+
+	For each frame passed up a struct m77_frame_info with length and status
+	is queued (up to 32), fetched with M77_FRAME_INFO (EAGAIN if empty). The
+	application can use it to split the data read into frames in any case.
+\verbatim
+Code: M77_RTU_SET     Argument: struct m77_rtu *
+                                enable: 1 = RTU mode, 0 = off
+                                flags: M77_RTU_CRCDROP
+                                t15Us, t35Us: gap times, 0 = Modbus values,
+                                at most 1s
+Code: M77_RTU_GET     Argument: struct m77_rtu *, returns settings (times
+                                in use) and the counters frames, crcErrors,
+                                t15Errors and infoLost
+Code: M77_FRAME_INFO  Argument: struct m77_frame_info *, returns len, flags
+                                (M77_FRM_CRCERR, _T15, _TRUNC), lsr
+                                (error bits) and the start time tsSec/tsNsec
+                                (CLOCK_MONOTONIC) of the oldest frame
+\endverbatim
+
+    \subsection ioctl_idle Idle gap telegram mode
+
+	Many field bus protocols without a fixed frame format delimit telegrams
+	by a line idle time only. The idle gap mode works like the Modbus RTU
+	mode, but telegrams are cut at a configurable idle gap, given in bit
+	times of the current baudrate (kept when the baudrate changes) or in
+	microseconds, and a CRC is checked only if set with M77_CRC_SET. The start of the 1st char of each
+	telegram is taken back from the interrupt time by the number of chars
+	read, it is returned with the LSR error bits of the telegram by 
+	M77_FRAME_INFO. A read() returns exactly one telegram as long as each 
+	telegram is read before the next one is complete, else the lengths of
+	the frame infos split the data.
+	Gaps shorter than the RX FIFO timeout (4 char times) are found by the
+	high resolution timer polling the FIFO. Transmission uses the frame TX
+	mode. Switching between RTU and idle gap mode passes up the telegram 
+	received so far. The same restrictions as for RTU mode apply.
+\verbatim
+Code: M77_IDLE_SET    Argument: struct m77_idle *
+                                enable: 1 = idle gap mode, 0 = off
+                                unit: M77_IDLE_BITS or M77_IDLE_US
+                                gap: idle time ending a telegram (max. 1s)
+Code: M77_IDLE_GET    Argument: struct m77_idle *, returns settings, gapUs
+                                (gap in use) and the counters telegrams and
+                                infoLost
+\endverbatim
+
+    \subsection ioctl_crc CRC check of received frames
+
+	In idle gap mode the driver can check the CRC at the end of each 
+	telegram, so the application doesn't have to compute it again. The CRC
+	is computed incrementally over the chars of each receive interrupt 
+	while they are collected, with the CRC library of the kernel (crc16(),
+	crc_itu_t(), crc32_le()), and is compared with the residue of
+	a good frame when the telegram ends. The CRC is expected at the end of
+	the telegram as usual for the type: CRC-16/MODBUS and CRC-32 low byte
+	first, CRC-16/CCITT (CCITT-FALSE) high byte first.
+	The result is returned in the frame info (M77_FRM_CRCOK or 
+	M77_FRM_CRCERR), bad frames are passed up with the last char marked 
+	as framing error or are discarded with flag M77_CRC_DROP (in RTU mode 
+	too). Modbus RTU mode always checks CRC-16/MODBUS.
+	The kernel must be built with CONFIG_CRC16, CONFIG_CRC_ITU_T and 
+	CONFIG_CRC32. TEST/m77_crccheck.c checks the init values and the 
+	residues the driver uses against bitwise reference CRCs.
+\verbatim
+Code: M77_CRC_SET     Argument: struct m77_crc *
+                                type: M77_CRC_NONE, M77_CRC16_MODBUS,
+                                      M77_CRC16_CCITT or M77_CRC32
+                                flags: M77_CRC_DROP
+                                the counters are reset
+Code: M77_CRC_GET     Argument: struct m77_crc *, returns settings and the
+                                counters good, bad and dropped
+\endverbatim
+
+    \subsection ioctl_sched Time triggered transmission
+
+	Poll frames which must go out on strict periodic schedules can be 
+	registered in up to 8 slots per channel. The driver sends them from a
+	high resolution timer, without any application involvement: a slot is
+	either cyclic with a period (min. 100us) and a phase, or is sent once
+	at an absolute CLOCK_MONOTONIC time. Cyclic slots are aligned to
+	multiples of the period (plus phase) of CLOCK_MONOTONIC, so slots with
+	the same period and phase run in step on all channels.
+	When the transmitter is free the frame is written into the TX FIFO
+	directly from the timer, else it is loaded with the next TX interrupt
+	ahead of the data written with write(). In frame TX mode (see
+	\ref ioctl_frametx, also used by the frame modes) a frame written 
+	with write() is completed first, without it the driver doesn't know 
+	where written frames end and a scheduled frame may go out between 
+	their chars, which corrupts both on a shared line. A slot whose last frame is still
+	queued skips the cycle (counted as missed). RS485 driver control works
+	as for written data.
+	For each slot the time the 1st char was written into the TX FIFO is 
+	returned, with the delay to the scheduled time (last, min., max.), so
+	the jitter can be measured. If chars were still in the FIFO the frame
+	starts on the line correspondingly later.
+	Closing the device removes all slots.
+\verbatim
+Code: M77_SCHED_SET   Argument: struct m77_sched_slot *
+                                slot: 0..7, enable: 1 = set, 0 = remove
+                                flags: M77_SCHED_ONESHOT, else cyclic
+                                startSec, startNsec: one-shot TX time
+                                periodUs, phaseUs: cyclic timing
+                                len, data: frame (max. 128 bytes)
+                                EBUSY while the slot's frame is queued
+Code: M77_SCHED_STAT  Argument: struct m77_sched_stat *
+                                slot: slot number, clear: 1 = reset
+                                returns enable, count, missed, lastSec,
+                                lastNsec (TX time) and lateNs, minLateNs,
+                                maxLateNs (TX time - scheduled time)
+\endverbatim
+
+    \subsection ioctl_prio Priority TX queue
+
+	Urgent frames can be passed to the driver with M77_PRIO_SEND instead of
+	write(). They are queued in a separate queue of 8 frames (max. 128 
+	bytes each) and go out with the next load of the TX FIFO, ahead of all
+	data still waiting in the transmit buffer (up to 4kB) which continues 
+	behind them. Only the chars already in the TX FIFO are sent first. A 
+	priority frame is never split by written data. In frame TX mode (see
+	\ref ioctl_frametx, also used by the frame modes) a frame written 
+	with write() is not split either, the priority frame follows at its 
+	end. Without it the driver doesn't know where written frames end. 
+	Scheduled frames (see
+	\ref ioctl_sched) which are due have precedence.
+	The latency from M77_PRIO_SEND until the 1st char is written into the
+	TX FIFO is measured for each frame. M77_PRIO_SEND returns EAGAIN when
+	the queue is full.
+\verbatim
+Code: M77_PRIO_SEND   Argument: struct m77_prio_frame *
+                                len, data: frame (max. 128 bytes)
+Code: M77_PRIO_STATS  Argument: struct m77_prio_stats *
+                                clear: 1 = reset statistics after reading
+                                returns count, queued, full and the 
+                                latencies lastNs, minNs, maxNs and avgNs
+\endverbatim
+
+    \subsection ioctl_bridge Port-to-port bridge
+
+	M77_BRIDGE_SET connects a channel to a peer channel (n of /dev/ttyDn,
+	also on another M-Module) inside the driver: the chars drained from the
+	RX FIFO in the interrupt are put straight into the transmit buffer of
+	the peer and its TX FIFO is loaded in the same interrupt, without a
+	round trip through the tty layer and a user process. The tty of the
+	bridged channel sees no RX data. With M77_BRIDGE_BIDIR the peer's RX is
+	sent on this channel too. Both channels must be open, baud rates may 
+	differ. The chars are forwarded as they are, errors are counted only.
+	Data written to the peer is mixed with the forwarded chars.
+	Without M77_BRIDGE_FLOW chars are dropped when the peer's transmit 
+	buffer (4kB) is full, e.g. if the peer is slower. With M77_BRIDGE_FLOW 
+	the RX FIFO is not drained any more then, until half of the peer's 
+	buffer is free again; with RTS/CTS or XON/XOFF set by termios on the 
+	receiving channel the UART stops the sender by itself.
+	The bridge is removed (both directions) with enable = 0 or when one of
+	the channels is closed. As it takes over the peer channel, which may
+	be open by another user, setting up a bridge needs CAP_SYS_ADMIN.
+	Frame modes, LIN master and delimiter wakeup
+	can't be used on a bridged channel.
+\verbatim
+Code: M77_BRIDGE_SET  Argument: struct m77_bridge *
+                                enable: 1 = bridge on, 0 = off
+                                line: peer channel
+                                flags: M77_BRIDGE_BIDIR, M77_BRIDGE_FLOW
+Code: M77_BRIDGE_GET  Argument: struct m77_bridge *
+                                returns the settings and the counters
+                                forwarded, dropped and holds
+\endverbatim
+
+    \subsection ioctl_group Port groups
+
+	To send the same telegram on many channels (e.g. separate RS485 
+	segments) up to 8 groups of channels can be defined with M77_GROUP_SET.
+	A single M77_GROUP_WRITE on any open channel of the driver then copies
+	the data (max. 1024 bytes) into the transmit buffer of every open
+	member and starts the transmitters together afterwards, so all TX
+	FIFOs are loaded in one pass of the interrupt handler. A member is
+	skipped if it is closed or its transmit buffer has no room for all of 
+	the data, queued returns the channels the data was queued on.
+	The groups are kept until the driver is unloaded. They are shared by
+	all users of the driver, so M77_GROUP_SET and M77_GROUP_WRITE need 
+	CAP_SYS_ADMIN.
+\verbatim
+Code: M77_GROUP_SET    Argument: struct m77_group *
+                                 group: 0..7
+                                 lines: bit n of lines[n / 32] = /dev/ttyDn
+Code: M77_GROUP_GET    Argument: struct m77_group *
+                                 group: 0..7, returns lines
+Code: M77_GROUP_WRITE  Argument: struct m77_group_write *
+                                 group, len, data: data to send
+                                 returns queued
+\endverbatim
+
+    \subsection ioctl_batch Batched I/O on many channels
+
+	Gateways serving many channels can do the reads and writes of all of
+	them with one ioctl on the control device /dev/m77ctl, instead of a
+	read() or write() per channel. M77_BATCH_ATTACH selects the channels
+	(all open) whose received data is read through the control device; it
+	goes into a 4kB ring per channel then instead of to the tty. Channels
+	not selected are given back to their tty. A channel belongs to the 
+	file which attached it, for other files it is not attached (EBUSY).
+	An attached channel is detached when it or the file is closed, frame
+	modes, LIN master, delimiter wakeup and the bridge can't be used on it.
+	M77_BATCH_IO takes up to 128 entries (line, direction, buffer, length)
+	and does them in order. Writes go into the transmit buffer of the
+	channel as with write(), reads take what is in the ring; neither waits,
+	each entry returns the chars done or a negative error number in result.
+	With M77_BATCH_WAIT the call sleeps first until one of the read entries
+	has data or timeoutMs passed. See TEST/m77_batch.c for an example.
+\verbatim
+Code: M77_BATCH_ATTACH  Argument: struct m77_batch_lines *
+                                  lines: bit n of lines[n / 32] = /dev/ttyDn
+                                  returns the channels attached
+Code: M77_BATCH_IO      Argument: struct m77_batch *
+                                  num, entries: struct m77_batch_entry[num]
+                                  flags: M77_BATCH_WAIT
+                                  timeoutMs: max. wait, 0 = forever
+\endverbatim
+
+    \subsection ioctl_raw Raw RX ring (mmap)
+
+	For high rate capture the received data can bypass the tty layer: a
+	file of the control device /dev/m77ctl is bound to a channel with
+	M77_RAW_SET, which allocates a ring (64kB default, power of 2 up to
+	4MB). mmap() of the file maps it: struct m77_raw_ring at offset 0, the
+	data at M77_RAW_DATA_OFF. In raw mode the interrupt handler copies the
+	chars of each RX interrupt straight into the ring and advances head,
+	the reader consumes up to head and advances tail itself. poll() on the
+	file is the only syscall needed, it returns POLLIN while the ring is 
+	not empty and POLLHUP when the channel left raw mode (M77_RAW_SET with
+	enable = 0 or the tty was closed).
+	Without flags the ring holds the plain chars. With M77_RAW_CHUNKS each
+	RX interrupt adds a struct m77_raw_chunk with the time of its 1st char
+	(CLOCK_MONOTONIC, as for frame infos) and its LSR errors, followed by
+	the chars, padded to 4 bytes; records wrap at the end of the ring.
+	Data not fitting into the ring is counted in lost. The tty must stay
+	open, it sets up the channel; it sees no RX data while in raw mode.
+	Raw mode is switched off when the bound file is closed, the other
+	modes which use the received chars can't be used meanwhile.
+	See TEST/m77_raw.c for a reader.
+\verbatim
+Code: M77_RAW_SET  Argument: struct m77_raw *  (on /dev/m77ctl)
+                             enable: 1 = raw mode, 0 = tty mode
+                             line, size: fixed by the first call
+                             flags: M77_RAW_CHUNKS
+Code: M77_RAW_GET  Argument: struct m77_raw *
+                             returns the settings and lost
+\endverbatim
+
+    \subsection ioctl_tap Traffic tap
+
+	RX and TX of any set of channels can be traced into one ring, e.g. to
+	look at a master and its slaves side by side. M77_TAP_SET on a file of
+	/dev/m77ctl allocates the ring (sizes as for raw mode) and selects the
+	channels; mmap() and poll() work as for raw mode. Each FIFO load of
+	the transmitter and the chars of each RX interrupt give one struct
+	m77_tap_rec with the time stamp, taken in the interrupt handler right
+	after the FIFO was drained or loaded, the channel, the direction and
+	for RX the LSR errors, followed by the chars padded to 4 bytes.
+	The tap sees the chars of all modes, the tty or the other modes still
+	get their data. There is one tap at a time, it ends when its file is
+	closed. Records not fitting into the ring are counted in lost. Without
+	a tap the interrupt paths see a static branch only (jump label).
+	See TEST/m77_tap.c for a decoder.
+\verbatim
+Code: M77_TAP_SET  Argument: struct m77_tap *  (on /dev/m77ctl)
+                             lines: tapped channels, 0 = none
+                             size: fixed by the first call
+Code: M77_TAP_GET  Argument: struct m77_tap *
+                             returns the settings and lost
+\endverbatim
+
+    \subsection ioctl_rxts RX time stamps
+
+	The tty loses the arrival time of the chars, a stamp taken after
+	read() adds the scheduling latency. With M77_RXTS_SET the interrupt
+	handler stamps the chars of each RX interrupt it passes to the tty 
+	and queues a struct m77_rxts per interrupt (up to M77_RXTS_NUM, the
+	oldest is overwritten and counted in lost). M77_RXTS_READ fetches the
+	stamps in bulk. A stamp refers to the chars by pos, the number of
+	chars passed to the tty since M77_RXTS_SET, so the application counts
+	the chars it read to match them. M77_RXTS_SET clears the queue and
+	restarts pos at 0, a flush of the tty input breaks the match.
+	The time is taken in receive_chars() right before the FIFO is drained;
+	between ISR entry and it are the reads of the CPLD interrupt register
+	and of the IIR/LSR of the channels checked before on the same module
+	(a few register accesses each), plus the drain of channels which had
+	data too, up to 128 chars each. This time is no error: the stamp is
+	moved back by the FIFO level at that moment (chars drained minus the
+	chars which arrived while draining) in char times, giving the start
+	of the 1st char within about one char time. For RX timeout interrupts
+	the 4 char idle time is subtracted too, the interrupt latency is then 
+	part of the error. Frame and telegram modes have their own stamps in
+	the frame infos, raw mode in its chunks.
+\verbatim
+Code: M77_RXTS_SET   Argument: struct m77_rxts_set *
+                               enable: 1 = stamp RX, 0 = off
+Code: M77_RXTS_READ  Argument: struct m77_rxts_read *
+                               num: IN max. stamps, OUT stamps in ts
+                               returns pos and lost
+\endverbatim
+
+    \subsection ioctl_msr Modem status events and PPS
+
+	TIOCMIWAIT wakes up on a modem line change but tells neither when it
+	happened nor how many changes there were. With M77_MSR_SET enable = 1
+	each modem status interrupt queues a struct m77_msr_event with the
+	MSR (line states and delta bits) and the time it was read in the 
+	interrupt handler, up to M77_MSR_NUM; the oldest is overwritten and
+	counted in lost. M77_MSR_READ fetches them in bulk, e.g. after 
+	TIOCMIWAIT. The modem status interrupt is enabled meanwhile, also
+	with CLOCAL and without CRTSCTS. A change read by TIOCMGET before the
+	interrupt handler saw it is counted for the tty, but gives no event 
+	and no PPS edge, as its time is unknown.
+	With M77_MSR_PPS DCD is registered as kernel PPS source (/dev/ppsN,
+	kernel built with CONFIG_PPS), e.g. for the 1PPS output of a GPS
+	receiver. The PPS time stamp is the 1st thing taken by the interrupt
+	handler on a DCD change, before the RX FIFO is drained. Assert is DCD active, with M77_MSR_PPS_CLEAR
+	DCD inactive. Both need the tty kept open, the PPS source stays until
+	M77_MSR_SET without M77_MSR_PPS or the driver is unloaded.
+\verbatim
+Code: M77_MSR_SET   Argument: struct m77_msr_set *
+                              enable: 1 = queue events, 0 = off
+                              flags: M77_MSR_PPS, M77_MSR_PPS_CLEAR
+Code: M77_MSR_READ  Argument: struct m77_msr_read *
+                              num: IN max. events, OUT events in ev
+                              returns the settings and lost
+\endverbatim
+
+    \subsection ioctl_net Network interface (RS485 multidrop)
+
+	M77_NET_SET on /dev/m77ctl (CAP_NET_ADMIN) creates a network 
+	interface m77n<line> for a channel, e.g. the master of a RS485 
+	multidrop segment, so qdiscs, packet sockets and the kernel's 
+	batching apply. While the interface is up it owns the channel like an
+	in-kernel client (see \ref kclient), the tty can't be opened. The
+	frame engine runs in idle gap mode (see \ref ioctl_idle): a packet
+	ends when the line was idle for gap, with M77_NET_DELIM also behind
+	the char delim. Received packets have protocol ETH_P_SLIP, they are
+	read with a packet socket (ETH_P_ALL). Each packet sent is queued in
+	one go and goes out without gaps, the next one after the FIFO drained
+	and the line was idle for gap. Frames with LSR or CRC errors and 
+	frames longer than M77_FRAME_MAX are dropped. 
+	The interface is 8N1 at baud, RS485 mode, echo and a frame CRC are
+	set up through the tty before. Bringing it up fails with EBUSY while
+	the tty left a frame mode, multidrop or delimiter mode on; the idle 
+	gap setting of the tty is given back when the interface goes down.
+	A packet which doesn't go out within twice the time of M77_FRAME_MAX
+	chars plus 1 s (e.g. held by CTS) is dropped by the TX watchdog and 
+	counted in tx_errors.
+	Besides packets, bytes and drops the netdev stats (ip -s link) show:
+\verbatim
+rx_fifo_errors   UART overruns
+rx_over_errors   frames dropped for an overrun
+rx_frame_errors  frames dropped for parity, framing error or break
+rx_crc_errors    frames dropped for a bad CRC (M77_CRC_SET)
+rx_length_errors frames truncated to M77_FRAME_MAX
+collisions       garbled echoes in half duplex mode
+tx_window_errors RS485 turnarounds longer than gap, the driver 
+                 still drives when a slave may answer
+tx_errors        packets dropped by the TX watchdog
+\endverbatim
+\verbatim
+Code: M77_NET_SET   Argument: struct m77_net *
+                              line: channel
+                              enable: 1 = create, 0 = remove interface
+                              baud, unit, gap, flags, delim
+                              OUT: name of the interface
+\endverbatim
+	See TEST/m77_net.c, e.g. m77_net -b 115200 3; ip link set m77n3 up
+
+    \subsection ioctl_bpf BPF receive filter
+
+	A BPF program can be attached per channel to filter the frames of 
+	idle gap and Modbus RTU mode (see \ref ioctl_idle) before they reach
+	the tty, e.g. to drop the traffic of other slaves on a busy bus
+	without waking up the application. The interrupt handler runs it on
+	each complete frame (after the CRC check), the frame starts at offset
+	0. As for socket filters the program returns the chars to keep: 0
+	drops the frame, less than its length truncates it, else it is passed
+	whole. A classic filter is given like SO_ATTACH_FILTER 
+	(M77_BPF_CLASSIC, struct sock_filter array), an eBPF program of type
+	BPF_PROG_TYPE_SOCKET_FILTER by its fd (M77_BPF_EBPF). M77_BPF_GET 
+	returns the hit counters of the program, M77_BPF_SET clears them. The
+	filter stays until M77_BPF_NONE is set or the tty is closed. 
+	M77_BPF_SET needs CAP_NET_ADMIN. Kernels from 4.10 on. See 
+	TEST/m77_bpf.c.
+\verbatim
+Code: M77_BPF_SET   Argument: struct m77_bpf *
+                              type: M77_BPF_NONE, M77_BPF_CLASSIC or
+                              M77_BPF_EBPF, fd or len/insns
+Code: M77_BPF_GET   Argument: struct m77_bpf *
+                              returns type, runs, passed, truncated and
+                              dropped
+\endverbatim
+
+    \subsection ioctl_lin LIN master
+
+	In LIN master mode the driver runs a schedule table of up to 16 frame
+	slots on its own, each slot hits its timing without any application 
+	involvement. For each slot the driver puts the break on the line 
+	(LCR[SBC]) for 13 bit times or more, followed by the break delimiter,
+	both timed by a high resolution timer, then sends sync (0x55) and the 
+	protected identifier. For M77_LIN_PUBLISH entries the master sends the
+	response data with checksum right behind the header, for
+	M77_LIN_SUBSCRIBE a slave responds. The response window ends 1.4 times
+	the nominal frame time after the start of the break (LIN 2.x). The 
+	enhanced checksum is used, except for the diagnostic frames 0x3c/0x3d
+	and entries flagged M77_LIN_CLASSIC. The next slot starts slotUs after
+	the break of the current one.
+	Header and published data are read back from the bus and compared, so 
+	the receive line must see the own transmission (LIN transceiver, M77 
+	with echo enabled). The result of each slot is queued (up to 32) with 
+	the response data and the time of the break and is fetched with 
+	M77_LIN_RESULT (EAGAIN if empty).
+	While the mode is on the RX trigger level is 1, received chars aren't
+	passed to the tty and written data is held back until the mode is
+	switched off. The mode can't be combined with the frame modes, the 
+	delimiter wakeup, 9-bit multidrop or echo cancellation, nor with 
+	scheduled or priority frames, a bridge, raw or batch I/O or an 
+	in-kernel client (EBUSY). Scheduled and priority frames are refused
+	while it is on. The baudrate
+	(usually 19200) is set with termios as usual.
+\verbatim
+Code: M77_LIN_TABLE   Argument: struct m77_lin_table *
+                                num: entries used (max. 16), per entry:
+                                id (0..0x3f), dir (M77_LIN_SUBSCRIBE or 
+                                M77_LIN_PUBLISH), len (1..8), flags 
+                                (M77_LIN_CLASSIC), slotUs, data
+                                EBUSY while the table runs
+Code: M77_LIN_SET     Argument: struct m77_lin *
+                                enable: 1 = (re)start the table, 0 = off
+                                breakBits: 13..26 (0 = 13)
+                                delimBits: 1..4 (0 = 1)
+                                flags: M77_LIN_ONCE = run the table once
+Code: M77_LIN_GET     Argument: struct m77_lin *, returns settings, running
+                                and the counters frames, noResponse,
+                                checksumErrors, bitErrors and resultsLost
+Code: M77_LIN_RESULT  Argument: struct m77_lin_result *, returns id, status
+                                (M77_LIN_OK, _NORESP, _INCOMPLETE, 
+                                _CHECKSUM, _BITERR), len, data and time of
+                                the break tsSec/tsNsec of the oldest slot
+\endverbatim
+
+    \subsection ioctl_echo Echo cancellation
+
+	In half duplex modes with echo on every transmitted char comes back in
+	the receive FIFO. With echo cancellation the driver keeps a copy of
+	the sent chars and drops their echoes already in the interrupt routine,
+	so the application reads only the chars of the other stations. An echo
+	which differs from the sent char or has a framing/parity error means
+	that another station sent at the same time (bus collision). Such 
+	collisions are counted, with flag M77_ECHO_MARKERR the garbled echo is
+	also passed up marked as framing error. Echoes not received within the
+	expected time (e.g. lost in an overrun) are counted as lost.
+	On M77 the receive line (DCR[RX_EN]) is switched on while the mode is
+	active and M77_ECHO_SUPPRESS 0 is refused with EBUSY.
+\verbatim
+Code: M77_ECHO_CANCEL_SET  Argument: struct m77_echo *
+                                     enable: 1 = drop echoes, 0 = off
+                                     flags: M77_ECHO_MARKERR
+Code: M77_ECHO_CANCEL_GET  Argument: struct m77_echo *, returns settings,
+                                     collision (since last GET), and the
+                                     counters echoCount, collisions and
+                                     lostCount
+\endverbatim
+
+    \subsection ioctl_rs485 Standard RS485 settings (TIOCSRS485)
+
+	On M77 the standard Linux ioctls TIOCSRS485/TIOCGRS485 with struct 
+	serial_rs485 are supported, so tools and libraries using them can switch
+	a channel to RS485. Setting SER_RS485_ENABLED puts the channel into 
+	RS485 HD mode, SER_RS485_RX_DURING_TX turns on the receive line while
+	sending (echo, same as M77_ECHO_SUPPRESS with 1). Clearing 
+	SER_RS485_ENABLED restores the PHY mode used before. M77_PHYS_INT_SET is
+	refused with EBUSY while RS485 is enabled this way. RS485 HD set with
+	the mode parameter or M77_PHYS_INT_SET is reported by TIOCGRS485 as
+	enabled too, M77_PHYS_INT_SET can switch it as before.
+
+	Without RTS delays the UART switches the line driver itself, exactly at
+	the end of the last stop bit. SER_RS485_RTS_ON_SEND (default) or 
+	SER_RS485_RTS_AFTER_SEND select the polarity of the driver enable.
+	When delay_rts_before_send or delay_rts_after_send (ms, max. 100) are 
+	set, the driver enable is switched by the driver using high resolution
+	timers. As the UART has no interrupt for an empty shift register, the
+	end of the last stop bit is then found by polling LSR[TEMT] with 1/4 
+	character time resolution. M77 has no switchable bus termination, so
+	SER_RS485_TERMINATE_BUS is always returned cleared.
+
+	In software timed mode the time from the end of the last stop bit to
+	driver disable can be read with M77_RS485_STATS to tune the bus 
+	timing. It is measured from the poll which found LSR[TEMT] set, the 
+	stop bit ended up to resNs before. Without RTS delays the UART 
+	switches at the end of the stop bit itself, there is nothing to 
+	measure and the statistics stay empty (swCtrl 0):
+\verbatim
+Code: M77_RS485_STATS  Argument: struct m77_rs485_stats *
+                                 clear: 1 = reset statistics after reading
+                                 returns swCtrl (software timed mode), count,
+                                 lastNs, minNs, maxNs of the turnaround and
+                                 resNs, the measurement resolution
+\endverbatim
+
 	\n \section parameter Module Parameter
 
     The driver supports the same Parameters as the previous kernel-2.4-only
@@ -150,6 +781,15 @@ Code: M77_PHYS_INT_SET   Arguments:  M77_RS422_HD
 	- echo
 	  disable/enable receive line of a M77 channelin HD modes
 
+	- kclient
+	  channels of in-kernel clients, name:line[:baud], see \ref kclient
+
+	- uio
+	  1 hands the Module to userspace through UIO, see \ref uio
+
+	- uioaddr
+	  physical address of the register window of a uio=1 Module
+
 	\subsection Examples For Module loading
 
 	The following examples explain passing the Parameters when loading the
@@ -183,6 +823,55 @@ modprobe men_lx_m77 devName=m77_1 brdName=d203_a24_1 slotNo=2 mode=1,1,7,7 echo=
 \endverbatim
     For M69N and M45N the mode and echo Parameters are ignored.
 
+	\n \section kclient In-kernel clients (serdev like)
+
+	Kernel modules (GNSS, HCI like protocols, own protocol modules) can
+	use a channel without tty, line discipline or userspace daemon, with
+	the interface in m77_kclient.h which follows serdev. serdev itself 
+	binds its clients by device tree or ACPI, which the M-Modules don't
+	have; here the kclient module parameter assigns a channel and a baud
+	rate to a client name. The client calls m77_kclient_open() with that
+	name and gets the chars of each RX interrupt in its receive_buf 
+	callback, called from the interrupt handler; m77_kclient_write() 
+	queues chars for sending from any context. The tty of the channel
+	can't be opened while a client has it and vice versa. The ioctl
+	modes of the tty are not available to the client, the traffic tap
+	works. Kernels from 2.6.32 on.
+\verbatim
+modprobe men_lx_m77 devName=m45_1 brdName=d201_1 slotNo=1 kclient=gnss:3:9600
+\endverbatim
+
+	\n \section uio UIO mode
+
+	With uio=1 for a Module the driver only does the MDIS bring-up 
+	(carrier, DCR/TCR, CPLD) and creates no ttyD of its channels. The
+	register window and the interrupt of the Module go to userspace as
+	/dev/uioN, named after devName in /sys/class/uio/uioN/name. The
+	window is map 0. MDIS hands out the ioremapped window only, so its
+	physical address is passed with uioaddr= (carrier BAR from lspci -v
+	plus the slot offset of the carrier). mmap() maps whole pages, so
+	the carrier must place the slot at a page of its own: the driver
+	refuses UIO for a Module without uioaddr, whose window doesn't start
+	a page or shares it with another Module of the driver. A refused
+	Module gets its ttyD channels as without uio=1. Other slots of the
+	carrier in the same page can't be seen by the driver, don't use UIO
+	on such carriers. The registers are 16 bit wide, a 16C950 register
+	is at (channel base + (reg << 1)) as in the driver, see 
+	TEST/m77_uio_lib.c. Writing 1 to /dev/uioN unmasks the interrupt of
+	the Module, reading blocks until it came; the driver masks it again
+	in its handler. The other Modules of the driver load stay ttys.
+	Kernels from 3.10 on with CONFIG_UIO.
+\verbatim
+modprobe men_lx_m77 devName=m77_1,m77_2 brdName=d201_1,d201_1 slotNo=0,1 uio=0,1 uioaddr=0,0xe8001000
+\endverbatim
+	TEST/m77_uiobench compares the round trip latency of UIO polling,
+	UIO interrupts (-i) and the tty, e.g. with a null modem cable 
+	between channel 0 and 1 of each Module:
+\verbatim
+m77_uiobench -n 10000 -b 115200 -u m77_2 0 1
+m77_uiobench -n 10000 -b 115200 -t 0 1
+\endverbatim
+
 	\n \section trouble Troubleshooting
 
 	In case of problems with using the driver there are some points that should